@@ -71,6 +71,7 @@ int main(int argc, char *argv[]) {
     bool cluster_leaves = true;
     int32 max_leaves_first = 1000;
     int32 max_leaves_second = 5000;
+    int32 num_threads = 1;
     std::string occs_out_filename;
 
     ParseOptions po(usage);
@@ -85,6 +86,9 @@ int main(int argc, char *argv[]) {
                 "leaves in second-level decision tree.");
     po.Register("cluster-leaves", &cluster_leaves, "If true, do a post-clustering"
                 " of the leaves of the final decision tree.");
+    po.Register("num-threads", &num_threads, "Number of threads used to "
+                "evaluate candidate splits and cluster leaves during "
+                "tree-building");
     
     po.Read(argc, argv);
 
@@ -155,7 +159,8 @@ int main(int argc, char *argv[]) {
                                max_leaves_second,
                                cluster_leaves,
                                P,
-                               &mapping);
+                               &mapping,
+                               num_threads);
 
     ContextDependency ctx_dep(N, P, to_pdf);  // takes ownership
     // of pointer "to_pdf", so set it NULL.
@@ -24,6 +24,7 @@
 #include "hmm/transition-model.h"
 #include "fstext/fstext-lib.h"
 #include "decoder/training-graph-compiler.h"
+#include "thread/kaldi-thread.h"
 
 
 int main(int argc, char *argv[]) {
@@ -52,6 +53,7 @@ int main(int argc, char *argv[]) {
 
     TrainingGraphCompilerOptions gopts;
     int32 batch_size = 250;
+    int32 num_threads = 1;
     gopts.transition_scale = 0.0;  // Change the default to 0.0 since we will generally add the
     // transition probs in the alignment phase (since they change each time)
     gopts.self_loop_scale = 0.0;  // Ditto for self-loop probs.
@@ -61,6 +63,9 @@ int main(int argc, char *argv[]) {
     po.Register("batch-size", &batch_size,
                 "Number of FSTs to compile at a time (more -> faster but uses "
                 "more memory.  E.g. 500");
+    po.Register("num-threads", &num_threads, "Number of threads used to "
+                "compile each batch of graphs (only relevant if "
+                "--batch-size > 1)");
     po.Register("read-disambig-syms", &disambig_rxfilename, "File containing "
                 "list of disambiguation symbols in phone symbol table");
     
@@ -70,6 +75,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    // CompileGraphs() uses g_num_threads; unlike its default, ours is 1.
+    g_num_threads = num_threads;
 
     std::string tree_rxfilename = po.GetArg(1);
     std::string model_rxfilename = po.GetArg(2);
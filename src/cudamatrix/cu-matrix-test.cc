@@ -1887,6 +1887,97 @@ static void UnitTestCuMatrixLookup() {
   }
 }
 
+template<typename Real>
+static void UnitTestCuMatrixSparse() {
+  for (int32 i = 0; i < 2; i++) {
+    int32 dimM = 10 + rand() % 50, dimN = 10 + rand() % 50,
+        dimK = 10 + rand() % 50;
+    std::vector<std::vector<std::pair<MatrixIndexT, Real> > > pairs(dimM);
+    for (int32 r = 0; r < dimM; r++)
+      for (int32 j = 0; j < rand() % 3; j++)
+        pairs[r].push_back(std::make_pair(rand() % dimN, RandGauss()));
+    SparseMatrix<Real> S(dimN, pairs);
+    Matrix<Real> S_dense(dimM, dimN);
+    S.CopyToMat(&S_dense);
+    CuMatrix<Real> S_cu(S_dense);
+
+    CuMatrix<Real> A(dimM, dimN), A2(dimM, dimN), B(dimN, dimK),
+        C(dimM, dimK), C2(dimM, dimK), D(dimK, dimM), E(dimK, dimN),
+        E2(dimK, dimN);
+    A.SetRandn();
+    B.SetRandn();
+    C.SetRandn();
+    D.SetRandn();
+    E.SetRandn();
+    A2.CopyFromMat(A);
+    C2.CopyFromMat(C);
+    E2.CopyFromMat(E);
+
+    A.AddSmat(0.5, S);
+    A2.AddMat(0.5, S_cu);
+    AssertEqual(A, A2);
+    C.AddSmatMat(2.0, S, kNoTrans, B, 0.5);
+    C2.AddMatMat(2.0, S_cu, kNoTrans, B, kNoTrans, 0.5);
+    AssertEqual(C, C2);
+    E.AddMatSmat(-1.0, D, S, kNoTrans, 1.0);
+    E2.AddMatMat(-1.0, D, kNoTrans, S_cu, kNoTrans, 1.0);
+    AssertEqual(E, E2);
+    AssertEqual(TraceMatSmat(A, S, kTrans), TraceMatMat(A, S_cu, kTrans));
+  }
+}
+
+// Checks that splitting the CPU versions of the row-wise operations across
+// threads gives the same results as not doing so.
+template<typename Real>
+static void UnitTestCuMatrixCpuThreads() {
+  for (int32 i = 0; i < 2; i++) {
+    int32 dimM = 10 + rand() % 50, dimN = 10 + rand() % 50;
+    CuMatrix<Real> src(dimM, dimN), diff(dimM, dimN), value(dimM, dimN);
+    CuVector<Real> row(dimN);
+    src.SetRandn();
+    diff.SetRandn();
+    value.SetRandUniform();
+    row.SetRandn();
+    std::vector<MatrixIndexT> reorder(dimM);
+    for (int32 r = 0; r < dimM; r++)
+      reorder[r] = rand() % (dimM + 1) - 1;  // -1 means set to zero.
+    std::vector<int32> tgt(dimM);
+    for (int32 r = 0; r < dimM; r++)
+      tgt[r] = rand() % dimN;
+    CuArray<int32> cu_tgt(tgt);
+
+    std::vector<CuMatrix<Real> > results(2, CuMatrix<Real>(dimM, 7 * dimN));
+    std::vector<CuVector<Real> > log_post(2);
+    std::vector<std::vector<int32> > max_ids(2);
+    for (int32 j = 0; j < 2; j++) {
+      if (j == 1) {
+        SetCuCpuNumThreads(4);
+        SetCuCpuMinElementsPerThread(1);
+      }
+      CuMatrix<Real> &ans = results[j];
+      ans.ColRange(0, dimN).ApplySoftMaxPerRow(src);
+      ans.ColRange(dimN, dimN).Sigmoid(src);
+      ans.ColRange(2 * dimN, dimN).Tanh(src);
+      ans.ColRange(3 * dimN, dimN).DiffSigmoid(value, diff);
+      ans.ColRange(4 * dimN, dimN).DiffTanh(value, diff);
+      ans.ColRange(5 * dimN, dimN).CopyFromMat(src);
+      ans.ColRange(5 * dimN, dimN).AddVecToRows(0.5, row, 2.0);
+      ans.ColRange(6 * dimN, dimN).CopyRows(src, reorder);
+      CuArray<int32> ids;
+      src.FindRowMaxId(&ids);
+      ids.CopyToVec(&(max_ids[j]));
+      CuMatrix<Real> post(ans.ColRange(0, dimN));
+      post.DiffXent(cu_tgt, &(log_post[j]));
+      ans.ColRange(0, dimN).AddMat(1.0, post);
+    }
+    SetCuCpuNumThreads(1);
+    SetCuCpuMinElementsPerThread(16384);
+    AssertEqual(results[0], results[1]);
+    AssertEqual(log_post[0], log_post[1]);
+    KALDI_ASSERT(max_ids[0] == max_ids[1]);
+  }
+}
+
 template<typename Real> 
 static void UnitTestCuMatrixEqualElementMask() {
   CuMatrix<Real> m1(10,9), m2(10,9);
@@ -1953,6 +2044,8 @@ template<typename Real> void CudaMatrixUnitTest() {
   UnitTestCuMatrixSetZeroAboveDiag<Real>();
   UnitTestCuMatrixAddElements<Real>();
   UnitTestCuMatrixLookup<Real>();
+  UnitTestCuMatrixSparse<Real>();
+  UnitTestCuMatrixCpuThreads<Real>();
   UnitTestCuMatrixEqualElementMask<Real>(); 
   // test CuVector<Real> methods
   UnitTestCuVectorAddVec<Real>();
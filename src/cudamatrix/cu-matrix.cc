@@ -29,6 +29,7 @@
 #endif
 
 #include "util/timer.h"
+#include "matrix/cpu-allocator.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -40,9 +41,152 @@
 #include "cudamatrix/cu-tp-matrix.h"
 #include "cudamatrix/cu-block-matrix.h"
 #include "cudamatrix/cublas-wrappers.h"
+#include "cudamatrix/cu-parallel.h"
 
 namespace kaldi {
 
+// The following classes are the CPU versions of some row-wise CuMatrixBase
+// operations, in the form used by CuParallelForRows() to split them across
+// threads.
+
+// Does dest.func(src) on a range of rows; used for Sigmoid and Tanh.
+template<typename Real>
+class CuCpuUnaryRowTask: public CuRowRangeTask {
+ public:
+  typedef void (MatrixBase<Real>::*Function)(const MatrixBase<Real> &src);
+  CuCpuUnaryRowTask(Function func, const MatrixBase<Real> &src,
+                    MatrixBase<Real> *dest):
+      func_(func), src_(src), dest_(dest) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    SubMatrix<Real> dest(dest_->RowRange(begin, end - begin));
+    (dest.*func_)(src_.RowRange(begin, end - begin));
+  }
+ private:
+  Function func_;
+  const MatrixBase<Real> &src_;
+  MatrixBase<Real> *dest_;
+};
+
+// Does dest.func(value, diff) on a range of rows; used for DiffSigmoid and
+// DiffTanh.
+template<typename Real>
+class CuCpuBinaryRowTask: public CuRowRangeTask {
+ public:
+  typedef void (MatrixBase<Real>::*Function)(const MatrixBase<Real> &value,
+                                             const MatrixBase<Real> &diff);
+  CuCpuBinaryRowTask(Function func, const MatrixBase<Real> &value,
+                     const MatrixBase<Real> &diff, MatrixBase<Real> *dest):
+      func_(func), value_(value), diff_(diff), dest_(dest) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    SubMatrix<Real> dest(dest_->RowRange(begin, end - begin));
+    (dest.*func_)(value_.RowRange(begin, end - begin),
+                  diff_.RowRange(begin, end - begin));
+  }
+ private:
+  Function func_;
+  const MatrixBase<Real> &value_;
+  const MatrixBase<Real> &diff_;
+  MatrixBase<Real> *dest_;
+};
+
+template<typename Real>
+class CuCpuSoftMaxTask: public CuRowRangeTask {
+ public:
+  CuCpuSoftMaxTask(const MatrixBase<Real> &src, MatrixBase<Real> *dest):
+      src_(src), dest_(dest) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    for (MatrixIndexT r = begin; r < end; r++) {
+      SubVector<Real> row(*dest_, r);
+      row.CopyFromVec(src_.Row(r));
+      row.ApplySoftMax();
+    }
+  }
+ private:
+  const MatrixBase<Real> &src_;
+  MatrixBase<Real> *dest_;
+};
+
+template<typename Real>
+class CuCpuAddVecToRowsTask: public CuRowRangeTask {
+ public:
+  CuCpuAddVecToRowsTask(Real alpha, const VectorBase<Real> &row, Real beta,
+                        MatrixBase<Real> *dest):
+      alpha_(alpha), row_(row), beta_(beta), dest_(dest) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    SubMatrix<Real> dest(dest_->RowRange(begin, end - begin));
+    if (beta_ != 1.0) dest.Scale(beta_);
+    dest.AddVecToRows(alpha_, row_);
+  }
+ private:
+  Real alpha_;
+  const VectorBase<Real> &row_;
+  Real beta_;
+  MatrixBase<Real> *dest_;
+};
+
+template<typename Real>
+class CuCpuFindRowMaxIdTask: public CuRowRangeTask {
+ public:
+  CuCpuFindRowMaxIdTask(const MatrixBase<Real> &mat, int32 *id):
+      mat_(mat), id_(id) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    MatrixIndexT num_cols = mat_.NumCols();
+    for (MatrixIndexT r = begin; r < end; r++) {
+      Real max = -1e21;
+      int32 max_id = -1;
+      const Real *row_data = mat_.RowData(r);
+      for (MatrixIndexT c = 0; c < num_cols; c++) {
+        if (max < row_data[c]) {
+          max = row_data[c];
+          max_id = c;
+        }
+      }
+      id_[r] = max_id;
+    }
+  }
+ private:
+  const MatrixBase<Real> &mat_;
+  int32 *id_;
+};
+
+template<typename Real>
+class CuCpuDiffXentTask: public CuRowRangeTask {
+ public:
+  CuCpuDiffXentTask(const int32 *tgt, MatrixBase<Real> *mat, Real *log_post_tgt):
+      tgt_(tgt), mat_(mat), log_post_tgt_(log_post_tgt) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    for (MatrixIndexT r = begin; r < end; r++) {
+      Real &value = (*mat_)(r, tgt_[r]);
+      log_post_tgt_[r] = log(value);
+      value -= 1.0;
+    }
+  }
+ private:
+  const int32 *tgt_;
+  MatrixBase<Real> *mat_;
+  Real *log_post_tgt_;
+};
+
+template<typename Real>
+class CuCpuCopyRowsTask: public CuRowRangeTask {
+ public:
+  CuCpuCopyRowsTask(const MatrixBase<Real> &src,
+                    const std::vector<MatrixIndexT> &reorder,
+                    MatrixBase<Real> *dest):
+      src_(src), reorder_(reorder), dest_(dest) { }
+  virtual void operator() (MatrixIndexT begin, MatrixIndexT end) {
+    for (MatrixIndexT r = begin; r < end; r++) {
+      SubVector<Real> row(*dest_, r);
+      if (reorder_[r] < 0) row.SetZero();
+      else row.CopyFromVec(src_.Row(reorder_[r]));
+    }
+  }
+ private:
+  const MatrixBase<Real> &src_;
+  const std::vector<MatrixIndexT> &reorder_;
+  MatrixBase<Real> *dest_;
+};
+
 template<typename Real>
 void CuMatrix<Real>::Resize(MatrixIndexT rows, MatrixIndexT cols,
                             MatrixResizeType resize_type) {
@@ -91,7 +235,7 @@ void CuMatrix<Real>::Destroy() {
   } else
 #endif
   {
-    if (this->data_ != NULL) KALDI_MEMALIGN_FREE(this->data_);
+    if (this->data_ != NULL) CpuAllocatorFree(this->data_);
   }
   this->data_ = NULL;
   this->num_rows_ = 0;
@@ -894,8 +1038,8 @@ void CuMatrixBase<Real>::AddVecToRows(Real alpha,
   } else
 #endif
   {
-    if (beta != 1.0) Mat().Scale(beta);
-    Mat().AddVecToRows(alpha, row.Vec());
+    CuCpuAddVecToRowsTask<Real> task(alpha, row.Vec(), beta, &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1026,7 +1170,9 @@ void CuMatrixBase<Real>::Sigmoid(const CuMatrixBase<Real> &src) {
   } else
   #endif
   {
-    Mat().Sigmoid(src.Mat());
+    KALDI_ASSERT(SameDim(*this, src));
+    CuCpuUnaryRowTask<Real> task(&MatrixBase<Real>::Sigmoid, src.Mat(), &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1150,11 +1296,9 @@ void CuMatrixBase<Real>::ApplySoftMaxPerRow(const CuMatrixBase<Real> &src) {
   } else
   #endif
   {
-    MatrixBase<Real> &mat(this->Mat());
-    mat.CopyFromMat(src.Mat());
-    for(MatrixIndexT r = 0; r < mat.NumRows(); r++) {
-      mat.Row(r).ApplySoftMax();
-    }
+    KALDI_ASSERT(SameDim(*this, src));
+    CuCpuSoftMaxTask<Real> task(src.Mat(), &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1177,7 +1321,10 @@ void CuMatrixBase<Real>::DiffSigmoid(const CuMatrixBase<Real> &value,
   } else
 #endif
   {
-    Mat().DiffSigmoid(value.Mat(), diff.Mat());
+    KALDI_ASSERT(SameDim(*this, value) && SameDim(*this, diff));
+    CuCpuBinaryRowTask<Real> task(&MatrixBase<Real>::DiffSigmoid, value.Mat(),
+                                  diff.Mat(), &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1199,7 +1346,9 @@ void CuMatrixBase<Real>::Tanh(const CuMatrixBase<Real> &src) {
   } else
 #endif
   {
-    Mat().Tanh(src.Mat());
+    KALDI_ASSERT(SameDim(*this, src));
+    CuCpuUnaryRowTask<Real> task(&MatrixBase<Real>::Tanh, src.Mat(), &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1222,7 +1371,10 @@ void CuMatrixBase<Real>::DiffTanh(const CuMatrixBase<Real> &value,
   } else
 #endif
   {
-    Mat().DiffTanh(value.Mat(), diff.Mat());
+    KALDI_ASSERT(SameDim(*this, value) && SameDim(*this, diff));
+    CuCpuBinaryRowTask<Real> task(&MatrixBase<Real>::DiffTanh, value.Mat(),
+                                  diff.Mat(), &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -1268,21 +1420,9 @@ void CuMatrixBase<Real>::FindRowMaxId(CuArray<int32> *id) const {
   {
     // allocate index buffer
     id->Resize(num_rows_);
-    id->Set(-1);
     // find maxima
-    MatrixIndexT num_rows = num_rows_, num_cols = num_cols_;
-    for(MatrixIndexT r = 0; r < num_rows; r++) {
-      Real max = -1e21;
-      int32 max_id = -1;
-      const Real *row_data = Mat().RowData(r);
-      for(MatrixIndexT c = 0; c < num_cols; c++) {
-        if (max < row_data[c]) {
-          max = row_data[c];
-          max_id = c;
-        }
-      }
-      id->Data()[r] = max_id;
-    }
+    CuCpuFindRowMaxIdTask<Real> task(Mat(), id->Data());
+    CuParallelForRows(num_rows_, num_cols_, &task);
   }
 }
 
@@ -1306,13 +1446,9 @@ void CuMatrixBase<Real>::DiffXent(const CuArray<int32> &tgt,
   } else
 #endif
   {
-    MatrixIndexT num_rows = num_rows_;
-    for(int32 r = 0; r < num_rows; r++) {
-      int32 col_tgt = tgt.Data()[r];
-      Real &value = Mat()(r, col_tgt);
-      log_post_tgt->Vec()(r) = log(value);
-      value -= 1.0;
-    }
+    CuCpuDiffXentTask<Real> task(tgt.Data(), &Mat(), log_post_tgt->Vec().Data());
+    // Each row only touches one element, so count it as one column.
+    CuParallelForRows(num_rows_, 1, &task);
   }
 }
 
@@ -1813,7 +1949,10 @@ void CuMatrixBase<Real>::CopyRows(const CuMatrixBase<Real> &src,
   } else
 #endif
   {
-    Mat().CopyRows(src.Mat(), reorder);
+    KALDI_ASSERT(static_cast<MatrixIndexT>(reorder.size()) == NumRows());
+    KALDI_ASSERT(NumCols() == src.NumCols());
+    CuCpuCopyRowsTask<Real> task(src.Mat(), reorder, &Mat());
+    CuParallelForRows(NumRows(), NumCols(), &task);
   }
 }
 
@@ -2134,6 +2273,120 @@ void CuMatrixBase<Real>::AddElements(Real alpha,
   }
 }
 
+template<typename Real>
+void CuMatrixBase<Real>::AddSmat(Real alpha, const SparseMatrix<Real> &A,
+                                 MatrixTransposeType trans) {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (trans == kNoTrans) {
+      KALDI_ASSERT(num_rows_ == A.NumRows() && num_cols_ == A.NumCols());
+    } else {
+      KALDI_ASSERT(num_rows_ == A.NumCols() && num_cols_ == A.NumRows());
+    }
+    std::vector<MatrixElement<Real> > elements;
+    elements.reserve(A.NumElements());
+    for (MatrixIndexT r = 0; r < A.NumRows(); r++) {
+      MatrixIndexT num_elements = A.RowNumElements(r);
+      if (num_elements == 0) continue;
+      const MatrixIndexT *indices = A.RowIndices(r);
+      const Real *values = A.RowValues(r);
+      for (MatrixIndexT k = 0; k < num_elements; k++) {
+        MatrixElement<Real> e = { r, indices[k], values[k] };
+        if (trans == kTrans) std::swap(e.row, e.column);
+        elements.push_back(e);
+      }
+    }
+    if (!elements.empty())
+      AddElements(alpha, elements);
+  } else
+#endif
+  {
+    Mat().AddSmat(alpha, A, trans);
+  }
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::AddSmatMat(Real alpha, const SparseMatrix<Real> &A,
+                                    MatrixTransposeType transA,
+                                    const CuMatrixBase<Real> &B, Real beta) {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // There is no sparse kernel yet; expand A on the device.
+    CuMatrix<Real> A_dense(A.NumRows(), A.NumCols());
+    A_dense.AddSmat(1.0, A);
+    AddMatMat(alpha, A_dense, transA, B, kNoTrans, beta);
+  } else
+#endif
+  {
+    Mat().AddSmatMat(alpha, A, transA, B.Mat(), beta);
+  }
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::AddMatSmat(Real alpha, const CuMatrixBase<Real> &A,
+                                    const SparseMatrix<Real> &B,
+                                    MatrixTransposeType transB, Real beta) {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // There is no sparse kernel yet; expand B on the device.
+    CuMatrix<Real> B_dense(B.NumRows(), B.NumCols());
+    B_dense.AddSmat(1.0, B);
+    AddMatMat(alpha, A, kNoTrans, B_dense, transB, beta);
+  } else
+#endif
+  {
+    Mat().AddMatSmat(alpha, A.Mat(), B, transB, beta);
+  }
+}
+
+template<typename Real>
+Real TraceMatSmat(const CuMatrixBase<Real> &A, const SparseMatrix<Real> &B,
+                  MatrixTransposeType trans) {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (trans == kNoTrans) {
+      KALDI_ASSERT(A.NumRows() == B.NumCols() && A.NumCols() == B.NumRows());
+    } else {
+      KALDI_ASSERT(A.NumRows() == B.NumRows() && A.NumCols() == B.NumCols());
+    }
+    // Fetch the elements of A that correspond to the stored elements of B.
+    std::vector<Int32Pair> indices;
+    std::vector<Real> values;
+    indices.reserve(B.NumElements());
+    values.reserve(B.NumElements());
+    for (MatrixIndexT r = 0; r < B.NumRows(); r++) {
+      MatrixIndexT num_elements = B.RowNumElements(r);
+      if (num_elements == 0) continue;
+      const MatrixIndexT *cols = B.RowIndices(r);
+      const Real *vals = B.RowValues(r);
+      for (MatrixIndexT k = 0; k < num_elements; k++) {
+        Int32Pair p;
+        p.first = (trans == kNoTrans ? cols[k] : r);
+        p.second = (trans == kNoTrans ? r : cols[k]);
+        indices.push_back(p);
+        values.push_back(vals[k]);
+      }
+    }
+    std::vector<Real> A_values;
+    A.Lookup(indices, &A_values);
+    Real ans = 0.0;
+    for (size_t i = 0; i < values.size(); i++)
+      ans += A_values[i] * values[i];
+    return ans;
+  } else
+#endif
+  {
+    return TraceMatSmat(A.Mat(), B, trans);
+  }
+}
+
+template
+float TraceMatSmat(const CuMatrixBase<float> &A, const SparseMatrix<float> &B,
+                   MatrixTransposeType trans);
+template
+double TraceMatSmat(const CuMatrixBase<double> &A,
+                    const SparseMatrix<double> &B, MatrixTransposeType trans);
+
 template<typename Real>
 void CuMatrixBase<Real>::Lookup(const std::vector<Int32Pair> &indices,
                                 std::vector<Real> *output) const {
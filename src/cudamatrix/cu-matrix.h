@@ -33,6 +33,7 @@
 #include "cudamatrix/cu-value.h"
 #include "matrix/matrix-common.h"
 #include "matrix/kaldi-matrix.h"
+#include "matrix/sparse-matrix.h"
 #include "cudamatrix/cu-array.h"
 #include "cudamatrix/cu-math.h"
 #include "cudamatrix/cu-rand.h"
@@ -42,6 +43,11 @@ namespace kaldi {
 template<typename Real>
 Real TraceMatMat(const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &B,
                  MatrixTransposeType trans = kNoTrans);
+
+/// Returns tr(A B), or tr(A B^T) if trans == kTrans, where B is sparse.
+template<typename Real>
+Real TraceMatSmat(const CuMatrixBase<Real> &A, const SparseMatrix<Real> &B,
+                  MatrixTransposeType trans = kNoTrans);
 /**
  * Matrix for CUDA computing.
  * Does the computation on the CUDA card when CUDA is compiled in and
@@ -118,6 +124,9 @@ class CuMatrixBase {
   friend Real TraceMatMat<Real>(const CuMatrixBase<Real> &A,
                                 const CuMatrixBase<Real> &B,
                                 MatrixTransposeType trans);
+  friend Real TraceMatSmat<Real>(const CuMatrixBase<Real> &A,
+                                 const SparseMatrix<Real> &B,
+                                 MatrixTransposeType trans);
 
   void AddToDiag(Real value);
   
@@ -286,6 +295,19 @@ class CuMatrixBase {
   /// C = alpha * A(^T)*B(^T) + beta * C
   void AddMatMat(Real alpha, const CuMatrixBase<Real> &A, MatrixTransposeType transA,
                  const CuMatrixBase<Real> &B, MatrixTransposeType transB, Real beta);
+  /// *this += alpha * A [or A^T], where A is a SparseMatrix.
+  void AddSmat(Real alpha, const SparseMatrix<Real> &A,
+               MatrixTransposeType trans = kNoTrans);
+  /// *this = beta * *this + alpha * A [or A^T] * B, where A is a
+  /// SparseMatrix.
+  void AddSmatMat(Real alpha, const SparseMatrix<Real> &A,
+                  MatrixTransposeType transA, const CuMatrixBase<Real> &B,
+                  Real beta);
+  /// *this = beta * *this + alpha * A * B [or B^T], where B is a
+  /// SparseMatrix.
+  void AddMatSmat(Real alpha, const CuMatrixBase<Real> &A,
+                  const SparseMatrix<Real> &B, MatrixTransposeType transB,
+                  Real beta);
   /// *this = a * b / c (by element; when c = 0, *this = a)
   void AddMatMatDivMat(const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &B, const CuMatrixBase<Real> &C);
 
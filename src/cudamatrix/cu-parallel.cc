@@ -0,0 +1,73 @@
+// cudamatrix/cu-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cudamatrix/cu-parallel.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+static int32 cu_cpu_num_threads = 1;
+static int32 cu_cpu_min_elements_per_thread = 16384;
+
+void SetCuCpuNumThreads(int32 num_threads) {
+  KALDI_ASSERT(num_threads >= 1);
+  cu_cpu_num_threads = num_threads;
+}
+
+int32 GetCuCpuNumThreads() {
+  return cu_cpu_num_threads;
+}
+
+void SetCuCpuMinElementsPerThread(int32 min_elements) {
+  KALDI_ASSERT(min_elements >= 1);
+  cu_cpu_min_elements_per_thread = min_elements;
+}
+
+// Runs one thread's share of the rows of a CuRowRangeTask.
+class CuRowRangeThreadable: public MultiThreadable {
+ public:
+  CuRowRangeThreadable(MatrixIndexT num_rows, CuRowRangeTask *task):
+      num_rows_(num_rows), task_(task) { }
+  void operator() () {
+    MatrixIndexT begin = (static_cast<int64>(num_rows_) * thread_id_) /
+        num_threads_,
+        end = (static_cast<int64>(num_rows_) * (thread_id_ + 1)) /
+        num_threads_;
+    if (end > begin)
+      (*task_)(begin, end);
+  }
+ private:
+  MatrixIndexT num_rows_;
+  CuRowRangeTask *task_;
+};
+
+void CuParallelForRows(MatrixIndexT num_rows, MatrixIndexT num_cols,
+                       CuRowRangeTask *task) {
+  int64 num_elements = static_cast<int64>(num_rows) * num_cols;
+  int32 num_threads = std::min<int64>(
+      std::min<int64>(cu_cpu_num_threads, num_rows),
+      num_elements / cu_cpu_min_elements_per_thread);
+  if (num_threads <= 1) {
+    if (num_rows > 0)
+      (*task)(0, num_rows);
+  } else {
+    CuRowRangeThreadable c(num_rows, task);
+    RunMultiThreadedPersistent(c, num_threads);
+  }
+}
+
+}  // namespace kaldi
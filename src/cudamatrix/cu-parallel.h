@@ -0,0 +1,72 @@
+// cudamatrix/cu-parallel.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDAMATRIX_CU_PARALLEL_H_
+#define KALDI_CUDAMATRIX_CU_PARALLEL_H_
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/**
+   When there is no GPU (or it is not in use), the row-wise CuMatrixBase
+   operations (ApplySoftMaxPerRow, Sigmoid, DiffSigmoid, Tanh, DiffTanh,
+   AddVecToRows, FindRowMaxId, DiffXent and CopyRows) run on the CPU.  They
+   can be split across threads from the persistent MultiThreadPool (see
+   thread/kaldi-thread.h) by calling SetCuCpuNumThreads(); matrix
+   multiplication is not affected, as it uses the BLAS library's own threads.
+
+   This is the CPU counterpart of the GPU selection done with CuDevice, and
+   like it is normally set up near the start of main(), e.g.:
+   \code
+     int32 cpu_threads = 1;
+     po.Register("cpu-threads", &cpu_threads, "Number of threads for the "
+                 "row-wise matrix operations when not using a GPU");
+     ...
+     SetCuCpuNumThreads(cpu_threads);
+   \endcode
+ */
+
+/// Sets the number of threads for the CPU versions of the row-wise CuMatrix
+/// operations; the default is 1, which means no threading.
+void SetCuCpuNumThreads(int32 num_threads);
+
+int32 GetCuCpuNumThreads();
+
+/// Sets the minimum number of matrix elements per thread (default 16384); an
+/// operation on a smaller matrix than this uses fewer threads, or none.
+void SetCuCpuMinElementsPerThread(int32 min_elements);
+
+/// An operation on a range of rows, for CuParallelForRows().
+class CuRowRangeTask {
+ public:
+  /// Processes rows row_begin ... row_end - 1.  It may be called from several
+  /// threads at once, with disjoint ranges.
+  virtual void operator() (MatrixIndexT row_begin, MatrixIndexT row_end) = 0;
+  virtual ~CuRowRangeTask() { }
+};
+
+/// Calls (*task)(begin, end) on ranges of rows that cover 0 ... num_rows - 1,
+/// in parallel if the number of threads set by SetCuCpuNumThreads() is more
+/// than one and the matrix (num_rows by num_cols) is large enough.
+void CuParallelForRows(MatrixIndexT num_rows, MatrixIndexT num_cols,
+                       CuRowRangeTask *task);
+
+}  // namespace kaldi
+
+#endif  // KALDI_CUDAMATRIX_CU_PARALLEL_H_
@@ -4,6 +4,7 @@
 #endif
 
 #include "util/timer.h"
+#include "matrix/cpu-allocator.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -847,7 +848,7 @@ void CuVector<Real>::Destroy() {
   } else
 #endif
   {
-    if (this->data_ != NULL) KALDI_MEMALIGN_FREE(this->data_);
+    if (this->data_ != NULL) CpuAllocatorFree(this->data_);
   }
   this->data_ = NULL;
   this->dim_ = 0;
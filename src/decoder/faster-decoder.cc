@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "decoder/faster-decoder.h"
+#include "fstext/fstext-utils.h"
 
 namespace kaldi {
 
@@ -321,4 +322,137 @@ void FasterDecoder::ClearToks(Elem *list) {
   }
 }
 
+// Does the alignment for AlignUtteranceWrapper and AlignUtteranceClass;
+// returns true on success.
+static bool AlignUtteranceInternal(const AlignConfig &config,
+                                   const std::string &utt,
+                                   const fst::Fst<fst::StdArc> &fst,
+                                   DecodableInterface *decodable,
+                                   bool *retried,
+                                   std::vector<int32> *alignment,
+                                   LatticeWeight *weight) {
+  FasterDecoderOptions decode_opts;
+  decode_opts.beam = config.beam;  // Don't set the other options.
+  FasterDecoder decoder(fst, decode_opts);
+  decoder.Decode(decodable);
+
+  fst::VectorFst<LatticeArc> decoded;  // linear FST.
+  bool ans = decoder.ReachedFinal()  // consider only final states.
+      && decoder.GetBestPath(&decoded);
+  *retried = false;
+  if (!ans && config.retry_beam != 0.0) {
+    *retried = true;
+    KALDI_WARN << "Retrying utterance " << utt << " with beam "
+               << config.retry_beam;
+    decode_opts.beam = config.retry_beam;
+    decoder.SetOptions(decode_opts);
+    decoder.Decode(decodable);
+    ans = decoder.ReachedFinal() && decoder.GetBestPath(&decoded);
+  }
+  if (!ans) return false;
+  std::vector<int32> words;
+  GetLinearSymbolSequence(decoded, alignment, &words, weight);
+  return true;
+}
+
+// Does the output for AlignUtteranceWrapper and AlignUtteranceClass.
+static void AlignUtteranceOutput(const std::string &utt,
+                                 BaseFloat acoustic_scale,
+                                 bool success,
+                                 bool retried,
+                                 const std::vector<int32> &alignment,
+                                 const LatticeWeight &weight,
+                                 Int32VectorWriter *alignment_writer,
+                                 BaseFloatWriter *scores_writer,
+                                 int32 *num_done,
+                                 int32 *num_error,
+                                 int32 *num_retried,
+                                 double *tot_like,
+                                 int64 *frame_count) {
+  if (retried && num_retried != NULL) (*num_retried)++;
+  if (!success) {
+    KALDI_WARN << "Did not successfully decode file " << utt;
+    if (num_error != NULL) (*num_error)++;
+    return;
+  }
+  BaseFloat score = -(weight.Value1() + weight.Value2()),
+      like = score / acoustic_scale;
+  if (scores_writer != NULL && scores_writer->IsOpen())
+    scores_writer->Write(utt, score);
+  alignment_writer->Write(utt, alignment);
+  if (tot_like != NULL) *tot_like += like;
+  if (frame_count != NULL) *frame_count += alignment.size();
+  if (num_done != NULL) {
+    (*num_done)++;
+    if (*num_done % 50 == 0) {
+      KALDI_LOG << "Processed " << *num_done << " utterances, "
+                << "log-like per frame for " << utt << " is "
+                << (like / alignment.size()) << " over "
+                << alignment.size() << " frames.";
+    }
+  }
+}
+
+void AlignUtteranceWrapper(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,
+    const fst::Fst<fst::StdArc> &fst,
+    DecodableInterface *decodable,
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count) {
+  bool retried;
+  std::vector<int32> alignment;
+  LatticeWeight weight;
+  bool success = AlignUtteranceInternal(config, utt, fst, decodable,
+                                        &retried, &alignment, &weight);
+  AlignUtteranceOutput(utt, acoustic_scale, success, retried, alignment,
+                       weight, alignment_writer, scores_writer, num_done,
+                       num_error, num_retried, tot_like, frame_count);
+}
+
+AlignUtteranceClass::AlignUtteranceClass(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,
+    fst::VectorFst<fst::StdArc> *fst,
+    DecodableInterface *decodable,
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count):
+    config_(config), utt_(utt), acoustic_scale_(acoustic_scale), fst_(fst),
+    decodable_(decodable), alignment_writer_(alignment_writer),
+    scores_writer_(scores_writer), num_done_(num_done),
+    num_error_(num_error), num_retried_(num_retried), tot_like_(tot_like),
+    frame_count_(frame_count), computed_(false), success_(false),
+    retried_(false) { }
+
+void AlignUtteranceClass::operator () () {
+  computed_ = true;
+  success_ = AlignUtteranceInternal(config_, utt_, *fst_, decodable_,
+                                    &retried_, &alignment_, &weight_);
+  // Free the memory now rather than waiting for the output.
+  delete decodable_;
+  decodable_ = NULL;
+  delete fst_;
+  fst_ = NULL;
+}
+
+AlignUtteranceClass::~AlignUtteranceClass() {
+  if (!computed_)
+    KALDI_ERR << "Destructor called without operator (), error in calling code.";
+  AlignUtteranceOutput(utt_, acoustic_scale_, success_, retried_, alignment_,
+                       weight_, alignment_writer_, scores_writer_, num_done_,
+                       num_error_, num_retried_, tot_like_, frame_count_);
+}
+
 } // end namespace kaldi.
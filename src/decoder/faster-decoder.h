@@ -26,6 +26,7 @@
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
+#include "util/common-utils.h"
 
 #ifdef _MSC_VER
 #include <unordered_map>
@@ -166,6 +167,91 @@ class FasterDecoder {
 };
 
 
+/// Options for forced alignment with FasterDecoder, as used in the programs
+/// gmm-align-compiled, sgmm2-align-compiled and nnet-align-compiled.
+struct AlignConfig {
+  BaseFloat beam;
+  BaseFloat retry_beam;
+  AlignConfig(): beam(200.0), retry_beam(0.0) { }
+  void Register(OptionsItf *po) {
+    po->Register("beam", &beam, "Decoding beam");
+    po->Register("retry-beam", &retry_beam, "Decoding beam for second try "
+                 "at alignment");
+  }
+};
+
+// The function AlignUtteranceWrapper and the class AlignUtteranceClass do the
+// forced alignment of one utterance for the *-align-compiled programs.  As with
+// DecodeUtteranceLatticeFaster, this is really "binary-level" code as it
+// involves table writers.  The FST "fst" must already include the transition
+// probabilities (see AddTransitionProbs()).  If decoding with config.beam does
+// not reach a final state and config.retry_beam != 0, it is retried with
+// config.retry_beam.  On success the alignment is written to
+// "alignment_writer" and, if scores_writer is open, the (acoustically scaled)
+// score to "scores_writer", and the counters are updated.
+void AlignUtteranceWrapper(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,  // affects the scores written and tot_like.
+    const fst::Fst<fst::StdArc> &fst,
+    DecodableInterface *decodable,  // not const but is really an input.
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count);
+
+// This class does the same job as the function AlignUtteranceWrapper, but in a
+// way that allows the alignment of several utterances to run in parallel,
+// using the TaskSequencer class from ../thread/kaldi-task-sequence.h.  The
+// alignment happens in operator (), and the output (and the updating of the
+// counters) in the destructor, which the TaskSequencer calls in the original
+// order of the utterances.
+class AlignUtteranceClass {
+ public:
+  // NOTE: we take ownership of "fst" and "decodable" and delete them when
+  // done; anything the decodable refers to, such as the features, must not be
+  // changed until then, so it will normally be owned by the decodable too.
+  AlignUtteranceClass(const AlignConfig &config,
+                      const std::string &utt,
+                      BaseFloat acoustic_scale,
+                      fst::VectorFst<fst::StdArc> *fst,
+                      DecodableInterface *decodable,
+                      Int32VectorWriter *alignment_writer,
+                      BaseFloatWriter *scores_writer,
+                      int32 *num_done,
+                      int32 *num_error,
+                      int32 *num_retried,
+                      double *tot_like,
+                      int64 *frame_count);
+  void operator () ();  // The alignment happens here.
+  ~AlignUtteranceClass();  // Output happens here.
+ private:
+  // The following variables correspond to inputs:
+  AlignConfig config_;
+  std::string utt_;
+  BaseFloat acoustic_scale_;
+  fst::VectorFst<fst::StdArc> *fst_;
+  DecodableInterface *decodable_;
+  Int32VectorWriter *alignment_writer_;
+  BaseFloatWriter *scores_writer_;
+  int32 *num_done_;
+  int32 *num_error_;
+  int32 *num_retried_;
+  double *tot_like_;
+  int64 *frame_count_;
+
+  // The following variables are set by the computation.
+  bool computed_;  // operator () was called.
+  bool success_;
+  bool retried_;
+  std::vector<int32> alignment_;
+  LatticeWeight weight_;
+};
+
+
 } // end namespace kaldi.
 
 
@@ -0,0 +1,128 @@
+// decoder/lattice-faster-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+// A random graph in which every state is final and has emitting arcs, so
+// that decoding never fails.  The ilabels are the columns of the likelihood
+// matrix, from 1 to num_pdfs - 1.
+static fst::VectorFst<fst::StdArc> *RandomGraph(int32 num_pdfs) {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>;
+  int32 num_states = 2 + rand() % 20;
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->SetFinal(s, Arc::Weight(RandUniform()));
+    int32 num_arcs = 1 + rand() % 4;
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 ilabel = 1 + rand() % (num_pdfs - 1),
+          olabel = (rand() % 3 == 0 ? 1 + rand() % 10 : 0);
+      fst->AddArc(s, Arc(ilabel, olabel, Arc::Weight(2.0 * RandUniform()),
+                         rand() % num_states));
+    }
+  }
+  return fst;
+}
+
+static void GetBestPathWords(const CompactLattice &clat,
+                             std::vector<int32> *words,
+                             LatticeWeight *weight) {
+  CompactLattice best_path_clat;
+  CompactLatticeShortestPath(clat, &best_path_clat);
+  Lattice best_path;
+  ConvertLattice(best_path_clat, &best_path);
+  std::vector<int32> alignment;
+  KALDI_ASSERT(fst::GetLinearSymbolSequence(best_path, &alignment, words,
+                                            weight));
+}
+
+// Checks that a determinized lattice has one path per word sequence.
+static void AssertDeterministic(const CompactLattice &clat) {
+  for (CompactLattice::StateId s = 0; s < clat.NumStates(); s++) {
+    std::set<int32> labels;
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      KALDI_ASSERT(arc.ilabel != 0 && labels.count(arc.ilabel) == 0);
+      labels.insert(arc.ilabel);
+    }
+  }
+}
+
+// Decodes with and without incremental determinization: the lattices should
+// both be deterministic and have the same best path.
+void UnitTestIncrementalDeterminization() {
+  int32 num_pdfs = 2 + rand() % 10, num_frames = 50 + rand() % 300;
+  fst::VectorFst<fst::StdArc> *graph = RandomGraph(num_pdfs);
+  Matrix<BaseFloat> likes(num_frames, num_pdfs);
+  likes.SetRandn();
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 8.0;
+  config.lattice_beam = 3.0 + 3.0 * RandUniform();
+  config.prune_interval = 5 + rand() % 20;
+  LatticeFasterDecoder decoder(*graph, config);
+  DecodableMatrixScaled decodable(likes, 1.0);
+  KALDI_ASSERT(decoder.Decode(&decodable));
+  CompactLattice clat;
+  KALDI_ASSERT(decoder.GetLattice(&clat));
+
+  config.determinize_period = 10 + rand() % 30;
+  config.determinize_delay = rand() % 30;
+  LatticeFasterDecoder incremental_decoder(*graph, config);
+  DecodableMatrixScaled incremental_decodable(likes, 1.0);
+  KALDI_ASSERT(incremental_decoder.Decode(&incremental_decodable));
+  CompactLattice incremental_clat;
+  KALDI_ASSERT(incremental_decoder.GetLattice(&incremental_clat));
+
+  AssertDeterministic(clat);
+  AssertDeterministic(incremental_clat);
+
+  std::vector<int32> words, incremental_words;
+  LatticeWeight weight, incremental_weight;
+  GetBestPathWords(clat, &words, &weight);
+  GetBestPathWords(incremental_clat, &incremental_words, &incremental_weight);
+  KALDI_ASSERT(words == incremental_words);
+  KALDI_ASSERT(fst::ApproxEqual(weight, incremental_weight, 1.0e-03));
+
+  Lattice best_path;
+  KALDI_ASSERT(incremental_decoder.GetBestPath(&best_path));
+  std::vector<int32> alignment, best_path_words;
+  LatticeWeight best_path_weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, &best_path_words,
+                               &best_path_weight);
+  KALDI_ASSERT(best_path_words == words);
+  KALDI_ASSERT(fst::ApproxEqual(best_path_weight, weight, 1.0e-03));
+  delete graph;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    UnitTestIncrementalDeterminization();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -20,13 +20,25 @@
 // limitations under the License.
 
 #include "decoder/lattice-faster-decoder.h"
+#include "lat/lattice-functions.h"
 
 namespace kaldi {
 
+// With incremental determinization, the arcs that join the chunks of the
+// lattice are labeled kBoundaryLabelOffset + i for the i'th token on the
+// frame where it was split; this is larger than any word-id.
+static const LatticeArc::Label kBoundaryLabelOffset = 1000000000;
+// When the next chunk is merged in, the arcs from the start state of its raw
+// lattice to the states that are determinized again with it are labeled
+// kEntryLabelOffset + j; these never appear in the output.
+static const LatticeArc::Label kEntryLabelOffset = 1500000000;
+
 // instantiate this class once for each thing you have to decode.
 LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
                                            const LatticeFasterDecoderConfig &config):
-    fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
+    fst_(fst), delete_fst_(false), config_(config), num_toks_(0),
+    final_active_(false), decoding_finalized_(false),
+    chunk_start_frame_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -34,7 +46,9 @@ LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
 
 LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
                                            fst::Fst<fst::StdArc> *fst):
-    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
+    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0),
+    final_active_(false), decoding_finalized_(false),
+    chunk_start_frame_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -43,46 +57,82 @@ LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &con
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).
 bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
+  InitDecoding();
+  AdvanceDecoding(decodable);
+  FinalizeDecoding();
+  // Returns true if we have any kind of traceback available (not necessarily
+  // to the end state; query ReachedFinal() for that).
+  return NumFramesDecoded() > 0 && !final_costs_.empty();
+}
+
+void LatticeFasterDecoder::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
   warned_ = false;
   final_active_ = false;
+  decoding_finalized_ = false;
   final_costs_.clear();
+  chunk_start_frame_ = 0;
+  boundary_toks_.clear();
+  det_lat_ = DeterminizedLattice();
   num_toks_ = 0;
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
   ProcessNonemitting(0);
-    
+}
+
+int32 LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
+                                            int32 max_num_frames) {
+  KALDI_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
+               "You must call InitDecoding() before AdvanceDecoding()");
   // We use 1-based indexing for frames in this decoder (if you view it in
   // terms of features), but note that the decodable object uses zero-based
   // numbering, which we have to correct for when we call it.
-  for (int32 frame = 1; !decodable->IsLastFrame(frame-2); frame++) {
-    active_toks_.resize(frame+1); // new column
+  int32 num_frames_decoded = 0;
+  while (max_num_frames < 0 || num_frames_decoded < max_num_frames) {
+    int32 frame = active_toks_.size();
+    if (decodable->IsLastFrame(frame - 2))
+      break;
+    active_toks_.resize(frame + 1); // new column
 
     ProcessEmitting(decodable, frame);
-      
+
     ProcessNonemitting(frame);
 
-    if (decodable->IsLastFrame(frame-1))
-      PruneActiveTokensFinal(frame);
-    else if (frame % config_.prune_interval == 0)
-      PruneActiveTokens(frame, config_.lattice_beam * 0.1); // use larger delta.        
+    if (frame % config_.prune_interval == 0) {
+      PruneActiveTokens(frame, config_.lattice_beam * 0.1); // use larger delta.
+      if (config_.determinize_period > 0)
+        PossiblyDeterminizeChunk(frame);
+    }
+    num_frames_decoded++;
   }
-  // Returns true if we have any kind of traceback available (not necessarily
-  // to the end state; query ReachedFinal() for that).
-  return !final_costs_.empty();
+  return num_frames_decoded;
+}
+
+void LatticeFasterDecoder::FinalizeDecoding() {
+  if (decoding_finalized_) return;
+  PruneActiveTokensFinal(NumFramesDecoded());
+  decoding_finalized_ = true;
 }
 
 // Outputs an FST corresponding to the single best path
 // through the lattice.
 bool LatticeFasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *ofst) const {
+  if (chunk_start_frame_ > 0) {
+    // The raw lattice before chunk_start_frame_ is gone.
+    CompactLattice clat, best_path;
+    if (!GetLattice(&clat)) return false;
+    CompactLatticeShortestPath(clat, &best_path);
+    ConvertLattice(best_path, ofst);
+    return true;
+  }
   fst::VectorFst<LatticeArc> fst;
   if (!GetRawLattice(&fst)) return false;
   // std::cout << "Raw lattice is:\n";
@@ -92,6 +142,101 @@ bool LatticeFasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *ofst) const
   return true;
 }
 
+void LatticeFasterDecoder::ComputeFinalCosts(
+    std::map<Token*, BaseFloat> *final_costs) const {
+  if (decoding_finalized_) {
+    *final_costs = final_costs_;
+    return;
+  }
+  final_costs->clear();
+  const BaseFloat infinity = std::numeric_limits<BaseFloat>::infinity();
+  for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail) {
+    BaseFloat final_cost = fst_.Final(e->key).Value();
+    if (final_cost != infinity)
+      (*final_costs)[e->val] = final_cost;
+  }
+  if (final_costs->empty()) {
+    for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail)
+      (*final_costs)[e->val] = 0.0;
+  }
+}
+
+bool LatticeFasterDecoder::GetBestPathTraceback(
+    fst::MutableFst<LatticeArc> *ofst,
+    bool use_final_probs,
+    int32 num_frames) const {
+  ofst->DeleteStates();
+  // Find the best token on the last frame.
+  Token *best_tok = NULL;
+  BaseFloat best_cost = std::numeric_limits<BaseFloat>::infinity(),
+      best_final_cost = 0.0;
+  if (use_final_probs) {
+    std::map<Token*, BaseFloat> final_costs;
+    ComputeFinalCosts(&final_costs);
+    for (std::map<Token*, BaseFloat>::const_iterator iter = final_costs.begin();
+         iter != final_costs.end(); ++iter) {
+      BaseFloat cost = iter->first->tot_cost + iter->second;
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_tok = iter->first;
+        best_final_cost = iter->second;
+      }
+    }
+  } else {
+    for (Token *tok = active_toks_.back().toks; tok != NULL; tok = tok->next) {
+      if (tok->tot_cost < best_cost) {
+        best_cost = tok->tot_cost;
+        best_tok = tok;
+      }
+    }
+  }
+  if (best_tok == NULL) return false;
+
+  // Follow the backpointers, finding the link used on each step.
+  std::vector<LatticeArc> arcs_reverse;  // arcs in reverse order.
+  int32 frame = NumFramesDecoded();
+  for (Token *tok = best_tok; tok->backpointer != NULL;
+       tok = tok->backpointer) {
+    Token *prev_tok = tok->backpointer;
+    const ForwardLink *best_link = NULL;
+    BaseFloat best_link_cost = std::numeric_limits<BaseFloat>::infinity();
+    for (const ForwardLink *link = prev_tok->links; link != NULL;
+         link = link->next) {
+      if (link->next_tok == tok &&
+          link->graph_cost + link->acoustic_cost < best_link_cost) {
+        best_link_cost = link->graph_cost + link->acoustic_cost;
+        best_link = link;
+      }
+    }
+    if (best_link == NULL)
+      KALDI_ERR << "Error tracing back best path (link not found)";
+    BaseFloat cost_offset = 0.0;
+    if (best_link->ilabel != 0) { // emitting: prev_tok is on the previous frame
+      if (num_frames >= 0 && NumFramesDecoded() - frame >= num_frames)
+        break;
+      frame--;
+      KALDI_ASSERT(frame >= 0 && frame < cost_offsets_.size());
+      cost_offset = cost_offsets_[frame];
+    }
+    arcs_reverse.push_back(
+        LatticeArc(best_link->ilabel, best_link->olabel,
+                   LatticeWeight(best_link->graph_cost,
+                                 best_link->acoustic_cost - cost_offset),
+                   fst::kNoStateId));
+  }
+  LatticeArc::StateId cur_state = ofst->AddState();
+  ofst->SetStart(cur_state);
+  for (ssize_t i = static_cast<ssize_t>(arcs_reverse.size()) - 1;
+       i >= 0; i--) {
+    LatticeArc arc = arcs_reverse[i];
+    arc.nextstate = ofst->AddState();
+    ofst->AddArc(cur_state, arc);
+    cur_state = arc.nextstate;
+  }
+  ofst->SetFinal(cur_state, LatticeWeight(best_final_cost, 0.0));
+  return true;
+}
+
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
 bool LatticeFasterDecoder::GetRawLattice(fst::MutableFst<LatticeArc> *ofst) const {
@@ -99,6 +244,9 @@ bool LatticeFasterDecoder::GetRawLattice(fst::MutableFst<LatticeArc> *ofst) cons
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
   typedef Arc::Label Label;
+  if (chunk_start_frame_ > 0)
+    KALDI_ERR << "GetRawLattice: the lattice has been partly determinized "
+              << "(--determinize-period > 0); use GetLattice().";
   ofst->DeleteStates();
   // num-frames plus one (since frames are one-based, and we have
   // an extra frame for the start-state).
@@ -124,6 +272,8 @@ bool LatticeFasterDecoder::GetRawLattice(fst::MutableFst<LatticeArc> *ofst) cons
   KALDI_VLOG(3) << "init:" << num_toks_/2 + 3 << " buckets:"
                 << tok_map.bucket_count() << " load:" << tok_map.load_factor()
                 << " max:" << tok_map.max_load_factor();
+  std::map<Token*, BaseFloat> final_costs;
+  ComputeFinalCosts(&final_costs);
   // Now create all arcs.
   StateId cur_state = 0; // we rely on the fact that we numbered these
   // consecutively (AddState() returns the numbers in order..)
@@ -149,8 +299,8 @@ bool LatticeFasterDecoder::GetRawLattice(fst::MutableFst<LatticeArc> *ofst) cons
       }
       if (f == num_frames) {
         std::map<Token*, BaseFloat>::const_iterator iter =
-            final_costs_.find(tok);
-        if (iter != final_costs_.end())
+            final_costs.find(tok);
+        if (iter != final_costs.end())
           ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
       }
     }
@@ -159,11 +309,18 @@ bool LatticeFasterDecoder::GetRawLattice(fst::MutableFst<LatticeArc> *ofst) cons
   return (cur_state != 0);
 }
 
-// This function is now deprecated, since now we do determinization from outside
-// the LatticeFasterDecoder class.
 // Outputs an FST corresponding to the lattice-determinized
 // lattice (one path per word sequence).
 bool LatticeFasterDecoder::GetLattice(fst::MutableFst<CompactLatticeArc> *ofst) const {
+  if (chunk_start_frame_ > 0) {
+    DeterminizedLattice det_lat(det_lat_);
+    if (!MergeLatticeChunk(NumFramesDecoded(), std::vector<BoundaryToken>(),
+                           &det_lat))
+      return false;
+    *ofst = det_lat.clat;
+    Connect(ofst); // Remove the dead states left by merging the chunks.
+    return (ofst->Start() != fst::kNoStateId);
+  }
   Lattice raw_fst;
   if (!GetRawLattice(&raw_fst)) return false;
   Invert(&raw_fst); // make it so word labels are on the input.
@@ -186,6 +343,429 @@ bool LatticeFasterDecoder::GetLattice(fst::MutableFst<CompactLatticeArc> *ofst)
   return true;
 }
 
+bool LatticeFasterDecoder::GetRawLatticeChunk(
+    int32 end_frame, const std::vector<BoundaryToken> &end_toks,
+    Lattice *ofst, unordered_map<Token*, StateId> *tok_map_out) const {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  ofst->DeleteStates();
+  bool is_last_frame = (end_frame == NumFramesDecoded());
+  KALDI_ASSERT(end_frame > chunk_start_frame_ &&
+               end_frame <= NumFramesDecoded());
+  unordered_map<Token*, StateId> &tok_map = *tok_map_out;
+  tok_map.clear();
+  for (int32 f = chunk_start_frame_; f <= end_frame; f++) {
+    if (active_toks_[f].toks == NULL) {
+      KALDI_WARN << "GetRawLatticeChunk: no tokens active on frame " << f
+                 << ": not producing lattice.\n";
+      return false;
+    }
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next)
+      tok_map[tok] = ofst->AddState();
+  }
+  if (chunk_start_frame_ == 0) {
+    // As in GetRawLattice(), the start token is the last one on frame 0.
+    Token *start_tok = active_toks_[0].toks;
+    while (start_tok->next != NULL) start_tok = start_tok->next;
+    ofst->SetStart(tok_map[start_tok]);
+  }
+  for (int32 f = chunk_start_frame_; f <= end_frame; f++) {
+    if (f == end_frame && !is_last_frame) break;
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      StateId cur_state = tok_map[tok];
+      for (ForwardLink *l = tok->links; l != NULL; l = l->next) {
+        unordered_map<Token*, StateId>::const_iterator iter =
+            tok_map.find(l->next_tok);
+        KALDI_ASSERT(iter != tok_map.end());
+        BaseFloat cost_offset = 0.0;
+        if (l->ilabel != 0) { // emitting..
+          KALDI_ASSERT(f >= 0 && f < cost_offsets_.size());
+          cost_offset = cost_offsets_[f];
+        }
+        ofst->AddArc(cur_state,
+                     Arc(l->ilabel, l->olabel,
+                         Weight(l->graph_cost, l->acoustic_cost - cost_offset),
+                         iter->second));
+      }
+    }
+  }
+  if (is_last_frame) {
+    std::map<Token*, BaseFloat> final_costs;
+    ComputeFinalCosts(&final_costs);
+    for (std::map<Token*, BaseFloat>::const_iterator iter = final_costs.begin();
+         iter != final_costs.end(); ++iter)
+      ofst->SetFinal(tok_map[iter->first], Weight(iter->second, 0.0));
+  } else {
+    // The cost on the arc of each token is chosen so that the best path
+    // through it costs its extra_cost more than the best path overall (its
+    // start arc in the next chunk adds the forward_cost back), so that the
+    // chunk is pruned as it would be as part of the whole lattice.
+    StateId final_state = ofst->AddState();
+    ofst->SetFinal(final_state, Weight::One());
+    for (size_t i = 0; i < end_toks.size(); i++)
+      ofst->AddArc(tok_map[end_toks[i].tok],
+                   Arc(0, kBoundaryLabelOffset + i,
+                       Weight(end_toks[i].extra_cost -
+                              end_toks[i].forward_cost, 0.0),
+                       final_state));
+  }
+  return true;
+}
+
+void LatticeFasterDecoder::DeterminizeLatticeChunk(
+    Lattice *raw_lat, CompactLattice *clat) const {
+  Connect(raw_lat); // Redeterminized states may lead only to pruned tokens.
+  Invert(raw_lat); // make it so word labels are on the input.
+  if (!TopSort(raw_lat))
+    KALDI_WARN << "Topological sorting of state-level lattice failed "
+        "(probably your lexicon has empty words or your LM has epsilon cycles; this "
+        " is a bad idea.)";
+  fst::ILabelCompare<LatticeArc> ilabel_comp;
+  ArcSort(raw_lat, ilabel_comp);
+  fst::DeterminizeLatticePrunedOptions lat_opts;
+  lat_opts.max_mem = config_.det_opts.max_mem;
+  DeterminizeLatticePruned(*raw_lat, config_.lattice_beam, clat, lat_opts);
+  raw_lat->DeleteStates();
+  Connect(clat);
+  TopSort(clat);
+}
+
+// Adds to "raw_lat" a path from "src" to "dest" that is equivalent to a
+// CompactLattice arc with label "word" and weight "weight": the
+// transition-ids on the input side, one per arc, and the word on the output
+// side of the first arc.
+static void AddCompactArcPath(LatticeArc::StateId src, int32 word,
+                              const CompactLatticeWeight &weight,
+                              LatticeArc::StateId dest, Lattice *raw_lat) {
+  typedef LatticeArc::StateId StateId;
+  const std::vector<int32> &string = weight.String();
+  if (string.empty()) {
+    raw_lat->AddArc(src, LatticeArc(0, word, weight.Weight(), dest));
+    return;
+  }
+  StateId cur_state = src;
+  for (size_t n = 0; n < string.size(); n++) {
+    StateId next_state = (n + 1 == string.size() ? dest : raw_lat->AddState());
+    raw_lat->AddArc(cur_state,
+                    LatticeArc(string[n], (n == 0 ? word : 0),
+                               (n == 0 ? weight.Weight() : LatticeWeight::One()),
+                               next_state));
+    cur_state = next_state;
+  }
+}
+
+// Returns "weight" with "cost" added to its graph part.
+static inline CompactLatticeWeight AddCost(const CompactLatticeWeight &weight,
+                                           double cost) {
+  return CompactLatticeWeight(LatticeWeight(weight.Weight().Value1() + cost,
+                                            weight.Weight().Value2()),
+                              weight.String());
+}
+
+// Outputs the best cost of reaching each state of "clat", which must be
+// topologically sorted, from its start state.
+static void ComputeForwardCosts(const CompactLattice &clat,
+                                std::vector<double> *costs) {
+  typedef CompactLatticeArc::StateId StateId;
+  costs->clear();
+  costs->resize(clat.NumStates(), std::numeric_limits<double>::infinity());
+  if (clat.Start() == fst::kNoStateId) return;
+  (*costs)[clat.Start()] = 0.0;
+  for (StateId s = 0; s < clat.NumStates(); s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      double cost = (*costs)[s] + arc.weight.Weight().Value1() +
+          arc.weight.Weight().Value2();
+      if (cost < (*costs)[arc.nextstate])
+        (*costs)[arc.nextstate] = cost;
+    }
+  }
+}
+
+// Replaces the redeterminized part of det_lat->clat by "chunk", which was
+// determinized from it and the next raw chunk (see AddRedeterminizedStates()):
+// each state entries[j] gets the arcs and final-prob of the state that the arc
+// from the start of "chunk" labeled kEntryLabelOffset + j leads to, with the
+// cost that was put on that arc taken out again, and the other states of
+// "chunk" are copied.  The states of the old part that are only reachable from
+// inside it become dead.  "entry_costs" are the forward costs of the entries
+// that were put on the entry arcs, less "offset".
+static void SpliceLatticeChunk(
+    const CompactLattice &chunk,
+    const std::vector<CompactLatticeArc::StateId> &entries,
+    const std::vector<double> &entry_costs, double offset,
+    CompactLattice *clat,
+    std::vector<CompactLatticeArc::StateId> *region,
+    unordered_map<CompactLatticeArc::StateId, double> *forward_costs) {
+  typedef CompactLatticeArc Arc;
+  typedef Arc::StateId StateId;
+  StateId chunk_start = chunk.Start();
+  region->clear();
+  forward_costs->clear();
+  if (chunk_start == fst::kNoStateId) {  // Nothing survived.
+    clat->DeleteStates();
+    return;
+  }
+  std::vector<double> chunk_costs;
+  ComputeForwardCosts(chunk, &chunk_costs);
+  std::vector<StateId> state_map(chunk.NumStates(), fst::kNoStateId);
+  for (StateId t = 0; t < chunk.NumStates(); t++) {
+    if (t == chunk_start) continue;
+    state_map[t] = clat->AddState();
+    region->push_back(state_map[t]);
+    (*forward_costs)[state_map[t]] = chunk_costs[t] + offset;
+  }
+  for (StateId t = 0; t < chunk.NumStates(); t++) {
+    if (t == chunk_start) continue;
+    StateId s = state_map[t];
+    clat->SetFinal(s, chunk.Final(t));
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, t); !aiter.Done();
+         aiter.Next()) {
+      Arc arc = aiter.Value();
+      arc.nextstate = state_map[arc.nextstate];
+      clat->AddArc(s, arc);
+    }
+  }
+  for (size_t j = 0; j < entries.size(); j++) {
+    clat->DeleteArcs(entries[j]);
+    clat->SetFinal(entries[j], CompactLatticeWeight::Zero());
+    region->push_back(entries[j]);
+    (*forward_costs)[entries[j]] = entry_costs[j] + offset;
+  }
+  for (fst::ArcIterator<CompactLattice> entry_iter(chunk, chunk_start);
+       !entry_iter.Done(); entry_iter.Next()) {
+    const Arc &entry_arc = entry_iter.Value();
+    KALDI_ASSERT(entry_arc.ilabel >= kEntryLabelOffset);
+    size_t j = entry_arc.ilabel - kEntryLabelOffset;
+    KALDI_ASSERT(j < entries.size());
+    StateId q = entries[j], t = entry_arc.nextstate;
+    double cost = -entry_costs[j];
+    if (chunk.Final(t) != CompactLatticeWeight::Zero())
+      clat->SetFinal(q, AddCost(Times(entry_arc.weight, chunk.Final(t)), cost));
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, t); !aiter.Done();
+         aiter.Next()) {
+      Arc arc = aiter.Value();
+      arc.weight = AddCost(Times(entry_arc.weight, arc.weight), cost);
+      arc.nextstate = state_map[arc.nextstate];
+      clat->AddArc(q, arc);
+    }
+  }
+}
+
+void LatticeFasterDecoder::AddRedeterminizedStates(
+    const DeterminizedLattice &det_lat,
+    const unordered_map<Token*, StateId> &tok_map,
+    Lattice *raw_lat, std::vector<StateId> *entries) const {
+  typedef CompactLatticeArc CArc;
+  const CompactLattice &clat = det_lat.clat;
+  // The states in det_lat.region with boundary arcs, and the states reachable
+  // from them (which are all in the region too).
+  unordered_map<StateId, StateId> state_map;  // clat state -> raw_lat state.
+  std::vector<StateId> queue;
+  for (size_t k = 0; k < det_lat.region.size(); k++) {
+    StateId s = det_lat.region[k];
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      if (aiter.Value().ilabel >= kBoundaryLabelOffset) {
+        state_map[s] = raw_lat->AddState();
+        queue.push_back(s);
+        break;
+      }
+    }
+  }
+  while (!queue.empty()) {
+    StateId s = queue.back();
+    queue.pop_back();
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CArc &arc = aiter.Value();
+      if (arc.ilabel < kBoundaryLabelOffset &&
+          state_map.count(arc.nextstate) == 0) {
+        state_map[arc.nextstate] = raw_lat->AddState();
+        queue.push_back(arc.nextstate);
+      }
+    }
+  }
+
+  // The entry states: those that were entries of the region, and those that
+  // states of the region outside this part have arcs to.
+  unordered_set<StateId> entry_set;
+  for (size_t k = 0; k < det_lat.entries.size(); k++)
+    if (state_map.count(det_lat.entries[k]) != 0)
+      entry_set.insert(det_lat.entries[k]);
+  for (size_t k = 0; k < det_lat.region.size(); k++) {
+    StateId s = det_lat.region[k];
+    if (state_map.count(s) != 0) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next())
+      if (state_map.count(aiter.Value().nextstate) != 0)
+        entry_set.insert(aiter.Value().nextstate);
+  }
+  CopySetToVector(entry_set, entries);
+  std::sort(entries->begin(), entries->end());
+
+  // The start state has an arc to each entry state, with its forward cost
+  // relative to the best of them, so that pruned determinization sees the
+  // costs of whole paths.
+  std::vector<double> costs(entries->size());
+  double best_cost = std::numeric_limits<double>::infinity();
+  for (size_t j = 0; j < entries->size(); j++) {
+    unordered_map<StateId, double>::const_iterator iter =
+        det_lat.forward_costs.find((*entries)[j]);
+    KALDI_ASSERT(iter != det_lat.forward_costs.end());
+    costs[j] = iter->second;
+    best_cost = std::min(best_cost, costs[j]);
+  }
+  StateId start_state = raw_lat->AddState();
+  raw_lat->SetStart(start_state);
+  for (size_t j = 0; j < entries->size(); j++)
+    raw_lat->AddArc(start_state,
+                    LatticeArc(0, kEntryLabelOffset + j,
+                               LatticeWeight(costs[j] - best_cost, 0.0),
+                               state_map[(*entries)[j]]));
+
+  // The states of the boundary tokens that are still alive; some may have
+  // been pruned since the lattice was split.
+  unordered_map<Token*, size_t> boundary_index;
+  for (size_t i = 0; i < boundary_toks_.size(); i++)
+    boundary_index[boundary_toks_[i].tok] = i;
+  std::vector<StateId> boundary_states(boundary_toks_.size(), fst::kNoStateId);
+  for (Token *tok = active_toks_[chunk_start_frame_].toks; tok != NULL;
+       tok = tok->next) {
+    unordered_map<Token*, size_t>::const_iterator iter =
+        boundary_index.find(tok);
+    if (iter != boundary_index.end())
+      boundary_states[iter->second] = tok_map.find(tok)->second;
+  }
+
+  // Copy the arcs, with the boundary arcs (and the final-probs after them)
+  // now leading to the tokens, and the cost that was put on them when the
+  // lattice was split taken out again.
+  for (unordered_map<StateId, StateId>::const_iterator iter = state_map.begin();
+       iter != state_map.end(); ++iter) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat, iter->first);
+         !aiter.Done(); aiter.Next()) {
+      const CArc &arc = aiter.Value();
+      if (arc.ilabel < kBoundaryLabelOffset) {
+        AddCompactArcPath(iter->second, arc.ilabel, arc.weight,
+                          state_map[arc.nextstate], raw_lat);
+        continue;
+      }
+      size_t i = arc.ilabel - kBoundaryLabelOffset;
+      KALDI_ASSERT(i < boundary_toks_.size());
+      if (boundary_states[i] == fst::kNoStateId) continue;
+      CompactLatticeWeight weight = AddCost(
+          Times(arc.weight, clat.Final(arc.nextstate)),
+          boundary_toks_[i].forward_cost - boundary_toks_[i].extra_cost);
+      AddCompactArcPath(iter->second, 0, weight, boundary_states[i], raw_lat);
+    }
+  }
+}
+
+bool LatticeFasterDecoder::MergeLatticeChunk(
+    int32 end_frame, const std::vector<BoundaryToken> &end_toks,
+    DeterminizedLattice *det_lat) const {
+  Lattice raw_lat;
+  unordered_map<Token*, StateId> tok_map;
+  if (!GetRawLatticeChunk(end_frame, end_toks, &raw_lat, &tok_map))
+    return false;
+  if (chunk_start_frame_ == 0) {
+    DeterminizeLatticeChunk(&raw_lat, &(det_lat->clat));
+    const CompactLattice &clat = det_lat->clat;
+    std::vector<double> costs;
+    ComputeForwardCosts(clat, &costs);
+    det_lat->region.clear();
+    det_lat->entries.clear();
+    det_lat->forward_costs.clear();
+    for (StateId s = 0; s < clat.NumStates(); s++) {
+      det_lat->region.push_back(s);
+      det_lat->forward_costs[s] = costs[s];
+    }
+    if (clat.Start() != fst::kNoStateId)
+      det_lat->entries.push_back(clat.Start());
+    return true;
+  }
+  if (det_lat->clat.Start() == fst::kNoStateId)
+    return true;  // The lattice was lost earlier.
+  std::vector<StateId> entries;
+  AddRedeterminizedStates(*det_lat, tok_map, &raw_lat, &entries);
+  // The arcs from the start state carry the entry states' forward costs
+  // relative to the best of them; SpliceLatticeChunk() needs both.
+  std::vector<double> entry_costs(entries.size());
+  double offset = std::numeric_limits<double>::infinity();
+  for (size_t j = 0; j < entries.size(); j++) {
+    entry_costs[j] = det_lat->forward_costs.find(entries[j])->second;
+    offset = std::min(offset, entry_costs[j]);
+  }
+  for (size_t j = 0; j < entries.size(); j++)
+    entry_costs[j] -= offset;
+  CompactLattice chunk;
+  DeterminizeLatticeChunk(&raw_lat, &chunk);
+  SpliceLatticeChunk(chunk, entries, entry_costs, offset, &(det_lat->clat),
+                     &(det_lat->region), &(det_lat->forward_costs));
+  return true;
+}
+
+void LatticeFasterDecoder::PossiblyDeterminizeChunk(int32 cur_frame) {
+  int32 last_frame = cur_frame - config_.determinize_delay;
+  if (last_frame - chunk_start_frame_ < config_.determinize_period)
+    return;
+  // Split at the frame with the fewest tokens among the most recent ones,
+  // preferring later frames.
+  int32 first_frame = std::max(chunk_start_frame_ + 1,
+                               last_frame - config_.determinize_period / 2),
+      end_frame = last_frame;
+  size_t best_num_toks = std::numeric_limits<size_t>::max();
+  for (int32 f = last_frame; f >= first_frame; f--) {
+    size_t num_toks = 0;
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next)
+      num_toks++;
+    if (num_toks < best_num_toks) {
+      best_num_toks = num_toks;
+      end_frame = f;
+    }
+  }
+
+  const BaseFloat infinity = std::numeric_limits<BaseFloat>::infinity();
+  BaseFloat best_cost = infinity;
+  for (Token *tok = active_toks_[end_frame].toks; tok != NULL; tok = tok->next)
+    best_cost = std::min(best_cost, tok->tot_cost);
+  std::vector<BoundaryToken> end_toks;
+  for (Token *tok = active_toks_[end_frame].toks; tok != NULL; tok = tok->next)
+    if (tok->extra_cost != infinity)
+      end_toks.push_back(BoundaryToken(tok, tok->tot_cost - best_cost,
+                                       tok->extra_cost));
+
+  if (!MergeLatticeChunk(end_frame, end_toks, &det_lat_))
+    return;
+
+  // Delete the tokens before end_frame; the ones on end_frame lose their
+  // backpointers to them.
+  for (int32 f = chunk_start_frame_; f < end_frame; f++) {
+    for (Token *tok = active_toks_[f].toks; tok != NULL; ) {
+      tok->DeleteForwardLinks();
+      Token *next_tok = tok->next;
+      delete tok;
+      num_toks_--;
+      tok = next_tok;
+    }
+    active_toks_[f].toks = NULL;
+  }
+  unordered_set<Token*> end_frame_toks;
+  for (Token *tok = active_toks_[end_frame].toks; tok != NULL; tok = tok->next)
+    end_frame_toks.insert(tok);
+  for (Token *tok = active_toks_[end_frame].toks; tok != NULL; tok = tok->next)
+    if (end_frame_toks.count(tok->backpointer) == 0)
+      tok->backpointer = NULL;
+  boundary_toks_.swap(end_toks);
+  chunk_start_frame_ = end_frame;
+  KALDI_VLOG(2) << "Determinized lattice up to frame " << end_frame
+                << ", it has " << det_lat_.clat.NumStates() << " states; "
+                << num_toks_ << " tokens remain.";
+}
+
 void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
@@ -200,7 +780,7 @@ void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
 inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
-    StateId state, int32 frame, BaseFloat tot_cost,
+    StateId state, int32 frame, BaseFloat tot_cost, Token *backpointer,
     bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
   // if the token was newly created or the cost changed.
@@ -212,7 +792,8 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks,
+                                backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -223,6 +804,7 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     Token *tok = e_found->val; // There is an existing Token for this state.
     if (tok->tot_cost > tot_cost) { // replace old token
       tok->tot_cost = tot_cost;
+      tok->backpointer = backpointer;
       // we don't allocate a new token, the old stays linked in active_toks_
       // we only replace the tot_cost
       // in the current frame, there are no forward links (and no extra_cost)
@@ -450,7 +1032,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame) {
 // for a larger delta, we will recurse less far back
 void LatticeFasterDecoder::PruneActiveTokens(int32 cur_frame, BaseFloat delta) {
   int32 num_toks_begin = num_toks_;
-  for (int32 frame = cur_frame-1; frame >= 0; frame--) {
+  for (int32 frame = cur_frame-1; frame >= chunk_start_frame_; frame--) {
     // Reason why we need to prune forward links in this situation:
     // (1) we have never pruned them (new TokenList)
     // (2) we have not yet pruned the forward links to the next frame,
@@ -458,7 +1040,8 @@ void LatticeFasterDecoder::PruneActiveTokens(int32 cur_frame, BaseFloat delta) {
     if (active_toks_[frame].must_prune_forward_links) {
       bool extra_costs_changed = false, links_pruned = false;
       PruneForwardLinks(frame, &extra_costs_changed, &links_pruned, delta);
-      if (extra_costs_changed && frame > 0) // any token has changed extra_cost
+      if (extra_costs_changed && frame > chunk_start_frame_)
+        // any token has changed extra_cost
         active_toks_[frame-1].must_prune_forward_links = true;
       if (links_pruned) // any link was pruned
         active_toks_[frame].must_prune_tokens = true;
@@ -480,13 +1063,13 @@ void LatticeFasterDecoder::PruneActiveTokensFinal(int32 cur_frame) {
   int32 num_toks_begin = num_toks_;
   PruneForwardLinksFinal(cur_frame); // prune final frame (with final-probs)
   // sets final_active_ and final_probs_
-  for (int32 frame = cur_frame-1; frame >= 0; frame--) {
+  for (int32 frame = cur_frame-1; frame >= chunk_start_frame_; frame--) {
     bool b1, b2; // values not used.
     BaseFloat dontcare = 0.0; // delta of zero means we must always update
     PruneForwardLinks(frame, &b1, &b2, dontcare);
     PruneTokensForFrame(frame+1);
   }
-  PruneTokensForFrame(0); 
+  PruneTokensForFrame(chunk_start_frame_);
   KALDI_VLOG(3) << "PruneActiveTokensFinal: pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
 }
@@ -623,7 +1206,8 @@ void LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable, int32
           if (tot_cost > next_cutoff) continue;
           else if (tot_cost + config_.beam < next_cutoff)
             next_cutoff = tot_cost + config_.beam; // prune by best current token
-          Token *next_tok = FindOrAddToken(arc.nextstate, frame, tot_cost, NULL);
+          Token *next_tok = FindOrAddToken(arc.nextstate, frame, tot_cost,
+                                           tok, NULL);
           // NULL: no change indicator needed
           
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
@@ -689,7 +1273,7 @@ void LatticeFasterDecoder::ProcessNonemitting(int32 frame) {
           bool changed;
 
           Token *new_tok = FindOrAddToken(arc.nextstate, frame, tot_cost,
-                                          &changed);
+                                          tok, &changed);
             
           tok->links = new ForwardLink(new_tok, 0, arc.olabel,
                                        graph_cost, 0, tok->links);
@@ -784,6 +1368,18 @@ void DecodeUtteranceLatticeFasterClass::operator () () {
   }
   if (!success_) return;
 
+  if (decoder_->GetOptions().determinize_period > 0) {
+    // The decoder determinized most of the lattice while decoding.
+    if (!determinize_)
+      KALDI_ERR << "--determinize-period > 0 requires determinization.";
+    clat_ = new CompactLattice;
+    if (!decoder_->GetLattice(clat_))
+      KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt_;
+    if (acoustic_scale_ != 0.0)
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), clat_);
+    return;
+  }
+
   // Get lattice, and do determinization if requested.
   lat_ = new Lattice;
   if (!decoder_->GetRawLattice(lat_))
@@ -953,6 +1549,24 @@ bool DecodeUtteranceLatticeFaster(
     likelihood = -(weight.Value1() + weight.Value2());
   }
 
+  if (decoder.GetOptions().determinize_period > 0) {
+    // The decoder determinized most of the lattice while decoding.
+    if (!determinize)
+      KALDI_ERR << "--determinize-period > 0 requires determinization.";
+    CompactLattice clat;
+    if (!decoder.GetLattice(&clat))
+      KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
+    // We'll write the lattice without acoustic scaling.
+    if (acoustic_scale != 0.0)
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
+    compact_lattice_writer->Write(utt, clat);
+    KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
+              << (likelihood / num_frames) << " over "
+              << num_frames << " frames.";
+    *like_ptr = likelihood;
+    return true;
+  }
+
   // Get lattice, and do determinization if requested.
   Lattice lat;
   if (!decoder.GetRawLattice(&lat))
@@ -43,6 +43,10 @@ struct LatticeFasterDecoderConfig {
   // command-line program.
   BaseFloat beam_delta; // has nothing to do with beam_ratio
   BaseFloat hash_ratio;
+  int32 determinize_period; // if > 0, determinize the lattice incrementally
+  // during decoding, in chunks of about this many frames.
+  int32 determinize_delay; // only frames at least this far behind the
+  // decoding front are determinized incrementally.
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
@@ -54,7 +58,9 @@ struct LatticeFasterDecoderConfig {
                                 prune_interval(25),
                                 determinize_lattice(true),
                                 beam_delta(0.5),
-                                hash_ratio(2.0) {}
+                                hash_ratio(2.0),
+                                determinize_period(0),
+                                determinize_delay(50) {}
   void Register(OptionsItf *po) {
     det_opts.Register(po);
     po->Register("beam", &beam, "Decoding beam.");
@@ -71,11 +77,21 @@ struct LatticeFasterDecoderConfig {
                  "max-active constraint is applied.  Larger is more accurate.");
     po->Register("hash-ratio", &hash_ratio, "Setting used in decoder to control"
                  " hash behavior");
+    po->Register("determinize-period", &determinize_period, "If > 0, the "
+                 "lattice is determinized incrementally while decoding, in "
+                 "chunks of about this many frames, so that long utterances "
+                 "need less memory and the lattice is ready soon after the "
+                 "last frame.  Requires --determinize-lattice=true.");
+    po->Register("determinize-delay", &determinize_delay, "With "
+                 "--determinize-period > 0, the number of frames behind the "
+                 "decoding front that are not yet determinized (larger is "
+                 "more accurate, as those frames are better pruned).");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0 
                  && prune_interval > 0 && beam_delta > 0.0
-                 && hash_ratio >= 1.0);
+                 && hash_ratio >= 1.0 && determinize_period >= 0
+                 && determinize_delay > 0);
   }
 };
 
@@ -83,6 +99,29 @@ struct LatticeFasterDecoderConfig {
 /** A bit more optimized version of the lattice decoder.
    See \ref lattices_generation \ref decoders_faster and \ref decoders_simple
     for more information.
+
+   Incremental determinization: if config.determinize_period > 0, then every
+   so often (at most once per prune_interval frames) the decoder picks a frame
+   that is at least config.determinize_delay frames behind the decoding front
+   and has few tokens, determinizes the part of the lattice between the
+   previous such frame and this one, merges it into the determinized lattice
+   so far and deletes the tokens before that frame.  The chunks are joined via
+   their tokens on the splitting frame: the raw lattice of a chunk ends with an
+   arc from each token on that frame to a single final state, labeled with a
+   special symbol that identifies the token.  The cost on that arc is chosen
+   so that determinizing the chunk separately prunes it about as much as
+   determinizing the whole lattice would.  When the next chunk is merged in,
+   the states of the determinized lattice from which such arcs can be reached
+   (the word histories still open at the split) are determinized again
+   together with the new chunk, their arcs to the final state now leading to
+   the tokens, and the result replaces them.  Paths with the same words that
+   cross the split through different tokens, or with a word before the split
+   on one side and after it on the other, are thus merged, and the lattice
+   stays deterministic (one path per word sequence) while only the end of it
+   is ever determinized again.  This bounds the memory used by the tokens,
+   and means that GetLattice() only has to determinize the last chunk at the
+   end of the utterance.  The raw lattice is then no longer available, and
+   GetBestPathTraceback() only sees the frames since the last chunk.
  */
 class LatticeFasterDecoder {
  public:
@@ -115,25 +154,70 @@ class LatticeFasterDecoder {
   }
 
   // Returns true if any kind of traceback is available (not necessarily from
-  // a final state).
+  // a final state).  This is equivalent to calling InitDecoding(),
+  // AdvanceDecoding() and FinalizeDecoding().
   bool Decode(DecodableInterface *decodable);
+
+  /// InitDecoding initializes the decoding, and should only be used if you
+  /// intend to call AdvanceDecoding().  If you call Decode(), you don't need
+  /// to call this.  You can call it again to start a new utterance.
+  void InitDecoding();
+
+  /// Decodes until the decodable object says there are no more frames, or
+  /// (if max_num_frames >= 0) until max_num_frames more frames have been
+  /// decoded; returns the number of frames decoded in this call.  The frames
+  /// of "decodable" are numbered from the start of the utterance, so the same
+  /// decodable object should be given each time (or one that numbers its frames
+  /// in the same way).  Between calls, you can get partial results from
+  /// GetBestPathTraceback() or GetRawLattice().
+  int32 AdvanceDecoding(DecodableInterface *decodable,
+                        int32 max_num_frames = -1);
+
+  /// Does the final pruning of the lattice, using the final-probs (if any
+  /// final state is active on the last frame); call this when there are no
+  /// more frames to decode, before getting the lattice.  After this,
+  /// AdvanceDecoding() cannot be called until the next InitDecoding().
+  void FinalizeDecoding();
+
+  /// Returns the number of frames decoded so far in this utterance.
+  int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
   
   /// says whether a final-state was active on the last frame.  If it was not, the
   /// lattice (or traceback) will end with states that are not final-states.
   bool ReachedFinal() const { return final_active_; }
 
   // Outputs an FST corresponding to the single best path
-  // through the lattice.
+  // through the lattice.  With incremental determinization, this is the best
+  // path through the output of GetLattice().
   bool GetBestPath(fst::MutableFst<LatticeArc> *ofst) const;
 
+  /// Outputs a linear FST for the best path through the frames decoded so far,
+  /// found by following the tokens' back-pointers from the best token on the
+  /// last frame (taking the final-probs into account if use_final_probs is
+  /// true and some final state is active).  This is much cheaper than
+  /// GetBestPath(), which works out the whole raw lattice, so it is suitable
+  /// for partial results between calls to AdvanceDecoding().  If num_frames
+  /// >= 0, only the last num_frames frames of the path are output.  With
+  /// incremental determinization, the path only goes back to the last frame
+  /// at which the lattice was split.  Returns false if there is no path.
+  bool GetBestPathTraceback(fst::MutableFst<LatticeArc> *ofst,
+                            bool use_final_probs = true,
+                            int32 num_frames = -1) const;
+
   // Outputs an FST corresponding to the raw, state-level
-  // tracebacks.
+  // tracebacks.  If called before FinalizeDecoding(), the final-probs of the
+  // currently active states are used (or, if none is final, all of them are
+  // treated as final).  It is an error to call this once part of the lattice
+  // has been determinized incrementally (see config.determinize_period).
   bool GetRawLattice(fst::MutableFst<LatticeArc> *ofst) const;
 
-  // This function is now deprecated, since now we do determinization from
-  // outside the LatticeTrackingDecoder class.
   // Outputs an FST corresponding to the lattice-determinized
-  // lattice (one path per word sequence).
+  // lattice (one path per word sequence).  Without incremental
+  // determinization this is deprecated, since we now do determinization from
+  // outside the LatticeTrackingDecoder class (using the phone-pruned version
+  // of the algorithm).  With it, this is the way to get the lattice: only the
+  // frames since the last chunk, and the end of the lattice before them, are
+  // determinized here.
   bool GetLattice(fst::MutableFst<CompactLatticeArc> *ofst) const;
 
 
@@ -173,10 +257,16 @@ class LatticeFasterDecoder {
     ForwardLink *links; // Head of singly linked list of ForwardLinks
     
     Token *next; // Next in list of tokens for this frame.
+
+    Token *backpointer; // The token that the best path to this one came from
+    // (on this frame or the previous one), or NULL for the start token.  The
+    // link from it to this token is never pruned while this token survives,
+    // since its extra_cost is the same as this token's.
     
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
-                 Token *next): tot_cost(tot_cost), extra_cost(extra_cost),
-                 links(links), next(next) { }
+                 Token *next, Token *backpointer):
+        tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
+        backpointer(backpointer) { }
     inline void DeleteForwardLinks() {
       ForwardLink *l = links, *m; 
       while (l != NULL) {
@@ -198,6 +288,30 @@ class LatticeFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
+  // A token on the frame where the lattice was last split for incremental
+  // determinization.
+  struct BoundaryToken {
+    Token *tok;
+    BaseFloat forward_cost; // tot_cost, relative to the best one on the frame.
+    BaseFloat extra_cost; // its extra_cost when the lattice was split.
+    BoundaryToken(Token *tok, BaseFloat forward_cost, BaseFloat extra_cost):
+        tok(tok), forward_cost(forward_cost), extra_cost(extra_cost) { }
+  };
+
+  // The lattice determinized so far with incremental determinization, with
+  // what is needed to merge the next chunk into it.
+  struct DeterminizedLattice {
+    typedef CompactLatticeArc::StateId StateId;
+    CompactLattice clat; // the determinized lattice up to chunk_start_frame_;
+    // it may contain dead states, which Connect() removes on output.
+    std::vector<StateId> region; // the states that were created or rewritten
+    // when the last chunk was merged in; only these can lead to boundary arcs.
+    std::vector<StateId> entries; // the states in "region" that states
+    // outside it have arcs to.
+    unordered_map<StateId, double> forward_costs; // the best cost of reaching
+    // each state in "region" from the start of "clat".
+  };
+
   typedef HashList<StateId, Token*>::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
@@ -208,9 +322,59 @@ class LatticeFasterDecoder {
   // and also into the singly linked list of tokens active on this frame
   // (whose head is at active_toks_[frame]).
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
-  // if the token was newly created or the cost changed.
+  // if the token was newly created or the cost changed; in that case its
+  // backpointer is set to "backpointer".
   inline Token *FindOrAddToken(StateId state, int32 frame, BaseFloat tot_cost,
-                               bool *changed);
+                               Token *backpointer, bool *changed);
+
+  // Works out the final-costs of the tokens on the last frame: after
+  // FinalizeDecoding() these are final_costs_; before, they are the
+  // final-probs of the currently active states, or zero for all of them if
+  // none is final.
+  void ComputeFinalCosts(std::map<Token*, BaseFloat> *final_costs) const;
+
+  // Outputs the raw lattice for frames chunk_start_frame_ to end_frame, and
+  // the state of each token in it.  If chunk_start_frame_ == 0 its start
+  // state is that of the start token; otherwise the start state is left for
+  // AddRedeterminizedStates() to add.  If end_frame is not the last frame,
+  // the links out of the tokens on end_frame are left out, and instead each
+  // token in end_toks has an arc to a single final state (see the class
+  // comment).
+  bool GetRawLatticeChunk(int32 end_frame,
+                          const std::vector<BoundaryToken> &end_toks,
+                          Lattice *ofst,
+                          unordered_map<Token*, StateId> *tok_map) const;
+
+  // Adds to raw_lat, the raw lattice since chunk_start_frame_, a start state
+  // and a copy of the part of det_lat.clat that has to be determinized again
+  // with it: the states reachable from those with boundary arcs, whose
+  // boundary arcs now lead to the tokens on chunk_start_frame_.  The start
+  // state has an arc labeled kEntryLabelOffset + j to the copy of
+  // (*entries)[j], for each of those states that other states have arcs to.
+  void AddRedeterminizedStates(const DeterminizedLattice &det_lat,
+                               const unordered_map<Token*, StateId> &tok_map,
+                               Lattice *raw_lat,
+                               std::vector<StateId> *entries) const;
+
+  // Determinizes a raw lattice (as output by GetRawLatticeChunk()) in the
+  // same way as GetLattice(), and sorts it topologically.
+  void DeterminizeLatticeChunk(Lattice *raw_lat, CompactLattice *clat) const;
+
+  // Determinizes the frames from chunk_start_frame_ to end_frame (see
+  // GetRawLatticeChunk()) together with the end of det_lat->clat, which they
+  // replace.  The result is deterministic as a whole, and the work done is
+  // proportional to the size of the chunk rather than of the whole lattice.
+  // Returns false if the raw lattice could not be obtained.
+  bool MergeLatticeChunk(int32 end_frame,
+                         const std::vector<BoundaryToken> &end_toks,
+                         DeterminizedLattice *det_lat) const;
+
+  // Called after pruning on frame cur_frame if config_.determinize_period >
+  // 0.  Once enough frames are at least config_.determinize_delay behind
+  // cur_frame, splits the lattice at the one of the most recent of them with
+  // the fewest tokens, merges the part before it into det_lat_ and deletes
+  // the tokens on earlier frames.
+  void PossiblyDeterminizeChunk(int32 cur_frame);
   
   // prunes outgoing links for all tokens in active_toks_[frame]
   // it's called by PruneActiveTokens
@@ -283,8 +447,16 @@ class LatticeFasterDecoder {
   bool warned_;
   bool final_active_; // use this to say whether we found active final tokens
   // on the last frame.
+  bool decoding_finalized_; // true if FinalizeDecoding() has been called.
   std::map<Token*, BaseFloat> final_costs_; // A cache of final-costs
   // of tokens on the last frame-- it's just convenient to store it this way.
+
+  // The following are only used for incremental determinization.
+  int32 chunk_start_frame_; // the frame where the lattice was last split (or
+  // zero); the tokens on earlier frames have been deleted.
+  std::vector<BoundaryToken> boundary_toks_; // the tokens on chunk_start_frame_
+  // when it was split; the i'th is labeled kBoundaryLabelOffset + i.
+  DeterminizedLattice det_lat_; // the lattice up to chunk_start_frame_.
   
   // There are various cleanup tasks... the the toks_ structure contains
   // singly linked lists of Token pointers, where Elem is the list type.
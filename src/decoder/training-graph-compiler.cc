@@ -17,6 +17,8 @@
 // limitations under the License.
 #include "decoder/training-graph-compiler.h"
 #include "hmm/hmm-utils.h" // for GetHTransducer
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -27,7 +29,8 @@ TrainingGraphCompiler::TrainingGraphCompiler(const TransitionModel &trans_model,
                                              const std::vector<int32> &disambig_syms,
                                              const TrainingGraphCompilerOptions &opts):
     trans_model_(trans_model), ctx_dep_(ctx_dep), lex_fst_(lex_fst),
-    disambig_syms_(disambig_syms), opts_(opts) {
+    disambig_syms_(disambig_syms), cfst_(NULL), H_(NULL), H_num_ilabels_(0),
+    opts_(opts) {
   using namespace fst;
   const std::vector<int32> &phone_syms = trans_model_.GetPhones();  // needed to create context fst.
 
@@ -57,78 +60,57 @@ TrainingGraphCompiler::TrainingGraphCompiler(const TransitionModel &trans_model,
     fst::OLabelCompare<fst::StdArc> olabel_comp;
     fst::ArcSort(lex_fst_, olabel_comp);
   }
-}
 
-bool TrainingGraphCompiler::CompileGraphFromText(
-    const std::vector<int32> &transcript,
-    fst::VectorFst<fst::StdArc> *out_fst) {
-  using namespace fst;
-  VectorFst<StdArc> word_fst;
-  MakeLinearAcceptor(transcript, &word_fst);
-  return CompileGraph(word_fst, out_fst);
+  // make cfst_ [ it's expanded on the fly ]
+  cfst_ = new ContextFst<StdArc>(subseq_symbol,
+                                 phone_syms,
+                                 disambig_syms_,
+                                 ctx_dep.ContextWidth(),
+                                 ctx_dep.CentralPosition());
 }
 
-bool TrainingGraphCompiler::CompileGraph(const fst::VectorFst<fst::StdArc> &word_fst,
-                                         fst::VectorFst<fst::StdArc> *out_fst) {
-  using namespace fst;
-  KALDI_ASSERT(lex_fst_ !=NULL);
-  KALDI_ASSERT(out_fst != NULL);
-
-  VectorFst<StdArc> phone2word_fst;
-  // TableCompose more efficient than compose.
-  TableCompose(*lex_fst_, word_fst, &phone2word_fst, &lex_cache_);
-
-  KALDI_ASSERT(phone2word_fst.Start() != kNoStateId);
-
-  ContextFst<StdArc> *cfst = NULL;
-  {  // make cfst [ it's expanded on the fly ]
-    const std::vector<int32> &phone_syms = trans_model_.GetPhones();  // needed to create context fst.
-    int32 subseq_symbol = phone_syms.back() + 1;
-    if (!disambig_syms_.empty() && subseq_symbol <= disambig_syms_.back())
-      subseq_symbol = 1 + disambig_syms_.back();
-
-    cfst = new ContextFst<StdArc>(subseq_symbol,
-                                  phone_syms,
-                                  disambig_syms_,
-                                  ctx_dep_.ContextWidth(),
-                                  ctx_dep_.CentralPosition());
-  }
-
-  VectorFst<StdArc> ctx2word_fst;
-  ComposeContextFst(*cfst, phone2word_fst, &ctx2word_fst);
-  // ComposeContextFst is like Compose but faster for this particular Fst type.
-  // [and doesn't expand too many arcs in the ContextFst.]
-
-  KALDI_ASSERT(ctx2word_fst.Start() != kNoStateId);
+TrainingGraphCompiler::~TrainingGraphCompiler() {
+  delete lex_fst_;
+  delete cfst_;
+  delete H_;
+}
 
+void TrainingGraphCompiler::UpdateHTransducer() {
+  const std::vector<std::vector<int32> > &ilabel_info = cfst_->ILabelInfo();
+  if (H_ != NULL && H_num_ilabels_ == ilabel_info.size())
+    return;
   HTransducerConfig h_cfg;
   h_cfg.transition_scale = opts_.transition_scale;
+  delete H_;
+  disambig_syms_h_.clear();
+  H_ = GetHTransducer(ilabel_info,
+                      ctx_dep_,
+                      trans_model_,
+                      h_cfg,
+                      &disambig_syms_h_);
+  H_num_ilabels_ = ilabel_info.size();
+}
+
+void TrainingGraphCompiler::CompileGraphFromCLG(
+    const fst::VectorFst<fst::StdArc> &H,
+    fst::VectorFst<fst::StdArc> *fst) const {
+  using namespace fst;
+  VectorFst<StdArc> trans2word_fst;  // transition-id to word.
+  TableCompose(H, *fst, &trans2word_fst);
 
-  std::vector<int32> disambig_syms_h; // disambiguation symbols on
-  // input side of H.
-  VectorFst<StdArc> *H = GetHTransducer(cfst->ILabelInfo(),
-                                        ctx_dep_,
-                                        trans_model_,
-                                        h_cfg,
-                                        &disambig_syms_h);
-  
-  VectorFst<StdArc> &trans2word_fst = *out_fst;  // transition-id to word.
-  TableCompose(*H, ctx2word_fst, &trans2word_fst);
-  
   KALDI_ASSERT(trans2word_fst.Start() != kNoStateId);
 
   // Epsilon-removal and determinization combined. This will fail if not determinizable.
   DeterminizeStarInLog(&trans2word_fst);
 
-  if (!disambig_syms_h.empty()) {
-    RemoveSomeInputSymbols(disambig_syms_h, &trans2word_fst);
+  if (!disambig_syms_h_.empty()) {
+    RemoveSomeInputSymbols(disambig_syms_h_, &trans2word_fst);
     // we elect not to remove epsilons after this phase, as it is
     // a little slow.
     if (opts_.rm_eps)
       RemoveEpsLocal(&trans2word_fst);
   }
 
-  
   // Encoded minimization.
   MinimizeEncoded(&trans2word_fst);
 
@@ -139,8 +121,41 @@ bool TrainingGraphCompiler::CompileGraph(const fst::VectorFst<fst::StdArc> &word
                opts_.reorder,
                &trans2word_fst);
 
-  delete H;
-  delete cfst;
+  KALDI_ASSERT(trans2word_fst.Start() != kNoStateId);
+
+  *fst = trans2word_fst;
+}
+
+bool TrainingGraphCompiler::CompileGraphFromText(
+    const std::vector<int32> &transcript,
+    fst::VectorFst<fst::StdArc> *out_fst) {
+  using namespace fst;
+  VectorFst<StdArc> word_fst;
+  MakeLinearAcceptor(transcript, &word_fst);
+  return CompileGraph(word_fst, out_fst);
+}
+
+bool TrainingGraphCompiler::CompileGraph(const fst::VectorFst<fst::StdArc> &word_fst,
+                                         fst::VectorFst<fst::StdArc> *out_fst) {
+  using namespace fst;
+  KALDI_ASSERT(lex_fst_ !=NULL);
+  KALDI_ASSERT(out_fst != NULL);
+
+  VectorFst<StdArc> phone2word_fst;
+  // TableCompose more efficient than compose.
+  TableCompose(*lex_fst_, word_fst, &phone2word_fst, &lex_cache_);
+
+  KALDI_ASSERT(phone2word_fst.Start() != kNoStateId);
+
+  VectorFst<StdArc> &ctx2word_fst = *out_fst;
+  ComposeContextFst(*cfst_, phone2word_fst, &ctx2word_fst);
+  // ComposeContextFst is like Compose but faster for this particular Fst type.
+  // [and doesn't expand too many arcs in the ContextFst.]
+
+  KALDI_ASSERT(ctx2word_fst.Start() != kNoStateId);
+
+  UpdateHTransducer();
+  CompileGraphFromCLG(*H_, out_fst);
   return true;
 }
 
@@ -161,6 +176,39 @@ bool TrainingGraphCompiler::CompileGraphsFromText(
   return ans;
 }
 
+// Does the second half of the compilation (see CompileGraphFromCLG()) for
+// a number of graphs, in parallel.  The graphs are handed out one at a time
+// to whichever thread is free, as they can be of very different sizes.
+class CompileGraphsFromCLGClass: public MultiThreadable {
+ public:
+  CompileGraphsFromCLGClass(
+      const TrainingGraphCompiler &gc,
+      const std::vector<const fst::VectorFst<fst::StdArc>*> &H_copies,
+      std::vector<fst::VectorFst<fst::StdArc>*> *fsts,
+      size_t *next_fst,
+      Mutex *next_fst_mutex):
+      gc_(gc), H_copies_(H_copies), fsts_(fsts), next_fst_(next_fst),
+      next_fst_mutex_(next_fst_mutex) { }
+  void operator () () {
+    // Each thread uses its own copy of H, as OpenFst's reference counting
+    // is not thread safe.
+    const fst::VectorFst<fst::StdArc> &H = *(H_copies_[thread_id_]);
+    while (true) {
+      next_fst_mutex_->Lock();
+      size_t i = (*next_fst_)++;
+      next_fst_mutex_->Unlock();
+      if (i >= fsts_->size()) break;
+      gc_.CompileGraphFromCLG(H, (*fsts_)[i]);
+    }
+  }
+ private:
+  const TrainingGraphCompiler &gc_;
+  const std::vector<const fst::VectorFst<fst::StdArc>*> &H_copies_;
+  std::vector<fst::VectorFst<fst::StdArc>*> *fsts_;
+  size_t *next_fst_;
+  Mutex *next_fst_mutex_;
+};
+
 bool TrainingGraphCompiler::CompileGraphs(
     const std::vector<const fst::VectorFst<fst::StdArc>* > &word_fsts,
     std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts) {
@@ -171,20 +219,8 @@ bool TrainingGraphCompiler::CompileGraphs(
   out_fsts->resize(word_fsts.size(), NULL);
   if (word_fsts.empty()) return true;
 
-  ContextFst<StdArc> *cfst = NULL;
-  {  // make cfst [ it's expanded on the fly ]
-    const std::vector<int32> &phone_syms = trans_model_.GetPhones();  // needed to create context fst.
-    int32 subseq_symbol = phone_syms.back() + 1;
-    if (!disambig_syms_.empty() && subseq_symbol <= disambig_syms_.back())
-      subseq_symbol = 1 + disambig_syms_.back();
-
-    cfst = new ContextFst<StdArc>(subseq_symbol,
-                                  phone_syms,
-                                  disambig_syms_,
-                                  ctx_dep_.ContextWidth(),
-                                  ctx_dep_.CentralPosition());
-  }
-
+  // The first half of the compilation is done sequentially, as it uses
+  // lex_cache_ and cfst_, which are not thread safe.
   for (size_t i = 0; i < word_fsts.size(); i++) {
     VectorFst<StdArc> phone2word_fst;
     // TableCompose more efficient than compose.
@@ -193,57 +229,39 @@ bool TrainingGraphCompiler::CompileGraphs(
     KALDI_ASSERT(phone2word_fst.Start() != kNoStateId &&
                  "Perhaps you have words missing in your lexicon?");
     
-    VectorFst<StdArc> ctx2word_fst;
-    ComposeContextFst(*cfst, phone2word_fst, &ctx2word_fst);
+    VectorFst<StdArc> *ctx2word_fst = new VectorFst<StdArc>;
+    ComposeContextFst(*cfst_, phone2word_fst, ctx2word_fst);
     // ComposeContextFst is like Compose but faster for this particular Fst type.
     // [and doesn't expand too many arcs in the ContextFst.]
 
-    KALDI_ASSERT(ctx2word_fst.Start() != kNoStateId);
+    KALDI_ASSERT(ctx2word_fst->Start() != kNoStateId);
 
-    (*out_fsts)[i] = ctx2word_fst.Copy();  // For now this contains the FST with symbols
+    (*out_fsts)[i] = ctx2word_fst;  // For now this contains the FST with symbols
     // representing phones-in-context.
   }
 
-  HTransducerConfig h_cfg;
-  h_cfg.transition_scale = opts_.transition_scale;
-
-  std::vector<int32> disambig_syms_h;
-  VectorFst<StdArc> *H = GetHTransducer(cfst->ILabelInfo(),
-                                        ctx_dep_,
-                                        trans_model_,
-                                        h_cfg,
-                                        &disambig_syms_h);
-
-  for (size_t i = 0; i < out_fsts->size(); i++) {
-    VectorFst<StdArc> &ctx2word_fst = *((*out_fsts)[i]);
-    VectorFst<StdArc> trans2word_fst;
-    TableCompose(*H, ctx2word_fst, &trans2word_fst);
-
-    DeterminizeStarInLog(&trans2word_fst);
-
-    if (!disambig_syms_h.empty()) {
-      RemoveSomeInputSymbols(disambig_syms_h, &trans2word_fst);
-      if (opts_.rm_eps)
-        RemoveEpsLocal(&trans2word_fst);
+  UpdateHTransducer();
+
+  int32 num_threads = std::min<size_t>(g_num_threads, out_fsts->size());
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < out_fsts->size(); i++)
+      CompileGraphFromCLG(*H_, (*out_fsts)[i]);
+  } else {
+    std::vector<const VectorFst<StdArc>*> H_copies(num_threads);
+    for (int32 t = 0; t < num_threads; t++)  // Deep copies: the constructor
+      // from Fst<Arc> does not share the implementation.
+      H_copies[t] = new VectorFst<StdArc>(static_cast<const Fst<StdArc>&>(*H_));
+    size_t next_fst = 0;
+    Mutex next_fst_mutex;
+    CompileGraphsFromCLGClass c(*this, H_copies, out_fsts, &next_fst,
+                                &next_fst_mutex);
+    {
+      // The destructor of "m" waits for the threads to finish.
+      MultiThreader<CompileGraphsFromCLGClass> m(num_threads, c);
     }
-    
-    // Encoded minimization.
-    MinimizeEncoded(&trans2word_fst);
-
-    std::vector<int32> disambig;
-    AddSelfLoops(trans_model_,
-                 disambig,
-                 opts_.self_loop_scale,
-                 opts_.reorder,
-                 &trans2word_fst);
-
-    KALDI_ASSERT(trans2word_fst.Start() != kNoStateId);
-
-    *((*out_fsts)[i]) = trans2word_fst;
+    for (int32 t = 0; t < num_threads; t++)
+      delete H_copies[t];
   }
-
-  delete H;
-  delete cfst;
   return true;
 }
 
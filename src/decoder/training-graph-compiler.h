@@ -74,7 +74,10 @@ class TrainingGraphCompiler {
                     fst::VectorFst<fst::StdArc> *out_fst);
   
   // CompileGraphs allows you to compile a number of graphs at the same
-  // time.  This consumes more memory but is faster.
+  // time.  This consumes more memory but is faster.  The expensive second
+  // half of the compilation (composition with H, determinization,
+  // minimization and adding self-loops) is done for the graphs in parallel,
+  // using g_num_threads threads (see ../thread/kaldi-thread.h).
   bool CompileGraphs(
       const std::vector<const fst::VectorFst<fst::StdArc> *> &word_fsts,
       std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
@@ -89,8 +92,22 @@ class TrainingGraphCompiler {
       std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
   
   
-  ~TrainingGraphCompiler() { delete lex_fst_; }
+  ~TrainingGraphCompiler();
  private:
+  friend class CompileGraphsFromCLGClass;
+
+  // Makes sure H_ covers all the phones-in-context that cfst_ has seen
+  // so far, rebuilding it if necessary.
+  void UpdateHTransducer();
+
+  // Does the part of the compilation that comes after composition with the
+  // context FST: on input "fst" has phones-in-context on its input side
+  // (i.e. it is CLG), on output it is the final graph.  "H" is H_ or a copy of
+  // it.  This function is const and so may be called from several threads.
+  void CompileGraphFromCLG(const fst::VectorFst<fst::StdArc> &H,
+                           fst::VectorFst<fst::StdArc> *fst) const;
+
+
   const TransitionModel &trans_model_;
   const ContextDependency &ctx_dep_;
   fst::VectorFst<fst::StdArc> *lex_fst_; // lexicon FST (an input; we take
@@ -100,6 +117,17 @@ class TrainingGraphCompiler {
   fst::TableComposeCache<fst::Fst<fst::StdArc> > lex_cache_;  // stores matcher..
   // this is one of Dan's extensions.
 
+  // The context FST is expanded on the fly; we keep it from one call to the
+  // next so that the contexts seen do not have to be expanded again, and the
+  // H transducer along with it.  H_ is rebuilt when cfst_ has seen new
+  // phones-in-context (its ilabel_info only ever grows, so a larger H_ is
+  // still correct for the older graphs).
+  fst::ContextFst<fst::StdArc> *cfst_;
+  fst::VectorFst<fst::StdArc> *H_;
+  std::vector<int32> disambig_syms_h_;  // disambiguation symbols on the input
+                                        // side of H_.
+  size_t H_num_ilabels_;  // size of cfst_->ILabelInfo() when H_ was built.
+
   TrainingGraphCompilerOptions opts_;
 };
 
@@ -0,0 +1,166 @@
+// feat/feature-extraction-task.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_FEATURE_EXTRACTION_TASK_H_
+#define KALDI_FEAT_FEATURE_EXTRACTION_TASK_H_
+
+#include <string>
+#include <vector>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/**
+   FeatureComputerPool holds one feature computer (e.g. Mfcc, Fbank or Plp)
+   per thread, for programs that compute features for several utterances in
+   parallel with TaskSequencer.  The computers can't be shared between
+   threads, as Compute() caches the mel banks and uses the FFT's temporary
+   storage.
+ */
+template<class F>
+class FeatureComputerPool {
+ public:
+  template<class Options>
+  FeatureComputerPool(const Options &opts, int32 num_threads):
+      num_available_(num_threads) {
+    KALDI_ASSERT(num_threads > 0);
+    for (int32 i = 0; i < num_threads; i++)
+      available_.push_back(new F(opts));
+  }
+
+  /// Waits until a computer is free and returns it; give it back with
+  /// Release().
+  F *Get() {
+    num_available_.Wait();
+    mutex_.Lock();
+    F *ans = available_.back();
+    available_.pop_back();
+    mutex_.Unlock();
+    return ans;
+  }
+
+  void Release(F *computer) {
+    mutex_.Lock();
+    available_.push_back(computer);
+    mutex_.Unlock();
+    num_available_.Signal();
+  }
+
+  /// All the computers must have been released.
+  ~FeatureComputerPool() {
+    for (size_t i = 0; i < available_.size(); i++)
+      delete available_[i];
+  }
+
+ private:
+  Semaphore num_available_;
+  Mutex mutex_;
+  std::vector<F*> available_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureComputerPool);
+};
+
+/**
+   ComputeFeaturesTask computes the features of one utterance for
+   compute-mfcc-feats and similar programs, for use with TaskSequencer:
+   operator () computes the features, using a computer from the pool, and the
+   destructor writes them, so they come out in the order of the input.  The
+   output goes to "kaldi_writer" if it is open, and otherwise to "htk_writer",
+   with "htk_sample_kind" in the header.
+ */
+template<class F>
+class ComputeFeaturesTask {
+ public:
+  ComputeFeaturesTask(FeatureComputerPool<F> *pool,
+                      const std::string &utt,
+                      const VectorBase<BaseFloat> &waveform,
+                      BaseFloat vtln_warp,
+                      bool subtract_mean,
+                      BaseFloatMatrixWriter *kaldi_writer,
+                      TableWriter<HtkMatrixHolder> *htk_writer,
+                      uint16 htk_sample_kind,
+                      int32 *num_success):
+      pool_(pool), utt_(utt), waveform_(waveform), vtln_warp_(vtln_warp),
+      subtract_mean_(subtract_mean), kaldi_writer_(kaldi_writer),
+      htk_writer_(htk_writer), htk_sample_kind_(htk_sample_kind),
+      num_success_(num_success), failed_(false) { }
+
+  void operator () () {
+    F *computer = pool_->Get();
+    try {
+      computer->Compute(waveform_, vtln_warp_, &features_, NULL);
+    } catch (...) {
+      failed_ = true;
+    }
+    pool_->Release(computer);
+    waveform_.Resize(0);  // we don't need it any more.
+    if (!failed_ && subtract_mean_) {
+      Vector<BaseFloat> mean(features_.NumCols());
+      mean.AddRowSumMat(1.0, features_);
+      mean.Scale(1.0 / features_.NumRows());
+      features_.AddVecToRows(-1.0, mean);
+    }
+  }
+
+  ~ComputeFeaturesTask() {
+    if (failed_) {
+      KALDI_WARN << "Failed to compute features for utterance " << utt_;
+      return;
+    }
+    if (kaldi_writer_->IsOpen()) {
+      kaldi_writer_->Write(utt_, features_);
+    } else {
+      std::pair<Matrix<BaseFloat>, HtkHeader> p;
+      HtkHeader header = {
+        features_.NumRows(),
+        100000,  // 10ms shift
+        static_cast<int16>(sizeof(float)*(features_.NumCols())),
+        htk_sample_kind_
+      };
+      p.first.Swap(&features_);
+      p.second = header;
+      htk_writer_->Write(utt_, p);
+    }
+    KALDI_VLOG(2) << "Processed features for key " << utt_;
+    (*num_success_)++;
+  }
+
+ private:
+  FeatureComputerPool<F> *pool_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloat vtln_warp_;
+  bool subtract_mean_;
+  BaseFloatMatrixWriter *kaldi_writer_;
+  TableWriter<HtkMatrixHolder> *htk_writer_;
+  uint16 htk_sample_kind_;
+  int32 *num_success_;
+  bool failed_;
+  Matrix<BaseFloat> features_;
+};
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_EXTRACTION_TASK_H_
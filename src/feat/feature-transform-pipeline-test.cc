@@ -0,0 +1,130 @@
+// feat/feature-transform-pipeline-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+
+#include "feat/feature-transform-pipeline.h"
+#include "transform/cmvn.h"
+
+namespace kaldi {
+
+// Applies a transform the way transform-feats does.
+static void ApplyTransformSimple(const Matrix<BaseFloat> &trans,
+                                 Matrix<BaseFloat> *feats) {
+  int32 dim = feats->NumCols();
+  Matrix<BaseFloat> out(feats->NumRows(), trans.NumRows());
+  SubMatrix<BaseFloat> linear_part(trans, 0, trans.NumRows(), 0, dim);
+  out.AddMatMat(1.0, *feats, kNoTrans, linear_part, kTrans, 0.0);
+  if (trans.NumCols() == dim + 1) {
+    Vector<BaseFloat> offset(trans.NumRows());
+    offset.CopyColFromMat(trans, dim);
+    out.AddVecToRows(1.0, offset);
+  }
+  feats->Swap(&out);
+}
+
+// Checks FeatureTransformPipeline against doing the stages one by one, in
+// the order given, for random sequences of stages.
+void UnitTestFeatureTransformPipeline() {
+  // "transform" is listed twice so it comes up more often.
+  const char *stage_names[] = { "cmvn", "deltas", "splice", "transform",
+                                "transform", "subsample" };
+  for (int32 iter = 0; iter < 100; iter++) {
+    FeatureTransformPipelineOptions opts;
+    opts.norm_vars = (rand() % 2 == 0);
+    opts.left_context = rand() % 4;
+    opts.right_context = rand() % 4;
+    opts.delta_opts.order = 1 + rand() % 2;
+    opts.subsample_n = 1 + rand() % 3;
+    opts.subsample_offset = rand() % 2;
+    int32 num_stages = rand() % 6;
+    std::vector<std::string> stages;
+    for (int32 i = 0; i < num_stages; i++)
+      stages.push_back(stage_names[rand() % 6]);
+    // there is only one set of cmvn stats.
+    if (std::count(stages.begin(), stages.end(), "cmvn") > 1) continue;
+    opts.stages = "";
+    for (size_t i = 0; i < stages.size(); i++)
+      opts.stages += (i == 0 ? "" : ",") + stages[i];
+
+    int32 num_frames = 5 + rand() % 20, dim = 2 + rand() % 5;
+    Matrix<BaseFloat> feats(num_frames, dim);
+    feats.SetRandn();
+    Matrix<BaseFloat> ref(feats);
+    Matrix<double> cmvn_stats;
+    std::vector<Matrix<BaseFloat>*> transforms;
+    for (size_t i = 0; i < stages.size(); i++) {
+      int32 cur_dim = ref.NumCols();
+      if (stages[i] == "cmvn") {
+        // the stats are for the features at this point.
+        InitCmvnStats(cur_dim, &cmvn_stats);
+        AccCmvnStats(ref, NULL, &cmvn_stats);
+        ApplyCmvn(cmvn_stats, opts.norm_vars, &ref);
+      } else if (stages[i] == "deltas") {
+        Matrix<BaseFloat> tmp;
+        ComputeDeltas(opts.delta_opts, ref, &tmp);
+        ref.Swap(&tmp);
+      } else if (stages[i] == "splice") {
+        Matrix<BaseFloat> tmp;
+        SpliceFrames(ref, opts.left_context, opts.right_context, &tmp);
+        ref.Swap(&tmp);
+      } else if (stages[i] == "transform") {
+        int32 out_dim = 1 + rand() % 6;
+        Matrix<BaseFloat> *trans = new Matrix<BaseFloat>(
+            out_dim, cur_dim + rand() % 2);
+        trans->SetRandn();
+        transforms.push_back(trans);
+        ApplyTransformSimple(*trans, &ref);
+      } else {
+        int32 n = 0;
+        for (int32 t = opts.subsample_offset; t < ref.NumRows();
+             t += opts.subsample_n)
+          n++;
+        Matrix<BaseFloat> tmp(n, ref.NumCols());
+        for (int32 k = 0; k < n; k++)
+          tmp.Row(k).CopyFromVec(
+              ref.Row(opts.subsample_offset + k * opts.subsample_n));
+        ref.Swap(&tmp);
+      }
+    }
+
+    FeatureTransformPipeline pipeline(opts);
+    KALDI_ASSERT(pipeline.NumTransforms() ==
+                 static_cast<int32>(transforms.size()));
+    std::vector<const Matrix<BaseFloat>*> const_transforms(transforms.begin(),
+                                                           transforms.end());
+    Matrix<BaseFloat> output;
+    bool ans = pipeline.Apply(feats,
+                              pipeline.NeedsCmvn() ? &cmvn_stats : NULL,
+                              const_transforms, &output);
+    KALDI_ASSERT(ans);
+    KALDI_ASSERT(output.NumRows() == ref.NumRows() &&
+                 output.NumCols() == ref.NumCols());
+    KALDI_ASSERT(output.ApproxEqual(ref, 0.001));
+    for (size_t i = 0; i < transforms.size(); i++) delete transforms[i];
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestFeatureTransformPipeline();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,246 @@
+// feat/feature-transform-pipeline.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "feat/feature-transform-pipeline.h"
+#include "transform/cmvn.h"
+#include "transform/transform-common.h"
+
+namespace kaldi {
+
+FeatureTransformPipeline::FeatureTransformPipeline(
+    const FeatureTransformPipelineOptions &opts): opts_(opts),
+                                                   num_transforms_(0) {
+  if (opts.left_context < 0 || opts.right_context < 0)
+    KALDI_ERR << "Invalid --left-context=" << opts.left_context
+              << " or --right-context=" << opts.right_context;
+  if (opts.subsample_n <= 0 || opts.subsample_offset < 0)
+    KALDI_ERR << "Invalid --subsample-n=" << opts.subsample_n
+              << " or --subsample-offset=" << opts.subsample_offset;
+  std::vector<std::string> names;
+  SplitStringToVector(opts.stages, ",", true, &names);
+  for (size_t i = 0; i < names.size(); i++) {
+    StageType type = kCmvn;
+    if (names[i] == "cmvn") type = kCmvn;
+    else if (names[i] == "deltas") type = kDeltas;
+    else if (names[i] == "splice") type = kSplice;
+    else if (names[i] == "transform") type = kTransform;
+    else if (names[i] == "subsample") type = kSubsample;
+    else
+      KALDI_ERR << "Unknown stage \"" << names[i] << "\" in --stages="
+                << opts.stages;
+    if (type == kTransform) num_transforms_++;
+    stages_.push_back(type);
+  }
+  // Subsampling gives the same result before a per-frame stage as after it,
+  // so do it first.  This doesn't change the order of the transforms.
+  for (size_t i = 1; i < stages_.size(); i++) {
+    for (size_t j = i; j > 0 && stages_[j] == kSubsample &&
+             IsPerFrame(stages_[j-1]); j--)
+      std::swap(stages_[j], stages_[j-1]);
+  }
+}
+
+bool FeatureTransformPipeline::NeedsCmvn() const {
+  for (size_t i = 0; i < stages_.size(); i++)
+    if (stages_[i] == kCmvn) return true;
+  return false;
+}
+
+bool FeatureTransformPipeline::ComposeStages(
+    size_t begin, size_t end, int32 dim,
+    const MatrixBase<double> *cmvn_stats,
+    const std::vector<const Matrix<BaseFloat>*> &transforms,
+    size_t *transform_index,
+    Matrix<BaseFloat> *transform) const {
+  transform->Resize(0, 0);
+  int32 cur_dim = dim;  // output dim of "transform" so far.
+  for (size_t i = begin; i < end; i++) {
+    Matrix<BaseFloat> cmvn_transform;
+    const Matrix<BaseFloat> *this_transform;
+    if (stages_[i] == kCmvn) {
+      if (cmvn_stats == NULL) {
+        KALDI_WARN << "No cmvn stats supplied for the cmvn stage";
+        return false;
+      }
+      if (cmvn_stats->NumCols() != cur_dim + 1) {
+        KALDI_WARN << "Dimension mismatch in cmvn stage: stats have dimension "
+                   << cmvn_stats->NumRows() << 'x' << cmvn_stats->NumCols()
+                   << ", features " << cur_dim;
+        return false;
+      }
+      GetCmvnTransform(*cmvn_stats, opts_.norm_vars, &cmvn_transform);
+      this_transform = &cmvn_transform;
+    } else {
+      KALDI_ASSERT(*transform_index < transforms.size());
+      this_transform = transforms[(*transform_index)++];
+      if (this_transform->NumCols() != cur_dim &&
+          this_transform->NumCols() != cur_dim + 1) {
+        KALDI_WARN << "Transform has bad dimension "
+                   << this_transform->NumRows() << 'x'
+                   << this_transform->NumCols() << " versus feature dim "
+                   << cur_dim;
+        return false;
+      }
+    }
+    if (i == begin) {
+      transform->Resize(this_transform->NumRows(), this_transform->NumCols(),
+                        kUndefined);
+      transform->CopyFromMat(*this_transform);
+    } else {  // apply this_transform after "transform".
+      Matrix<BaseFloat> composed;
+      bool is_affine = (transform->NumCols() == dim + 1);
+      ComposeTransforms(*this_transform, *transform, is_affine, &composed);
+      transform->Swap(&composed);
+    }
+    cur_dim = transform->NumRows();
+  }
+  return true;
+}
+
+// Adds "input" times "linear_part" transposed to "output".
+static void AddTransform(const MatrixBase<BaseFloat> &input,
+                         const SubMatrix<BaseFloat> &linear_part,
+                         MatrixBase<BaseFloat> *output) {
+  output->AddMatMat(1.0, input, kNoTrans, linear_part, kTrans, 1.0);
+}
+
+// Adds the offset of "transform" to the rows of "output", if it is affine.
+static void AddOffset(const MatrixBase<BaseFloat> &transform,
+                      int32 input_dim,
+                      MatrixBase<BaseFloat> *output) {
+  if (transform.NumCols() == input_dim + 1) {
+    Vector<BaseFloat> offset(transform.NumRows());
+    offset.CopyColFromMat(transform, input_dim);
+    output->AddVecToRows(1.0, offset);
+  }
+}
+
+// Does the same as SpliceFrames() followed by multiplying by "transform", but
+// without forming the spliced features: output frame t is the sum over the
+// context positions j of input frame t + j - left_context (clamped to the
+// utterance) times the j'th block of columns of the transform.
+static void SpliceAndTransform(const MatrixBase<BaseFloat> &input,
+                               int32 left_context, int32 right_context,
+                               const MatrixBase<BaseFloat> &transform,
+                               Matrix<BaseFloat> *output) {
+  int32 T = input.NumRows(), D = input.NumCols(),
+      N = 1 + left_context + right_context;
+  // "padded" has the first and last frames repeated, so that the input for
+  // context position j is rows j to j + T - 1.
+  Matrix<BaseFloat> padded(T + N - 1, D, kUndefined);
+  for (int32 t = 0; t < T + N - 1; t++) {
+    int32 t2 = std::min(std::max(t - left_context, 0), T - 1);
+    padded.Row(t).CopyFromVec(input.Row(t2));
+  }
+  output->Resize(T, transform.NumRows());
+  for (int32 j = 0; j < N; j++) {
+    SubMatrix<BaseFloat> this_input(padded, j, T, 0, D),
+        this_linear_part(transform, 0, transform.NumRows(), j * D, D);
+    AddTransform(this_input, this_linear_part, output);
+  }
+  AddOffset(transform, D * N, output);
+}
+
+bool FeatureTransformPipeline::Apply(
+    const MatrixBase<BaseFloat> &feats,
+    const MatrixBase<double> *cmvn_stats,
+    const std::vector<const Matrix<BaseFloat>*> &transforms,
+    Matrix<BaseFloat> *output) const {
+  if (static_cast<int32>(transforms.size()) != num_transforms_)
+    KALDI_ERR << "Expected " << num_transforms_ << " transforms, got "
+              << transforms.size();
+  if (feats.NumRows() == 0 || feats.NumCols() == 0) {
+    KALDI_WARN << "Empty features";
+    return false;
+  }
+  // Each stage reads *cur and writes to one of "buffers", alternately, so
+  // that it never writes to its own input.
+  const MatrixBase<BaseFloat> *cur = &feats;
+  Matrix<BaseFloat> buffers[2];
+  int32 which = 0;
+  size_t transform_index = 0;
+  for (size_t i = 0; i < stages_.size(); which = 1 - which) {
+    StageType type = stages_[i];
+    Matrix<BaseFloat> &next = buffers[which];
+    if (type == kDeltas) {
+      ComputeDeltas(opts_.delta_opts, *cur, &next);
+      i++;
+    } else if (type == kSubsample) {
+      int32 num_frames = 0;
+      for (int32 t = opts_.subsample_offset; t < cur->NumRows();
+           t += opts_.subsample_n)
+        num_frames++;
+      if (num_frames == 0) {
+        KALDI_WARN << "Output of the subsample stage would have no frames";
+        return false;
+      }
+      next.Resize(num_frames, cur->NumCols(), kUndefined);
+      for (int32 s = 0; s < num_frames; s++)
+        next.Row(s).CopyFromVec(
+            cur->Row(opts_.subsample_offset + s * opts_.subsample_n));
+      i++;
+    } else {
+      // A splice stage and/or a run of per-frame stages.
+      bool splice = (type == kSplice);
+      size_t begin = (splice ? i + 1 : i), end = begin;
+      while (end < stages_.size() && IsPerFrame(stages_[end]))
+        end++;
+      int32 N = 1 + opts_.left_context + opts_.right_context;
+      if (splice && begin == end) {
+        SpliceFrames(*cur, opts_.left_context, opts_.right_context, &next);
+      } else if (!splice && end == begin + 1 && type == kCmvn) {
+        // on its own, cmvn is cheaper than a matrix multiply.
+        if (cmvn_stats == NULL || cmvn_stats->NumCols() != cur->NumCols() + 1) {
+          KALDI_WARN << "Missing cmvn stats or dimension mismatch in cmvn "
+                     << "stage";
+          return false;
+        }
+        next.Resize(cur->NumRows(), cur->NumCols(), kUndefined);
+        next.CopyFromMat(*cur);
+        ApplyCmvn(*cmvn_stats, opts_.norm_vars, &next);
+      } else {
+        int32 dim = cur->NumCols() * (splice ? N : 1);
+        Matrix<BaseFloat> transform;
+        if (!ComposeStages(begin, end, dim, cmvn_stats, transforms,
+                           &transform_index, &transform))
+          return false;
+        if (splice) {
+          SpliceAndTransform(*cur, opts_.left_context, opts_.right_context,
+                             transform, &next);
+        } else {
+          next.Resize(cur->NumRows(), transform.NumRows());
+          AddTransform(*cur, SubMatrix<BaseFloat>(transform, 0,
+                                                  transform.NumRows(), 0, dim),
+                       &next);
+          AddOffset(transform, dim, &next);
+        }
+      }
+      i = end;
+    }
+    cur = &next;
+  }
+  if (cur == &feats) {
+    output->Resize(feats.NumRows(), feats.NumCols(), kUndefined);
+    output->CopyFromMat(feats);
+  } else {
+    output->Swap(&(buffers[1 - which]));
+  }
+  return true;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,123 @@
+// feat/feature-transform-pipeline.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_FEATURE_TRANSFORM_PIPELINE_H_
+#define KALDI_FEAT_FEATURE_TRANSFORM_PIPELINE_H_
+
+#include <string>
+#include <vector>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "feat/feature-functions.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+
+struct FeatureTransformPipelineOptions {
+  std::string stages;  // e.g. "cmvn,splice,transform,transform"
+  bool norm_vars;  // for the cmvn stage.
+  int32 left_context;  // for the splice stage.
+  int32 right_context;
+  DeltaFeaturesOptions delta_opts;  // for the deltas stage.
+  int32 subsample_n;  // for the subsample stage.
+  int32 subsample_offset;
+
+  FeatureTransformPipelineOptions(): stages("cmvn"), norm_vars(false),
+                                     left_context(4), right_context(4),
+                                     subsample_n(1), subsample_offset(0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("stages", &stages, "Comma-separated list of the stages to "
+                 "apply, in order: any of cmvn, deltas, splice, transform "
+                 "(which may be repeated, and uses the transforms in the order "
+                 "they are given), subsample.");
+    po->Register("norm-vars", &norm_vars, "If true, the cmvn stage normalizes "
+                 "variances as well as means.");
+    po->Register("left-context", &left_context, "Number of frames of left "
+                 "context for the splice stage");
+    po->Register("right-context", &right_context, "Number of frames of right "
+                 "context for the splice stage");
+    delta_opts.Register(po);
+    po->Register("subsample-n", &subsample_n, "The subsample stage takes "
+                 "every n'th frame, for this value of n");
+    po->Register("subsample-offset", &subsample_offset, "The subsample stage "
+                 "starts with the frame with this offset.");
+  }
+};
+
+
+/**
+   FeatureTransformPipeline applies a sequence of the feature transformations
+   that are otherwise done by chains of apply-cmvn, add-deltas, splice-feats,
+   transform-feats and subsample-feats, to one utterance in memory.
+
+   Adjacent stages that act on each frame separately (cmvn, which is a
+   diagonal affine transform, and transform) are composed into a single
+   affine transform, so they cost one matrix multiply; a splice stage directly
+   followed by such stages is done as part of that multiply, without forming
+   the spliced features; and subsampling is done before any such stages that
+   precede it, as it gives the same result on fewer frames.
+ */
+class FeatureTransformPipeline {
+ public:
+  explicit FeatureTransformPipeline(const FeatureTransformPipelineOptions &opts);
+
+  /// Number of transforms that Apply() expects.
+  int32 NumTransforms() const { return num_transforms_; }
+
+  /// True if the stages include cmvn, so Apply() needs cmvn stats.
+  bool NeedsCmvn() const;
+
+  /// Applies the stages to "feats".  "cmvn_stats" is as for ApplyCmvn() (it
+  /// may be NULL if !NeedsCmvn()); "transforms" has NumTransforms() linear or
+  /// affine transforms, as for transform-feats.  Returns false (with a
+  /// warning) on a dimension mismatch or if the output would be empty.
+  bool Apply(const MatrixBase<BaseFloat> &feats,
+             const MatrixBase<double> *cmvn_stats,
+             const std::vector<const Matrix<BaseFloat>*> &transforms,
+             Matrix<BaseFloat> *output) const;
+
+ private:
+  enum StageType { kCmvn, kDeltas, kSplice, kTransform, kSubsample };
+
+  static bool IsPerFrame(StageType type) {
+    return type == kCmvn || type == kTransform;
+  }
+
+  // Composes the per-frame stages [begin, end) into one affine transform of
+  // features of dimension "dim"; "transform_index" is the index of the first
+  // transform they use, and is advanced past them.
+  bool ComposeStages(size_t begin, size_t end, int32 dim,
+                     const MatrixBase<double> *cmvn_stats,
+                     const std::vector<const Matrix<BaseFloat>*> &transforms,
+                     size_t *transform_index,
+                     Matrix<BaseFloat> *transform) const;
+
+  FeatureTransformPipelineOptions opts_;
+  std::vector<StageType> stages_;
+  int32 num_transforms_;
+};
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_TRANSFORM_PIPELINE_H_
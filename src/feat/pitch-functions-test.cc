@@ -436,12 +436,89 @@ void UnitTestResample() {
   }
 }
 
+void UnitTestNccfComputer() {
+  KALDI_LOG << "=== UnitTestNccfComputer() ===\n";
+  for (int32 n = 0; n < 20; n++) {
+    int32 window_size = 10 + rand() % 200, start = rand() % 20,
+        end = start + 1 + rand() % 200;
+    Vector<double> window(window_size + end + rand() % 3);
+    window.SetRandn();
+    window.Add(RandGauss());
+    Vector<double> inner_prod1(end - start), norm_prod1(end - start),
+        inner_prod2(end - start), norm_prod2(end - start);
+    Nccf(window, start, end, window_size, &inner_prod1, &norm_prod1);
+    NccfComputer nccf_computer(window_size, start, end);
+    nccf_computer.Compute(window, &inner_prod2, &norm_prod2);
+    KALDI_ASSERT(inner_prod1.ApproxEqual(inner_prod2, 1.0e-08));
+    KALDI_ASSERT(norm_prod1.ApproxEqual(norm_prod2, 1.0e-08));
+  }
+}
+
+// Checks that OnlinePitchExtractor, given the waveform in chunks, gives the
+// same output as Compute() if the latency is long enough and there is no NCCF
+// ballast (which is scaled differently).
+void UnitTestOnlinePitch() {
+  KALDI_LOG << "=== UnitTestOnlinePitch() ===\n";
+  for (int32 n = 0; n < 3; n++) {
+    PitchExtractionOptions op;
+    op.nccf_ballast = 0.0;
+    op.max_frames_latency = 10000;
+    if (n == 1) op.preemph_coeff = 0.97;
+    Vector<BaseFloat> wave(4000 + rand() % 16000);
+    BaseFloat freq = 0.02 + 0.01 * n;
+    for (int32 i = 0; i < wave.Dim(); i++)
+      wave(i) = 1000 * sin(i * freq * (1.0 + 0.3 * sin(i * 0.0003))) +
+          100 * RandGauss();
+    Matrix<BaseFloat> output;
+    Compute(op, wave, &output);
+
+    OnlinePitchExtractor online_pitch(op);
+    for (int32 offset = 0; offset < wave.Dim(); ) {
+      int32 chunk = std::min(wave.Dim() - offset, rand() % 1000);
+      online_pitch.AcceptWaveform(wave.Range(offset, chunk));
+      offset += chunk;
+    }
+    online_pitch.InputFinished();
+    KALDI_ASSERT(online_pitch.NumFramesReady() == output.NumRows());
+    Matrix<BaseFloat> online_output(output.NumRows(), 2);
+    for (int32 t = 0; t < output.NumRows(); t++) {
+      SubVector<BaseFloat> row(online_output, t);
+      online_pitch.GetFrame(t, &row);
+    }
+    AssertEqual(online_output, output, 0.001);
+  }
+
+  // With the default latency, most frames should be the same.
+  PitchExtractionOptions op;
+  Vector<BaseFloat> wave(16000);
+  for (int32 i = 0; i < wave.Dim(); i++)
+    wave(i) = 1000 * sin(i * 0.03 * (1.0 + 0.3 * sin(i * 0.0003))) +
+        100 * RandGauss();
+  Matrix<BaseFloat> output;
+  Compute(op, wave, &output);
+  OnlinePitchExtractor online_pitch(op);
+  online_pitch.AcceptWaveform(wave.Range(0, 8000));
+  KALDI_ASSERT(online_pitch.NumFramesReady() > 0);
+  online_pitch.AcceptWaveform(wave.Range(8000, 8000));
+  online_pitch.InputFinished();
+  KALDI_ASSERT(online_pitch.NumFramesReady() == output.NumRows());
+  int32 num_same = 0;
+  Vector<BaseFloat> feat(2);
+  for (int32 t = 0; t < output.NumRows(); t++) {
+    online_pitch.GetFrame(t, &feat);
+    if (fabs(feat(1) - output(t, 1)) < 0.01 * output(t, 1)) num_same++;
+  }
+  KALDI_ASSERT(num_same > 0.95 * output.NumRows());
+}
+
 static void UnitTestFeatNoKeele() {
   UnitTestSimple();
   UnitTestDeltaPitch();
   UnitTestTakeLogOfPitch();
   UnitTestWeightedMwn();
   UnitTestResample();
+  UnitTestNccfComputer();
+  UnitTestOnlinePitch();
 }
 static void UnitTestFeatWithKeele() {
   UnitTestKeele();
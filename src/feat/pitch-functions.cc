@@ -23,6 +23,7 @@
 #include <limits>
 #include "feat/feature-functions.h"
 #include "matrix/matrix-functions.h"
+#include "matrix/srfft.h"
 #include "feat/pitch-functions.h"
 #include "feat/mel-computations.h"
 
@@ -238,27 +239,50 @@ class LinearResample {
     int32 resampled_len = 1 + static_cast<int>(num_samples_in_ / frame_shift_);
     if (output->Dim() != resampled_len) resampled_len = output->Dim();
 
-    for (int32 i = 0; i < resampled_len; i++) {
-      int32 inner_i = i % num_weights_;  // the index of weight to be used
-      int32 offset = (i - inner_i) * frame_shift_;
-      int32 fake_first_index = indexes_[inner_i].first_index + offset,
-            fake_last_index = indexes_[inner_i].last_index + offset;
-      int32 first_index = std::max(0, fake_first_index),
-            last_index = std::min((num_samples_in_ - 1), fake_last_index);
-      int32 num_indices = last_index - first_index + 1;
-      SubVector<double> input_part(input, first_index, num_indices);
-      Vector<double> &weights = weights_[inner_i];
-      if (num_indices == weights.Dim())
-        (*output)(i) = VecVec(input_part, weights);
-      else if (fake_first_index >= 0) {
-        SubVector<double> weight_vec(weights, 0, num_indices);
-        (*output)(i) = VecVec(input_part, weight_vec);
-      } else if (fake_first_index < 0) {
-        SubVector<double> weight_vec(weights, -fake_first_index, num_indices);
-        (*output)(i) = VecVec(input_part, weight_vec);
-      }
-    }
-    output->Scale(1.0/samp_rate_in_);
+    for (int32 i = 0; i < resampled_len; i++)
+      (*output)(i) = OutputSample(i, input, 0, num_samples_in_);
+  }
+
+  // Returns output sample i of a signal with num_samples_in input samples,
+  // of which "input" contains those from input_offset on.  It must contain at
+  // least samples FirstInputSample(i) through LastInputSample(i) (or those of
+  // them that are in the range [0, num_samples_in)).  This is what allows the
+  // resampling to be done online.
+  double OutputSample(int64 i, const VectorBase<double> &input,
+                      int64 input_offset, int64 num_samples_in) const {
+    int32 inner_i = i % num_weights_;  // the index of weight to be used
+    int64 offset = static_cast<int64>((i - inner_i) * frame_shift_);
+    int64 fake_first_index = indexes_[inner_i].first_index + offset,
+        fake_last_index = indexes_[inner_i].last_index + offset;
+    int64 first_index = std::max<int64>(0, fake_first_index),
+        last_index = std::min<int64>(num_samples_in - 1, fake_last_index);
+    int32 num_indices = last_index - first_index + 1;
+    if (num_indices <= 0) return 0.0;
+    KALDI_ASSERT(first_index >= input_offset &&
+                 last_index < input_offset + input.Dim());
+    SubVector<double> input_part(input, first_index - input_offset,
+                                 num_indices);
+    SubVector<double> weight_vec(weights_[inner_i],
+                                 first_index - fake_first_index, num_indices);
+    return VecVec(input_part, weight_vec) * (1.0 / samp_rate_in_);
+  }
+  // The first input sample that output sample i depends on (may be negative).
+  int64 FirstInputSample(int64 i) const {
+    int32 inner_i = i % num_weights_;
+    return indexes_[inner_i].first_index +
+        static_cast<int64>((i - inner_i) * frame_shift_);
+  }
+  // The last input sample that output sample i depends on, ignoring the end
+  // of the signal.
+  int64 LastInputSample(int64 i) const {
+    int32 inner_i = i % num_weights_;
+    return indexes_[inner_i].last_index +
+        static_cast<int64>((i - inner_i) * frame_shift_);
+  }
+  // The number of output samples for a signal of num_samples_in samples (as
+  // in PreProcess()).
+  int64 NumOutputSamples(int64 num_samples_in) const {
+    return 1 + static_cast<int64>(num_samples_in / frame_shift_);
   }
  private:
   void PreSet() {
@@ -468,6 +492,101 @@ void Nccf(const Vector<double> &wave,
   }
 }
 
+// NccfComputer computes the same quantities as Nccf() (which is the
+// reference version, kept for testing), but faster: the energies of the lagged
+// windows are updated incrementally from one lag to the next, and, when it is
+// cheaper, the inner products for all lags are computed together as a
+// cross-correlation using the FFT.
+class NccfComputer {
+ public:
+  NccfComputer(int32 nccf_window_size, int32 start, int32 end):
+      window_size_(nccf_window_size), start_(start), end_(end), srfft_(NULL) {
+    KALDI_ASSERT(nccf_window_size > 0 && start >= 0 && end > start);
+    int32 fft_size = 4;
+    while (fft_size < window_size_ + end_)
+      fft_size *= 2;
+    // Rough number of multiply-adds for the direct computation and for the
+    // three real FFTs plus the product in the frequency domain.
+    double direct_cost = static_cast<double>(end_ - start_) * window_size_,
+        fft_cost = 1.5 * fft_size * (log(static_cast<double>(fft_size)) /
+                                     log(2.0)) + 2.0 * fft_size;
+    if (fft_cost < direct_cost) {
+      srfft_ = new SplitRadixRealFft<double>(fft_size);
+      fft_x_.Resize(fft_size);
+      fft_y_.Resize(fft_size);
+    }
+  }
+  ~NccfComputer() { delete srfft_; }
+
+  bool UsesFft() const { return (srfft_ != NULL); }
+
+  // "window" must contain at least nccf_window_size + end - 1 samples.
+  // Outputs the same as Nccf(): for start <= lag < end,
+  // (*inner_prod)(lag - start) and (*norm_prod)(lag - start).
+  void Compute(const VectorBase<double> &window,
+               VectorBase<double> *inner_prod,
+               VectorBase<double> *norm_prod) {
+    int32 num_samples = window_size_ + end_ - 1;
+    KALDI_ASSERT(window.Dim() >= num_samples &&
+                 inner_prod->Dim() >= end_ - start_ &&
+                 norm_prod->Dim() >= end_ - start_);
+    zero_mean_.Resize(num_samples, kUndefined);
+    zero_mean_.CopyFromVec(SubVector<double>(window, 0, num_samples));
+    zero_mean_.Add(-SubVector<double>(window, 0, window_size_).Sum() /
+                   window_size_);
+    const double *x = zero_mean_.Data();
+    SubVector<double> sub_vec1(zero_mean_, 0, window_size_);
+    double e1 = VecVec(sub_vec1, sub_vec1),
+        e2 = VecVec(SubVector<double>(zero_mean_, start_, window_size_),
+                    SubVector<double>(zero_mean_, start_, window_size_));
+    for (int32 lag = start_; lag < end_; lag++) {
+      if (lag > start_) {
+        double x_in = x[lag + window_size_ - 1], x_out = x[lag - 1];
+        e2 += x_in * x_in - x_out * x_out;
+        if (e2 < 0.0) e2 = 0.0;  // roundoff.
+      }
+      (*norm_prod)(lag - start_) = e1 * e2;
+    }
+
+    if (srfft_ == NULL) {
+      for (int32 lag = start_; lag < end_; lag++) {
+        SubVector<double> sub_vec2(zero_mean_, lag, window_size_);
+        (*inner_prod)(lag - start_) = VecVec(sub_vec1, sub_vec2);
+      }
+    } else {
+      // The cross-correlation of the first window_size_ samples with the
+      // whole signal; the FFT size is large enough that it does not wrap
+      // around for the lags we need.
+      int32 n = fft_x_.Dim();
+      fft_x_.SetZero();
+      fft_x_.Range(0, window_size_).CopyFromVec(sub_vec1);
+      fft_y_.SetZero();
+      fft_y_.Range(0, num_samples).CopyFromVec(zero_mean_);
+      srfft_->Compute(fft_x_.Data(), true);
+      srfft_->Compute(fft_y_.Data(), true);
+      double *X = fft_x_.Data();
+      const double *Y = fft_y_.Data();
+      // Multiply conj(X) by Y; see SplitRadixRealFft for the packing.
+      X[0] *= Y[0];
+      X[1] *= Y[1];
+      for (int32 k = 2; k < n; k += 2) {
+        double re = X[k] * Y[k] + X[k + 1] * Y[k + 1],
+            im = X[k] * Y[k + 1] - X[k + 1] * Y[k];
+        X[k] = re;
+        X[k + 1] = im;
+      }
+      srfft_->Compute(X, false);
+      for (int32 lag = start_; lag < end_; lag++)
+        (*inner_prod)(lag - start_) = X[lag] / n;
+    }
+  }
+ private:
+  int32 window_size_, start_, end_;
+  SplitRadixRealFft<double> *srfft_;  // NULL if we don't use the FFT.
+  Vector<double> fft_x_, fft_y_, zero_mean_;  // Temporaries.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NccfComputer);
+};
+
 void ProcessNccf(const Vector<double> &inner_prod,
                  const Vector<double> &norm_prod,
                  const double &a_fact,
@@ -506,6 +625,81 @@ void SelectLag(const PitchExtractionOptions &opts,
   (*state_num) = count;
 }
 
+// Sets (*penalty)(d) to the Viterbi transition cost for a change of d in the
+// lag index, for 0 <= d < num_states.
+static void ComputeViterbiPenalty(const PitchExtractionOptions &opts,
+                                  int32 num_states,
+                                  Vector<double> *penalty) {
+  BaseFloat delta_pitch_sq = log(1 + opts.delta_pitch)
+    * log(1 + opts.delta_pitch);
+  penalty->Resize(num_states);
+  for (int32 d = 0; d < num_states; d++) {
+    double intercost = d * d * delta_pitch_sq;
+    (*penalty)(d) = opts.penalty_factor * intercost;
+  }
+}
+
+// Computes the local cost of each state (lag) of a frame, from the upsampled
+// NCCF of the frame.
+static void ComputeLocalCost(const PitchExtractionOptions &opts,
+                             const VectorBase<double> &nccf_pitch,
+                             const VectorBase<double> &lags,
+                             VectorBase<double> *local_cost) {
+  local_cost->Set(1.0);
+  local_cost->AddVec(-1.0, nccf_pitch);
+  local_cost->AddVecVec(opts.soft_min_f0, nccf_pitch, lags, 1.0);
+}
+
+// One frame of the Viterbi computation: given the objective function of the
+// previous frame and the local cost of this one, computes the objective
+// function of this frame and its back-pointers.  Because the transition cost
+// increases with the distance between the states, the best predecessors are
+// monotonic in the state, which the forward and backward passes exploit.
+static void PitchViterbiStep(const VectorBase<double> &penalty,
+                             const VectorBase<double> &prev_obj_func,
+                             const VectorBase<double> &local_cost,
+                             VectorBase<double> *obj_func,
+                             std::vector<int32> *back_pointers) {
+  int32 num_states = local_cost.Dim();
+  KALDI_ASSERT(prev_obj_func.Dim() == num_states &&
+               obj_func->Dim() == num_states &&
+               penalty.Dim() >= num_states);
+  back_pointers->resize(num_states);
+  const double *prev = prev_obj_func.Data(), *pen = penalty.Data();
+  double min_c, this_c;
+  int32 best_b, min_i, max_i;
+  // Forward Pass
+  for (int32 i = 0; i < num_states; i++) {
+    min_i = (i == 0 ? 0 : (*back_pointers)[i - 1]);
+    min_c = std::numeric_limits<double>::infinity();
+    best_b = -1;
+    for (int32 k = min_i; k <= i; k++) {
+      this_c = prev[k] + pen[i - k];
+      if (this_c < min_c) {
+        min_c = this_c;
+        best_b = k;
+      }
+    }
+    (*back_pointers)[i] = best_b;
+    (*obj_func)(i) = min_c + local_cost(i);
+  }
+  // Backward Pass
+  for (int32 i = num_states - 1; i >= 0; i--) {
+    max_i = (i == num_states - 1 ? num_states - 1 : (*back_pointers)[i + 1]);
+    min_c = (*obj_func)(i) - local_cost(i);
+    best_b = (*back_pointers)[i];
+    for (int32 k = i + 1; k <= max_i; k++) {
+      this_c = prev[k] + pen[k - i];
+      if (this_c < min_c) {
+        min_c = this_c;
+        best_b = k;
+      }
+    }
+    (*back_pointers)[i] = best_b;
+    (*obj_func)(i) = min_c + local_cost(i);
+  }
+}
+
 class PitchExtractor {
  public:
   explicit PitchExtractor(const PitchExtractionOptions &opts,
@@ -515,103 +709,41 @@ class PitchExtractor {
       opts_(opts),
       state_num_(state_num),
       num_frames_(num_frames),
-      lags_(lags) {
-    frames_.resize(num_frames_+1);
-    for (int32 i = 0; i < num_frames_+1; i++) {
-      frames_[i].local_cost.Resize(state_num_);
-      frames_[i].obj_func.Resize(state_num_);
-      frames_[i].back_pointers.Resize(state_num_);
-    }
+      lags_(lags),
+      back_pointers_(num_frames),
+      pitch_(num_frames),
+      pov_(num_frames) {
+    ComputeViterbiPenalty(opts_, state_num_, &penalty_);
   }
   ~PitchExtractor() {}
 
-  void ComputeLocalCost(const Matrix<double> &autocorrelation) {
-    Vector<double> correl(state_num_);
-
-    for (int32 i = 1; i < num_frames_ + 1; i++) {
-      SubVector<double> frame(autocorrelation.Row(i-1));
-      Vector<double> local_cost(state_num_);
-      for (int32 j = 0; j < state_num_; j++)
-        correl(j) = frame(j);
-      // compute the local cost
-      frames_[i].local_cost.Add(1.0);
-      frames_[i].local_cost.AddVec(-1.0, correl);
-      Vector<double> corr_lag_cost(state_num_);
-      corr_lag_cost.AddVecVec(opts_.soft_min_f0, correl, lags_, 0);
-      frames_[i].local_cost.AddVec(1.0, corr_lag_cost);
-    }  // end of loop over frames
-  }
   void FastViterbi(const Matrix<double> &correl) {
-    ComputeLocalCost(correl);
-    double intercost, min_c, this_c;
-    int best_b, min_i, max_i;
-    BaseFloat delta_pitch_sq = log(1 + opts_.delta_pitch)
-      * log(1 + opts_.delta_pitch);
+    Vector<double> local_cost(state_num_), prev_obj_func(state_num_);
+    obj_func_.Resize(state_num_);
     // loop over frames
-    for (int32 t = 1; t < num_frames_ + 1; t++) {
-      // Forward Pass
-      for (int32 i = 0; i < state_num_; i++) {
-        if ( i == 0 )
-          min_i = 0;
-        else
-          min_i = frames_[t].back_pointers(i-1);
-        min_c = std::numeric_limits<double>::infinity();
-        best_b = -1;
-
-        for (int32 k = min_i; k <= i; k++) {
-          intercost = (i-k) * (i-k) * delta_pitch_sq;
-          this_c = frames_[t-1].obj_func(k)+ opts_.penalty_factor * intercost;
-          if (this_c < min_c) {
-            min_c = this_c;
-            best_b = k;
-          }
-        }
-        frames_[t].back_pointers(i) = best_b;
-        frames_[t].obj_func(i) = min_c + frames_[t].local_cost(i);
-      }
-      // Backward Pass
-      for (int32 i = state_num_-1; i >= 0; i--) {
-        if (i == state_num_-1)
-          max_i = state_num_-1;
-        else
-          max_i = frames_[t].back_pointers(i+1);
-        min_c = frames_[t].obj_func(i) - frames_[t].local_cost(i);
-        best_b = frames_[t].back_pointers(i);
-
-        for (int32 k = i+1 ; k <= max_i; k++) {
-          intercost = (i-k) * (i-k) * delta_pitch_sq;
-          this_c = frames_[t-1].obj_func(k)+ opts_.penalty_factor *intercost;
-          if (this_c < min_c) {
-            min_c = this_c;
-            best_b = k;
-          }
-        }
-        frames_[t].back_pointers(i) = best_b;
-        frames_[t].obj_func(i) = min_c + frames_[t].local_cost(i);
-      }
+    for (int32 t = 0; t < num_frames_; t++) {
+      ComputeLocalCost(opts_, correl.Row(t), lags_, &local_cost);
+      prev_obj_func.Swap(&obj_func_);
+      PitchViterbiStep(penalty_, prev_obj_func, local_cost, &obj_func_,
+                       &(back_pointers_[t]));
     }
-    // FindBestPath(resampled_nccf_pov);
   }
 
   void FindBestPath(const Matrix<double> &correlation) {
     // Find the Best path using backpointers
-    int32 i = num_frames_;
     int32 best;
-    double l_opt;
-    frames_[i].obj_func.Min(&best);
-    while (i > 0) {
-      l_opt = lags_(best);
-      frames_[i].truepitch = 1.0 / l_opt;
-      frames_[i].pov = correlation(i-1, best);
-      best = frames_[i].back_pointers(best);
-      i--;
+    obj_func_.Min(&best);
+    for (int32 t = num_frames_ - 1; t >= 0; t--) {
+      pitch_[t] = 1.0 / lags_(best);
+      pov_[t] = correlation(t, best);
+      best = back_pointers_[t][best];
     }
   }
   void GetPitch(Matrix<BaseFloat> *output) {
     output->Resize(num_frames_, 2);
     for (int32 frm = 0; frm < num_frames_; frm++) {
-      (*output)(frm, 0) = static_cast<BaseFloat>(frames_[frm + 1].pov);
-      (*output)(frm, 1) = static_cast<BaseFloat>(frames_[frm + 1].truepitch);
+      (*output)(frm, 0) = static_cast<BaseFloat>(pov_[frm]);
+      (*output)(frm, 1) = static_cast<BaseFloat>(pitch_[frm]);
     }
   }
  private:
@@ -619,15 +751,11 @@ class PitchExtractor {
   int32 state_num_;      // number of states in Viterbi Computation
   int32 num_frames_;     // number of frames in input wave
   Vector<double> lags_;    // all lags used in viterbi
-  struct PitchFrame {
-    Vector<double> local_cost;
-    Vector<double> obj_func;      // optimal objective function for frame i
-    Vector<double> back_pointers;
-    double truepitch;             // True pitch
-    double pov;                   // probability of voicing
-    explicit PitchFrame() {}
-  };
-  std::vector< PitchFrame > frames_;
+  Vector<double> penalty_;  // transition cost, indexed by change in state.
+  Vector<double> obj_func_;  // objective function for the last frame.
+  std::vector<std::vector<int32> > back_pointers_;  // indexed [frame][state]
+  std::vector<double> pitch_;  // True pitch
+  std::vector<double> pov_;  // NCCF for probability of voicing
 };
 
 void Compute(const PitchExtractionOptions &opts,
@@ -661,12 +789,12 @@ void Compute(const PitchExtractionOptions &opts,
     a_fact_pov = pow(10, -9);
   Matrix<double> nccf_pitch(rows_out, num_max_lag + 1),
       nccf_pov(rows_out, num_max_lag + 1);
+  NccfComputer nccf_computer(opts.NccfWindowSize(), start, end);
+  Vector<double> inner_prod(num_lags), norm_prod(num_lags);
   for (int32 r = 0; r < rows_out; r++) {  // r is frame index.
     ExtractFrame(processed_wave, r, opts, &window);
     // compute nccf for pitch extraction
-    Vector<double> inner_prod(num_lags), norm_prod(num_lags);
-    Nccf(window, start, end, opts.NccfWindowSize(),
-         &inner_prod, &norm_prod);
+    nccf_computer.Compute(window, &inner_prod, &norm_prod);
     SubVector<double> nccf_pitch_vec(nccf_pitch.Row(r));
     ProcessNccf(inner_prod, norm_prod, a_fact_pitch,
         start, end, &(nccf_pitch_vec));
@@ -704,6 +832,229 @@ void Compute(const PitchExtractionOptions &opts,
   pitch.GetPitch(output);
 }
 
+OnlinePitchExtractor::OnlinePitchExtractor(
+    const PitchExtractionOptions &opts):
+    opts_(opts), signal_resampler_(NULL), nccf_resampler_(NULL),
+    nccf_computer_(NULL), input_offset_(0), num_input_samples_(0),
+    downsampled_offset_(0), num_downsampled_samples_(0),
+    downsampled_sumsq_(0.0), input_finished_(false),
+    num_frames_processed_(0), num_frames_output_(0) {
+  KALDI_ASSERT(opts.max_frames_latency >= 0);
+  // The following are as in Compute().
+  double outer_min_lag = 1.0 / (1.0 * opts.max_f0) -
+      (opts.upsample_filter_width/(2.0 * opts.resample_freq));
+  double outer_max_lag = 1.0 / (1.0 * opts.min_f0) +
+      (opts.upsample_filter_width/(2.0 * opts.resample_freq));
+  num_max_lag_ = Round(outer_max_lag * opts.resample_freq) + 1;
+  nccf_first_lag_ = Round(opts.resample_freq * outer_min_lag);
+  nccf_last_lag_ = Round(opts.resample_freq / opts.min_f0) +
+      Round(opts.lowpass_filter_width / 2);
+  frame_window_size_ = opts.NccfWindowSize() + nccf_last_lag_;
+  a_fact_pitch_ = pow(opts.NccfWindowSize(), 4) * opts.nccf_ballast;
+  a_fact_pov_ = pow(10, -9);
+
+  int32 num_states;
+  SelectLag(opts, &num_states, &lags_);
+  std::vector<double> lag_vec(num_states);
+  for (int32 i = 0; i < num_states; i++)
+    lag_vec[i] = lags_(i);
+  signal_resampler_ = new LinearResample(opts.samp_freq, opts.resample_freq,
+                                         opts.lowpass_cutoff,
+                                         opts.lowpass_filter_width);
+  nccf_resampler_ = new ArbitraryResample(num_max_lag_ + 1, opts.resample_freq,
+                                          opts.resample_freq * 0.5, lag_vec,
+                                          opts.upsample_filter_width);
+  nccf_computer_ = new NccfComputer(opts.NccfWindowSize(), nccf_first_lag_,
+                                    nccf_last_lag_);
+  ComputeViterbiPenalty(opts, num_states, &penalty_);
+  obj_func_.Resize(num_states);
+}
+
+OnlinePitchExtractor::~OnlinePitchExtractor() {
+  delete signal_resampler_;
+  delete nccf_resampler_;
+  delete nccf_computer_;
+}
+
+void OnlinePitchExtractor::AcceptWaveform(const VectorBase<BaseFloat> &wave) {
+  if (input_finished_)
+    KALDI_ERR << "AcceptWaveform called after InputFinished.";
+  if (wave.Dim() == 0) return;
+  Vector<double> input(input_.Dim() + wave.Dim(), kUndefined);
+  if (input_.Dim() != 0)
+    input.Range(0, input_.Dim()).CopyFromVec(input_);
+  input.Range(input_.Dim(), wave.Dim()).CopyFromVec(wave);
+  input_.Swap(&input);
+  num_input_samples_ += wave.Dim();
+  ProcessInput();
+}
+
+void OnlinePitchExtractor::InputFinished() {
+  if (input_finished_) return;
+  input_finished_ = true;
+  ProcessInput();
+  // The remaining frames are output from the best path through the whole
+  // utterance.
+  int32 num_frames = num_frames_processed_ - num_frames_output_;
+  if (num_frames == 0) return;
+  std::vector<int32> best_states(num_frames);
+  int32 best;
+  obj_func_.Min(&best);
+  for (int32 t = num_frames - 1; t >= 0; t--) {
+    best_states[t] = best;
+    best = back_pointers_[t][best];
+  }
+  for (int32 t = 0; t < num_frames; t++)
+    output_.push_back(std::make_pair(
+        static_cast<BaseFloat>(nccf_pov_[t](best_states[t])),
+        static_cast<BaseFloat>(1.0 / lags_(best_states[t]))));
+  back_pointers_.clear();
+  nccf_pov_.clear();
+  num_frames_output_ = num_frames_processed_;
+}
+
+void OnlinePitchExtractor::GetFrame(int32 frame,
+                                    VectorBase<BaseFloat> *feat) const {
+  KALDI_ASSERT(frame >= 0 && frame < NumFramesReady() && feat->Dim() == 2);
+  (*feat)(0) = output_[frame].first;
+  (*feat)(1) = output_[frame].second;
+}
+
+void OnlinePitchExtractor::ProcessInput() {
+  // Work out how many downsampled samples we can compute: all of them if the
+  // input is finished, else those that don't need any future input.
+  int64 num_downsampled;
+  if (input_finished_) {
+    num_downsampled = signal_resampler_->NumOutputSamples(num_input_samples_);
+  } else {
+    num_downsampled = num_downsampled_samples_;
+    while (signal_resampler_->LastInputSample(num_downsampled) <
+           num_input_samples_)
+      num_downsampled++;
+  }
+  int64 num_new = num_downsampled - num_downsampled_samples_;
+  if (num_new > 0) {
+    int32 old_dim = downsampled_.Dim();
+    Vector<double> downsampled(old_dim + num_new, kUndefined);
+    if (old_dim != 0)
+      downsampled.Range(0, old_dim).CopyFromVec(downsampled_);
+    for (int64 i = 0; i < num_new; i++) {
+      double x = signal_resampler_->OutputSample(num_downsampled_samples_ + i,
+                                                 input_, input_offset_,
+                                                 num_input_samples_);
+      downsampled(old_dim + i) = x;
+      downsampled_sumsq_ += x * x;
+    }
+    downsampled_.Swap(&downsampled);
+    num_downsampled_samples_ = num_downsampled;
+
+    // Discard the input that no future output sample needs.
+    int64 first_needed = std::min(
+        signal_resampler_->FirstInputSample(num_downsampled_samples_),
+        num_input_samples_);
+    if (first_needed > input_offset_) {
+      Vector<double> input(input_.Range(first_needed - input_offset_,
+                                        num_input_samples_ - first_needed));
+      input_.Swap(&input);
+      input_offset_ = first_needed;
+    }
+  }
+
+  // Work out how many frames we can compute.  Before the end, a frame needs
+  // all the samples of its window (including the lags); at the end, the
+  // number of frames is as in Compute() and the windows are padded with zeros.
+  int32 frame_shift = opts_.NccfWindowShift();
+  int64 num_frames;
+  if (input_finished_) {
+    num_frames = PitchNumFrames(num_downsampled_samples_, opts_);
+  } else if (num_downsampled_samples_ < frame_window_size_) {
+    num_frames = 0;
+  } else {
+    num_frames = 1 + (num_downsampled_samples_ - frame_window_size_) /
+        frame_shift;
+  }
+  if (num_frames > num_frames_processed_)
+    ProcessFrames(num_frames - num_frames_processed_);
+}
+
+void OnlinePitchExtractor::ProcessFrames(int32 num_frames) {
+  KALDI_ASSERT(num_frames > 0);
+  int32 frame_shift = opts_.NccfWindowShift(),
+      num_states = lags_.Dim(),
+      num_lags = nccf_last_lag_ - nccf_first_lag_;
+  // This scaling of the ballast term corresponds to the normalization of the
+  // signal by its RMS value in PreProcess().
+  double mean_square = downsampled_sumsq_ / num_downsampled_samples_,
+      ballast_scale = mean_square * mean_square;
+  Matrix<double> nccf_pitch(num_frames, num_max_lag_ + 1),
+      nccf_pov(num_frames, num_max_lag_ + 1);
+  Vector<double> window(frame_window_size_), inner_prod(num_lags),
+      norm_prod(num_lags);
+  for (int32 f = 0; f < num_frames; f++) {
+    int64 start = static_cast<int64>(num_frames_processed_ + f) * frame_shift;
+    int32 num_samples = std::min<int64>(frame_window_size_,
+                                        num_downsampled_samples_ - start);
+    KALDI_ASSERT(start >= downsampled_offset_ && num_samples > 0);
+    // As ExtractFrame().
+    window.SetZero();
+    SubVector<double> window_part(window, 0, num_samples);
+    window_part.CopyFromVec(downsampled_.Range(start - downsampled_offset_,
+                                               num_samples));
+    if (opts_.preemph_coeff != 0.0)
+      PreemphasizeFrame(&window_part, opts_.preemph_coeff);
+    nccf_computer_->Compute(window, &inner_prod, &norm_prod);
+    SubVector<double> nccf_pitch_vec(nccf_pitch.Row(f));
+    ProcessNccf(inner_prod, norm_prod, a_fact_pitch_ * ballast_scale,
+                nccf_first_lag_, nccf_last_lag_, &nccf_pitch_vec);
+    SubVector<double> nccf_pov_vec(nccf_pov.Row(f));
+    ProcessNccf(inner_prod, norm_prod, a_fact_pov_ * ballast_scale,
+                nccf_first_lag_, nccf_last_lag_, &nccf_pov_vec);
+  }
+  Matrix<double> resampled_nccf_pitch(num_frames, num_states),
+      resampled_nccf_pov(num_frames, num_states);
+  nccf_resampler_->Upsample(nccf_pitch, &resampled_nccf_pitch);
+  nccf_resampler_->Upsample(nccf_pov, &resampled_nccf_pov);
+
+  Vector<double> local_cost(num_states), prev_obj_func(num_states);
+  for (int32 f = 0; f < num_frames; f++) {
+    ComputeLocalCost(opts_, resampled_nccf_pitch.Row(f), lags_, &local_cost);
+    prev_obj_func.Swap(&obj_func_);
+    back_pointers_.push_back(std::vector<int32>());
+    PitchViterbiStep(penalty_, prev_obj_func, local_cost, &obj_func_,
+                     &(back_pointers_.back()));
+    nccf_pov_.push_back(Vector<double>(resampled_nccf_pov.Row(f)));
+    num_frames_processed_++;
+    while (num_frames_output_ <
+           num_frames_processed_ - opts_.max_frames_latency)
+      OutputFrame();
+  }
+
+  // Discard the downsampled signal that no future frame needs.
+  int64 first_needed = std::min<int64>(
+      static_cast<int64>(num_frames_processed_) * frame_shift,
+      num_downsampled_samples_);
+  if (first_needed > downsampled_offset_) {
+    Vector<double> downsampled(downsampled_.Range(
+        first_needed - downsampled_offset_,
+        num_downsampled_samples_ - first_needed));
+    downsampled_.Swap(&downsampled);
+    downsampled_offset_ = first_needed;
+  }
+}
+
+void OnlinePitchExtractor::OutputFrame() {
+  int32 best;
+  obj_func_.Min(&best);
+  for (int32 t = num_frames_processed_ - 1; t > num_frames_output_; t--)
+    best = back_pointers_[t - num_frames_output_][best];
+  output_.push_back(std::make_pair(
+      static_cast<BaseFloat>(nccf_pov_.front()(best)),
+      static_cast<BaseFloat>(1.0 / lags_(best))));
+  back_pointers_.pop_front();
+  nccf_pov_.pop_front();
+  num_frames_output_++;
+}
+
 void ExtractDeltaPitch(const PostProcessPitchOptions &opts,
                        const Vector<BaseFloat> &input,
                        Vector<BaseFloat> *output) {
@@ -22,7 +22,9 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <deque>
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -55,6 +57,8 @@ struct PitchExtractionOptions {
                                 // lowpass filter
   int32 upsample_filter_width;  // Integer that determines filter width when
                                 // upsampling NCCF
+  int32 max_frames_latency;  // Frames of delay before OnlinePitchExtractor
+                             // outputs a frame; not used by Compute().
   explicit PitchExtractionOptions() :
       samp_freq(16000),
       frame_shift_ms(10.0),
@@ -69,7 +73,8 @@ struct PitchExtractionOptions {
       delta_pitch(0.005),
       nccf_ballast(0.7),
       lowpass_filter_width(1),
-      upsample_filter_width(5) {}
+      upsample_filter_width(5),
+      max_frames_latency(20) {}
   void Register(OptionsItf *po) {
     po->Register("sample-frequency", &samp_freq,
                  "Waveform data sample frequency (must match the waveform file, "
@@ -100,6 +105,11 @@ struct PitchExtractionOptions {
                  "lowpass filter, more gives sharper filter");
     po->Register("upsample-filter-width", &upsample_filter_width,
                  "Integer that determines filter width when upsampling NCCF");
+    po->Register("max-frames-latency", &max_frames_latency,
+                 "For online pitch extraction only: the number of frames "
+                 "by which the output lags the input; the pitch of a frame "
+                 "is decided by the best Viterbi path this many frames "
+                 "later.");
   }
   int32 NccfWindowSize() const {
     return static_cast<int32>(resample_freq * 0.001 * frame_length_ms);
@@ -166,6 +176,91 @@ struct PostProcessPitchOptions {
                 "If true, the warped NCCF is added to output features");
   }
 };
+
+class LinearResample;
+class ArbitraryResample;
+class NccfComputer;
+
+/**
+   OnlinePitchExtractor computes the same features as Compute() (i.e. rows of
+   (NCCF, pitch in Hz)), but incrementally, as the waveform arrives in chunks,
+   so it can be used in an online front end.  The pitch of a frame is output
+   once opts.max_frames_latency more frames have been seen, using the best
+   Viterbi path up to then; after InputFinished(), the remaining frames use
+   the best path through the whole utterance.  Only the last
+   max_frames_latency frames of the Viterbi back-pointers are kept, and only as
+   much of the waveform as is needed for frames not yet computed.
+
+   There are two differences from Compute(), which sees the whole utterance:
+   the frames output before the end may be on a different path than the one
+   Compute() would choose, and the NCCF ballast term (see nccf_ballast) is
+   scaled by the mean-square of the signal seen so far rather than that of the
+   whole utterance.  With a large max_frames_latency and nccf_ballast = 0 the
+   output is the same as Compute()'s, up to roundoff.
+ */
+class OnlinePitchExtractor {
+ public:
+  explicit OnlinePitchExtractor(const PitchExtractionOptions &opts);
+
+  /// Accepts more of the waveform, sampled at opts.samp_freq.
+  void AcceptWaveform(const VectorBase<BaseFloat> &wave);
+
+  /// Call this after the last AcceptWaveform(); it makes all the remaining
+  /// frames ready.
+  void InputFinished();
+
+  /// Returns the number of frames whose features are ready.
+  int32 NumFramesReady() const { return output_.size(); }
+
+  /// Gets the features of a frame: "feat" must have dimension 2, and gets
+  /// (NCCF, pitch in Hz).  Requires frame < NumFramesReady().
+  void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) const;
+
+  ~OnlinePitchExtractor();
+ private:
+  // Resamples as much of the input as we can (all of it if input_finished_),
+  // and computes the frames for which the downsampled signal is complete.
+  void ProcessInput();
+
+  // Computes the NCCF of a block of frames and runs them through the Viterbi
+  // algorithm, outputting any frames that are then ready.
+  void ProcessFrames(int32 num_frames);
+
+  // Outputs the frame num_frames_output_, from the best path through the
+  // frames processed so far.
+  void OutputFrame();
+
+  PitchExtractionOptions opts_;
+  LinearResample *signal_resampler_;  // Downsamples the input.
+  ArbitraryResample *nccf_resampler_;  // Upsamples the NCCF to the lags_.
+  NccfComputer *nccf_computer_;
+
+  // Derived from the options, as in Compute().
+  int32 nccf_first_lag_, nccf_last_lag_, num_max_lag_, frame_window_size_;
+  double a_fact_pitch_, a_fact_pov_;
+  Vector<double> lags_;
+  Vector<double> penalty_;  // Viterbi transition cost, by change in lag index.
+
+  Vector<double> input_;  // Input samples from input_offset_ on.
+  int64 input_offset_;
+  int64 num_input_samples_;
+  Vector<double> downsampled_;  // Downsampled samples from downsampled_offset_
+  int64 downsampled_offset_;    // on.
+  int64 num_downsampled_samples_;
+  double downsampled_sumsq_;  // Sum of squares of all downsampled samples.
+  bool input_finished_;
+
+  int32 num_frames_processed_;
+  Vector<double> obj_func_;  // Viterbi objective function of the last frame.
+  // For the frames from num_frames_output_ to num_frames_processed_ - 1:
+  // their back-pointers and upsampled NCCF for the POV.
+  std::deque<std::vector<int32> > back_pointers_;
+  std::deque<Vector<double> > nccf_pov_;
+  int32 num_frames_output_;
+  std::vector<std::pair<BaseFloat, BaseFloat> > output_;  // (NCCF, pitch).
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlinePitchExtractor);
+};
+
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
 #endif  // KALDI_FEAT_PITCH_FUNCTIONS_H_
@@ -0,0 +1,95 @@
+// feat/wave-reader-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstdio>
+#include <sstream>
+
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+
+// Random 16-bit data: a mix of smooth signal and noise, with some samples at
+// the ends of the range.
+static void RandWaveData(WaveData *wave) {
+  int32 num_chan = 1 + rand() % 2, num_samp = 1 + rand() % 20000;
+  Matrix<BaseFloat> data(num_chan, num_samp);
+  for (int32 c = 0; c < num_chan; c++) {
+    for (int32 i = 0; i < num_samp; i++) {
+      BaseFloat x = 10000.0 * sin(0.01 * i * (c + 1)) + 100.0 * RandGauss();
+      if (rand() % 1000 == 0) x = (rand() % 2 == 0 ? 32767 : -32768);
+      data(c, i) = std::max<BaseFloat>(-32768, std::min<BaseFloat>(32767,
+                                                                   floor(x)));
+    }
+  }
+  *wave = WaveData(16000, data);
+}
+
+static void UnitTestCompressedWave() {
+  for (int32 iter = 0; iter < 10; iter++) {
+    WaveData wave;
+    RandWaveData(&wave);
+    std::ostringstream os_compressed, os;
+    wave.WriteCompressed(os_compressed, 1 + rand() % 5000);
+    wave.Write(os);
+    KALDI_ASSERT(os_compressed.str().size() < os.str().size());
+    std::istringstream is(os_compressed.str());
+    WaveData wave2;
+    wave2.Read(is);
+    KALDI_ASSERT(wave2.SampFreq() == wave.SampFreq());
+    KALDI_ASSERT(wave2.Data().ApproxEqual(wave.Data(), 0.0));
+  }
+}
+
+static void UnitTestWaveSegmentReader() {
+  for (int32 iter = 0; iter < 10; iter++) {
+    WaveData wave;
+    RandWaveData(&wave);
+    bool compressed = (iter % 2 == 0);
+    std::string filename = "tmp.wave-reader-test.wav";
+    {
+      Output ko(filename, true, false);
+      if (compressed) wave.WriteCompressed(ko.Stream(), 1 + rand() % 3000);
+      else wave.Write(ko.Stream());
+    }
+    WaveSegmentReader reader;
+    KALDI_ASSERT(reader.Open(filename));
+    const Matrix<BaseFloat> &data = wave.Data();
+    KALDI_ASSERT(reader.NumSamples() == data.NumCols() &&
+                 reader.NumChannels() == data.NumRows() &&
+                 reader.SampFreq() == wave.SampFreq());
+    for (int32 i = 0; i < 20; i++) {
+      int32 start = rand() % data.NumCols(),
+          num_samp = 1 + rand() % (data.NumCols() - start);
+      Matrix<BaseFloat> segment;
+      reader.Read(start, num_samp, &segment);
+      KALDI_ASSERT(segment.ApproxEqual(
+          data.Range(0, data.NumRows(), start, num_samp), 0.0));
+    }
+    std::remove(filename.c_str());
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestCompressedWave();
+  UnitTestWaveSegmentReader();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -19,8 +19,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cstdio>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "feat/wave-reader.h"
@@ -29,8 +31,7 @@
 
 namespace kaldi {
 
-// static
-void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
+static void Expect4ByteTag(std::istream &is, const char *expected) {
   char tmp[5];
   tmp[4] = '\0';
   is.read(tmp, 4);
@@ -40,7 +41,7 @@ void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
     KALDI_ERR << "WaveData: expected " << expected << ", got " << tmp;
 }
 
-uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
+static uint32 ReadUint32(std::istream &is, bool swap) {
   union {
     char result[4];
     uint32 ans;
@@ -54,7 +55,7 @@ uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
 }
 
 
-uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
+static uint16 ReadUint16(std::istream &is, bool swap) {
   union {
     char result[2];
     int16 ans;
@@ -67,15 +68,13 @@ uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
   return u.ans;
 }
 
-// static
-void WaveData::Read4ByteTag(std::istream &is, char *dest) {
+static void Read4ByteTag(std::istream &is, char *dest) {
   is.read(dest, 4);
   if (is.fail())
     KALDI_ERR << "WaveData: expected 4-byte chunk-name, got read errror";
 }
 
-// static
-void WaveData::WriteUint32(std::ostream &os, int32 i) {
+static void WriteUint32(std::ostream &os, int32 i) {
   union {
     char buf[4];
     int i;
@@ -89,7 +88,7 @@ void WaveData::WriteUint32(std::ostream &os, int32 i) {
     KALDI_ERR << "WaveData: error writing to stream.";
 }
 
-void WaveData::WriteUint16(std::ostream &os, int16 i) {
+static void WriteUint16(std::ostream &os, int16 i) {
   union {
     char buf[2];
     int16 i;
@@ -104,14 +103,237 @@ void WaveData::WriteUint16(std::ostream &os, int16 i) {
 }
 
 
+// The compressed format (all integers little-endian):
+//   "KWVC", samp_freq (uint32), num_channels (uint16), num_samples (uint32),
+//   block_size (uint32), num_blocks (uint32),
+//   num_blocks + 1 block offsets (uint32), then the blocks.
+// Each block has the samples of each channel in turn: the first sample as an
+// int16, then the residuals of the order-2 fixed predictor
+// 2 x[i-1] - x[i-2] (just x[i-1] for the second sample), as Rice codes with a
+// 5-bit parameter chosen per block and channel; each block is padded to a
+// whole number of bytes.  This is the same idea as FLAC's fixed predictors.
+
+static const char *kCompressedWaveTag = "KWVC";
+
+// Writes the bits of Rice codes to a string.
+class BitWriter {
+ public:
+  explicit BitWriter(std::string *out): out_(out), buf_(0), num_bits_(0) { }
+  // Writes the low "num_bits" bits of "value", num_bits <= 32.
+  void Put(uint32 value, int32 num_bits) {
+    buf_ = (buf_ << num_bits) | value;
+    num_bits_ += num_bits;
+    while (num_bits_ >= 8) {
+      num_bits_ -= 8;
+      out_->push_back(static_cast<char>(buf_ >> num_bits_));
+    }
+  }
+  // Writes q as q zeros and a one.
+  void PutUnary(uint32 q) {
+    for (; q >= 32; q -= 32)
+      Put(0, 32);
+    Put(1, q + 1);
+  }
+  void Flush() {
+    if (num_bits_ > 0) Put(0, 8 - num_bits_);
+  }
+ private:
+  std::string *out_;
+  uint64 buf_;
+  int32 num_bits_;  // number of bits of buf_ not yet written.
+};
+
+// Reads back what BitWriter wrote.
+class BitReader {
+ public:
+  BitReader(const char *data, const char *end): data_(data), end_(end),
+                                                buf_(0), num_bits_(0) { }
+  uint32 Get(int32 num_bits) {
+    while (num_bits_ < num_bits) NextByte();
+    num_bits_ -= num_bits;
+    return static_cast<uint32>((buf_ >> num_bits_) &
+                               ((static_cast<uint64>(1) << num_bits) - 1));
+  }
+  uint32 GetUnary() {
+    uint32 q = 0;
+    while (true) {
+      if (num_bits_ == 0) NextByte();
+      num_bits_--;
+      if ((buf_ >> num_bits_) & 1) return q;
+      if (++q > (1 << 20))
+        KALDI_ERR << "WaveData: corrupted compressed data";
+    }
+  }
+ private:
+  void NextByte() {
+    if (data_ == end_)
+      KALDI_ERR << "WaveData: corrupted compressed data (block too short)";
+    buf_ = (buf_ << 8) | static_cast<unsigned char>(*data_++);
+    num_bits_ += 8;
+  }
+  const char *data_, *end_;
+  uint64 buf_;
+  int32 num_bits_;
+};
+
+static void EncodeCompressedBlock(const MatrixBase<BaseFloat> &data,
+                                  int32 start, int32 num_samp,
+                                  std::string *out) {
+  BitWriter writer(out);
+  std::vector<int32> samples(num_samp);
+  std::vector<uint32> residuals(num_samp);
+  for (int32 c = 0; c < data.NumRows(); c++) {
+    const BaseFloat *row = data.RowData(c) + start;
+    for (int32 i = 0; i < num_samp; i++) {
+      int32 elem = static_cast<int32>(row[i]);
+      if (static_cast<int32>(static_cast<int16>(elem)) != elem)
+        KALDI_ERR << "Wave file is out of range for 16-bit.";
+      samples[i] = elem;
+      if (i > 0) {
+        int32 pred = (i == 1 ? samples[0] : 2 * samples[i-1] - samples[i-2]),
+            r = elem - pred;
+        residuals[i] = (r >= 0 ? 2 * r : -2 * r - 1);  // fold the sign in.
+      }
+    }
+    // Choose the Rice parameter that gives the fewest bits.
+    int32 best_k = 0;
+    int64 best_bits = -1;
+    for (int32 k = 0; k < 20; k++) {
+      int64 bits = static_cast<int64>(k + 1) * (num_samp - 1);
+      for (int32 i = 1; i < num_samp; i++)
+        bits += residuals[i] >> k;
+      if (best_bits < 0 || bits < best_bits) {
+        best_bits = bits;
+        best_k = k;
+      }
+    }
+    writer.Put(static_cast<uint16>(samples[0]), 16);
+    writer.Put(best_k, 5);
+    for (int32 i = 1; i < num_samp; i++) {
+      writer.PutUnary(residuals[i] >> best_k);
+      writer.Put(residuals[i] & ((1u << best_k) - 1), best_k);
+    }
+  }
+  writer.Flush();
+}
 
-void WaveData::Read(std::istream &is) {
-  data_.Resize(0, 0);  // clear the data.
+// Reads block "b" of a compressed file from "is", which must be at the
+// start of it, into "block_data".
+static void DecodeCompressedBlock(std::istream &is, const WaveHeader &header,
+                                  int32 b, Matrix<BaseFloat> *block_data) {
+  uint32 num_bytes = header.block_offsets[b+1] - header.block_offsets[b];
+  std::vector<char> bytes(num_bytes + 1);
+  is.read(&(bytes[0]), num_bytes);
+  if (is.fail())
+    KALDI_ERR << "WaveData: failed to read compressed data.";
+  int32 num_samp = std::min<int64>(header.block_size,
+                                   header.num_samples -
+                                   static_cast<int64>(b) * header.block_size);
+  block_data->Resize(header.num_channels, num_samp, kUndefined);
+  BitReader reader(&(bytes[0]), &(bytes[0]) + num_bytes);
+  for (int32 c = 0; c < header.num_channels; c++) {
+    BaseFloat *row = block_data->RowData(c);
+    int32 x1 = static_cast<int16>(reader.Get(16)), x2 = 0;  // x[i-1], x[i-2]
+    int32 k = reader.Get(5);
+    row[0] = x1;
+    for (int32 i = 1; i < num_samp; i++) {
+      uint32 q = reader.GetUnary(),
+          u = (q << k) | reader.Get(k);
+      int32 r = (u & 1 ? -static_cast<int32>(u >> 1) - 1
+                 : static_cast<int32>(u >> 1)),
+          x = r + (i == 1 ? x1 : 2 * x1 - x2);
+      row[i] = x;
+      x2 = x1;
+      x1 = x;
+    }
+  }
+}
 
+// Reads the next "data->NumCols()" samples of a RIFF file into "data",
+// a chunk at a time.
+static void ReadPcmSamples(std::istream &is, const WaveHeader &header,
+                           MatrixBase<BaseFloat> *data) {
+  KALDI_ASSERT(data->NumRows() == header.num_channels);
+  int32 num_samp = data->NumCols(), num_channels = header.num_channels,
+      bits_per_sample = header.bits_per_sample,
+      block_align = header.BlockAlign(),
+      chunk_size = std::max(1, 65536 / block_align);  // in samples.
+  bool swap = header.swap;
+  std::vector<char> chunk_data_vec(std::min(chunk_size, num_samp) * block_align);
+  for (int32 i0 = 0; i0 < num_samp; i0 += chunk_size) {
+    int32 n = std::min(chunk_size, num_samp - i0);
+    char *data_ptr = &(chunk_data_vec[0]);
+    is.read(data_ptr, n * block_align);
+    if (is.fail())
+      KALDI_ERR << "WaveData: failed to read data chunk.";
+    for (int32 i = i0; i < i0 + n; i++) {
+      for (int32 j = 0; j < num_channels; j++) {
+        switch (bits_per_sample) {
+          case 8:
+            (*data)(j, i) = *data_ptr;
+            data_ptr++;
+            break;
+          case 16:
+            {
+              int16 k = *reinterpret_cast<uint16*>(data_ptr);
+              if (swap)
+                KALDI_SWAP2(k);
+              (*data)(j, i) =  k;
+              data_ptr += 2;
+              break;
+            }
+          case 32:
+            {
+              int32 k = *reinterpret_cast<uint32*>(data_ptr);
+              if (swap)
+                KALDI_SWAP4(k);
+              (*data)(j, i) =  k;
+              data_ptr += 4;
+              break;
+            }
+          default:
+            KALDI_ERR << "bits per sample is " << bits_per_sample;  // already checked this.
+        }
+      }
+    }
+  }
+}
+
+
+void WaveHeader::Read(std::istream &is) {
   char tmp[5];
   tmp[4] = '\0';
   Read4ByteTag(is, &tmp[0]);
-  bool is_rifx;
+  if (!strcmp(tmp, kCompressedWaveTag)) {
+#ifdef __BIG_ENDIAN__
+    bool swap = true;
+#else
+    bool swap = false;
+#endif
+    compressed = true;
+    samp_freq = static_cast<BaseFloat>(ReadUint32(is, swap));
+    num_channels = ReadUint16(is, swap);
+    num_samples = ReadUint32(is, swap);
+    block_size = ReadUint32(is, swap);
+    uint32 num_blocks = ReadUint32(is, swap);
+    bits_per_sample = 16;
+    if (num_channels <= 0 || num_samples <= 0 || block_size <= 0 ||
+        num_blocks != (num_samples + block_size - 1) / block_size)
+      KALDI_ERR << "WaveData: invalid header in compressed data";
+    block_offsets.resize(num_blocks + 1);
+    for (uint32 b = 0; b <= num_blocks; b++) {
+      block_offsets[b] = ReadUint32(is, swap);
+      if (b == 0 ? block_offsets[b] != 0
+          : block_offsets[b] < block_offsets[b-1])
+        KALDI_ERR << "WaveData: invalid block offsets in compressed data";
+    }
+    return;
+  }
+  compressed = false;
+  block_size = 0;
+  block_offsets.clear();
+
+  bool is_rifx = false;
   if (!strcmp(tmp, "RIFF"))
     is_rifx = false;
   else if (!strcmp(tmp, "RIFX"))
@@ -120,9 +342,9 @@ void WaveData::Read(std::istream &is) {
     KALDI_ERR << "WaveData: expected RIFF or RIFX, got " << tmp;
 
 #ifdef __BIG_ENDIAN__  
-  bool swap = !is_rifx;
+  swap = !is_rifx;
 #else
-  bool swap = is_rifx;
+  swap = is_rifx;
 #endif
   
   uint32 riff_chunk_size = ReadUint32(is, swap);
@@ -133,12 +355,12 @@ void WaveData::Read(std::istream &is) {
 
   Expect4ByteTag(is, "fmt ");
   uint32 subchunk1_size = ReadUint32(is, swap);
-  uint16 audio_format = ReadUint16(is, swap),
-      num_channels = ReadUint16(is, swap);
+  uint16 audio_format = ReadUint16(is, swap);
+  num_channels = ReadUint16(is, swap);
   uint32 sample_rate = ReadUint32(is, swap),
       byte_rate = ReadUint32(is, swap),
-      block_align = ReadUint16(is, swap),
-      bits_per_sample = ReadUint16(is, swap);
+      block_align = ReadUint16(is, swap);
+  bits_per_sample = ReadUint16(is, swap);
 
   if (audio_format != 1)
     KALDI_ERR << "WaveData: can read only PCM data, audio_format is not 1: "
@@ -150,14 +372,14 @@ void WaveData::Read(std::istream &is) {
 
   if (num_channels <= 0)
     KALDI_ERR << "WaveData: no channels present";
-  samp_freq_ = static_cast<BaseFloat>(sample_rate);
+  samp_freq = static_cast<BaseFloat>(sample_rate);
   if (bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 32)
     KALDI_ERR << "WaveData: bits_per_sample is " << bits_per_sample;
   if (byte_rate != sample_rate * bits_per_sample/8 * num_channels)
     KALDI_ERR << "Unexpected byte rate " << byte_rate << " vs. "
               << sample_rate <<" * " << (bits_per_sample/8)
               << " * " << num_channels;
-  if (block_align != num_channels * bits_per_sample/8)
+  if (block_align != static_cast<uint32>(num_channels * bits_per_sample/8))
     KALDI_ERR << "Unexpected block_align: " << block_align << " vs. "
               << num_channels << " * " << (bits_per_sample/8);
 
@@ -193,54 +415,37 @@ void WaveData::Read(std::istream &is) {
 
   uint32 data_chunk_size = ReadUint32(is, swap);
   riff_chunk_read += 4;
-  std::vector<char> chunk_data_vec(data_chunk_size);
-  char *data_ptr = &(chunk_data_vec[0]);
-  is.read(data_ptr, data_chunk_size);
   riff_chunk_read += data_chunk_size;
 
   if (riff_chunk_read != riff_chunk_size)
     KALDI_WARN << "Expected " << riff_chunk_size << " bytes in RIFF chunk, but got "
                << riff_chunk_read << " (do not support reading multiple data chunks).";
-  if (is.fail())
-    KALDI_ERR << "WaveData: failed to read data chunk.";
 
   if (data_chunk_size % block_align != 0)
     KALDI_ERR << "WaveData: data chunk size has unexpected length "
               << data_chunk_size << "; block-align = " << block_align;
   if (data_chunk_size == 0)
     KALDI_ERR << "WaveData: empty file (no data)";
+  num_samples = data_chunk_size / block_align;
+}
 
-  uint32 num_samp = data_chunk_size / block_align;
-  data_.Resize(num_channels, num_samp);
-  for (uint32 i = 0; i < num_samp; i++) {
-    for (uint32 j = 0; j < num_channels; j++) {
-      switch (bits_per_sample) {
-        case 8:
-          data_(j, i) = *data_ptr;
-          data_ptr++;
-          break;
-        case 16:
-          {
-            int16 k = *reinterpret_cast<uint16*>(data_ptr);
-            if (swap)
-              KALDI_SWAP2(k);
-            data_(j, i) =  k;
-            data_ptr += 2;
-            break;
-          }
-        case 32:
-          {
-            int32 k = *reinterpret_cast<uint32*>(data_ptr);
-            if (swap)
-              KALDI_SWAP4(k);
-            data_(j, i) =  k;
-            data_ptr += 4;
-            break;
-          }
-        default:
-          KALDI_ERR << "bits per sample is " << bits_per_sample;  // already checked this.
-      }
+
+void WaveData::Read(std::istream &is) {
+  data_.Resize(0, 0);  // clear the data.
+
+  WaveHeader header;
+  header.Read(is);
+  samp_freq_ = header.samp_freq;
+  data_.Resize(header.num_channels, header.num_samples, kUndefined);
+  if (header.compressed) {
+    Matrix<BaseFloat> block_data;
+    for (int32 b = 0; b < header.NumBlocks(); b++) {
+      DecodeCompressedBlock(is, header, b, &block_data);
+      data_.Range(0, header.num_channels, b * header.block_size,
+                  block_data.NumCols()).CopyFromMat(block_data);
     }
+  } else {
+    ReadPcmSamples(is, header, &data_);
   }
 }
 
@@ -297,4 +502,106 @@ void WaveData::Write(std::ostream &os) const {
 }
 
 
+void WaveData::WriteCompressed(std::ostream &os, int32 block_size) const {
+  if (data_.NumRows() == 0)
+    KALDI_ERR << "Error: attempting to write empty WAVE file";
+  KALDI_ASSERT(samp_freq_ > 0 && block_size > 0);
+  int32 num_chan = data_.NumRows(),
+      num_samp = data_.NumCols(),
+      num_blocks = (num_samp + block_size - 1) / block_size;
+
+  std::string blocks;
+  std::vector<uint32> block_offsets(1, 0);
+  for (int32 b = 0; b < num_blocks; b++) {
+    int32 start = b * block_size;
+    EncodeCompressedBlock(data_, start, std::min(block_size, num_samp - start),
+                          &blocks);
+    block_offsets.push_back(blocks.size());
+  }
+  os << kCompressedWaveTag;
+  WriteUint32(os, static_cast<int32>(samp_freq_));
+  WriteUint16(os, num_chan);
+  WriteUint32(os, num_samp);
+  WriteUint32(os, block_size);
+  WriteUint32(os, num_blocks);
+  for (size_t b = 0; b < block_offsets.size(); b++)
+    WriteUint32(os, block_offsets[b]);
+  os.write(blocks.data(), blocks.size());
+  if (os.fail())
+    KALDI_ERR << "Error writing wave data to stream.";
+}
+
+
+bool WaveSegmentReader::Open(const std::string &rxfilename) {
+  cached_block_ = -1;
+  wave_.Clear();
+  header_ = WaveHeader();
+  if (!input_.Open(rxfilename, NULL)) {  // NULL: no Kaldi binary header.
+    KALDI_WARN << "Failed to open wave file " << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  InputType type = ClassifyRxfilename(rxfilename);
+  in_memory_ = (type != kFileInput && type != kOffsetFileInput);
+  try {
+    if (in_memory_) {  // we can't seek, so read it all.
+      wave_.Read(input_.Stream());
+      input_.Close();
+      header_.samp_freq = wave_.SampFreq();
+      header_.num_channels = wave_.Data().NumRows();
+      header_.num_samples = wave_.Data().NumCols();
+    } else {
+      header_.Read(input_.Stream());
+      data_start_ = input_.Stream().tellg();
+      if (data_start_ == std::streampos(-1))
+        KALDI_ERR << "Could not get the position in the file";
+    }
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Failed to read wave data from "
+               << PrintableRxfilename(rxfilename);
+    if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+    input_.Close();
+    return false;
+  }
+  return true;
+}
+
+void WaveSegmentReader::Read(int64 start, int32 num_samples,
+                             Matrix<BaseFloat> *data) {
+  int32 num_channels = header_.num_channels;
+  if (start < 0 || num_samples <= 0 || start + num_samples > NumSamples())
+    KALDI_ERR << "Invalid range of samples " << start << " to "
+              << (start + num_samples) << " in recording with "
+              << NumSamples() << " samples";
+  data->Resize(num_channels, num_samples, kUndefined);
+  if (in_memory_) {
+    data->CopyFromMat(wave_.Data().Range(0, num_channels, start, num_samples));
+    return;
+  }
+  std::istream &is = input_.Stream();
+  if (!header_.compressed) {
+    is.clear();
+    is.seekg(data_start_ + static_cast<std::streamoff>(start *
+                                                        header_.BlockAlign()));
+    ReadPcmSamples(is, header_, data);
+    return;
+  }
+  int64 end = start + num_samples;
+  for (int32 b = start / header_.block_size;
+       static_cast<int64>(b) * header_.block_size < end; b++) {
+    if (b != cached_block_) {
+      is.clear();
+      is.seekg(data_start_ +
+               static_cast<std::streamoff>(header_.block_offsets[b]));
+      cached_block_ = -1;  // in case of exception.
+      DecodeCompressedBlock(is, header_, b, &block_data_);
+      cached_block_ = b;
+    }
+    int64 block_start = static_cast<int64>(b) * header_.block_size,
+        s = std::max(start, block_start),
+        e = std::min(end, block_start + block_data_.NumCols());
+    data->Range(0, num_channels, s - start, e - s).CopyFromMat(
+        block_data_.Range(0, num_channels, s - block_start, e - s));
+  }
+}
+
 }  // end namespace kaldi
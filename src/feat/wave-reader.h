@@ -44,14 +44,48 @@
 #define KALDI_FEAT_WAVE_READER_H_
 
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "base/kaldi-types.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
+#include "util/kaldi-io.h"
 
 
 namespace kaldi {
 
+/// The format information at the start of a wave file, which is all that
+/// needs to be read before reading the samples.  This covers RIFF files and
+/// the compressed format written by WaveData::WriteCompressed().
+struct WaveHeader {
+  BaseFloat samp_freq;
+  int32 num_channels;
+  int64 num_samples;  // per channel.
+  bool compressed;
+  // For RIFF files:
+  int32 bits_per_sample;
+  bool swap;  // true if the samples need byte-swapping.
+  // For compressed files: the samples are in blocks of block_size samples
+  // (the last block may be shorter), and block_offsets has the byte offset of
+  // each block, and of the end of the last one, relative to the first block.
+  int32 block_size;
+  std::vector<uint32> block_offsets;
+
+  WaveHeader(): samp_freq(0.0), num_channels(0), num_samples(0),
+                compressed(false), bits_per_sample(0), swap(false),
+                block_size(0) { }
+
+  /// Reads the header, leaving "is" at the first sample (RIFF) or block
+  /// (compressed).  Throws on error.
+  void Read(std::istream &is);
+
+  int32 NumBlocks() const { return block_offsets.size() - 1; }
+  /// Bytes per sample of all the channels, for RIFF files.
+  int32 BlockAlign() const { return num_channels * bits_per_sample / 8; }
+};
+
+
 /// This class's purpose is to read in Wave files.
 class WaveData {
  public:
@@ -63,12 +97,19 @@ class WaveData {
 
   /// Read() will throw on error.  It's valid to call Read() more than once--
   /// in this case it will destroy what was there before.
-  /// "is" should be opened in binary mode.
+  /// "is" should be opened in binary mode.  Reads RIFF files, and the
+  /// compressed format written by WriteCompressed().
   void Read(std::istream &is);
 
   /// Write() will throw on error.   os should be opened in binary mode.
   void Write(std::ostream &os) const;
 
+  /// Writes the data in a lossless compressed format (the samples must be in
+  /// the 16-bit range, as for Write()).  Each block of "block_size" samples
+  /// can be decoded on its own, so WaveSegmentReader can read part of a
+  /// recording without decoding all of it.  Will throw on error.
+  void WriteCompressed(std::ostream &os, int32 block_size = 4096) const;
+
   // This function returns the wave data-- it's in a matrix
   // becase there may be multiple channels.  In the normal case
   // there's just one channel so Data() will have one row.
@@ -92,16 +133,44 @@ class WaveData {
  private:
   Matrix<BaseFloat> data_;
   BaseFloat samp_freq_;
-  static void Expect4ByteTag(std::istream &is, const char *expected);
-  uint32 ReadUint32(std::istream &is, bool swap);
-  uint16 ReadUint16(std::istream &is, bool swap);
-  static void Read4ByteTag(std::istream &is, char *dest);
-
-  static void WriteUint32(std::ostream &os, int32 i);
-  static void WriteUint16(std::ostream &os, int16 i);
 };
 
 
+/**
+   WaveSegmentReader reads ranges of samples from one recording, e.g. the
+   segments of a long recording, without reading all of it into memory:
+   Open() reads only the header, and Read() seeks to the samples it needs.
+   For compressed files it decodes only the blocks that overlap the range, and
+   it keeps the last block it decoded, as consecutive segments often share
+   one.  Input that can't seek (a pipe or the standard input) is read into
+   memory in full by Open().
+ */
+class WaveSegmentReader {
+ public:
+  WaveSegmentReader(): cached_block_(-1) { }
+
+  /// Opens the recording and reads its header; returns false (with a
+  /// warning) on error.
+  bool Open(const std::string &rxfilename);
+
+  BaseFloat SampFreq() const { return header_.samp_freq; }
+  int32 NumChannels() const { return header_.num_channels; }
+  int64 NumSamples() const { return header_.num_samples; }
+
+  /// Reads samples [start, start + num_samples) of each channel into "data",
+  /// which will have one row per channel.  Throws on error.
+  void Read(int64 start, int32 num_samples, Matrix<BaseFloat> *data);
+
+ private:
+  Input input_;
+  WaveHeader header_;
+  std::streampos data_start_;  // position of the first sample or block.
+  bool in_memory_;
+  WaveData wave_;  // the whole recording, if in_memory_.
+  int32 cached_block_;  // the compressed block in block_data_, or -1.
+  Matrix<BaseFloat> block_data_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveSegmentReader);
+};
 
 
 // Holder class for .wav files that enables us to read (but not write)
@@ -155,6 +224,26 @@ class WaveHolder {
 };
 
 
+// Holder class that writes wave data in the compressed format (see
+// WaveData::WriteCompressed()); it reads in the same way as WaveHolder, which
+// reads both formats.
+class CompressedWaveHolder: public WaveHolder {
+ public:
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    KALDI_ASSERT(binary == true
+                 && "Wave data can only be written in binary mode.");
+    try {
+      t.WriteCompressed(os);  // throws exception on failure.
+      return true;
+    } catch(const std::exception &e) {
+      KALDI_WARN << "Exception caught in CompressedWaveHolder object (writing).";
+      if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+      return false;  // write failure.
+    }
+  }
+};
+
+
 }  // namespace kaldi
 
 #endif  // KALDI_FEAT_WAVE_READER_H_
@@ -0,0 +1,155 @@
+// featbin/apply-feat-pipeline.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "matrix/kaldi-matrix.h"
+#include "feat/feature-transform-pipeline.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Apply a sequence of feature transformations in one process, instead of\n"
+        "a pipe of apply-cmvn, add-deltas, splice-feats, transform-feats and\n"
+        "subsample-feats; adjacent cmvn and transform stages are combined into\n"
+        "one affine transform.  The transforms are used by the transform stages\n"
+        "in the order given; each is per-utterance, or per-speaker if --utt2spk\n"
+        "is given, or global if it's an rxfilename (and similarly for --cmvn).\n"
+        "Usage: apply-feat-pipeline [options] feats-rspecifier feats-wspecifier "
+        "[(transform-rspecifier|transform-rxfilename) ...]\n"
+        " e.g.: apply-feat-pipeline --stages=cmvn,splice,transform,transform \\\n"
+        "   --cmvn=scp:cmvn.scp --utt2spk=ark:utt2spk scp:feats.scp ark:- \\\n"
+        "   final.mat ark:trans.1\n";
+
+    ParseOptions po(usage);
+    FeatureTransformPipelineOptions pipeline_opts;
+    std::string cmvn_rspecifier_or_rxfilename, utt2spk_rspecifier;
+    pipeline_opts.Register(&po);
+    po.Register("cmvn", &cmvn_rspecifier_or_rxfilename, "CMVN stats for the "
+                "cmvn stage (rspecifier or rxfilename)");
+    po.Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance to "
+                "speaker map, for the cmvn stats and transforms");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    FeatureTransformPipeline pipeline(pipeline_opts);
+    int32 num_transforms = po.NumArgs() - 2;
+    if (num_transforms != pipeline.NumTransforms())
+      KALDI_ERR << "--stages=" << pipeline_opts.stages << " needs "
+                << pipeline.NumTransforms() << " transforms, but "
+                << num_transforms << " were given.";
+    if (pipeline.NeedsCmvn() != (cmvn_rspecifier_or_rxfilename != ""))
+      KALDI_ERR << "The --cmvn option must be given if and only if the stages "
+                << "include cmvn.";
+
+    std::string feat_rspecifier = po.GetArg(1),
+        feat_wspecifier = po.GetArg(2);
+
+    SequentialBaseFloatMatrixReader feat_reader(feat_rspecifier);
+    BaseFloatMatrixWriter feat_writer(feat_wspecifier);
+
+    // For each transform, either a global one or a reader.
+    std::vector<Matrix<BaseFloat> > global_transforms(num_transforms);
+    std::vector<RandomAccessBaseFloatMatrixReaderMapped*> transform_readers(
+        num_transforms, NULL);
+    for (int32 i = 0; i < num_transforms; i++) {
+      std::string transform_rspecifier_or_rxfilename = po.GetArg(3 + i);
+      if (ClassifyRspecifier(transform_rspecifier_or_rxfilename, NULL, NULL)
+          == kNoRspecifier) {
+        ReadKaldiObject(transform_rspecifier_or_rxfilename,
+                        &(global_transforms[i]));
+      } else {
+        transform_readers[i] = new RandomAccessBaseFloatMatrixReaderMapped(
+            transform_rspecifier_or_rxfilename, utt2spk_rspecifier);
+      }
+    }
+    Matrix<double> global_cmvn_stats;
+    RandomAccessDoubleMatrixReaderMapped *cmvn_reader = NULL;
+    if (pipeline.NeedsCmvn()) {
+      if (ClassifyRspecifier(cmvn_rspecifier_or_rxfilename, NULL, NULL)
+          == kNoRspecifier)
+        ReadKaldiObject(cmvn_rspecifier_or_rxfilename, &global_cmvn_stats);
+      else
+        cmvn_reader = new RandomAccessDoubleMatrixReaderMapped(
+            cmvn_rspecifier_or_rxfilename, utt2spk_rspecifier);
+    }
+
+    int32 num_done = 0, num_err = 0;
+    int64 frames_in = 0, frames_out = 0;
+    for (; !feat_reader.Done(); feat_reader.Next()) {
+      std::string utt = feat_reader.Key();
+      const Matrix<BaseFloat> &feats = feat_reader.Value();
+
+      const Matrix<double> *cmvn_stats = NULL;
+      if (cmvn_reader != NULL) {
+        if (!cmvn_reader->HasKey(utt)) {
+          KALDI_WARN << "No normalization statistics available for key "
+                     << utt << ", producing no output for this utterance";
+          num_err++;
+          continue;
+        }
+        cmvn_stats = &(cmvn_reader->Value(utt));
+      } else if (pipeline.NeedsCmvn()) {
+        cmvn_stats = &global_cmvn_stats;
+      }
+      std::vector<const Matrix<BaseFloat>*> transforms(num_transforms);
+      bool ok = true;
+      for (int32 i = 0; i < num_transforms && ok; i++) {
+        if (transform_readers[i] == NULL) {
+          transforms[i] = &(global_transforms[i]);
+        } else if (transform_readers[i]->HasKey(utt)) {
+          transforms[i] = &(transform_readers[i]->Value(utt));
+        } else {
+          KALDI_WARN << "No transform available for utterance " << utt
+                     << " in " << po.GetArg(3 + i)
+                     << ", producing no output for this utterance";
+          ok = false;
+        }
+      }
+      Matrix<BaseFloat> output;
+      if (!ok || !pipeline.Apply(feats, cmvn_stats, transforms, &output)) {
+        if (ok)
+          KALDI_WARN << "Failed to apply the feature pipeline to utterance "
+                     << utt;
+        num_err++;
+        continue;
+      }
+      frames_in += feats.NumRows();
+      frames_out += output.NumRows();
+      feat_writer.Write(utt, output);
+      num_done++;
+    }
+    for (int32 i = 0; i < num_transforms; i++)
+      delete transform_readers[i];
+    delete cmvn_reader;
+    KALDI_LOG << "Applied feature pipeline " << pipeline_opts.stages << " to "
+              << num_done << " utterances, errors on " << num_err
+              << "; " << frames_in << " frames in, " << frames_out << " out.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
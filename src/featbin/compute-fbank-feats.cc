@@ -22,6 +22,8 @@
 #include "util/common-utils.h"
 #include "feat/feature-fbank.h"
 #include "feat/wave-reader.h"
+#include "feat/feature-extraction-task.h"
+#include "thread/kaldi-task-sequence.h"
 
 
 int main(int argc, char *argv[]) {
@@ -40,6 +42,7 @@ int main(int argc, char *argv[]) {
     std::string utt2spk_rspecifier;
     int32 channel = -1;
     BaseFloat min_duration = 0.0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     // Define defaults for gobal options
     std::string output_format = "kaldi";
 
@@ -54,6 +57,7 @@ int main(int argc, char *argv[]) {
     po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, 0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments to process (in seconds).");
 
+    sequencer_config.Register(&po);
     // OPTION PARSING ..........................................................
     //
 
@@ -69,7 +73,8 @@ int main(int argc, char *argv[]) {
 
     std::string output_wspecifier = po.GetArg(2);
 
-    Fbank fbank(fbank_opts);
+    // One Fbank object per thread.
+    FeatureComputerPool<Fbank> pool(fbank_opts, sequencer_config.num_threads);
 
     SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
@@ -93,6 +98,12 @@ int main(int argc, char *argv[]) {
       KALDI_ERR << "Invalid output_format string " << output_format;
     }
 
+    uint16 htk_sample_kind = static_cast<uint16>(007 | // FBANK
+        (fbank_opts.use_energy ? 0100 : 020000));  // energy; otherwise c0
+
+    // The sequencer is only used if --num-threads > 1; it computes the
+    // features in parallel, and writes them in the original order.
+    TaskSequencer<ComputeFeaturesTask<Fbank> > sequencer(sequencer_config);
     int32 num_utts = 0, num_success = 0;
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
@@ -139,42 +150,19 @@ int main(int argc, char *argv[]) {
                   << "option).  Utterance is " << utt;
 
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        fbank.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
+      ComputeFeaturesTask<Fbank> *task = new ComputeFeaturesTask<Fbank>(
+          &pool, utt, waveform, vtln_warp_local, subtract_mean, &kaldi_writer,
+          &htk_writer, htk_sample_kind, &num_success);
+      if (sequencer_config.num_threads == 1) {
+        (*task)();
+        delete task;  // writes the features.
       } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          static_cast<uint16>(007 | // FBANK
-          (fbank_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
+        sequencer.Run(task);
       }
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
     }
+    sequencer.Wait();
     KALDI_LOG << " Done " << num_success << " out of " << num_utts
               << " utterances.";
     return (num_success != 0 ? 0 : 1);
@@ -20,7 +20,61 @@
 #include "util/common-utils.h"
 #include "feat/pitch-functions.cc"
 #include "feat/wave-reader.h"
+#include "thread/kaldi-task-sequence.h"
 
+namespace kaldi {
+
+// Computes the pitch of one utterance in operator (), and writes it in the
+// destructor, so that TaskSequencer writes the utterances in order.
+class ComputePitchTask {
+ public:
+  ComputePitchTask(const PitchExtractionOptions &pitch_opts,
+                   const std::string &utt,
+                   const VectorBase<BaseFloat> &waveform,
+                   BaseFloatMatrixWriter *feat_writer,
+                   int32 *num_done):
+      pitch_opts_(pitch_opts), utt_(utt), waveform_(waveform),
+      feat_writer_(feat_writer), num_done_(num_done), failed_(false) { }
+
+  void operator () () {
+    try {
+      Compute(pitch_opts_, waveform_, &features_);
+    } catch (...) {
+      failed_ = true;
+    }
+    waveform_.Resize(0);
+  }
+
+  ~ComputePitchTask() {
+    if (failed_) {
+      KALDI_WARN << "Failed to compute pitch for utterance "
+                 << utt_;
+      return;
+    }
+    double tot = features_.Sum();
+    if (features_.NumCols() != 2 || KALDI_ISINF(tot) || KALDI_ISNAN(tot)) {
+      KALDI_WARN << "Pitch extraction failed for utterance " << utt_
+                 << ", num-rows is " << features_.NumRows() << ", total is "
+                 << tot;
+    }
+
+    feat_writer_->Write(utt_, features_);
+    if (*num_done_ % 50 == 0 && *num_done_ != 0)
+      KALDI_VLOG(2) << "Processed " << *num_done_ << " utterances";
+    (*num_done_)++;
+  }
+
+ private:
+  const PitchExtractionOptions &pitch_opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloatMatrixWriter *feat_writer_;
+  int32 *num_done_;
+  bool failed_;
+  Matrix<BaseFloat> features_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -42,7 +96,10 @@ int main(int argc, char *argv[]) {
                         // on the command line (in the .scp file) using sox or
                         // similar.
 
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+
     pitch_opts.Register(&po);
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -57,6 +114,9 @@ int main(int argc, char *argv[]) {
     SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
     BaseFloatMatrixWriter feat_writer(feat_wspecifier);
 
+    // The sequencer is only used if --num-threads > 1; it computes the
+    // pitch in parallel, and writes it in the original order.
+    TaskSequencer<ComputePitchTask> sequencer(sequencer_config);
     int32 num_done = 0, num_err = 0;
     for (; !wav_reader.Done(); wav_reader.Next()) {
       std::string utt = wav_reader.Key();  
@@ -89,27 +149,16 @@ int main(int argc, char *argv[]) {
       
       
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        Compute(pitch_opts, waveform, &features);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute pitch for utterance "
-                   << utt;
-        continue;
+      ComputePitchTask *task = new ComputePitchTask(pitch_opts, utt, waveform,
+                                                    &feat_writer, &num_done);
+      if (sequencer_config.num_threads == 1) {
+        (*task)();
+        delete task;  // writes the pitch.
+      } else {
+        sequencer.Run(task);
       }
-
-      double tot = features.Sum();
-      if (features.NumCols() != 2 || KALDI_ISINF(tot) || KALDI_ISNAN(tot)) {
-        KALDI_WARN << "Pitch extraction failed for utterance " << utt
-                   << ", num-rows is " << features.NumRows() << ", total is "
-                   << tot;
-      }
-      
-      feat_writer.Write(utt, features);
-      if (num_done % 50 == 0 && num_done != 0)
-        KALDI_VLOG(2) << "Processed " << num_done << " utterances";
-      num_done++;
     }
+    sequencer.Wait();
     KALDI_LOG << "Done " << num_done << " utterances, " << num_err
               << " with errors.";
     return (num_done != 0 ? 0 : 1);
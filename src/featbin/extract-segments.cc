@@ -18,6 +18,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "feat/feature-mfcc.h"
@@ -68,7 +70,27 @@ int main(int argc, char *argv[]) {
     std::string segments_rxfilename = po.GetArg(2);
     std::string wav_wspecifier = po.GetArg(3);
 
-    RandomAccessTableReader<WaveHolder> reader(wav_rspecifier);
+    // If the recordings come from an scp file, we open each one with
+    // WaveSegmentReader, which reads just the segments, seeking to each one,
+    // instead of reading in the whole recording.
+    std::string script_rxfilename;
+    bool use_segment_reader = (ClassifyRspecifier(wav_rspecifier,
+                                                  &script_rxfilename, NULL)
+                               == kScriptRspecifier);
+    RandomAccessTableReader<WaveHolder> reader;
+    std::map<std::string, std::string> recording_rxfilenames;
+    if (use_segment_reader) {
+      std::vector<std::pair<std::string, std::string> > script;
+      if (!ReadScriptFile(script_rxfilename, true, &script))
+        KALDI_ERR << "Error reading script file "
+                  << PrintableRxfilename(script_rxfilename);
+      recording_rxfilenames.insert(script.begin(), script.end());
+    } else if (!reader.Open(wav_rspecifier)) {
+      KALDI_ERR << "Could not open recordings " << wav_rspecifier;
+    }
+    WaveSegmentReader segment_reader;
+    std::string open_recording;  // the recording segment_reader has open.
+    bool open_ok = false;
     TableWriter<WaveHolder> writer(wav_wspecifier);
     Input ki(segments_rxfilename);  // no binary argment: never binary.
 
@@ -121,17 +143,36 @@ int main(int argc, char *argv[]) {
       /* check whether a segment start time and end time exists in recording 
        * if fails , skips the segment.
        */ 
-      if (!reader.HasKey(recording)) {
-        KALDI_WARN << "Could not find recording " << recording
-                   << ", skipping segment " << segment;
-        continue;
+      BaseFloat samp_freq;  // sampling frequency
+      int32 num_samp,  // number of samples in recording
+          num_chan;  // number of channels in recording
+      if (use_segment_reader) {
+        if (recording != open_recording) {
+          std::map<std::string, std::string>::const_iterator iter =
+              recording_rxfilenames.find(recording);
+          open_recording = recording;
+          open_ok = (iter != recording_rxfilenames.end() &&
+                     segment_reader.Open(iter->second));
+        }
+        if (!open_ok) {
+          KALDI_WARN << "Could not find or read recording " << recording
+                     << ", skipping segment " << segment;
+          continue;
+        }
+        samp_freq = segment_reader.SampFreq();
+        num_samp = segment_reader.NumSamples();
+        num_chan = segment_reader.NumChannels();
+      } else {
+        if (!reader.HasKey(recording)) {
+          KALDI_WARN << "Could not find recording " << recording
+                     << ", skipping segment " << segment;
+          continue;
+        }
+        const WaveData &wave = reader.Value(recording);
+        samp_freq = wave.SampFreq();
+        num_samp = wave.Data().NumCols();
+        num_chan = wave.Data().NumRows();
       }
-      
-      const WaveData &wave = reader.Value(recording);
-      const Matrix<BaseFloat> &wave_data = wave.Data();
-      BaseFloat samp_freq = wave.SampFreq();  // read sampling fequency
-      int32 num_samp = wave_data.NumCols(),  // number of samples in recording
-        num_chan = wave_data.NumRows();  // number of channels in recording
 
       // Convert starting time of the segment to corresponding sample number.
       // If end time is -1 then use the whole file starting from start time.
@@ -185,7 +226,15 @@ int main(int argc, char *argv[]) {
       /*
        * This function  return a portion of a wav data from the orignial wav data matrix 
        */
-      SubMatrix<BaseFloat> segment_matrix(wave_data, channel, 1, start_samp, end_samp-start_samp);
+      Matrix<BaseFloat> segment_matrix;
+      if (use_segment_reader) {
+        segment_reader.Read(start_samp, end_samp - start_samp, &segment_matrix);
+        if (num_chan != 1)
+          segment_matrix = Matrix<BaseFloat>(segment_matrix.RowRange(channel, 1));
+      } else {
+        segment_matrix = reader.Value(recording).Data().Range(
+            channel, 1, start_samp, end_samp - start_samp);
+      }
       WaveData segment_wave(samp_freq, segment_matrix);
       writer.Write(segment, segment_wave); // write segment in wave format.
       num_success++;
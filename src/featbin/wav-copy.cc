@@ -30,9 +30,16 @@ int main(int argc, char *argv[]) {
         "\n"
         "Usage:  wav-copy [options...] <wav-rspecifier> <wav-rspecifier>\n"
         "e.g. wav-copy scp:wav.scp ark:-\n"
+        "With --compress=true, writes a lossless compressed format that all\n"
+        "programs that read wave files can read, and that extract-segments can\n"
+        "read segments of without decoding the whole recording, e.g.\n"
+        " wav-copy --compress=true scp:wav.scp ark,scp:wav.ark,wav_compressed.scp\n"
         "See also: wav-to-duration extract-segments\n";
     
     ParseOptions po(usage);
+    bool compress = false;
+    po.Register("compress", &compress, "If true, write the lossless compressed "
+                "format (for 16-bit data) instead of RIFF wave files.");
 
     po.Read(argc, argv);
 
@@ -47,10 +54,17 @@ int main(int argc, char *argv[]) {
     int32 num_done = 0;
     
     SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
-    TableWriter<WaveHolder> wav_writer(wav_wspecifier);
+    TableWriter<WaveHolder> wav_writer;
+    TableWriter<CompressedWaveHolder> compressed_wav_writer;
+    if (!(compress ? compressed_wav_writer.Open(wav_wspecifier)
+          : wav_writer.Open(wav_wspecifier)))
+      KALDI_ERR << "Could not open output " << wav_wspecifier;
 
     for (; !wav_reader.Done(); wav_reader.Next()) {
-      wav_writer.Write(wav_reader.Key(), wav_reader.Value());
+      if (compress)
+        compressed_wav_writer.Write(wav_reader.Key(), wav_reader.Value());
+      else
+        wav_writer.Write(wav_reader.Key(), wav_reader.Value());
       num_done++;
     }
     KALDI_LOG << "Copied " << num_done << " wave files\n";
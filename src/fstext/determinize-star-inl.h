@@ -29,11 +29,51 @@
 #include <tr1/unordered_map>
 #endif
 using std::tr1::unordered_map;
+#include <algorithm>
 #include <vector>
 #include <climits>
 
 namespace fst {
 
+// ArrayArena stores arrays of T (e.g. the subsets and strings of
+// DeterminizerStar) in large chunks, so we do not need a separate allocation
+// for each of them.  The arrays cannot be freed individually; Clear() frees
+// them all.
+template<class T> class ArrayArena {
+ public:
+  ArrayArena(size_t chunk_size = 16384): chunk_size_(chunk_size) { }
+
+  // Stores a copy of the array [begin, end) and returns a pointer to it,
+  // which stays valid until Clear() is called (NULL for an empty array).
+  const T *Copy(const T *begin, const T *end) {
+    size_t n = end - begin;
+    if (n == 0) return NULL;
+    if (chunks_.empty() ||
+        chunks_.back()->capacity() - chunks_.back()->size() < n) {
+      chunks_.push_back(new vector<T>());
+      chunks_.back()->reserve(std::max(n, chunk_size_));
+    }
+    vector<T> *chunk = chunks_.back();
+    size_t start = chunk->size();
+    // This never reallocates, as the capacity is sufficient.
+    chunk->insert(chunk->end(), begin, end);
+    return &((*chunk)[start]);
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < chunks_.size(); i++)
+      delete chunks_[i];
+    vector<vector<T>*> tmp;
+    tmp.swap(chunks_);
+  }
+
+  ~ArrayArena() { Clear(); }
+ private:
+  size_t chunk_size_;
+  vector<vector<T>*> chunks_;
+  DISALLOW_COPY_AND_ASSIGN(ArrayArena);
+};
+
 // This class maps back and forth from/to integer id's to sequences of strings.
 // used in determinization algorithm.
 
@@ -44,24 +84,30 @@ template<class Label, class StringId> class StringRepository {
   // We treat sequences of length zero and one separately, for efficiency.
 
  public:
+  // A sequence of labels, stored in the arena (or, for lookups, in a vector
+  // owned by the caller).
+  struct Seq {
+    const Label *data;
+    size_t size;
+  };
   class VectorKey { // Hash function object.
    public:
-    size_t operator()(const vector<Label> *vec) const {
-      assert(vec != NULL);
-      size_t hash = 0, factor = 1;
-      for (typename vector<Label>::const_iterator it = vec->begin(); it != vec->end(); it++)
-        hash += factor*(*it); factor*=103333;  // just an arbitrary prime number.
+    size_t operator()(const Seq &seq) const {
+      size_t hash = 0;
+      for (size_t i = 0; i < seq.size; i++)
+        hash = hash * 7853 + seq.data[i];  // 7853 is an arbitrary prime.
       return hash;
     }
   };
   class VectorEqual {  // Equality-operator function object.
    public:
-    size_t operator()(const vector<Label> *vec1, const vector<Label> *vec2) const {
-      return (*vec1 == *vec2);
+    bool operator()(const Seq &seq1, const Seq &seq2) const {
+      return seq1.size == seq2.size &&
+          std::equal(seq1.data, seq1.data + seq1.size, seq2.data);
     }
   };
 
-  typedef unordered_map<const vector<Label>*, StringId, VectorKey, VectorEqual> MapType;
+  typedef unordered_map<Seq, StringId, VectorKey, VectorEqual> MapType;
 
   StringId IdOfEmpty() { return no_symbol; }
 
@@ -91,7 +137,8 @@ template<class Label, class StringId> class StringRepository {
       v->resize(1); (*v)[0] = id - single_symbol_start;
     } else {
       assert(id >= string_start && id < static_cast<StringId>(vec_.size()));
-      *v = *(vec_[id]);
+      const Seq &seq = vec_[id];
+      v->assign(seq.data, seq.data + seq.size);
     }
   }
   StringId RemovePrefix(StringId id, size_t prefix_len) {
@@ -116,12 +163,11 @@ template<class Label, class StringId> class StringRepository {
     single_symbol_range =  numeric_limits<StringId>::max() - single_symbol_start;
   }
   void Destroy() {
-    for (typename vector<vector<Label>* >::iterator iter = vec_.begin(); iter != vec_.end(); ++iter)
-      delete *iter;
-    vector<vector<Label>* > tmp_vec;
-    tmp_vec.swap(vec_);    
+    vector<Seq> tmp_vec;
+    tmp_vec.swap(vec_);
     MapType tmp_map;
     tmp_map.swap(map_);
+    arena_.Clear();
   }
   ~StringRepository() {
     Destroy();
@@ -131,21 +177,25 @@ template<class Label, class StringId> class StringRepository {
   DISALLOW_COPY_AND_ASSIGN(StringRepository);
 
   StringId IdOfSeqInternal(const vector<Label> &v) {
-    typename MapType::iterator iter = map_.find(&v);
+    Seq seq;
+    seq.data = &(v[0]);  // v is never empty here.
+    seq.size = v.size();
+    typename MapType::iterator iter = map_.find(seq);
     if (iter != map_.end()) {
       return iter->second;
     } else {  // must add it to map.
       StringId this_id = (StringId) vec_.size();
-      vector<Label> *v_new = new vector<Label> (v);
-      vec_.push_back(v_new);
-      map_[v_new] = this_id;
+      seq.data = arena_.Copy(&(v[0]), &(v[0]) + v.size());
+      vec_.push_back(seq);
+      map_[seq] = this_id;
       assert(this_id < string_end);  // or we used up the labels.
       return this_id;
     }
   }
 
-  vector<vector<Label>* > vec_;
+  vector<Seq> vec_;  // The sequences, indexed by StringId.
   MapType map_;
+  ArrayArena<Label> arena_;  // Holds the data of the sequences.
 
   static const StringId string_start = (StringId) 0;  // This must not change.  It's assumed.
   StringId string_end;  // = (numeric_limits<StringId>::max() / 2) - 1; // all hash values must be <= this.
@@ -314,24 +364,7 @@ template<class Arc> class DeterminizerStar {
       OutputStateId cur_id = SubsetToStateId(vec);
       assert(cur_id == 0 && "Do not call Determinize twice.");
     }
-    while (!Q_.empty()) {
-      pair<vector<Element>*, OutputStateId> cur_pair = Q_.front();
-      Q_.pop_front();
-      ProcessSubset(cur_pair);
-      if (debug_ptr && *debug_ptr) Debug();  // will exit.
-      if (max_states_ > 0 && output_arcs_.size() > max_states_) {
-        if (allow_partial_ == false) {
-          std::cerr << "Determinization aborted since passed " << max_states_
-                    << " states.\n";
-          throw std::runtime_error("max-states reached in determinization");
-        } else {
-          KALDI_WARN << "Determinization terminated since passed " << max_states_
-                     << " states, partial results will be generated.";
-          is_partial_ = true;
-          break;
-        }
-      }
-    }
+    ProcessQueue(debug_ptr);
     determinized_ = true;
   }
 
@@ -346,11 +379,11 @@ template<class Arc> class DeterminizerStar {
       delete ifst_;
       ifst_ = NULL;
     }
-    for (typename SubsetHash::iterator iter = hash_.begin();
-        iter != hash_.end(); ++iter)
-      delete iter->first;
     SubsetHash tmp;
-    tmp.swap(hash_); 
+    tmp.swap(hash_);
+    deque<pair<Subset, OutputStateId> > tmp_queue;
+    tmp_queue.swap(Q_);
+    subset_arena_.Clear();
   }
   
   ~DeterminizerStar() {
@@ -387,8 +420,14 @@ template<class Arc> class DeterminizerStar {
   };
 
 
+  // A subset, stored in subset_arena_ (or, for lookups, in a vector owned by
+  // the caller).
+  struct Subset {
+    const Element *elems;
+    size_t size;
+  };
+
   // Hashing function used in hash of subsets.
-  // A subset is a pointer to vector<Element>.
   // The Elements are in sorted order on state id, and without repeated states.
   // Because the order of Elements is fixed, we can use a hashing function that is
   // order-dependent.  However the weights are not included in the hashing function--
@@ -402,12 +441,11 @@ template<class Arc> class DeterminizerStar {
 
   class SubsetKey {
    public:
-    size_t operator ()(const vector<Element> * subset) const {  // hashes only the state and string.
-      size_t hash = 0, factor = 1;
-      for (typename vector<Element>::const_iterator iter= subset->begin(); iter != subset->end(); ++iter) {
-        hash *= factor;
-        hash += iter->state + 103333*iter->string;
-        factor *= 23531;  // these numbers are primes.
+    size_t operator ()(const Subset &subset) const {  // hashes only the state and string.
+      size_t hash = 0;
+      for (size_t i = 0; i < subset.size; i++) {
+        const Element &elem = subset.elems[i];
+        hash = hash * 7853 + elem.state + 103333 * elem.string;  // primes.
       }
       return hash;
     }
@@ -417,12 +455,10 @@ template<class Arc> class DeterminizerStar {
   // and string, and approximate match on weights.
   class SubsetEqual {
    public:
-    bool operator ()(const vector<Element> * s1, const vector<Element> * s2) const {
-      size_t sz = s1->size();
-      assert(sz>=0);
-      if (sz != s2->size()) return false;
-      typename vector<Element>::const_iterator iter1 = s1->begin(),
-          iter1_end = s1->end(), iter2=s2->begin();
+    bool operator ()(const Subset &s1, const Subset &s2) const {
+      if (s1.size != s2.size) return false;
+      const Element *iter1 = s1.elems, *iter1_end = s1.elems + s1.size,
+          *iter2 = s2.elems;
       for (; iter1 < iter1_end; ++iter1, ++iter2) {
         if (iter1->state != iter2->state ||
            iter1->string != iter2->string ||
@@ -439,28 +475,23 @@ template<class Arc> class DeterminizerStar {
   // Used only for debug.
   class SubsetEqualStates {
    public:
-    bool operator ()(const vector<Element> * s1, const vector<Element> * s2) const {
-      size_t sz = s1->size();
-      assert(sz>=0);
-      if (sz != s2->size()) return false;
-      typename vector<Element>::const_iterator iter1 = s1->begin(),
-          iter1_end = s1->end(), iter2=s2->begin();
-      for (; iter1 < iter1_end; ++iter1, ++iter2) {
-        if (iter1->state != iter2->state) return false;
-      }
+    bool operator ()(const Subset &s1, const Subset &s2) const {
+      if (s1.size != s2.size) return false;
+      for (size_t i = 0; i < s1.size; i++)
+        if (s1.elems[i].state != s2.elems[i].state) return false;
       return true;
     }
   };
 
   // Define the hash type we use to store subsets.
-  typedef unordered_map<const vector<Element>*, OutputStateId, SubsetKey, SubsetEqual> SubsetHash;
+  typedef unordered_map<Subset, OutputStateId, SubsetKey, SubsetEqual> SubsetHash;
 
 
   // This function computes epsilon closure of subset of states by following epsilon links.
   // Called by ProcessSubset.
   // Has no side effects except on the repository.
 
-  void EpsilonClosure(const vector<Element> & input_subset,
+  void EpsilonClosure(const Subset &input_subset,
                       vector<Element> *output_subset) {
     // input_subset must have only one example of each StateId.
 
@@ -468,8 +499,9 @@ template<class Arc> class DeterminizerStar {
     typedef typename std::map<InputStateId, Element>::iterator MapIter;
     {
       MapIter iter = cur_subset.end();
-      for (size_t i = 0;i < input_subset.size();i++) {
-        std::pair<const InputStateId, Element> pr(input_subset[i].state, input_subset[i]);
+      for (size_t i = 0;i < input_subset.size;i++) {
+        const Element &elem = input_subset.elems[i];
+        std::pair<const InputStateId, Element> pr(elem.state, elem);
         iter = cur_subset.insert(iter, pr);
         // By providing iterator where we inserted last one, we make insertion more efficient since
         // input subset was already in sorted order.
@@ -478,7 +510,8 @@ template<class Arc> class DeterminizerStar {
     // find whether input fst is known to be sorted in input label.
     bool sorted = ((ifst_->Properties(kILabelSorted, false) & kILabelSorted) != 0);
     
-    vector<Element> queue(input_subset);  // queue of things to be processed.
+    vector<Element> queue(input_subset.elems, input_subset.elems +
+                          input_subset.size);  // queue of things to be processed.
     bool replaced_elems = false; // relates to an optimization, see below.
     int counter = 0; // relates to max-states option, used for test.
     while (queue.size() != 0) {
@@ -760,20 +793,25 @@ template<class Arc> class DeterminizerStar {
 
   OutputStateId SubsetToStateId(const vector<Element> &subset) {  // may add the subset to the queue.
     typedef typename SubsetHash::iterator IterType;
-    IterType iter = hash_.find(&subset);
+    Subset key;
+    key.elems = (subset.empty() ? NULL : &(subset[0]));
+    key.size = subset.size();
+    IterType iter = hash_.find(key);
     if (iter == hash_.end()) {  // was not there.
-      vector<Element> *new_subset = new vector<Element>(subset);
+      Subset new_subset;
+      new_subset.elems = subset_arena_.Copy(key.elems, key.elems + key.size);
+      new_subset.size = key.size;
       OutputStateId new_state_id = (OutputStateId) output_arcs_.size();
       hash_[new_subset] = new_state_id;
       output_arcs_.push_back(vector<TempArc>());
       if (allow_partial_ == false) {
         // If --allow-partial is not requested, we do the old way.
-        Q_.push_front(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
+        Q_.push_front(pair<Subset, OutputStateId>(new_subset,  new_state_id));
       } else {
         // If --allow-partial is requested, we do breadth first search. This
         // ensures that when we return partial results, we return the states
         // that are reachable by the fewest steps from the start state.
-        Q_.push_back(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
+        Q_.push_back(pair<Subset, OutputStateId>(new_subset,  new_state_id));
       }
       return new_state_id;
     } else {
@@ -782,6 +820,29 @@ template<class Arc> class DeterminizerStar {
   }
 
 
+  // Processes subsets from the queue until it is empty (or max_states_ is
+  // reached).
+  void ProcessQueue(bool *debug_ptr) {
+    while (!Q_.empty()) {
+      pair<Subset, OutputStateId> cur_pair = Q_.front();
+      Q_.pop_front();
+      ProcessSubset(cur_pair);
+      if (debug_ptr && *debug_ptr) Debug();  // will exit.
+      if (max_states_ > 0 && output_arcs_.size() > max_states_) {
+        if (allow_partial_ == false) {
+          std::cerr << "Determinization aborted since passed " << max_states_
+                    << " states.\n";
+          throw std::runtime_error("max-states reached in determinization");
+        } else {
+          KALDI_WARN << "Determinization terminated since passed " << max_states_
+                     << " states, partial results will be generated.";
+          is_partial_ = true;
+          break;
+        }
+      }
+    }
+  }
+
   // ProcessSubset does the processing of a determinized state, i.e. it creates
   // transitions out of it and adds new determinized states to the queue if necessary.
   // The first stage is "EpsilonClosure" (follow epsilons to get a possibly larger set
@@ -789,12 +850,12 @@ template<class Arc> class DeterminizerStar {
   // of the state, and then handle transitions out (this may add more determinized states
   // to the queue).
 
-  void ProcessSubset(const pair<vector<Element>*, OutputStateId> & pair) {
-    const vector<Element> *subset = pair.first;
+  void ProcessSubset(const pair<Subset, OutputStateId> & pair) {
+    const Subset &subset = pair.first;
     OutputStateId state = pair.second;
 
     vector<Element> closed_subset;  // subset after epsilon closure.
-    EpsilonClosure(*subset, &closed_subset);
+    EpsilonClosure(subset, &closed_subset);
 
     // Now follow non-epsilon arcs [and also process final states]
     ProcessFinal(closed_subset, state);
@@ -867,7 +928,7 @@ template<class Arc> class DeterminizerStar {
 
 
   DISALLOW_COPY_AND_ASSIGN(DeterminizerStar);
-  deque<pair<vector<Element>*, OutputStateId> > Q_;  // queue of subsets to be processed.
+  deque<pair<Subset, OutputStateId> > Q_;  // queue of subsets to be processed.
 
   vector<vector<TempArc> > output_arcs_;  // essentially an FST in our format.
 
@@ -880,6 +941,8 @@ template<class Arc> class DeterminizerStar {
   SubsetKey hasher_;  // object that computes keys-- has no data members.
   SubsetEqual equal_;  // object that compares subsets-- only data member is delta_.
   SubsetHash hash_;  // hash from Subset to StateId in final Fst.
+  ArrayArena<Element> subset_arena_;  // holds the Elements of the subsets in
+                                      // hash_ and Q_.
 
   StringRepository<Label, StringId> repository_;  // associate integer id's with sequences of labels.
 };
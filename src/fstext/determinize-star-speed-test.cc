@@ -0,0 +1,118 @@
+// fstext/determinize-star-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fstext/determinize-star.h"
+#include "util/timer.h"
+
+namespace fst {
+
+// Makes a lexicon with a loop back to the start state, as in L_disambig.fst:
+// phones 1 ... num_phones on the input and words 1 ... num_words on the
+// output; each word has a different pronunciation of 4 phones, so no
+// disambiguation symbols are needed at the word ends.  The start state has a
+// self-loop with the phone num_phones + 1 on the input and the word
+// num_words + 1 on the output, which stand for #0.
+template<class Arc> VectorFst<Arc> *SyntheticLexicon(int32 num_words,
+                                                     int32 num_phones) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  VectorFst<Arc> *fst = new VectorFst<Arc>();
+  StateId start = fst->AddState();
+  fst->SetStart(start);
+  fst->SetFinal(start, Weight::One());
+  fst->AddArc(start, Arc(num_phones + 1, num_words + 1, Weight::One(), start));
+  std::set<vector<int32> > prons;
+  for (int32 w = 1; w <= num_words; w++) {
+    vector<int32> pron(4);
+    do {
+      for (size_t j = 0; j < pron.size(); j++)
+        pron[j] = 1 + rand() % num_phones;
+    } while (!prons.insert(pron).second);
+    StateId cur = start;
+    for (size_t j = 0; j < pron.size(); j++) {
+      StateId next = (j + 1 == pron.size() ? start : fst->AddState());
+      fst->AddArc(cur, Arc(pron[j], (j == 0 ? w : 0), Weight::One(), next));
+      cur = next;
+    }
+  }
+  return fst;
+}
+
+// Makes a bigram grammar with back-off: state 0 is the unigram state, and
+// words 1 ... num_histories each have a state with num_bigrams bigrams and a
+// back-off arc to state 0, labeled #0 (word num_words + 1) on the input and
+// epsilon on the output.
+template<class Arc> VectorFst<Arc> *SyntheticGrammar(int32 num_words,
+                                                     int32 num_histories,
+                                                     int32 num_bigrams) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  VectorFst<Arc> *fst = new VectorFst<Arc>();
+  for (int32 h = 0; h <= num_histories; h++)
+    fst->AddState();
+  fst->SetStart(0);
+  fst->SetFinal(0, Weight::One());
+  for (int32 w = 1; w <= num_words; w++)
+    fst->AddArc(0, Arc(w, w, Weight(0.01 * (rand() % 1000)),
+                       (w <= num_histories ? w : 0)));
+  for (StateId h = 1; h <= num_histories; h++) {
+    std::set<int32> words;
+    while (static_cast<int32>(words.size()) < num_bigrams)
+      words.insert(1 + rand() % num_words);
+    for (std::set<int32>::iterator iter = words.begin(); iter != words.end();
+         ++iter)
+      fst->AddArc(h, Arc(*iter, *iter, Weight(0.01 * (rand() % 500)),
+                         (*iter <= num_histories ? *iter : 0)));
+    fst->AddArc(h, Arc(num_words + 1, 0, Weight(0.01 * (rand() % 300)), 0));
+  }
+  return fst;
+}
+
+// Times DeterminizeStar on a synthetic LG, composed from the lexicon and
+// grammar above.  Compare the times with a build of an earlier version to see
+// the effect of a change to DeterminizerStar.
+template<class Arc> void TestDeterminizeStarSpeed(int32 num_words,
+                                                  int32 num_phones,
+                                                  int32 num_histories,
+                                                  int32 num_bigrams) {
+  VectorFst<Arc> *lex = SyntheticLexicon<Arc>(num_words, num_phones),
+      *grammar = SyntheticGrammar<Arc>(num_words, num_histories, num_bigrams);
+  ArcSort(lex, OLabelCompare<Arc>());
+  ArcSort(grammar, ILabelCompare<Arc>());
+  VectorFst<Arc> lg;
+  Compose(*lex, *grammar, &lg);
+  delete lex;
+  delete grammar;
+  ArcSort(&lg, ILabelCompare<Arc>());  // as fstdeterminizestar does.
+  kaldi::Timer timer;
+  VectorFst<Arc> det_lg;
+  DeterminizeStar(lg, &det_lg);
+  std::cout << "DeterminizeStar on synthetic LG with " << num_words
+            << " words and " << num_histories << " bigram histories ("
+            << lg.NumStates() << " states) took " << timer.Elapsed()
+            << " seconds; output has " << det_lg.NumStates() << " states.\n";
+}
+
+} // end namespace fst
+
+int main() {
+  srand(0);  // The same graphs each time, so the times can be compared.
+  fst::TestDeterminizeStarSpeed<fst::StdArc>(1000, 40, 100, 20);
+  fst::TestDeterminizeStarSpeed<fst::StdArc>(5000, 40, 1000, 50);
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,90 @@
+// fstext/lookahead-compose-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fstext/lookahead-compose.h"
+#include "fstext/rand-fst.h"
+
+namespace fst {
+
+// Checks that the lazily composed graph is equivalent to the result of
+// composing HCL with G (with its disambiguation symbols removed) in the
+// normal way.
+void TestLazyComposeGraph(bool lookahead) {
+  for (int32 i = 0; i < 10; i++) {
+    RandFstOptions opts;
+    opts.acyclic = true;
+    VectorFst<StdArc> *hcl = RandFst<StdArc>(opts);
+    opts.n_syms += 1;  // G's last symbol is a disambiguation symbol.
+    VectorFst<StdArc> *g = RandFst<StdArc>(opts);
+    Project(g, PROJECT_INPUT);
+    if (hcl->Start() == kNoStateId || g->Start() == kNoStateId) {
+      delete hcl;
+      delete g;
+      continue;
+    }
+    StdArc::Label disambig_sym = opts.n_syms - 1;
+    std::vector<int32> disambig_syms(1, disambig_sym);
+
+    VectorFst<StdArc> g_nodisambig(*g);
+    for (StdArc::StateId s = 0; s < g_nodisambig.NumStates(); s++) {
+      for (MutableArcIterator<VectorFst<StdArc> > aiter(&g_nodisambig, s);
+           !aiter.Done(); aiter.Next()) {
+        StdArc arc = aiter.Value();
+        if (arc.ilabel == disambig_sym) {
+          arc.ilabel = arc.olabel = 0;
+          aiter.SetValue(arc);
+        }
+      }
+    }
+    ArcSort(hcl, OLabelCompare<StdArc>());
+    VectorFst<StdArc> hclg;
+    Compose(*hcl, g_nodisambig, &hclg);
+
+    LazyComposeOptions compose_opts;
+    compose_opts.lookahead = lookahead;
+    compose_opts.cache_bytes = 1000;  // Small, to exercise the garbage
+                                      // collection.
+    LazyComposeGraph lazy_hclg(*hcl, *g, disambig_syms, compose_opts);
+    delete hcl;  // LazyComposeGraph keeps its own copies.
+    delete g;
+
+    if (hclg.Start() == kNoStateId) {
+      // Nothing to compare with; just check that we can expand it.
+      VectorFst<StdArc> lazy_copy(lazy_hclg.Graph());
+      Connect(&lazy_copy);
+      assert(lazy_copy.Start() == kNoStateId);
+      continue;
+    }
+    assert(RandEquivalent(hclg, lazy_hclg.Graph(), 5/*paths*/, 0.01/*delta*/,
+                          rand()/*seed*/, 100/*path length, max*/));
+    // The total weight should also be the same.
+    StdArc::Weight w1 = ShortestDistance(hclg),
+        w2 = ShortestDistance(lazy_hclg.Graph());
+    assert(ApproxEqual(w1, w2));
+  }
+}
+
+}  // namespace fst
+
+int main() {
+  using namespace fst;
+  for (int32 i = 0; i < 5; i++) {
+    TestLazyComposeGraph(true);
+    TestLazyComposeGraph(false);
+  }
+  std::cout << "Test OK\n";
+}
@@ -0,0 +1,95 @@
+// fstext/lookahead-compose.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "fstext/lookahead-compose.h"
+
+namespace fst {
+
+// Replaces the symbols in "syms" (which must be sorted) with epsilon, on both
+// sides of the FST.
+static void RemoveDisambigSyms(const std::vector<int32> &syms,
+                               VectorFst<StdArc> *fst) {
+  typedef StdArc::StateId StateId;
+  for (StateId s = 0; s < fst->NumStates(); s++) {
+    for (MutableArcIterator<VectorFst<StdArc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      StdArc arc = aiter.Value();
+      bool changed = false;
+      if (std::binary_search(syms.begin(), syms.end(), arc.ilabel)) {
+        arc.ilabel = 0;
+        changed = true;
+      }
+      if (std::binary_search(syms.begin(), syms.end(), arc.olabel)) {
+        arc.olabel = 0;
+        changed = true;
+      }
+      if (changed) aiter.SetValue(arc);
+    }
+  }
+}
+
+LazyComposeGraph::LazyComposeGraph(const Fst<StdArc> &hcl,
+                                   const Fst<StdArc> &g,
+                                   const std::vector<int32> &g_disambig_syms,
+                                   const LazyComposeOptions &opts):
+    hcl_(NULL), g_(NULL), compose_fst_(NULL) {
+  if (hcl.Start() == kNoStateId || g.Start() == kNoStateId)
+    KALDI_ERR << "LazyComposeGraph: HCL or G is empty.";
+  std::vector<int32> syms(g_disambig_syms);
+  std::sort(syms.begin(), syms.end());
+  if (!syms.empty() && syms[0] == 0)
+    KALDI_ERR << "LazyComposeGraph: epsilon is not a disambiguation symbol.";
+
+  g_ = new VectorFst<StdArc>(g);
+  RemoveDisambigSyms(syms, g_);
+
+  CacheOptions cache_opts(true, opts.cache_bytes);
+  if (opts.lookahead) {
+    // Converting HCL to StdOLabelLookAheadFst relabels its output symbols so
+    // that the words reachable from each state form an interval; G must then
+    // be relabeled to match.
+    StdOLabelLookAheadFst *hcl_lookahead = new StdOLabelLookAheadFst(hcl);
+    hcl_ = hcl_lookahead;
+    LabelLookAheadRelabeler<StdArc>::Relabel(g_, *hcl_lookahead, true);
+    ArcSort(g_, ILabelCompare<StdArc>());
+
+    typedef LookAheadMatcher<StdFst> M;
+    typedef AltSequenceComposeFilter<M> SF;
+    typedef LookAheadComposeFilter<SF, M> LF;
+    typedef PushWeightsComposeFilter<LF, M> WF;
+    typedef PushLabelsComposeFilter<WF, M> ComposeFilter;
+    ComposeFstOptions<StdArc, M, ComposeFilter> compose_opts(cache_opts);
+    compose_fst_ = new ComposeFst<StdArc>(*hcl_, *g_, compose_opts);
+  } else {
+    VectorFst<StdArc> *hcl_sorted = new VectorFst<StdArc>(hcl);
+    ArcSort(hcl_sorted, OLabelCompare<StdArc>());
+    hcl_ = hcl_sorted;
+    ArcSort(g_, ILabelCompare<StdArc>());
+    compose_fst_ = new ComposeFst<StdArc>(*hcl_, *g_, cache_opts);
+  }
+}
+
+LazyComposeGraph::~LazyComposeGraph() {
+  // The ComposeFst holds its own (reference-counted) copies of its inputs, so
+  // the order of deletion does not matter.
+  delete compose_fst_;
+  delete hcl_;
+  delete g_;
+}
+
+}  // namespace fst
@@ -0,0 +1,84 @@
+// fstext/lookahead-compose.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_LOOKAHEAD_COMPOSE_H_
+#define KALDI_FSTEXT_LOOKAHEAD_COMPOSE_H_
+
+#include <vector>
+#include <fst/fstlib.h>
+#include <fst/fst-decl.h>
+#include "base/kaldi-common.h"
+
+namespace fst {
+
+struct LazyComposeOptions {
+  /// Limit in bytes on the states of the composed FST that are kept in its
+  /// cache; states beyond this are garbage collected, and expanded again if
+  /// the decoder visits them again.
+  size_t cache_bytes;
+  /// If true, use label and weight lookahead (with label and weight pushing)
+  /// in the composition, which expands far fewer dead-end states of G.
+  bool lookahead;
+  LazyComposeOptions(): cache_bytes(static_cast<size_t>(256) << 20),
+                        lookahead(true) { }
+};
+
+/**
+   LazyComposeGraph is a decoding graph HCLG that is built on demand, as
+   HCL o G, instead of being compiled in advance; this is useful for language
+   models that are too large to compose with HCL offline.  The states of the
+   composition are created when the decoder first visits them (through the
+   normal Fst interface, i.e. Start(), Final() and ArcIterator), so only the
+   part of the graph that survives the beam is ever expanded.
+
+   HCL should have transition-ids on the input side and words on the output
+   side, with the self-loops already added and the disambiguation symbols
+   removed from the input side (i.e. H o C o L_disambig, with the
+   disambiguation symbols then replaced by epsilon, e.g. with fstrmsymbols).
+   G is the usual word acceptor; the disambiguation symbols
+   on its input side (normally just #0 on the backoff arcs) are turned into
+   epsilons here.
+
+   The weights are not pushed in the way mkgraph.sh would push them, so the
+   search is somewhat less efficient at a given beam than with the static
+   graph; the lookahead composition recovers most of the difference.  Like any
+   delayed Fst, the graph is not thread-safe: each decoding thread needs its
+   own LazyComposeGraph.
+ */
+class LazyComposeGraph {
+ public:
+  /// The arguments are copied, so they do not have to outlive this object.
+  LazyComposeGraph(const Fst<StdArc> &hcl,
+                   const Fst<StdArc> &g,
+                   const std::vector<int32> &g_disambig_syms,
+                   const LazyComposeOptions &opts);
+
+  /// The graph, to be given to the decoder.
+  const Fst<StdArc> &Graph() const { return *compose_fst_; }
+
+  ~LazyComposeGraph();
+ private:
+  Fst<StdArc> *hcl_;  // A StdOLabelLookAheadFst, or an olabel-sorted
+                      // VectorFst if !opts.lookahead.
+  VectorFst<StdArc> *g_;  // G, relabeled and ilabel-sorted.
+  Fst<StdArc> *compose_fst_;  // The delayed composition of hcl_ and g_.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LazyComposeGraph);
+};
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_LOOKAHEAD_COMPOSE_H_
@@ -42,7 +42,9 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Generate lattices using GMM-based model.\n"
         "Usage: gmm-latgen-faster [options] model-in (fst-in|fsts-rspecifier) features-rspecifier"
-        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n"
+        "With --g-fst, the FST argument is HCL, which is composed on the fly\n"
+        "with G during decoding instead of using a precompiled HCLG.\n";
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
@@ -50,6 +52,9 @@ int main(int argc, char *argv[]) {
     LatticeFasterDecoderConfig config;
     
     std::string word_syms_filename;
+    std::string g_fst_rxfilename, g_disambig_rxfilename;
+    fst::LazyComposeOptions compose_opts;
+    int32 compose_cache_mb = 256;
     config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
@@ -57,6 +62,16 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "If true, produce output even if end state was not reached.");
+    po.Register("g-fst", &g_fst_rxfilename, "If set, the grammar G, which "
+                "is composed on the fly with the FST argument (which must "
+                "then be HCL, and not a table of FSTs).");
+    po.Register("g-disambig-syms", &g_disambig_rxfilename, "List of "
+                "disambiguation symbols on the input of G (e.g. #0), which are "
+                "replaced by epsilon [with --g-fst]");
+    po.Register("lookahead", &compose_opts.lookahead, "If true, use label "
+                "and weight lookahead when composing with G [with --g-fst]");
+    po.Register("compose-cache-mb", &compose_cache_mb, "Limit on the memory "
+                "(in MB) of the cached states of HCL o G [with --g-fst]");
     
     po.Read(argc, argv);
 
@@ -107,9 +122,23 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::LazyComposeGraph *lazy_fst = NULL;
+      if (g_fst_rxfilename != "") {
+        VectorFst<StdArc> *g_fst = fst::ReadFstKaldi(g_fst_rxfilename);
+        std::vector<int32> g_disambig;
+        if (g_disambig_rxfilename != "" &&
+            !ReadIntegerVectorSimple(g_disambig_rxfilename, &g_disambig))
+          KALDI_ERR << "Could not read disambiguation symbols from "
+                    << g_disambig_rxfilename;
+        compose_opts.cache_bytes = static_cast<size_t>(compose_cache_mb) << 20;
+        lazy_fst = new fst::LazyComposeGraph(*decode_fst, *g_fst, g_disambig,
+                                             compose_opts);
+        delete g_fst;
+      }
       
       {
-        LatticeFasterDecoder decoder(*decode_fst, config);
+        LatticeFasterDecoder decoder(lazy_fst != NULL ? lazy_fst->Graph() :
+                                     *decode_fst, config);
     
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
@@ -136,8 +165,11 @@ int main(int argc, char *argv[]) {
           } else num_err++;
         }
       }
+      delete lazy_fst;
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
+      if (g_fst_rxfilename != "")
+        KALDI_ERR << "--g-fst cannot be used with a table of FSTs.";
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);          
       for (; !fst_reader.Done(); fst_reader.Next()) {
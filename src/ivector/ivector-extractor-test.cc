@@ -76,6 +76,68 @@ void TestIvectorStatsIO(IvectorStats &stats) {
 }
   
 
+// Gets Gaussian posteriors for "feats" from "fgmm", with no pruning.
+void GetTestPosteriors(const FullGmm &fgmm,
+                       const MatrixBase<BaseFloat> &feats,
+                       Posterior *post) {
+  post->resize(feats.NumRows());
+  for (int32 t = 0; t < feats.NumRows(); t++) {
+    Vector<BaseFloat> this_post(fgmm.NumGauss());
+    fgmm.ComponentPosteriors(feats.Row(t), &this_post);
+    for (int32 i = 0; i < this_post.Dim(); i++)
+      (*post)[t].push_back(std::make_pair(i, this_post(i)));
+  }
+}
+
+void TestIvectorExtractorBatch(const IvectorExtractor &extractor,
+                               const FullGmm &fgmm,
+                               const std::vector<Matrix<BaseFloat> > &all_feats) {
+  int32 num_utts = all_feats.size(), S = extractor.IvectorDim();
+  std::vector<IvectorExtractorUtteranceStats*> stats(num_utts);
+  std::vector<const IvectorExtractorUtteranceStats*> const_stats(num_utts);
+  std::vector<Posterior> posts(num_utts);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    GetTestPosteriors(fgmm, all_feats[utt], &(posts[utt]));
+    stats[utt] = new IvectorExtractorUtteranceStats(extractor.NumGauss(),
+                                                    extractor.FeatDim(),
+                                                    false);
+    extractor.GetStats(all_feats[utt], posts[utt], stats[utt]);
+    const_stats[utt] = stats[utt];
+  }
+  Matrix<double> means(num_utts, S);
+  std::vector<SpMatrix<double> > vars;
+  extractor.GetIvectorDistributionBatch(const_stats, &means, &vars);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    Vector<double> mean(S);
+    SpMatrix<double> var(S);
+    extractor.GetIvectorDistribution(*(stats[utt]), &mean, &var);
+    Vector<double> batch_mean(means.Row(utt));
+    AssertEqual(mean, batch_mean, 1.0e-04);
+    AssertEqual(var, vars[utt], 1.0e-04);
+
+    if (!extractor.IvectorDependentWeights()) {
+      // The online estimation should give the same answer, when we solve
+      // exactly, or when we do enough iterations of conjugate gradient.
+      OnlineIvectorEstimationStats online_stats(S, extractor.PriorOffset());
+      int32 num_frames = all_feats[utt].NumRows(),
+          half = num_frames / 2;
+      Vector<double> online_ivector(S);
+      online_stats.GetDefaultIvector(&online_ivector);
+      for (int32 t = 0; t < num_frames; t++) {
+        online_stats.AccStats(extractor, all_feats[utt].Row(t),
+                              posts[utt][t]);
+        if (t == half)  // get an intermediate estimate, to warm-start from.
+          online_stats.GetIvector(S, &online_ivector);
+      }
+      online_stats.GetIvector(2 * S, &online_ivector);
+      AssertEqual(mean, online_ivector, 1.0e-03);
+      online_stats.GetIvector(0, &online_ivector);
+      AssertEqual(mean, online_ivector, 1.0e-04);
+    }
+    delete stats[utt];
+  }
+}
+
 void UnitTestIvectorExtractor() {
   FullGmm fgmm;
   int32 dim = 5 + rand() % 5, num_comp = 1 + rand() % 5;
@@ -118,6 +180,7 @@ void UnitTestIvectorExtractor() {
       stats.AccStatsForUtterance(extractor, feats, fgmm);
     }
     TestIvectorStatsIO(stats);
+    TestIvectorExtractorBatch(extractor, fgmm, all_feats);
     
     IvectorExtractorEstimationOptions estimation_opts;
     estimation_opts.gaussian_min_count = dim + 5;
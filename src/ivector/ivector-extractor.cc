@@ -93,32 +93,66 @@ void IvectorExtractor::GetIvectorDistribution(
     const IvectorExtractorUtteranceStats &utt_stats,
     VectorBase<double> *mean,
     SpMatrix<double> *var) const {
+  Vector<double> linear(IvectorDim());
+  SpMatrix<double> quadratic(IvectorDim());
+  GetIvectorDistMean(utt_stats, &linear, &quadratic);
+  GetIvectorDistPrior(utt_stats, &linear, &quadratic);
+  GetIvectorDistributionFromTerms(utt_stats, linear, quadratic, mean, var);
+}
+
+void IvectorExtractor::GetIvectorDistributionBatch(
+    const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+    MatrixBase<double> *means,
+    std::vector<SpMatrix<double> > *vars) const {
+  int32 num_utts = utt_stats.size(), S = IvectorDim();
+  KALDI_ASSERT(means->NumRows() == num_utts && means->NumCols() == S);
+  if (vars != NULL) vars->resize(num_utts);
+  Matrix<double> linear(num_utts, S),
+      quadratic(num_utts, S * (S + 1) / 2);
+  GetIvectorDistMeanBatch(utt_stats, &linear, &quadratic);
+
+  SpMatrix<double> this_quadratic(S);
+  for (int32 b = 0; b < num_utts; b++) {
+    SubVector<double> this_linear(linear, b);
+    SubVector<double> q_vec(this_quadratic.Data(), S * (S + 1) / 2);
+    q_vec.CopyFromVec(quadratic.Row(b));
+    GetIvectorDistPrior(*(utt_stats[b]), &this_linear, &this_quadratic);
+    SubVector<double> this_mean(*means, b);
+    SpMatrix<double> *this_var = NULL;
+    if (vars != NULL) {
+      (*vars)[b].Resize(S);
+      this_var = &((*vars)[b]);
+    }
+    GetIvectorDistributionFromTerms(*(utt_stats[b]), this_linear,
+                                    this_quadratic, &this_mean, this_var);
+  }
+}
+
+void IvectorExtractor::GetIvectorDistributionFromTerms(
+    const IvectorExtractorUtteranceStats &utt_stats,
+    const VectorBase<double> &linear,
+    const SpMatrix<double> &quadratic_in,
+    VectorBase<double> *mean,
+    SpMatrix<double> *var) const {
   if (!IvectorDependentWeights()) {
-    Vector<double> linear(IvectorDim());
-    SpMatrix<double> quadratic(IvectorDim());
-    GetIvectorDistMean(utt_stats, &linear, &quadratic);
-    GetIvectorDistPrior(utt_stats, &linear, &quadratic);
     if (var != NULL) {
-      var->CopyFromSp(quadratic);
+      var->CopyFromSp(quadratic_in);
       var->Invert(); // now it's a variance.
 
       // mean of distribution = quadratic^{-1} * linear...
       mean->AddSpVec(1.0, *var, linear, 0.0);
     } else {
+      SpMatrix<double> quadratic(quadratic_in);
       quadratic.Invert();
       mean->AddSpVec(1.0, quadratic, linear, 0.0);
     }
   } else {
-    Vector<double> linear(IvectorDim());
-    SpMatrix<double> quadratic(IvectorDim());
-    GetIvectorDistMean(utt_stats, &linear, &quadratic);
-    GetIvectorDistPrior(utt_stats, &linear, &quadratic);
+    const SpMatrix<double> &quadratic = quadratic_in;
     // At this point, "linear" and "quadratic" contain
     // the mean and prior-related terms, and we avoid
     // recomputing those. 
 
     Vector<double> cur_mean(IvectorDim());
-
     SpMatrix<double> quadratic_inv(IvectorDim());
     InvertWithFlooring(quadratic, &quadratic_inv);
     cur_mean.AddSpVec(1.0, quadratic_inv, linear, 0.0);
@@ -300,6 +334,42 @@ void IvectorExtractor::GetIvectorDistMean(
   q_vec.AddMatVec(1.0, U_, kTrans, Vector<double>(utt_stats.gamma), 1.0);
 }
 
+void IvectorExtractor::GetIvectorDistMeanBatch(
+    const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+    MatrixBase<double> *linear,
+    MatrixBase<double> *quadratic) const {
+  int32 num_utts = utt_stats.size(), I = NumGauss(), D = FeatDim();
+  KALDI_ASSERT(linear->NumRows() == num_utts &&
+               quadratic->NumRows() == num_utts &&
+               quadratic->NumCols() == U_.NumCols());
+  // gammas is the zeroth-order stats for all the utterances, stacked.
+  Matrix<double> gammas(num_utts, I);
+  for (int32 b = 0; b < num_utts; b++)
+    gammas.Row(b).CopyFromVec(utt_stats[b]->gamma);
+  // All the quadratic terms at once: quadratic_b += \sum_i \gamma_{bi} U_i.
+  quadratic->AddMatMat(1.0, gammas, kNoTrans, U_, kNoTrans, 1.0);
+
+  // For the linear term, for each Gaussian i we stack the first-order stats of
+  // the utterances into X_i (each row of which is \gamma_{bi} \m_{bi}), and
+  // do linear += X_i \Sigma_i^{-1} \M_i, which is the same as
+  // a += \gamma_i \M_i^T \Sigma_i^{-1} \m_i for each utterance.
+  Matrix<double> X(num_utts, D), X_sigma_inv(num_utts, D);
+  for (int32 i = 0; i < I; i++) {
+    bool nonzero = false;
+    for (int32 b = 0; b < num_utts; b++) {
+      if (gammas(b, i) != 0.0) {
+        X.Row(b).CopyFromVec(utt_stats[b]->X.Row(i));
+        nonzero = true;
+      } else {
+        X.Row(b).SetZero();
+      }
+    }
+    if (!nonzero) continue;
+    X_sigma_inv.AddMatSp(1.0, X, kNoTrans, Sigma_inv_[i], 0.0);
+    linear->AddMatMat(1.0, X_sigma_inv, kNoTrans, M_[i], kNoTrans, 1.0);
+  }
+}
+
 void IvectorExtractor::GetIvectorDistPrior(
     const IvectorExtractorUtteranceStats &utt_stats,
     VectorBase<double> *linear,
@@ -594,6 +664,112 @@ void IvectorExtractor::Read(std::istream &is, bool binary) {
 }
 
 
+OnlineIvectorEstimationStats::OnlineIvectorEstimationStats(
+    int32 ivector_dim, BaseFloat prior_offset):
+    prior_offset_(prior_offset), num_frames_(0.0),
+    linear_term_(ivector_dim), quadratic_term_(ivector_dim) {
+  KALDI_ASSERT(ivector_dim > 0);
+  // Include the prior term: the inverse-variance of the prior is the unit
+  // matrix and the zero'th dimension has an offset mean.
+  linear_term_(0) += prior_offset;
+  for (int32 d = 0; d < ivector_dim; d++)
+    quadratic_term_(d, d) += 1.0;
+}
+
+OnlineIvectorEstimationStats::OnlineIvectorEstimationStats(
+    const OnlineIvectorEstimationStats &other):
+    prior_offset_(other.prior_offset_), num_frames_(other.num_frames_),
+    linear_term_(other.linear_term_),
+    quadratic_term_(other.quadratic_term_) { }
+
+void OnlineIvectorEstimationStats::AccStats(
+    const IvectorExtractor &extractor,
+    const VectorBase<BaseFloat> &feature,
+    const std::vector<std::pair<int32, BaseFloat> > &gauss_post) {
+  KALDI_ASSERT(extractor.IvectorDim() == IvectorDim() &&
+               extractor.FeatDim() == feature.Dim());
+  int32 S = IvectorDim();
+  Vector<double> x(feature), // double-precision copy of the feature.
+      sigma_inv_x(feature.Dim());
+  SubVector<double> q_vec(quadratic_term_.Data(), S * (S + 1) / 2);
+  for (size_t idx = 0; idx < gauss_post.size(); idx++) {
+    int32 i = gauss_post[idx].first;
+    double weight = gauss_post[idx].second;
+    if (weight == 0.0) continue;
+    // Next line: a += \gamma_i \M_i^T \Sigma_i^{-1} x, where \gamma_i
+    // is the posterior for this frame.
+    sigma_inv_x.AddSpVec(1.0, extractor.Sigma_inv_[i], x, 0.0);
+    linear_term_.AddMatVec(weight, extractor.M_[i], kTrans,
+                           sigma_inv_x, 1.0);
+    // Next line: quadratic += \gamma_i U_i.
+    q_vec.AddVec(weight, extractor.U_.Row(i));
+    num_frames_ += weight;
+  }
+}
+
+void OnlineIvectorEstimationStats::AccStats(
+    const IvectorExtractor &extractor,
+    const MatrixBase<BaseFloat> &feats,
+    const Posterior &post) {
+  KALDI_ASSERT(static_cast<int32>(post.size()) == feats.NumRows());
+  for (int32 t = 0; t < feats.NumRows(); t++)
+    AccStats(extractor, feats.Row(t), post[t]);
+}
+
+void OnlineIvectorEstimationStats::GetDefaultIvector(
+    VectorBase<double> *ivector) const {
+  KALDI_ASSERT(ivector->Dim() == IvectorDim());
+  ivector->SetZero();
+  (*ivector)(0) = prior_offset_;
+}
+
+void OnlineIvectorEstimationStats::GetIvector(
+    int32 num_cg_iters,
+    VectorBase<double> *ivector) const {
+  KALDI_ASSERT(ivector->Dim() == IvectorDim());
+  if (num_cg_iters <= 0) {
+    SpMatrix<double> quadratic_inv(quadratic_term_);
+    quadratic_inv.Invert();
+    ivector->AddSpVec(1.0, quadratic_inv, linear_term_, 0.0);
+    return;
+  }
+  // Conjugate gradient on the objective 0.5 x^T Q x - x^T a, whose minimum is
+  // at Q x = a; we start from the current value of "ivector".
+  int32 S = IvectorDim();
+  Vector<double> r(linear_term_), // residual, r = a - Q x.
+      p(S), Qp(S);
+  r.AddSpVec(-1.0, quadratic_term_, *ivector, 1.0);
+  p.CopyFromVec(r);
+  double r_sumsq = VecVec(r, r),
+      tolerance = 1.0e-20 * VecVec(linear_term_, linear_term_);
+  for (int32 iter = 0; iter < num_cg_iters && r_sumsq > tolerance; iter++) {
+    Qp.AddSpVec(1.0, quadratic_term_, p, 0.0);
+    double alpha = r_sumsq / VecVec(p, Qp);
+    ivector->AddVec(alpha, p);
+    r.AddVec(-alpha, Qp);
+    double r_sumsq_new = VecVec(r, r);
+    p.Scale(r_sumsq_new / r_sumsq);
+    p.AddVec(1.0, r);
+    r_sumsq = r_sumsq_new;
+  }
+}
+
+void OnlineIvectorEstimationStats::Scale(double scale) {
+  KALDI_ASSERT(scale >= 0.0);
+  // Remove the prior terms, scale, and add them back.
+  int32 S = IvectorDim();
+  linear_term_(0) -= prior_offset_;
+  for (int32 d = 0; d < S; d++)
+    quadratic_term_(d, d) -= 1.0;
+  linear_term_.Scale(scale);
+  quadratic_term_.Scale(scale);
+  num_frames_ *= scale;
+  linear_term_(0) += prior_offset_;
+  for (int32 d = 0; d < S; d++)
+    quadratic_term_(d, d) += 1.0;
+}
+
+
 IvectorStats::IvectorStats(const IvectorExtractor &extractor,
                            const IvectorStatsOptions &stats_opts):
     config_(stats_opts) {
@@ -127,6 +127,21 @@ class IvectorExtractor {
       VectorBase<double> *mean,
       SpMatrix<double> *var) const;
 
+  /// This is a batched version of GetIvectorDistribution(), which processes
+  /// several utterances at once.  The terms that arise from the Gaussian means
+  /// are computed with matrix-matrix products over all the utterances (the
+  /// quadratic terms as a single product of the stacked zeroth-order stats
+  /// with U_), rather than with per-utterance vector operations; this is
+  /// much faster when there are many utterances.  "means" must have
+  /// utt_stats.size() rows and this->IvectorDim() columns; row b is set to the
+  /// mean for utt_stats[b].  "vars" may be NULL; otherwise it is resized to
+  /// utt_stats.size() and set to the variances.  The results are the same as
+  /// GetIvectorDistribution() up to roundoff.
+  void GetIvectorDistributionBatch(
+      const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+      MatrixBase<double> *means,
+      std::vector<SpMatrix<double> > *vars) const;
+
   /// The distribution over iVectors, in our formulation, is not centered at
   /// zero; its first dimension has a nonzero offset.  This function returns
   /// that offset.
@@ -189,6 +204,15 @@ class IvectorExtractor {
       VectorBase<double> *linear,
       SpMatrix<double> *quadratic) const;
 
+  /// This is a batched version of GetIvectorDistMean(); row b of "linear"
+  /// and "quadratic" gets the terms for utt_stats[b] added to it.  Row b of
+  /// "quadratic" is the packed form of an SpMatrix (i.e. its dimension is
+  /// IvectorDim() * (IvectorDim() + 1) / 2).
+  void GetIvectorDistMeanBatch(
+      const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+      MatrixBase<double> *linear,
+      MatrixBase<double> *quadratic) const;
+
   /// Gets the linear and quadratic terms in the distribution over
   /// iVectors, that arise from the prior.  Adds to the outputs,
   /// rather than setting them.
@@ -232,6 +256,19 @@ class IvectorExtractor {
   void ComputeDerivedVars();
   void ComputeDerivedVars(int32 i);
   friend class IvectorExtractorComputeDerivedVarsClass;
+  friend class OnlineIvectorEstimationStats;
+
+  /// This does the part of GetIvectorDistribution() that comes after working
+  /// out the mean and prior terms, i.e. it adds the weight-related terms if
+  /// applicable and solves for the distribution.  It's also used by
+  /// GetIvectorDistributionBatch().  "linear" and "quadratic" should contain
+  /// the mean and prior related terms.
+  void GetIvectorDistributionFromTerms(
+      const IvectorExtractorUtteranceStats &utt_stats,
+      const VectorBase<double> &linear,
+      const SpMatrix<double> &quadratic,
+      VectorBase<double> *mean,
+      SpMatrix<double> *var) const;
   
   // Imagine we'll project the iVectors with transformation T, so apply T^{-1}
   // where necessary to keep the model equivalent.  Used to keep unit variance
@@ -285,6 +322,75 @@ class IvectorExtractor {
 };
 
 
+/// This class is used to estimate iVectors in an online way, where the data
+/// arrives frame by frame (or chunk by chunk) and we want an up-to-date
+/// estimate of the iVector after each chunk.  Rather than storing the
+/// utterance stats and recomputing the linear and quadratic terms from
+/// scratch, it accumulates those terms directly, so the cost of each frame
+/// is proportional to the number of Gaussians with nonzero posterior.
+/// GetIvector() can refine the previous estimate with a few iterations of
+/// conjugate gradient, which is cheap compared with a full solve and, since
+/// the iVector changes slowly, is generally enough.
+/// Note: this class ignores the weight-projection w_ (i.e. it acts as if
+/// IvectorDependentWeights() were false), since the weights term is not
+/// quadratic in the iVector and can't be accumulated incrementally.
+class OnlineIvectorEstimationStats {
+ public:
+  OnlineIvectorEstimationStats(int32 ivector_dim,
+                               BaseFloat prior_offset);
+
+  OnlineIvectorEstimationStats(const OnlineIvectorEstimationStats &other);
+
+  /// Accumulates the stats for one frame; "gauss_post" is a list of
+  /// (Gaussian-index, posterior) pairs, as in one element of a Posterior.
+  void AccStats(const IvectorExtractor &extractor,
+                const VectorBase<BaseFloat> &feature,
+                const std::vector<std::pair<int32, BaseFloat> > &gauss_post);
+
+  /// Accumulates the stats for a chunk of frames; post.size() must equal
+  /// feats.NumRows().
+  void AccStats(const IvectorExtractor &extractor,
+                const MatrixBase<BaseFloat> &feats,
+                const Posterior &post);
+
+  int32 IvectorDim() const { return linear_term_.Dim(); }
+
+  /// Gets the current estimate of the iVector (the mean of its distribution;
+  /// note that its first element includes the prior offset, as for the
+  /// output of IvectorExtractor::GetIvectorDistribution()).  If num_cg_iters
+  /// > 0, it does that many iterations of conjugate gradient starting from
+  /// the value in "ivector", which should be the previous estimate or, the
+  /// first time, the prior mean (see GetDefaultIvector()).  If num_cg_iters
+  /// <= 0, it solves exactly and ignores the input value.
+  void GetIvector(int32 num_cg_iters,
+                  VectorBase<double> *ivector) const;
+
+  /// Sets "ivector" to the prior mean, which is a suitable starting point
+  /// for GetIvector() before we have seen any data.
+  void GetDefaultIvector(VectorBase<double> *ivector) const;
+
+  double NumFrames() const { return num_frames_; }
+
+  double PriorOffset() const { return prior_offset_; }
+
+  /// Scales the stats (but not the prior); can be used to implement
+  /// forgetting of old data in long recordings.
+  void Scale(double scale);
+
+ private:
+  double prior_offset_;
+  double num_frames_; // total weight of frames accumulated so far.
+  Vector<double> linear_term_; // sum of M_i^T Sigma_i^{-1} x weighted by the
+                               // posteriors, plus the prior term.
+  SpMatrix<double> quadratic_term_; // sum of U_i weighted by the
+                                    // posteriors, plus the prior term.
+
+  // Disallow assignment.
+  OnlineIvectorEstimationStats &operator = (
+      const OnlineIvectorEstimationStats &other);
+};
+
+
 /// Options for IvectorStats, which is used to update the parameters of
 /// IvectorExtractor.
 struct IvectorStatsOptions {
@@ -28,65 +28,89 @@ namespace kaldi {
 
 // This class will be used to parallelize over multiple threads the job
 // that this program does.  The work happens in the operator (), the
-// output happens in the destructor.
+// output happens in the destructor.  Each task processes a batch of
+// utterances, so that the iVector extractor can use matrix-matrix
+// operations across the utterances (see GetIvectorDistributionBatch()).
 class IvectorExtractTask {
  public:
   IvectorExtractTask(const IvectorExtractor &extractor,
-                     std::string utt,
-                     const Matrix<BaseFloat> &feats,
-                     const Posterior &posterior,
                      BaseFloatVectorWriter *writer,
                      double *tot_auxf_change):
-      extractor_(extractor), utt_(utt), feats_(feats), posterior_(posterior),
-      writer_(writer), tot_auxf_change_(tot_auxf_change) { }
+      extractor_(extractor), writer_(writer),
+      tot_auxf_change_(tot_auxf_change) { }
+
+  // Adds an utterance to this task's batch.
+  void AddUtterance(const std::string &utt,
+                    const Matrix<BaseFloat> &feats,
+                    const Posterior &posterior) {
+    utts_.push_back(utt);
+    feats_.push_back(feats);
+    posteriors_.push_back(posterior);
+  }
+
+  int32 NumUtterances() const { return utts_.size(); }
 
   void operator () () {
     bool need_2nd_order_stats = false;
-    
-    IvectorExtractorUtteranceStats utt_stats(extractor_.NumGauss(),
-                                             extractor_.FeatDim(),
-                                             need_2nd_order_stats);
-      
-    extractor_.GetStats(feats_, posterior_, &utt_stats);
-
-    ivector_.Resize(extractor_.IvectorDim());
-    ivector_(0) = extractor_.PriorOffset();
+    int32 num_utts = utts_.size();
+
+    std::vector<IvectorExtractorUtteranceStats*> utt_stats(num_utts);
+    std::vector<const IvectorExtractorUtteranceStats*> const_utt_stats(num_utts);
+    for (int32 n = 0; n < num_utts; n++) {
+      utt_stats[n] = new IvectorExtractorUtteranceStats(extractor_.NumGauss(),
+                                                        extractor_.FeatDim(),
+                                                        need_2nd_order_stats);
+      extractor_.GetStats(feats_[n], posteriors_[n], utt_stats[n]);
+      const_utt_stats[n] = utt_stats[n];
+    }
+    feats_.clear(); // No longer needed.
 
+    ivectors_.Resize(num_utts, extractor_.IvectorDim());
     if (tot_auxf_change_ != NULL) {
-      double old_auxf = extractor_.GetAuxf(utt_stats, ivector_);
-      extractor_.GetIvectorDistribution(utt_stats, &ivector_, NULL);
-      double new_auxf = extractor_.GetAuxf(utt_stats, ivector_);
-      auxf_change_ = new_auxf - old_auxf;
-    } else {
-      extractor_.GetIvectorDistribution(utt_stats, &ivector_, NULL);
+      auxf_change_.resize(num_utts);
+      for (int32 n = 0; n < num_utts; n++) {
+        Vector<double> ivector(extractor_.IvectorDim());
+        ivector(0) = extractor_.PriorOffset();
+        auxf_change_[n] = -extractor_.GetAuxf(*(utt_stats[n]), ivector);
+      }
+    }
+    extractor_.GetIvectorDistributionBatch(const_utt_stats, &ivectors_, NULL);
+    for (int32 n = 0; n < num_utts; n++) {
+      if (tot_auxf_change_ != NULL)
+        auxf_change_[n] += extractor_.GetAuxf(*(utt_stats[n]),
+                                              ivectors_.Row(n));
+      delete utt_stats[n];
     }
   }
   ~IvectorExtractTask() {
-    if (tot_auxf_change_ != NULL) {
-      int32 T = posterior_.size();
-      *tot_auxf_change_ += auxf_change_;
-      KALDI_VLOG(2) << "Auxf change for utterance " << utt_ << " was "
-                    << (auxf_change_ / T) << " per frame over " << T
-                    << " frames.";
+    for (size_t n = 0; n < utts_.size(); n++) {
+      if (tot_auxf_change_ != NULL) {
+        int32 T = posteriors_[n].size();
+        *tot_auxf_change_ += auxf_change_[n];
+        KALDI_VLOG(2) << "Auxf change for utterance " << utts_[n] << " was "
+                      << (auxf_change_[n] / T) << " per frame over " << T
+                      << " frames.";
+      }
+      // We actually write out the offset of the iVector's from the mean of the
+      // prior distribution; this is the form we'll need it in for scoring.
+      // (most formulations of iVectors have zero-mean priors so this is not
+      // normally an issue).
+      SubVector<double> ivector(ivectors_, n);
+      ivector(0) -= extractor_.PriorOffset();
+      KALDI_VLOG(2) << "Ivector norm for utterance " << utts_[n]
+                    << " was " << ivector.Norm(2.0);
+      writer_->Write(utts_[n], Vector<BaseFloat>(ivector));
     }
-    // We actually write out the offset of the iVector's from the mean of the
-    // prior distribution; this is the form we'll need it in for scoring.  (most
-    // formulations of iVectors have zero-mean priors so this is not normally an
-    // issue).
-    ivector_(0) -= extractor_.PriorOffset();
-    KALDI_VLOG(2) << "Ivector norm for utterance " << utt_
-                  << " was " << ivector_.Norm(2.0);
-    writer_->Write(utt_, Vector<BaseFloat>(ivector_));
   }
  private:
   const IvectorExtractor &extractor_;
-  std::string utt_;
-  Matrix<BaseFloat> feats_;
-  Posterior posterior_;
+  std::vector<std::string> utts_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  std::vector<Posterior> posteriors_;
   BaseFloatVectorWriter *writer_;
   double *tot_auxf_change_; // if non-NULL we need the auxf change.
-  Vector<double> ivector_;
-  double auxf_change_;
+  Matrix<double> ivectors_;
+  std::vector<double> auxf_change_;
 };
 
 
@@ -112,10 +136,14 @@ int main(int argc, char *argv[]) {
     bool compute_objf_change = true;
     IvectorStatsOptions stats_opts;
     TaskSequencerConfig sequencer_config;
+    int32 batch_size = 1;
     po.Register("compute-objf-change", &compute_objf_change,
                 "If true, compute the change in objective function from using "
                 "nonzero iVector (a potentially useful diagnostic).  Combine "
                 "with --verbose=2 for per-utterance information");
+    po.Register("batch-size", &batch_size, "Number of utterances to process "
+                "together in each thread; larger values make more use of "
+                "matrix-matrix operations, at the cost of more memory.");
     stats_opts.Register(&po);
     sequencer_config.Register(&po);
     
@@ -125,6 +153,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (batch_size <= 0)
+      KALDI_ERR << "Invalid --batch-size " << batch_size;
 
     std::string ivector_extractor_rxfilename = po.GetArg(1),
         feature_rspecifier = po.GetArg(2),
@@ -147,6 +177,7 @@ int main(int argc, char *argv[]) {
 
     {
       TaskSequencer<IvectorExtractTask> sequencer(sequencer_config);
+      IvectorExtractTask *task = NULL; // the batch we're currently adding to.
       for (; !feature_reader.Done(); feature_reader.Next()) {
         std::string key = feature_reader.Key();
         if (!posteriors_reader.HasKey(key)) {
@@ -165,14 +196,21 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        double *auxf_ptr = (compute_objf_change ? &tot_auxf_change : NULL );
-
-        sequencer.Run(new IvectorExtractTask(extractor, key, mat, posterior,
-                                             &ivector_writer, auxf_ptr));
+        if (task == NULL) {
+          double *auxf_ptr = (compute_objf_change ? &tot_auxf_change : NULL );
+          task = new IvectorExtractTask(extractor, &ivector_writer, auxf_ptr);
+        }
+        task->AddUtterance(key, mat, posterior);
+        if (task->NumUtterances() == batch_size) {
+          sequencer.Run(task);
+          task = NULL;
+        }
                       
         tot_t += posterior.size();
         num_done++;
       }
+      if (task != NULL)
+        sequencer.Run(task);
       // Destructor of "sequencer" will wait for any remaining tasks.
     }
 
@@ -23,6 +23,63 @@
 #include "fstext/fstext-utils.h"
 #include "lat/kaldi-kws.h"
 #include "lat/kws-functions.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class KwsIndexUnionTask {
+ public:
+  // Initializer takes ownership of "index", which is the union of the indices
+  // in one shard.  The writer is only accessed from the destructor, which
+  // TaskSequencer runs sequentially and in order.
+  KwsIndexUnionTask(const std::string &key,
+                    bool skip_opt,
+                    int32 max_states,
+                    KwsLexicographicFst *index,
+                    TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> >
+                    *index_writer):
+      key_(key), skip_opt_(skip_opt), max_states_(max_states), index_(index),
+      index_writer_(index_writer) { }
+
+  void operator () () {
+    using namespace fst;
+    if (skip_opt_ == false) {
+      // Do the encoded epsilon removal, determinization and minimization
+      KwsLexicographicFst ifst = *index_;
+      EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
+      Encode(&ifst, &encoder);
+      try {
+        DeterminizeStar(ifst, index_, kDelta, NULL, max_states_);
+      } catch(const std::exception &e) {
+        KALDI_WARN << e.what()
+                   << " (should affect speed of search but not results)";
+        *index_ = ifst;
+      }
+      Minimize(index_);
+      Decode(index_, encoder);
+    }
+  }
+
+  ~KwsIndexUnionTask() {
+    index_writer_->Write(key_, *index_);
+    delete index_;
+  }
+ private:
+  std::string key_;
+  bool skip_opt_;
+  int32 max_states_;
+  KwsLexicographicFst *index_;  // owned locally.
+  TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > *index_writer_;
+};
+
+// Returns the key of the n'th index shard (numbered from 1).
+static std::string ShardKey(int32 n) {
+  std::ostringstream os;
+  os << "global-" << n;
+  return os.str();
+}
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -36,6 +93,12 @@ int main(int argc, char *argv[]) {
         "the output index is also in the T*T*T semiring. At the end of this program, encoded\n"
         "epsilon removal, determinization and minimization will be applied.\n"
         "\n"
+        "By default the output has a single entry, with key \"global\".  With\n"
+        "--shard-size=N, every N input indices are combined into a separate shard\n"
+        "with keys global-1, global-2 and so on; kws-search processes the shards\n"
+        "one at a time, so the memory needed by both programs is bounded by the\n"
+        "shard size.\n"
+        "\n"
         "Usage: kws-index-union [options]  index-rspecifier index-wspecifier\n"
         " e.g.: kws-index-union ark:input.idx ark:global.idx\n";
 
@@ -44,9 +107,15 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     bool skip_opt = false;
     int32 max_states = -1;
+    int32 shard_size = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     po.Register("strict", &strict, "Will allow 0 lattice if it is set to false.");
     po.Register("skip-optimization", &skip_opt, "Skip optimization if it's set to true.");
     po.Register("max-states", &max_states, "Maximum states for DeterminizeStar.");
+    po.Register("shard-size", &shard_size, "If positive, number of input indices "
+                "combined into each output shard; otherwise all are combined "
+                "into one index.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -61,39 +130,52 @@ int main(int argc, char *argv[]) {
     SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
     TableWriter< VectorFstTplHolder<KwsLexicographicArc> > index_writer(index_wspecifier);
 
-    int32 n_done = 0;
-    KwsLexicographicFst global_index;
-    for (; !index_reader.Done(); index_reader.Next()) {
-      std::string key = index_reader.Key();
-      KwsLexicographicFst index = index_reader.Value();
-      index_reader.FreeCurrent();
-
-      Union(&global_index, index);
-
-      n_done++;
-    }
+    int32 n_done = 0, n_shards = 0;
+    {
+      // The shards are optimized in parallel, in the order they are completed.
+      TaskSequencer<KwsIndexUnionTask> sequencer(sequencer_config);
+      KwsLexicographicFst *shard_index = new KwsLexicographicFst();
+      int32 shard_count = 0;  // number of indices in shard_index.
+      for (; !index_reader.Done(); index_reader.Next()) {
+        std::string key = index_reader.Key();
+        KwsLexicographicFst index = index_reader.Value();
+        index_reader.FreeCurrent();
+
+        Union(shard_index, index);
+        shard_count++;
+        n_done++;
+
+        if (shard_size > 0 && shard_count == shard_size) {
+          n_shards++;
+          sequencer.Run(new KwsIndexUnionTask(ShardKey(n_shards),
+                                              skip_opt, max_states, shard_index,
+                                              &index_writer));
+          shard_index = new KwsLexicographicFst();
+          shard_count = 0;
+        }
+      }
 
-    if (skip_opt == false) {
-      // Do the encoded epsilon removal, determinization and minimization
-      KwsLexicographicFst ifst = global_index;
-      EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
-      Encode(&ifst, &encoder);
-      try {
-        DeterminizeStar(ifst, &global_index, kDelta, NULL, max_states);
-      } catch(const std::exception &e) {
-        KALDI_WARN << e.what()
-                   << " (should affect speed of search but not results)";
-        global_index = ifst;
+      if (skip_opt)
+        KALDI_LOG << "Skipping index optimization...";
+
+      if (shard_size <= 0) {
+        // Write the result
+        n_shards++;
+        sequencer.Run(new KwsIndexUnionTask("global", skip_opt, max_states,
+                                            shard_index, &index_writer));
+      } else if (shard_count > 0) {
+        n_shards++;
+        sequencer.Run(new KwsIndexUnionTask(ShardKey(n_shards),
+                                            skip_opt, max_states, shard_index,
+                                            &index_writer));
+      } else {
+        delete shard_index;
       }
-      Minimize(&global_index);
-      Decode(&global_index, encoder);
-    } else {
-      KALDI_LOG << "Skipping index optimization...";
+      sequencer.Wait();
     }
 
-    // Write the result
-    index_writer.Write("global", global_index);
-
+    if (shard_size > 0)
+      KALDI_LOG << "Wrote " << n_shards << " index shards.";
     KALDI_LOG << "Done " << n_done << " indices";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
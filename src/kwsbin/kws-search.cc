@@ -84,7 +84,10 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Search the keywords over the index. This program can be executed parallely, either\n"
         "on the index side or the keywords side; we use a script to combine the final search\n"
-        "results. Note that the index archive has a only key \"global\".\n"
+        "results. The index archive normally has only the key \"global\"; if it\n"
+        "has several entries (e.g. shards written by kws-index-union --shard-size),\n"
+        "each is searched in turn, reading one at a time; the hits for each keyword\n"
+        "from all of them are merged before --nbest is applied.\n"
         "The output file is in the format:\n"
         "kw utterance_id beg_frame end_frame negated_log_probs\n"
         " e.g.: KW1 1 23 67 0.6074219\n"
@@ -134,51 +137,14 @@ int main(int argc, char *argv[]) {
         keyword_rspecifier = po.GetOptArg(2),
         result_wspecifier = po.GetOptArg(3);
 
-    RandomAccessTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
+    SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
     SequentialTableReader<VectorFstHolder> keyword_reader(keyword_rspecifier);
     TableWriter< BasicVectorHolder<double> > result_writer(result_wspecifier);
 
-    // Index has key "global"
-    KwsLexicographicFst index = index_reader.Value("global");
-    
-    // First we have to remove the disambiguation symbols. But rather than
-    // removing them totally, we actually move them from input side to output
-    // side, making the output symbol a "combined" symbol of the disambiguation
-    // symbols and the utterance id's.
-    // Note that in Dogan and Murat's original paper, they simply remove the
-    // disambiguation symbol on the input symbol side, which will not allow us
-    // to do epsilon removal after composition with the keyword FST. They have
-    // to traverse the resulting FST.
-    int32 label_count = 1;
-    std::tr1::unordered_map<uint64, uint32> label_encoder;
-    std::tr1::unordered_map<uint32, uint64> label_decoder;
-    for (StateIterator<KwsLexicographicFst> siter(index); !siter.Done(); siter.Next()) {
-      StateId state_id = siter.Value();
-      for (MutableArcIterator<KwsLexicographicFst> 
-           aiter(&index, state_id); !aiter.Done(); aiter.Next()) {
-        Arc arc = aiter.Value();
-        // Skip the non-final arcs
-        if (index.Final(arc.nextstate) == Weight::Zero())
-          continue;
-        // Encode the input and output label of the final arc, and this is the
-        // new output label for this arc; set the input label to <epsilon>
-        uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
-        arc.ilabel = 0;
-        if (label_encoder.find(osymbol) == label_encoder.end()) {
-          arc.olabel = label_count;
-          label_encoder[osymbol] = label_count;
-          label_decoder[label_count] = osymbol;
-          label_count++;
-        } else { 
-          arc.olabel = label_encoder[osymbol];
-        }
-        aiter.SetValue(arc);
-      }
-    }
-    ArcSort(&index, fst::ILabelCompare<KwsLexicographicArc>());
-    
-    int32 n_done = 0;
-    int32 n_fail = 0;
+    // The keywords are read into memory so that they can be searched for in
+    // each index shard; they are small compared with the index.
+    std::vector<std::string> keyword_keys;
+    std::vector<KwsLexicographicFst*> keyword_fsts;
     for (; !keyword_reader.Done(); keyword_reader.Next()) {
       std::string key = keyword_reader.Key();
       VectorFst<StdArc> keyword = keyword_reader.Value();
@@ -194,56 +160,125 @@ int main(int argc, char *argv[]) {
         keyword = tmp;
       }
 
-      KwsLexicographicFst keyword_fst;
-      KwsLexicographicFst result_fst;
-      Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
-      Compose(keyword_fst, index, &result_fst);
-      Project(&result_fst, PROJECT_OUTPUT);
-      Minimize(&result_fst);
-      ShortestPath(result_fst, &result_fst, n_best);
-      RmEpsilon(&result_fst);
-
-      // No result found
-      if (result_fst.Start() == kNoStateId)
-        continue;
-
-      // Got something here
-      double score;
-      int32 tbeg, tend, uid;
-      for (ArcIterator<KwsLexicographicFst> 
-           aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
-        const Arc &arc = aiter.Value();
-
-        // We're expecting a two-state FST
-        if (result_fst.Final(arc.nextstate) != Weight::One()) {
-          KALDI_WARN << "The resulting FST does not have the expected structure for key " << key;
-          n_fail++;
-          continue;
+      KwsLexicographicFst *keyword_fst = new KwsLexicographicFst();
+      Map(keyword, keyword_fst, VectorFstToKwsLexicographicFstMapper());
+      keyword_keys.push_back(key);
+      keyword_fsts.push_back(keyword_fst);
+    }
+
+    int32 n_done = 0;
+    int32 n_fail = 0;
+    int32 n_shards = 0;
+    // The hits for each keyword, as (score, result), collected over all the
+    // index shards so that each keyword is written once with its n-best.
+    std::vector<std::vector<std::pair<double, std::vector<double> > > >
+        keyword_hits(keyword_fsts.size());
+    for (; !index_reader.Done(); index_reader.Next()) {
+      KwsLexicographicFst index = index_reader.Value();
+      index_reader.FreeCurrent();
+      n_shards++;
+    
+      // First we have to remove the disambiguation symbols. But rather than
+      // removing them totally, we actually move them from input side to output
+      // side, making the output symbol a "combined" symbol of the disambiguation
+      // symbols and the utterance id's.
+      // Note that in Dogan and Murat's original paper, they simply remove the
+      // disambiguation symbol on the input symbol side, which will not allow us
+      // to do epsilon removal after composition with the keyword FST. They have
+      // to traverse the resulting FST.
+      int32 label_count = 1;
+      std::tr1::unordered_map<uint64, uint32> label_encoder;
+      std::tr1::unordered_map<uint32, uint64> label_decoder;
+      for (StateIterator<KwsLexicographicFst> siter(index); !siter.Done(); siter.Next()) {
+        StateId state_id = siter.Value();
+        for (MutableArcIterator<KwsLexicographicFst> 
+             aiter(&index, state_id); !aiter.Done(); aiter.Next()) {
+          Arc arc = aiter.Value();
+          // Skip the non-final arcs
+          if (index.Final(arc.nextstate) == Weight::Zero())
+            continue;
+          // Encode the input and output label of the final arc, and this is the
+          // new output label for this arc; set the input label to <epsilon>
+          uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
+          arc.ilabel = 0;
+          if (label_encoder.find(osymbol) == label_encoder.end()) {
+            arc.olabel = label_count;
+            label_encoder[osymbol] = label_count;
+            label_decoder[label_count] = osymbol;
+            label_count++;
+          } else { 
+            arc.olabel = label_encoder[osymbol];
+          }
+          aiter.SetValue(arc);
         }
+      }
+      ArcSort(&index, fst::ILabelCompare<KwsLexicographicArc>());
+    
+      for (size_t k = 0; k < keyword_fsts.size(); k++) {
+        const std::string &key = keyword_keys[k];
+        KwsLexicographicFst result_fst;
+        Compose(*(keyword_fsts[k]), index, &result_fst);
+        Project(&result_fst, PROJECT_OUTPUT);
+        Minimize(&result_fst);
+        ShortestPath(result_fst, &result_fst, n_best);
+        RmEpsilon(&result_fst);
+
+        // No result found
+        if (result_fst.Start() == kNoStateId)
+          continue;
 
-        uint64 osymbol = label_decoder[arc.olabel];
-        uid = (int32)DecodeLabelUid(osymbol);
-        tbeg = arc.weight.Value2().Value1().Value();
-        tend = arc.weight.Value2().Value2().Value();
-        score = arc.weight.Value1().Value();
+        // Got something here
+        double score;
+        int32 tbeg, tend, uid;
+        for (ArcIterator<KwsLexicographicFst> 
+             aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
+          const Arc &arc = aiter.Value();
+
+          // We're expecting a two-state FST
+          if (result_fst.Final(arc.nextstate) != Weight::One()) {
+            KALDI_WARN << "The resulting FST does not have the expected structure for key " << key;
+            n_fail++;
+            continue;
+          }
 
-        if (score < 0) {
-          if (score < negative_tolerance) {
-            KALDI_WARN << "Score out of expected range: " << score;
+          uint64 osymbol = label_decoder[arc.olabel];
+          uid = (int32)DecodeLabelUid(osymbol);
+          tbeg = arc.weight.Value2().Value1().Value();
+          tend = arc.weight.Value2().Value2().Value();
+          score = arc.weight.Value1().Value();
+
+          if (score < 0) {
+            if (score < negative_tolerance) {
+              KALDI_WARN << "Score out of expected range: " << score;
+            }
+            score = 0.0;
           }
-          score = 0.0;
+          vector<double> result;
+          result.push_back(uid);
+          result.push_back(tbeg);
+          result.push_back(tend);
+          result.push_back(score);
+          keyword_hits[k].push_back(std::make_pair(score, result));
         }
-        vector<double> result;
-        result.push_back(uid);
-        result.push_back(tbeg);
-        result.push_back(tend);
-        result.push_back(score);
-        result_writer.Write(key, result);
       }
+    }
+    DeletePointers(&keyword_fsts);
 
+    for (size_t k = 0; k < keyword_hits.size(); k++) {
+      std::vector<std::pair<double, std::vector<double> > > &hits =
+          keyword_hits[k];
+      if (hits.empty()) continue;
       n_done++;
+      // Each shard kept its own n-best; keep the best n over all of them.
+      std::sort(hits.begin(), hits.end());
+      if (n_best != -1 && hits.size() > static_cast<size_t>(n_best))
+        hits.resize(n_best);
+      for (size_t i = 0; i < hits.size(); i++)
+        result_writer.Write(keyword_keys[k], hits[i].second);
     }
 
+    if (n_shards > 1)
+      KALDI_LOG << "Searched " << n_shards << " index shards.";
     KALDI_LOG << "Done " << n_done << " keywords";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
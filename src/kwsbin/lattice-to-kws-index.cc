@@ -27,6 +27,163 @@
 #include "lat/kaldi-kws.h"
 #include "lat/kws-functions.h"
 #include "fstext/epsilon-property.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class LatticeToKwsIndexTask {
+ public:
+  // Initializer takes ownership of "clat".  The writer and counters are only
+  // accessed from the destructor, which TaskSequencer runs sequentially and in
+  // order.
+  LatticeToKwsIndexTask(const std::string &key,
+                        int32 utterance_id,
+                        int32 max_silence_frames,
+                        BaseFloat max_states_scale,
+                        bool allow_partial,
+                        CompactLattice *clat,
+                        TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> >
+                        *index_writer,
+                        int32 *n_done, int32 *n_fail):
+      key_(key), utterance_id_(utterance_id),
+      max_silence_frames_(max_silence_frames),
+      max_states_scale_(max_states_scale), allow_partial_(allow_partial),
+      clat_(clat), success_(false), factor_failed_(false),
+      index_writer_(index_writer),
+      n_done_(n_done), n_fail_(n_fail) { }
+
+  void operator () () {
+    success_ = CreateIndex();
+    delete clat_;  // No longer needed.
+    clat_ = NULL;
+  }
+
+  ~LatticeToKwsIndexTask() {
+    if (factor_failed_) (*n_fail_)++;
+    if (success_) {
+      index_writer_->Write(key_, index_transducer_);
+      (*n_done_)++;
+    } else {
+      (*n_fail_)++;
+    }
+  }
+ private:
+  // Does the work for one lattice, returning false on failure.
+  bool CreateIndex() {
+    CompactLattice &clat = *clat_;
+    int32 max_states = -1;
+    if (max_states_scale_ > 0) {
+      max_states = static_cast<int32>(
+          max_states_scale_ * static_cast<BaseFloat>(clat.NumStates()));
+    }
+
+    // Topologically sort the lattice, if not already sorted.
+    uint64 props = clat.Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(&clat) == false) {
+        KALDI_WARN << "Cycles detected in lattice " << key_;
+        return false;
+      }
+    }
+
+    // Get the alignments
+    std::vector<int32> state_times;
+    CompactLatticeStateTimes(clat, &state_times);
+
+    // Cluster the arcs in the CompactLattice, write the cluster_id on the
+    // output label side.
+    // ClusterLattice() corresponds to the second part of the preprocessing in
+    // Dogan and Murat's paper -- clustering. Note that we do the first part
+    // of preprocessing (the weight pushing step) later when generating the
+    // factor transducer.
+    KALDI_VLOG(1) << "Arc clustering...";
+    bool success = false;
+    success = ClusterLattice(&clat, state_times);
+    if (!success) {
+      KALDI_WARN << "State id's and alignments do not match for lattice "
+                 << key_;
+      return false;
+    }
+
+    // The next part is something new, not in the Dogan and Can paper.  It is
+    // necessary because we have epsilon arcs, due to silences, in our
+    // lattices.  We modify the factor transducer, while maintaining
+    // equivalence, to ensure that states don't have both epsilon *and*
+    // non-epsilon arcs entering them.  (and the same, with "entering"
+    // replaced with "leaving").  Later we will find out which states have
+    // non-epsilon arcs leaving/entering them and use it to be more selective
+    // in adding arcs to connect them with the initial/final states.  The goal
+    // here is to disallow silences at the beginning or ending of a keyword
+    // occurrence.
+    if (true) {
+      EnsureEpsilonProperty(&clat);
+      fst::TopSort(&clat);
+      // We have to recompute the state times because they will have changed.
+      CompactLatticeStateTimes(clat, &state_times);
+    }
+
+    // Generate factor transducer
+    // CreateFactorTransducer() corresponds to the "Factor Generation" part of
+    // Dogan and Murat's paper. But we also move the weight pushing step to
+    // this function as we have to compute the alphas and betas anyway.
+    KALDI_VLOG(1) << "Generating factor transducer...";
+    KwsProductFst factor_transducer;
+    success = CreateFactorTransducer(clat, state_times, utterance_id_,
+                                     &factor_transducer);
+    if (!success) {
+      KALDI_WARN << "Cannot generate factor transducer for lattice " << key_;
+      factor_failed_ = true;  // counted as a failure, but we still write
+                              // the index.
+    }
+
+    MaybeDoSanityCheck(factor_transducer);
+
+    // Remove long silence arc
+    // We add the filtering step in our implementation. This is because gap
+    // between two successive words in a query term should be less than 0.5s
+    KALDI_VLOG(1) << "Removing long silence...";
+    RemoveLongSilences(max_silence_frames_, state_times, &factor_transducer);
+
+    MaybeDoSanityCheck(factor_transducer);
+
+    // Do factor merging, and return a transducer in T*T*T semiring. This step
+    // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
+    KALDI_VLOG(1) << "Merging factors...";
+    DoFactorMerging(&factor_transducer, &index_transducer_);
+
+    MaybeDoSanityCheck(index_transducer_);
+
+    // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
+    // step in Dogan and Murat's paper.
+    KALDI_VLOG(1) << "Doing factor disambiguation...";
+    DoFactorDisambiguation(&index_transducer_);
+
+    MaybeDoSanityCheck(index_transducer_);
+
+    // Optimize the above factor transducer. It corresponds to the
+    // "Optimization" step in the paper.
+    KALDI_VLOG(1) << "Optimizing factor transducer...";
+    OptimizeFactorTransducer(&index_transducer_, max_states, allow_partial_);
+
+    MaybeDoSanityCheck(index_transducer_);
+    return true;
+  }
+
+  std::string key_;
+  int32 utterance_id_;
+  int32 max_silence_frames_;
+  BaseFloat max_states_scale_;
+  bool allow_partial_;
+  CompactLattice *clat_;  // The input lattice; owned locally.
+  bool success_;
+  bool factor_failed_;
+  KwsLexicographicFst index_transducer_;  // The output.
+  TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > *index_writer_;
+  int32 *n_done_;
+  int32 *n_fail_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -49,6 +206,7 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     bool allow_partial = true;
     BaseFloat max_states_scale = 4;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     po.Register("max-silence-frames", &max_silence_frames, "Maximum #frames for"
                 " silence arc.");
     po.Register("strict", &strict, "Setting --strict=false will cause successful "
@@ -59,6 +217,7 @@ int main(int argc, char *argv[]) {
                 "limit on the number of states.");
     po.Register("allow-partial", &allow_partial, "Allow partial output if fails"
                 " to determinize, otherwise skip determinization if it fails.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -82,121 +241,30 @@ int main(int argc, char *argv[]) {
     int32 n_done = 0;
     int32 n_fail = 0;
 
-    int32 max_states = -1;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      KALDI_LOG << "Processing lattice " << key;
-
-      if (max_states_scale > 0) {
-        max_states = static_cast<int32>(
-            max_states_scale * static_cast<BaseFloat>(clat.NumStates()));
-      }
-
-      // Check if we have the corresponding utterance id.
-      if (!usymtab_reader.HasKey(key)) {
-        KALDI_WARN << "Cannot find utterance id for " << key;
-        n_fail++;
-        continue;
-      }
+    {
+      TaskSequencer<LatticeToKwsIndexTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        KALDI_LOG << "Processing lattice " << key;
 
-      // Topologically sort the lattice, if not already sorted.
-      uint64 props = clat.Properties(fst::kFstProperties, false);
-      if (!(props & fst::kTopSorted)) {
-        if (fst::TopSort(&clat) == false) {
-          KALDI_WARN << "Cycles detected in lattice " << key;
+        // Check if we have the corresponding utterance id.
+        if (!usymtab_reader.HasKey(key)) {
+          KALDI_WARN << "Cannot find utterance id for " << key;
           n_fail++;
           continue;
         }
-      } 
-
-      // Get the alignments
-      vector<int32> state_times;
-      CompactLatticeStateTimes(clat, &state_times);
-
-      // Cluster the arcs in the CompactLattice, write the cluster_id on the
-      // output label side.
-      // ClusterLattice() corresponds to the second part of the preprocessing in
-      // Dogan and Murat's paper -- clustering. Note that we do the first part
-      // of preprocessing (the weight pushing step) later when generating the
-      // factor transducer.
-      KALDI_VLOG(1) << "Arc clustering...";
-      bool success = false;
-      success = ClusterLattice(&clat, state_times);
-      if (!success) {
-        KALDI_WARN << "State id's and alignments do not match for lattice " << key;
-        n_fail++;
-        continue;
+        int32 utterance_id = usymtab_reader.Value(key);
+
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LatticeToKwsIndexTask(key, utterance_id,
+                                                max_silence_frames,
+                                                max_states_scale,
+                                                allow_partial, clat,
+                                                &index_writer,
+                                                &n_done, &n_fail));
       }
-
-      // The next part is something new, not in the Dogan and Can paper.  It is
-      // necessary because we have epsilon arcs, due to silences, in our
-      // lattices.  We modify the factor transducer, while maintaining
-      // equivalence, to ensure that states don't have both epsilon *and*
-      // non-epsilon arcs entering them.  (and the same, with "entering"
-      // replaced with "leaving").  Later we will find out which states have
-      // non-epsilon arcs leaving/entering them and use it to be more selective
-      // in adding arcs to connect them with the initial/final states.  The goal
-      // here is to disallow silences at the beginning or ending of a keyword
-      // occurrence.
-      if (true) {
-        EnsureEpsilonProperty(&clat);
-        fst::TopSort(&clat);
-        // We have to recompute the state times because they will have changed.
-        CompactLatticeStateTimes(clat, &state_times);        
-      }
-      
-      // Generate factor transducer
-      // CreateFactorTransducer() corresponds to the "Factor Generation" part of
-      // Dogan and Murat's paper. But we also move the weight pushing step to
-      // this function as we have to compute the alphas and betas anyway.
-      KALDI_VLOG(1) << "Generating factor transducer...";
-      KwsProductFst factor_transducer;
-      int32 utterance_id = usymtab_reader.Value(key);
-      success = CreateFactorTransducer(clat, state_times, utterance_id, &factor_transducer);
-      if (!success) {
-        KALDI_WARN << "Cannot generate factor transducer for lattice " << key;
-        n_fail++; 
-      }
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Remove long silence arc
-      // We add the filtering step in our implementation. This is because gap
-      // between two successive words in a query term should be less than 0.5s
-      KALDI_VLOG(1) << "Removing long silence...";
-      RemoveLongSilences(max_silence_frames, state_times, &factor_transducer);
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Do factor merging, and return a transducer in T*T*T semiring. This step
-      // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Merging factors...";
-      KwsLexicographicFst index_transducer;
-      DoFactorMerging(&factor_transducer, &index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-      
-      // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
-      // step in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Doing factor disambiguation...";
-      DoFactorDisambiguation(&index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-
-      // Optimize the above factor transducer. It corresponds to the
-      // "Optimization" step in the paper.
-      KALDI_VLOG(1) << "Optimizing factor transducer...";
-      OptimizeFactorTransducer(&index_transducer, max_states, allow_partial);
-
-      MaybeDoSanityCheck(index_transducer);      
-      
-      // Write result
-      index_writer.Write(key, index_transducer);  
-
-      n_done++;
+      sequencer.Wait();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
@@ -97,31 +97,35 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
   alpha_dash(1, 0) = 0.0; // Line 5.
   for (int32 q = 1; q <= Q; q++) 
     alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q)); // Line 7.
+  double *alpha_dash_arc_data = alpha_dash_arc.Data();
   for (int32 n = 2; n <= N; n++) {
     double alpha_n = kLogZeroDouble;
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++) {
+      const Arc &arc = arcs_[i];
       alpha_n = LogAdd(alpha_n, alpha(arc.start_node) + arc.loglike);
     }
     alpha(n) = alpha_n; // Line 10.
     // Line 11 omitted: matrix was initialized to zero.
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
+    double *alpha_dash_n = alpha_dash.RowData(n);
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++) {
+      const Arc &arc = arcs_[i];
       int32 s_a = arc.start_node, w_a = arc.word;
       BaseFloat p_a = arc.loglike;
-      for (int32 q = 0; q <= Q; q++) {
-        if (q == 0) {
-          alpha_dash_arc(q) = // line 15.
-              alpha_dash(s_a, q) + l(w_a, 0) + delta();
-        } else {  // a1,a2,a3 are the 3 parts of min expression of line 17.
-          int32 r_q = r(q);
-          double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-              a2 = alpha_dash(s_a, q) + l(w_a, 0) + delta(),
-              a3 = alpha_dash_arc(q-1) + l(0, r_q);
-          alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
-        }
+      const double *alpha_dash_s = alpha_dash.RowData(s_a);
+      // The arc posterior, which doesn't depend on q.
+      double arc_post = exp(alpha(s_a) + p_a - alpha(n));
+      alpha_dash_arc_data[0] = // line 15.
+          alpha_dash_s[0] + l(w_a, 0) + delta();
+      alpha_dash_n[0] += arc_post * alpha_dash_arc_data[0]; // line 19.
+      for (int32 q = 1; q <= Q; q++) {
+        // a1,a2,a3 are the 3 parts of min expression of line 17.
+        int32 r_q = r(q);
+        double a1 = alpha_dash_s[q-1] + l(w_a, r_q),
+            a2 = alpha_dash_s[q] + l(w_a, 0) + delta(),
+            a3 = alpha_dash_arc_data[q-1] + l(0, r_q);
+        alpha_dash_arc_data[q] = std::min(a1, std::min(a2, a3));
         // line 19:
-        alpha_dash(n, q) += exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
+        alpha_dash_n[q] += arc_post * alpha_dash_arc_data[q];
       }
     }
   }
@@ -130,9 +134,7 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
 
 // Figure 5 in the paper.
 void MinimumBayesRisk::AccStats() {
-  using std::map;
-  
-  int32 N = static_cast<int32>(pre_.size()) - 1,
+  int32 N = static_cast<int32>(pre_.size()) - 2,
       Q = static_cast<int32>(R_.size());
 
   Vector<double> alpha(N+1); // index (1...N)
@@ -141,8 +143,9 @@ void MinimumBayesRisk::AccStats() {
   Matrix<double> beta_dash(N+1, Q+1); // index (1...N, 0...Q)
   Vector<double> beta_dash_arc(Q+1); // index 0...Q
   vector<char> b_arc(Q+1); // integer in {1,2,3}; index 1...Q
-  vector<map<int32, double> > gamma(Q+1); // temp. form of gamma.
-  // index 1...Q [word] -> occ.
+  // temp. form of gamma: index 1...Q, list of (word-index, occ) pairs (see
+  // words_ and AddToGamma()).
+  std::vector<std::vector<std::pair<int32, double> > > gamma(Q+1);
 
   // The tau arrays below are the sums over words of the tau_b
   // and tau_e timing quantities mentioned in Appendix C of
@@ -159,65 +162,72 @@ void MinimumBayesRisk::AccStats() {
   KALDI_VLOG(2) << "L = " << L_;
   // omit line 10: zero when initialized.
   beta_dash(N, Q) = 1.0; // Line 11.
+  double *alpha_dash_arc_data = alpha_dash_arc.Data(),
+      *beta_dash_arc_data = beta_dash_arc.Data();
   for (int32 n = N; n >= 2; n--) {
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      int32 s_a = arc.start_node, w_a = arc.word;
+    const double *beta_dash_n = beta_dash.RowData(n);
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++) {
+      const Arc &arc = arcs_[i];
+      int32 s_a = arc.start_node, w_a = arc.word, w_a_index = arc.word_index;
       BaseFloat p_a = arc.loglike;
-      alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0) + delta(); // line 14.
+      const double *alpha_dash_s = alpha_dash.RowData(s_a);
+      double *beta_dash_s = beta_dash.RowData(s_a);
+      // The arc posterior, which doesn't depend on q.
+      double arc_post = exp(alpha(s_a) + p_a - alpha(n));
+      alpha_dash_arc_data[0] = alpha_dash_s[0] + l(w_a, 0) + delta(); // line 14.
       for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
         int32 r_q = r(q);
-        double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-            a2 = alpha_dash(s_a, q) + l(w_a, 0) + delta(),
-            a3 = alpha_dash_arc(q-1) + l(0, r_q);
+        double a1 = alpha_dash_s[q-1] + l(w_a, r_q),
+            a2 = alpha_dash_s[q] + l(w_a, 0) + delta(),
+            a3 = alpha_dash_arc_data[q-1] + l(0, r_q);
         if (a1 <= a2) {
-          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc(q) = a1; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc_data[q] = a1; }
+          else { b_arc[q] = 3; alpha_dash_arc_data[q] = a3; }
         } else {
-          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc(q) = a2; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc_data[q] = a2; }
+          else { b_arc[q] = 3; alpha_dash_arc_data[q] = a3; }
         }
       }
       beta_dash_arc.SetZero(); // line 19.
       for (int32 q = Q; q >= 1; q--) {
         // line 21:
-        beta_dash_arc(q) += exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
+        beta_dash_arc_data[q] += arc_post * beta_dash_n[q];
         switch (static_cast<int>(b_arc[q])) { // lines 22 and 23:
           case 1:
-            beta_dash(s_a, q-1) += beta_dash_arc(q);
+            beta_dash_s[q-1] += beta_dash_arc_data[q];
             // next: gamma(q, w(a)) += beta_dash_arc(q)
-            AddToMap(w_a, beta_dash_arc(q), &(gamma[q]));
+            AddToGamma(w_a_index, beta_dash_arc_data[q], &(gamma[q]));
             // next: accumulating times, see decl for tau_b,tau_e
-            tau_b(q) += state_times_[s_a] * beta_dash_arc(q);
-            tau_e(q) += state_times_[n] * beta_dash_arc(q);
+            tau_b(q) += state_times_[s_a] * beta_dash_arc_data[q];
+            tau_e(q) += state_times_[n] * beta_dash_arc_data[q];
             break;
           case 2:
-            beta_dash(s_a, q) += beta_dash_arc(q);
+            beta_dash_s[q] += beta_dash_arc_data[q];
             break;
           case 3:
-            beta_dash_arc(q-1) += beta_dash_arc(q);
+            beta_dash_arc_data[q-1] += beta_dash_arc_data[q];
             // next: gamma(q, epsilon) += beta_dash_arc(q)
-            AddToMap(0, beta_dash_arc(q), &(gamma[q]));
+            AddToGamma(0, beta_dash_arc_data[q], &(gamma[q]));
             // next: accumulating times, see decl for tau_b,tau_e
             // WARNING: there was an error in Appendix C.  If we followed
             // the instructions there the next line would say state_times_[sa], but
             // it would be wrong.  I will try to publish an erratum.
-            tau_b(q) += state_times_[n] * beta_dash_arc(q);
-            tau_e(q) += state_times_[n] * beta_dash_arc(q);
+            tau_b(q) += state_times_[n] * beta_dash_arc_data[q];
+            tau_e(q) += state_times_[n] * beta_dash_arc_data[q];
             break;
           default:
             KALDI_ERR << "Invalid b_arc value"; // error in code.
         }
       }
-      beta_dash_arc(0) += exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
-      beta_dash(s_a, 0) += beta_dash_arc(0); // line 26.
+      beta_dash_arc_data[0] += arc_post * beta_dash_n[0];
+      beta_dash_s[0] += beta_dash_arc_data[0]; // line 26.
     }
   }
   beta_dash_arc.SetZero(); // line 29.
   for (int32 q = Q; q >= 1; q--) {
     beta_dash_arc(q) += beta_dash(1, q);
     beta_dash_arc(q-1) += beta_dash_arc(q);
-    AddToMap(0, beta_dash_arc(q), &(gamma[q]));
+    AddToGamma(0, beta_dash_arc(q), &(gamma[q]));
     // the statements below are actually redundant because
     // state_times_[1] is zero.
     tau_b(q) += state_times_[1] * beta_dash_arc(q);
@@ -225,8 +235,8 @@ void MinimumBayesRisk::AccStats() {
   }
   for (int32 q = 1; q <= Q; q++) { // a check (line 35)
     double sum = 0.0;
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter) sum += iter->second;
+    for (size_t i = 0; i < gamma[q].size(); i++)
+      sum += gamma[q][i].second;
     if (fabs(sum - 1.0) > 0.1)
       KALDI_WARN << "sum of gamma[" << q << ",s] is " << sum;
   }
@@ -236,9 +246,13 @@ void MinimumBayesRisk::AccStats() {
   gamma_.clear();
   gamma_.resize(Q);
   for (int32 q = 1; q <= Q; q++) {
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter)
-      gamma_[q-1].push_back(std::make_pair(iter->first, static_cast<BaseFloat>(iter->second)));
+    // sort on word-index first, i.e. on the word, so that words with equal
+    // posteriors come out in the same order as they used to.
+    std::sort(gamma[q].begin(), gamma[q].end());
+    for (size_t i = 0; i < gamma[q].size(); i++)
+      gamma_[q-1].push_back(
+          std::make_pair(words_[gamma[q][i].first],
+                         static_cast<BaseFloat>(gamma[q][i].second)));
     // sort gamma_[q-1] from largest to smallest posterior.
     GammaCompare comp;
     std::sort(gamma_[q-1].begin(), gamma_[q-1].end(), comp);
@@ -285,15 +299,17 @@ MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
     state_times_[i] = state_times_[i-1];
   
   // Now we convert the information in "clat" into a special internal
-  // format (pre_, post_ and arcs_) which allows us to access the
-  // arcs preceding any given state.
+  // format (pre_, words_ and arcs_) which allows us to access the
+  // arcs preceding any given state as a contiguous range of arcs_.
   // Note: in our internal format the states will be numbered from 1,
   // which involves adding 1 to the OpenFst states.
   int32 N = clat.NumStates();
-  pre_.resize(N+1);
 
   // Careful: "Arc" is a class-member struct, not an OpenFst type of arc as one
   // would normally assume.
+  std::vector<Arc> arcs; // arcs in the order we see them in clat.
+  std::vector<int32> num_pre(N+2, 0); // number of arcs entering each node.
+  words_.push_back(0); // epsilon is always present.
   for (int32 n = 1; n <= N; n++) {
     for (fst::ArcIterator<CompactLattice> aiter(clat, n-1);
          !aiter.Done();
@@ -301,6 +317,7 @@ MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
       const CompactLatticeArc &carc = aiter.Value();
       Arc arc; // in our local format.
       arc.word = carc.ilabel; // == carc.olabel
+      arc.word_index = -1; // set below.
       arc.start_node = n;
       arc.end_node = carc.nextstate + 1; // convert to 1-based.
       arc.loglike = - (carc.weight.Weight().Value1() +
@@ -308,10 +325,28 @@ MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
       // loglike: sum graph/LM and acoustic cost, and negate to
       // convert to loglikes.  We assume acoustic scaling is already done.
 
-      pre_[arc.end_node].push_back(arcs_.size()); // record index of this arc.
-      arcs_.push_back(arc);
+      num_pre[arc.end_node]++;
+      words_.push_back(arc.word);
+      arcs.push_back(arc);
     }
   }
+  SortAndUniq(&words_);
+  KALDI_ASSERT(words_[0] == 0);
+
+  // Do a stable counting sort of the arcs on end_node, so the arcs entering
+  // each node are contiguous and in the same order as before.
+  pre_.resize(N+2);
+  pre_[0] = pre_[1] = 0;
+  for (int32 n = 1; n <= N; n++)
+    pre_[n+1] = pre_[n] + num_pre[n];
+  arcs_.resize(arcs.size());
+  std::vector<int32> next_pos(pre_);
+  for (size_t i = 0; i < arcs.size(); i++) {
+    Arc &arc = arcs[i];
+    arc.word_index = std::lower_bound(words_.begin(), words_.end(), arc.word)
+        - words_.begin();
+    arcs_[next_pos[arc.end_node]++] = arc;
+  }
 
   // We don't need to look at clat.Start() or clat.Final(state):
   // we know clat.Start() == 0 since it's topologically sorted,
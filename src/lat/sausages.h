@@ -125,17 +125,27 @@ class MinimumBayesRisk {
   static inline BaseFloat delta() { return 1.0e-05; } // A constant
   // used in the algorithm.
 
-  /// Function used to increment map.
-  static inline void AddToMap(int32 i, double d, std::map<int32, double> *gamma) {
+  /// Function used to increment gamma for a particular position q, stored as
+  /// a list of (word-index, occupancy) pairs; "i" is a word-index (see
+  /// words_), not a word.  Only a few words compete for any one position, so
+  /// a linear search (from the end, where the most recent words are) is
+  /// cheaper than a map.  Like the old std::map version, it doesn't create an
+  /// entry for zero increments.
+  static inline void AddToGamma(int32 i, double d,
+                                std::vector<std::pair<int32, double> > *gamma) {
     if (d == 0) return;
-    std::pair<const int32, double> pr(i, d);
-    std::pair<std::map<int32, double>::iterator, bool> ret = gamma->insert(pr);
-    if (!ret.second) // not inserted, so add to contents.
-      ret.first->second += d;
+    for (size_t k = gamma->size(); k > 0; k--) {
+      if ((*gamma)[k-1].first == i) {
+        (*gamma)[k-1].second += d;
+        return;
+      }
+    }
+    gamma->push_back(std::make_pair(i, d));
   }
     
   struct Arc {
     int32 word;
+    int32 word_index; // index of "word" in words_.
     int32 start_node;
     int32 end_node;
     BaseFloat loglike;
@@ -148,12 +158,20 @@ class MinimumBayesRisk {
   
   /// Arcs in the topologically sorted acceptor form of the word-level lattice,
   /// with one final-state.  Contains (word-symbol, log-likelihood on arc ==
-  /// negated cost).  Indexed from zero.
+  /// negated cost).  Indexed from zero.  The arcs are sorted on end_node (and
+  /// otherwise kept in the order we saw them in the lattice), so the arcs
+  /// entering node n are arcs_[pre_[n]] ... arcs_[pre_[n+1] - 1].
   std::vector<Arc> arcs_;
 
-  /// For each node in the lattice, a list of arcs entering that node. Indexed
-  /// from 1 (first node == 1).
-  std::vector<std::vector<int32> > pre_;
+  /// For each node in the lattice, the index into arcs_ of the first arc
+  /// entering that node.  Indexed from 1 (first node == 1); has size N+2, and
+  /// pre_[N+1] == arcs_.size().
+  std::vector<int32> pre_;
+
+  /// The sorted list of distinct words that appear on arcs of the lattice,
+  /// with epsilon (0) always present as words_[0].  AccStats() accumulates
+  /// gamma by index into this list.
+  std::vector<int32> words_;
 
   std::vector<int32> state_times_; // time of each state in the word lattice,
   // indexed from 1 (same index as into pre_)
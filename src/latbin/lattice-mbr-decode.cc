@@ -20,6 +20,71 @@
 #include "util/common-utils.h"
 #include "lat/sausages.h"
 #include "hmm/posterior.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class MbrDecodeTask {
+ public:
+  // Initializer takes ownership of "clat".  The writers are only accessed
+  // from the destructor, which TaskSequencer runs sequentially and in order.
+  MbrDecodeTask(const std::string &key,
+                BaseFloat lm_scale,
+                BaseFloat acoustic_scale,
+                bool one_best_times,
+                CompactLattice *clat,
+                Int32VectorWriter *trans_writer,
+                BaseFloatWriter *bayes_risk_writer,
+                PosteriorWriter *sausage_stats_writer,
+                BaseFloatPairVectorWriter *times_writer,
+                int32 *n_done, int32 *n_words,
+                BaseFloat *tot_bayes_risk):
+      key_(key), lm_scale_(lm_scale), acoustic_scale_(acoustic_scale),
+      one_best_times_(one_best_times), clat_(clat), mbr_(NULL),
+      trans_writer_(trans_writer), bayes_risk_writer_(bayes_risk_writer),
+      sausage_stats_writer_(sausage_stats_writer),
+      times_writer_(times_writer), n_done_(n_done), n_words_(n_words),
+      tot_bayes_risk_(tot_bayes_risk) { }
+
+  void operator () () {
+    fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), clat_);
+    mbr_ = new MinimumBayesRisk(*clat_);
+    delete clat_; // No longer needed.
+    clat_ = NULL;
+  }
+
+  ~MbrDecodeTask() {
+    if (trans_writer_->IsOpen())
+      trans_writer_->Write(key_, mbr_->GetOneBest());
+    if (bayes_risk_writer_->IsOpen())
+      bayes_risk_writer_->Write(key_, mbr_->GetBayesRisk());
+    if (sausage_stats_writer_->IsOpen())
+      sausage_stats_writer_->Write(key_, mbr_->GetSausageStats());
+    if (times_writer_->IsOpen())
+      times_writer_->Write(key_, one_best_times_ ? mbr_->GetOneBestTimes() :
+                           mbr_->GetSausageTimes());
+    (*n_done_)++;
+    (*n_words_) += mbr_->GetOneBest().size();
+    (*tot_bayes_risk_) += mbr_->GetBayesRisk();
+    delete mbr_;
+  }
+ private:
+  std::string key_;
+  BaseFloat lm_scale_;
+  BaseFloat acoustic_scale_;
+  bool one_best_times_;
+  CompactLattice *clat_; // The input lattice; owned locally.
+  MinimumBayesRisk *mbr_; // The output of our process; owned locally.
+  Int32VectorWriter *trans_writer_;
+  BaseFloatWriter *bayes_risk_writer_;
+  PosteriorWriter *sausage_stats_writer_;
+  BaseFloatPairVectorWriter *times_writer_;
+  int32 *n_done_;
+  int32 *n_words_;
+  BaseFloat *tot_bayes_risk_;
+};
+
+} // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -50,6 +115,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     BaseFloat lm_scale = 1.0;
     bool one_best_times = false;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
 
     std::string word_syms_filename;
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
@@ -60,6 +126,7 @@ int main(int argc, char *argv[]) {
                 "words [for debug output]");
     po.Register("one-best-times", &one_best_times, "If true, output times "
                 "corresponding to one-best, not whole sausage.");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -94,27 +161,19 @@ int main(int argc, char *argv[]) {
     int32 n_done = 0, n_words = 0;
     BaseFloat tot_bayes_risk = 0.0;
     
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-      MinimumBayesRisk mbr(clat);
-
-      if (trans_wspecifier != "")
-        trans_writer.Write(key, mbr.GetOneBest());
-      if (bayes_risk_wspecifier != "")
-        bayes_risk_writer.Write(key, mbr.GetBayesRisk());
-      if (sausage_stats_wspecifier != "")
-        sausage_stats_writer.Write(key, mbr.GetSausageStats());
-      if (times_wspecifier != "")
-        times_writer.Write(key, one_best_times ? mbr.GetOneBestTimes() :
-                           mbr.GetSausageTimes());
-      
-      n_done++;
-      n_words += mbr.GetOneBest().size();
-      tot_bayes_risk += mbr.GetBayesRisk();
+    {
+      TaskSequencer<MbrDecodeTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
+        sequencer.Run(new MbrDecodeTask(key, lm_scale, acoustic_scale,
+                                        one_best_times, clat, &trans_writer,
+                                        &bayes_risk_writer,
+                                        &sausage_stats_writer, &times_writer,
+                                        &n_done, &n_words, &tot_bayes_risk));
+      }
+      sequencer.Wait();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices.";
@@ -19,6 +19,67 @@
 
 #include "util/common-utils.h"
 #include "lat/sausages.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class LatticeToCtmConfTask {
+ public:
+  // Initializer takes ownership of "clat".  The ctm is written to "os" in
+  // the destructor, which TaskSequencer runs sequentially and in order.
+  LatticeToCtmConfTask(const std::string &key,
+                       BaseFloat lm_scale,
+                       BaseFloat acoustic_scale,
+                       bool decode_mbr,
+                       BaseFloat frame_shift,
+                       CompactLattice *clat,
+                       std::ostream *os,
+                       int32 *n_done, int32 *n_words,
+                       BaseFloat *tot_bayes_risk):
+      key_(key), lm_scale_(lm_scale), acoustic_scale_(acoustic_scale),
+      decode_mbr_(decode_mbr), frame_shift_(frame_shift), clat_(clat),
+      mbr_(NULL), os_(os), n_done_(n_done), n_words_(n_words),
+      tot_bayes_risk_(tot_bayes_risk) { }
+
+  void operator () () {
+    fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), clat_);
+    mbr_ = new MinimumBayesRisk(*clat_, decode_mbr_);
+    delete clat_; // No longer needed.
+    clat_ = NULL;
+  }
+
+  ~LatticeToCtmConfTask() {
+    const std::vector<BaseFloat> &conf = mbr_->GetOneBestConfidences();
+    const std::vector<int32> &words = mbr_->GetOneBest();
+    const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
+        mbr_->GetOneBestTimes();
+    KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
+    for (size_t i = 0; i < words.size(); i++) {
+      KALDI_ASSERT(words[i] != 0); // Should not have epsilons.
+      (*os_) << key_ << " 1 " << (frame_shift_ * times[i].first) << ' '
+             << (frame_shift_ * (times[i].second-times[i].first)) << ' '
+             << words[i] << ' ' << conf[i] << '\n';
+    }
+    (*n_done_)++;
+    (*n_words_) += words.size();
+    (*tot_bayes_risk_) += mbr_->GetBayesRisk();
+    delete mbr_;
+  }
+ private:
+  std::string key_;
+  BaseFloat lm_scale_;
+  BaseFloat acoustic_scale_;
+  bool decode_mbr_;
+  BaseFloat frame_shift_;
+  CompactLattice *clat_; // The input lattice; owned locally.
+  MinimumBayesRisk *mbr_; // The output of our process; owned locally.
+  std::ostream *os_;
+  int32 *n_done_;
+  int32 *n_words_;
+  BaseFloat *tot_bayes_risk_;
+};
+
+} // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -43,6 +104,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0, inv_acoustic_scale = 1.0, lm_scale = 1.0;
     bool decode_mbr = true;
     BaseFloat frame_shift = 0.01;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
 
     std::string word_syms_filename;
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
@@ -54,6 +116,7 @@ int main(int argc, char *argv[]) {
     po.Register("decode-mbr", &decode_mbr, "If true, do Minimum Bayes Risk "
                 "decoding (else, Maximum a Posteriori)");
     po.Register("frame-shift", &frame_shift, "Time in seconds between frames.\n");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -80,28 +143,18 @@ int main(int argc, char *argv[]) {
     int32 n_done = 0, n_words = 0;
     BaseFloat tot_bayes_risk = 0.0;
     
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-      MinimumBayesRisk mbr(clat, decode_mbr);
-      
-      const std::vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
-      const std::vector<int32> &words = mbr.GetOneBest();
-      const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
-          mbr.GetOneBestTimes();
-      KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
-      for (size_t i = 0; i < words.size(); i++) {
-        KALDI_ASSERT(words[i] != 0); // Should not have epsilons.
-        ko.Stream() << key << " 1 " << (frame_shift * times[i].first) << ' '
-                    << (frame_shift * (times[i].second-times[i].first)) << ' '
-                    << words[i] << ' ' << conf[i] << '\n';
+    {
+      TaskSequencer<LatticeToCtmConfTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LatticeToCtmConfTask(key, lm_scale, acoustic_scale,
+                                               decode_mbr, frame_shift, clat,
+                                               &(ko.Stream()), &n_done,
+                                               &n_words, &tot_bayes_risk));
       }
-      n_done++;
-      n_words += mbr.GetOneBest().size();
-      tot_bayes_risk += mbr.GetBayesRisk();
+      sequencer.Wait();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices.";
@@ -324,40 +324,48 @@ void CompressedMatrix::Write(std::ostream &os, bool binary) const {
 }
 
 void CompressedMatrix::Read(std::istream &is, bool binary) {
+  // Caution: the following is not back compatible, if you were using
+  // CompressedMatrix before, the old format will not be readable.
+  if (binary && Peek(is, binary) == 'C') {  // Binary-mode read.
+    ExpectToken(is, binary, "CM"); 
+    GlobalHeader h;
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (is.fail())
+      KALDI_ERR << "Failed to read header";
+    int32 size = DataSize(h), remaining_size = size - sizeof(GlobalHeader);
+    // When reading many matrices of the same size (e.g. from an archive)
+    // we keep the memory we have.
+    if (data_ != NULL && (h.num_cols == 0 ||
+        DataSize(*reinterpret_cast<GlobalHeader*>(data_)) != size)) {
+      delete [] (static_cast<float*>(data_));
+      data_ = NULL;
+    }
+    if (h.num_cols == 0) {  // empty matrix.
+      return;
+    }
+    if (data_ == NULL)
+      data_ = AllocateData(size);
+    *(reinterpret_cast<GlobalHeader*>(data_)) = h;
+    is.read(reinterpret_cast<char*>(data_) + sizeof(GlobalHeader),
+            remaining_size);
+    if (is.fail())
+      KALDI_ERR << "Failed to read data.";
+    return;
+  }
   if (data_ != NULL) {
     delete [] (static_cast<float*>(data_));
     data_ = NULL;
   }
-  if (binary) {  // Binary-mode read.
-    // Caution: the following is not back compatible, if you were using
-    // CompressedMatrix before, the old format will not be readable.
-
-    int peekval = Peek(is, binary);
-    if (peekval == 'C') {
-      ExpectToken(is, binary, "CM"); 
-      GlobalHeader h;
-      is.read(reinterpret_cast<char*>(&h), sizeof(h));
-      if (is.fail())
-        KALDI_ERR << "Failed to read header";
-      if (h.num_cols == 0) {  // empty matrix.
-        return;
-      }
-      int32 size = DataSize(h), remaining_size = size - sizeof(GlobalHeader);
-      data_ = AllocateData(size);
-      *(reinterpret_cast<GlobalHeader*>(data_)) = h;
-      is.read(reinterpret_cast<char*>(data_) + sizeof(GlobalHeader),
-              remaining_size);
-    } else {
-      // Assume that what we're reading is a regular Matrix.  This might be the
-      // case if you changed your code, making a Matrix into a CompressedMatrix,
-      // and you want back-compatibility for reading.
-      Matrix<BaseFloat> M;
-      M.Read(is, binary); // This will crash if it was not a Matrix.  This might happen,
-                          // for instance, if the CompressedMatrix was written using the
-                          // older code where we didn't write the token "CM", we just
-                          // wrote the binary data directly.
-      this->CopyFromMat(M);
-    }
+  if (binary) {
+    // Assume that what we're reading is a regular Matrix.  This might be the
+    // case if you changed your code, making a Matrix into a CompressedMatrix,
+    // and you want back-compatibility for reading.
+    Matrix<BaseFloat> M;
+    M.Read(is, binary); // This will crash if it was not a Matrix.  This might happen,
+                        // for instance, if the CompressedMatrix was written using the
+                        // older code where we didn't write the token "CM", we just
+                        // wrote the binary data directly.
+    this->CopyFromMat(M);
   } else {  // Text-mode read.
 #if DEBUG_COMPRESSED_MATRIX == 0    
     Matrix<BaseFloat> temp;
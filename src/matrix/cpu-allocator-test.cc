@@ -0,0 +1,161 @@
+// matrix/cpu-allocator-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include "matrix/matrix-lib.h"
+#include "util/timer.h"
+
+namespace kaldi {
+
+static void UnitTestCpuAllocatorBasic() {
+  CpuAllocatorStats stats_start;
+  GetCpuAllocatorStats(&stats_start);
+  for (int32 i = 0; i < 100; i++) {
+    size_t size = 1 + rand() % 100000;
+    char *ptr = static_cast<char*>(CpuAllocatorMalloc(size));
+    KALDI_ASSERT(reinterpret_cast<size_t>(ptr) % 16 == 0);
+    memset(ptr, 0, size);  // check (with valgrind) that it is all usable.
+    // Allocate the same size again: this must come from the cache.
+    CpuAllocatorFree(ptr);
+    CpuAllocatorStats stats;
+    GetCpuAllocatorStats(&stats);
+    char *ptr2 = static_cast<char*>(CpuAllocatorMalloc(size));
+    KALDI_ASSERT(ptr2 == ptr);
+    CpuAllocatorStats stats2;
+    GetCpuAllocatorStats(&stats2);
+    KALDI_ASSERT(stats2.num_hits == stats.num_hits + 1 &&
+                 stats2.num_allocations == stats.num_allocations + 1 &&
+                 stats2.bytes_cached < stats.bytes_cached &&
+                 stats2.bytes_in_use >= stats.bytes_in_use +
+                 static_cast<int64>(size));
+    CpuAllocatorFree(ptr2);
+  }
+  // A very large block is not cached.
+  size_t big_size = static_cast<size_t>(200) << 20;
+  CpuAllocatorStats stats, stats2;
+  GetCpuAllocatorStats(&stats);
+  CpuAllocatorFree(CpuAllocatorMalloc(big_size));
+  GetCpuAllocatorStats(&stats2);
+  KALDI_ASSERT(stats2.bytes_cached == stats.bytes_cached &&
+               stats2.bytes_in_use == stats.bytes_in_use &&
+               stats2.peak_bytes_in_use >= static_cast<int64>(big_size));
+
+  CpuAllocatorReleaseCache();
+  GetCpuAllocatorStats(&stats);
+  KALDI_ASSERT(stats.bytes_cached == 0 &&
+               stats.bytes_in_use == stats_start.bytes_in_use);
+}
+
+// Checks that blocks allocated while the allocator is disabled can be freed
+// while it is enabled, and vice versa.
+static void UnitTestCpuAllocatorSwitch() {
+  SetCpuAllocatorEnabled(false);
+  Vector<float> v(10);
+  Matrix<double> m(5, 7);
+  SetCpuAllocatorEnabled(true);
+  Vector<float> v2(20);
+  v.Swap(&v2);
+  SetCpuAllocatorEnabled(false);
+  v.Resize(0);
+  SetCpuAllocatorEnabled(true);
+  v2.Resize(0);
+  m.Resize(3, 3);
+  SetCpuAllocatorEnabled(false);
+  m.Resize(0, 0);
+  SetCpuAllocatorEnabled(true);
+}
+
+template<typename Real>
+static void UnitTestCpuAllocatorMatrix() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT rows = 1 + rand() % 50, cols = 1 + rand() % 50;
+    Matrix<Real> M(rows, cols);
+    KALDI_ASSERT(M.IsZero());
+    M.SetRandn();
+    Matrix<Real> N(M);
+    AssertEqual(M, N);
+    N.Resize(rows, cols + 1, kCopyData);
+    KALDI_ASSERT(N.Range(0, rows, 0, cols).ApproxEqual(M));
+    SpMatrix<Real> S(rows);
+    S.SetRandn();
+    Matrix<Real> P(S);
+    SpMatrix<Real> S2(rows);
+    S2.CopyFromMat(P);
+    KALDI_ASSERT(S.ApproxEqual(S2));
+    Vector<Real> v(rows);
+    KALDI_ASSERT(v.IsZero());
+  }
+}
+
+static void *AllocateInThread(void *arg) {
+  std::vector<void*> *blocks = static_cast<std::vector<void*>*>(arg);
+  for (int32 i = 0; i < 100; i++)
+    blocks->push_back(CpuAllocatorMalloc(1 + rand() % 1000));
+  // This matrix is freed when the thread exits; its memory should then be
+  // released.
+  Matrix<float> m(10, 10);
+  return NULL;
+}
+
+// Checks that memory allocated in one thread may be freed in another.
+static void UnitTestCpuAllocatorThreads() {
+  CpuAllocatorReleaseCache();
+  CpuAllocatorStats stats_start;
+  GetCpuAllocatorStats(&stats_start);
+  std::vector<void*> blocks;
+  pthread_t thread;
+  KALDI_ASSERT(pthread_create(&thread, NULL, AllocateInThread, &blocks) == 0);
+  KALDI_ASSERT(pthread_join(thread, NULL) == 0);
+  KALDI_ASSERT(blocks.size() == 100);
+  for (size_t i = 0; i < blocks.size(); i++)
+    CpuAllocatorFree(blocks[i]);
+  CpuAllocatorStats stats;
+  GetCpuAllocatorStats(&stats);
+  KALDI_ASSERT(stats.num_allocations == stats_start.num_allocations + 101 &&
+               stats.bytes_in_use == stats_start.bytes_in_use);
+}
+
+static void UnitTestCpuAllocatorSpeed() {
+  for (int32 enabled = 0; enabled <= 1; enabled++) {
+    SetCpuAllocatorEnabled(enabled != 0);
+    Timer timer;
+    for (int32 i = 0; i < 10000; i++) {
+      Matrix<float> m(256, 1024, kUndefined);
+      m(i % 256, i % 1024) = 1.0;
+      Vector<float> v(1024, kUndefined);
+      v(i % 1024) = 1.0;
+    }
+    KALDI_LOG << "For CPU allocator " << (enabled ? "enabled" : "disabled")
+              << ", 10000 allocations of a 256 x 1024 matrix and a vector "
+              << "took " << timer.Elapsed() << " seconds.";
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  SetCpuAllocatorEnabled(true);
+  UnitTestCpuAllocatorBasic();
+  UnitTestCpuAllocatorSwitch();
+  UnitTestCpuAllocatorMatrix<float>();
+  UnitTestCpuAllocatorMatrix<double>();
+  UnitTestCpuAllocatorThreads();
+  UnitTestCpuAllocatorSpeed();
+  PrintCpuAllocatorStats();
+  KALDI_LOG << "Tests succeeded.";
+}
@@ -0,0 +1,288 @@
+// matrix/cpu-allocator.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "matrix/cpu-allocator.h"
+
+namespace kaldi {
+
+// Every block starts with a header of kHeaderBytes, followed by the memory
+// given to the user; since the header size is a multiple of 16, the user's
+// memory is 16-byte aligned like the block itself.
+struct CpuAllocatorHeader {
+  size_t bytes;  // Usable size of the block, excluding the header.
+  int32 size_class;  // Size class, or -1 if the block is not to be cached.
+  int32 counted;  // 1 if the block is counted in the statistics.
+};
+
+static const size_t kHeaderBytes = 16;
+
+// Size class c has 2^k + (c % 4) 2^(k-2) bytes, with k = 6 + c / 4; the
+// largest, c = 83, has 2^26 * 7/4 bytes (112MB).
+static const int32 kNumSizeClasses = 84;
+
+static inline size_t SizeClassBytes(int32 c) {
+  int32 k = 6 + c / 4;
+  return (static_cast<size_t>(1) << k) +
+      (c % 4) * (static_cast<size_t>(1) << (k - 2));
+}
+
+// Returns the smallest size class that can hold "size" bytes, or -1 if it is
+// too large to be cached.
+static inline int32 SizeClassForBytes(size_t size) {
+  if (size <= 64) return 0;
+  int32 k = 6;  // We find k such that 2^k < size <= 2^(k+1).
+  while ((static_cast<size_t>(1) << (k + 1)) < size) {
+    k++;
+    if (k >= 6 + kNumSizeClasses / 4) return -1;
+  }
+  size_t step = static_cast<size_t>(1) << (k - 2);
+  int32 c = 4 * (k - 6) + static_cast<int32>(
+      (size - (static_cast<size_t>(1) << k) + step - 1) / step);
+  return (c < kNumSizeClasses ? c : -1);
+}
+
+// Only the owning thread uses "freed"; "stats" is also read by
+// GetCpuAllocatorStats() in other threads, so it is only accessed with "mutex"
+// held (the owning thread holds it while it allocates or frees a block; as the
+// lock is almost never contended, this costs little).
+struct CpuAllocatorThreadCache {
+  std::vector<char*> freed[kNumSizeClasses];  // Cached blocks, by size class.
+  CpuAllocatorStats stats;
+  pthread_mutex_t mutex;
+  CpuAllocatorThreadCache() { pthread_mutex_init(&mutex, NULL); }
+  ~CpuAllocatorThreadCache() { pthread_mutex_destroy(&mutex); }
+};
+
+// These are not protected by a lock; SetCpuAllocatorEnabled() and
+// SetCpuAllocatorMaxCachedBytes() must be called before any other threads
+// are started.
+#ifdef KALDI_CPU_ALLOCATOR
+static bool cpu_allocator_enabled = true;
+#else
+static bool cpu_allocator_enabled = false;
+#endif
+static int64 cpu_allocator_max_cached_bytes = 256 << 20;
+
+// The caches of the threads that are running are registered in
+// cpu_allocator_caches so that GetCpuAllocatorStats() can see them; the
+// statistics of threads that have exited are added to
+// cpu_allocator_retired_stats.  Both are protected by cpu_allocator_mutex.
+static pthread_once_t cpu_allocator_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cpu_allocator_key;
+static pthread_mutex_t cpu_allocator_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<CpuAllocatorThreadCache*> *cpu_allocator_caches = NULL;
+static CpuAllocatorStats cpu_allocator_retired_stats;
+
+static void AddCpuAllocatorStats(const CpuAllocatorStats &src,
+                                 CpuAllocatorStats *dest) {
+  dest->num_allocations += src.num_allocations;
+  dest->num_hits += src.num_hits;
+  dest->bytes_cached += src.bytes_cached;
+  dest->peak_bytes_cached += src.peak_bytes_cached;
+  dest->bytes_in_use += src.bytes_in_use;
+  dest->peak_bytes_in_use += src.peak_bytes_in_use;
+}
+
+// Must be called by the owning thread, with cache->mutex held.
+static void ReleaseThreadCache(CpuAllocatorThreadCache *cache) {
+  for (int32 c = 0; c < kNumSizeClasses; c++) {
+    std::vector<char*> &freed = cache->freed[c];
+    for (size_t i = 0; i < freed.size(); i++)
+      KALDI_MEMALIGN_FREE(freed[i]);
+    cache->stats.bytes_cached -= static_cast<int64>(freed.size()) *
+        SizeClassBytes(c);
+    freed.clear();
+  }
+}
+
+// Called by pthreads when a thread that has a cache exits.
+static void DestroyThreadCache(void *ptr) {
+  CpuAllocatorThreadCache *cache = static_cast<CpuAllocatorThreadCache*>(ptr);
+  pthread_mutex_lock(&cache->mutex);
+  ReleaseThreadCache(cache);
+  pthread_mutex_unlock(&cache->mutex);
+  pthread_mutex_lock(&cpu_allocator_mutex);
+  // Nothing else uses the cache now, and GetCpuAllocatorStats() can't see it
+  // once we have removed it (which we do with cpu_allocator_mutex held).
+  AddCpuAllocatorStats(cache->stats, &cpu_allocator_retired_stats);
+  std::vector<CpuAllocatorThreadCache*>::iterator iter =
+      std::find(cpu_allocator_caches->begin(), cpu_allocator_caches->end(),
+                cache);
+  KALDI_ASSERT(iter != cpu_allocator_caches->end());
+  cpu_allocator_caches->erase(iter);
+  pthread_mutex_unlock(&cpu_allocator_mutex);
+  delete cache;
+}
+
+static void CreateCpuAllocatorKey() {
+  if (pthread_key_create(&cpu_allocator_key, DestroyThreadCache) != 0)
+    KALDI_ERR << "Error creating thread-specific key for the CPU allocator.";
+}
+
+static CpuAllocatorThreadCache *GetThreadCache() {
+  pthread_once(&cpu_allocator_once, CreateCpuAllocatorKey);
+  void *ptr = pthread_getspecific(cpu_allocator_key);
+  if (ptr != NULL)
+    return static_cast<CpuAllocatorThreadCache*>(ptr);
+  CpuAllocatorThreadCache *cache = new CpuAllocatorThreadCache;
+  pthread_mutex_lock(&cpu_allocator_mutex);
+  if (cpu_allocator_caches == NULL)
+    cpu_allocator_caches = new std::vector<CpuAllocatorThreadCache*>;
+  cpu_allocator_caches->push_back(cache);
+  pthread_mutex_unlock(&cpu_allocator_mutex);
+  pthread_setspecific(cpu_allocator_key, cache);
+  return cache;
+}
+
+// Allocates a new block with "bytes" usable bytes; returns the start of the
+// block (i.e. of the header), or NULL on failure.
+static inline char *AllocateBlock(size_t bytes, int32 size_class,
+                                  bool counted) {
+  void *temp;
+  char *block = static_cast<char*>(KALDI_MEMALIGN(16, kHeaderBytes + bytes,
+                                                  &temp));
+  if (block != NULL) {
+    CpuAllocatorHeader *header = reinterpret_cast<CpuAllocatorHeader*>(block);
+    header->bytes = bytes;
+    header->size_class = size_class;
+    header->counted = (counted ? 1 : 0);
+  }
+  return block;
+}
+
+void *CpuAllocatorMalloc(size_t size) {
+  KALDI_ASSERT(size > 0);
+  KALDI_COMPILE_TIME_ASSERT(sizeof(CpuAllocatorHeader) <= kHeaderBytes);
+  if (!cpu_allocator_enabled) {
+    char *block = AllocateBlock(size, -1, false);
+    if (block == NULL) throw std::bad_alloc();
+    return block + kHeaderBytes;
+  }
+  CpuAllocatorThreadCache *cache = GetThreadCache();
+  CpuAllocatorStats &stats = cache->stats;
+  int32 c = SizeClassForBytes(size);
+  char *block;
+  pthread_mutex_lock(&cache->mutex);
+  stats.num_allocations++;
+  if (c != -1 && !cache->freed[c].empty()) {
+    block = cache->freed[c].back();
+    cache->freed[c].pop_back();
+    stats.num_hits++;
+    stats.bytes_cached -= SizeClassBytes(c);
+  } else {
+    size_t bytes = (c != -1 ? SizeClassBytes(c) : size);
+    block = AllocateBlock(bytes, c, true);
+    if (block == NULL && stats.bytes_cached != 0) {
+      // Give the cached memory back and try again.
+      ReleaseThreadCache(cache);
+      block = AllocateBlock(bytes, c, true);
+    }
+    if (block == NULL) {
+      pthread_mutex_unlock(&cache->mutex);
+      throw std::bad_alloc();
+    }
+  }
+  stats.bytes_in_use += reinterpret_cast<CpuAllocatorHeader*>(block)->bytes;
+  stats.peak_bytes_in_use = std::max(stats.peak_bytes_in_use,
+                                     stats.bytes_in_use);
+  pthread_mutex_unlock(&cache->mutex);
+  return block + kHeaderBytes;
+}
+
+void CpuAllocatorFree(void *ptr) {
+  if (ptr == NULL) return;
+  char *block = static_cast<char*>(ptr) - kHeaderBytes;
+  const CpuAllocatorHeader *header =
+      reinterpret_cast<const CpuAllocatorHeader*>(block);
+  if (!header->counted) {
+    KALDI_MEMALIGN_FREE(block);
+    return;
+  }
+  CpuAllocatorThreadCache *cache = GetThreadCache();
+  CpuAllocatorStats &stats = cache->stats;
+  int64 bytes = header->bytes;
+  pthread_mutex_lock(&cache->mutex);
+  stats.bytes_in_use -= bytes;
+  if (header->size_class != -1 && cpu_allocator_enabled &&
+      stats.bytes_cached + bytes <= cpu_allocator_max_cached_bytes) {
+    cache->freed[header->size_class].push_back(block);
+    stats.bytes_cached += bytes;
+    stats.peak_bytes_cached = std::max(stats.peak_bytes_cached,
+                                       stats.bytes_cached);
+    block = NULL;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+  if (block != NULL)
+    KALDI_MEMALIGN_FREE(block);
+}
+
+void SetCpuAllocatorEnabled(bool enabled) {
+  cpu_allocator_enabled = enabled;
+}
+
+bool CpuAllocatorEnabled() {
+  return cpu_allocator_enabled;
+}
+
+void SetCpuAllocatorMaxCachedBytes(int64 max_cached_bytes) {
+  KALDI_ASSERT(max_cached_bytes >= 0);
+  cpu_allocator_max_cached_bytes = max_cached_bytes;
+}
+
+void CpuAllocatorReleaseCache() {
+  pthread_once(&cpu_allocator_once, CreateCpuAllocatorKey);
+  void *ptr = pthread_getspecific(cpu_allocator_key);
+  if (ptr != NULL) {
+    CpuAllocatorThreadCache *cache = static_cast<CpuAllocatorThreadCache*>(ptr);
+    pthread_mutex_lock(&cache->mutex);
+    ReleaseThreadCache(cache);
+    pthread_mutex_unlock(&cache->mutex);
+  }
+}
+
+void GetCpuAllocatorStats(CpuAllocatorStats *stats) {
+  pthread_mutex_lock(&cpu_allocator_mutex);
+  *stats = cpu_allocator_retired_stats;
+  if (cpu_allocator_caches != NULL) {
+    for (size_t i = 0; i < cpu_allocator_caches->size(); i++) {
+      CpuAllocatorThreadCache *cache = (*cpu_allocator_caches)[i];
+      pthread_mutex_lock(&cache->mutex);
+      AddCpuAllocatorStats(cache->stats, stats);
+      pthread_mutex_unlock(&cache->mutex);
+    }
+  }
+  pthread_mutex_unlock(&cpu_allocator_mutex);
+}
+
+void PrintCpuAllocatorStats() {
+  CpuAllocatorStats stats;
+  GetCpuAllocatorStats(&stats);
+  if (stats.num_allocations == 0) return;
+  KALDI_LOG << "CPU allocator: " << stats.num_allocations << " allocations, "
+            << stats.num_hits << " cache hits ("
+            << (100.0 * stats.num_hits / stats.num_allocations) << "%); "
+            << "bytes cached " << stats.bytes_cached << " (peak "
+            << stats.peak_bytes_cached << "), bytes in use "
+            << stats.bytes_in_use << " (peak " << stats.peak_bytes_in_use
+            << ").";
+}
+
+}  // namespace kaldi
@@ -0,0 +1,104 @@
+// matrix/cpu-allocator.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_CPU_ALLOCATOR_H_
+#define KALDI_MATRIX_CPU_ALLOCATOR_H_
+
+#include <cstddef>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/**
+   The memory for Matrix, Vector and PackedMatrix (and hence for CuMatrix,
+   CuVector and CuPackedMatrix when they are not using a GPU) is obtained from
+   CpuAllocatorMalloc() and returned with CpuAllocatorFree().  By default these
+   are just a 16-byte aligned malloc and free.  If the allocator is enabled,
+   either with SetCpuAllocatorEnabled(true) or by compiling with
+   -DKALDI_CPU_ALLOCATOR (which makes it enabled by default), freed blocks are
+   kept in a per-thread cache, organized by size class, and handed out again
+   by later allocations of a similar size; this is the CPU analogue of the
+   caching done by CuDevice for GPU memory, and avoids most of the cost of
+   malloc, free and page faults in code that resizes its temporaries for each
+   minibatch or utterance.
+
+   The size classes are 64, 80, 96, 112, 128, 160, ... bytes (four per power of
+   two), so at most 25% of a cached block is wasted.  Blocks larger than about
+   100MB are never cached.  Memory allocated in one thread may be freed in
+   another; it then goes into the freeing thread's cache.  A thread's cache is
+   released when the thread exits, or by CpuAllocatorReleaseCache().
+
+   Note that memory from the cache is not zeroed, so it holds the old contents
+   of the block; Matrix and Vector only rely on this for kUndefined.
+ */
+
+/// Statistics of the allocator, summed over threads (including threads that
+/// have exited).  Only allocations made while the allocator was enabled are
+/// counted.
+struct CpuAllocatorStats {
+  int64 num_allocations;  ///< Number of calls to CpuAllocatorMalloc().
+  int64 num_hits;  ///< Number of those that were served from the cache.
+  int64 bytes_cached;  ///< Bytes currently held in the caches.
+  int64 peak_bytes_cached;  ///< Sum over threads of the peak of bytes_cached.
+  int64 bytes_in_use;  ///< Bytes currently allocated and not freed.
+  int64 peak_bytes_in_use;  ///< Sum over threads of the peak of bytes_in_use.
+  CpuAllocatorStats(): num_allocations(0), num_hits(0), bytes_cached(0),
+                       peak_bytes_cached(0), bytes_in_use(0),
+                       peak_bytes_in_use(0) { }
+};
+
+/// Returns a 16-byte aligned block of at least "size" bytes (size > 0);
+/// throws std::bad_alloc on failure.
+void *CpuAllocatorMalloc(size_t size);
+
+/// Frees a block returned by CpuAllocatorMalloc() (does nothing for NULL).
+/// It does not matter whether the allocator was enabled when the block was
+/// allocated.
+void CpuAllocatorFree(void *ptr);
+
+/// Turns the caching on or off.  The flag is not protected by a lock, so this
+/// must be called before any other threads are started (normally near the
+/// start of main()).  Turning it off does not release memory that is already
+/// cached.
+void SetCpuAllocatorEnabled(bool enabled);
+
+bool CpuAllocatorEnabled();
+
+/// Sets the maximum number of bytes each thread may hold in its cache
+/// (default 256MB); blocks freed when the cache is full go back to the system.
+/// Like SetCpuAllocatorEnabled(), call this before starting any threads.
+void SetCpuAllocatorMaxCachedBytes(int64 max_cached_bytes);
+
+/// Returns all the memory cached by the calling thread to the system.
+void CpuAllocatorReleaseCache();
+
+/// Gets the statistics.  It may be called from any thread; each thread's
+/// numbers are consistent, but the sum is only a snapshot if other threads are
+/// allocating at the same time.
+void GetCpuAllocatorStats(CpuAllocatorStats *stats);
+
+/// Prints the statistics with KALDI_LOG (if the allocator has been used).
+void PrintCpuAllocatorStats();
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_CPU_ALLOCATOR_H_
@@ -25,6 +25,9 @@
 #include "matrix/jama-svd.h"
 #include "matrix/jama-eig.h"
 #include "matrix/compressed-matrix.h"
+#include "matrix/sparse-matrix.h"
+#include "matrix/simd-functions.h"
+#include "matrix/cpu-allocator.h"
 
 namespace kaldi {
 
@@ -326,6 +329,102 @@ void MatrixBase<Real>::AddSmatMat(const Real alpha,
   }
 }
 
+template<typename Real>
+void MatrixBase<Real>::AddSmat(Real alpha, const SparseMatrix<Real> &A,
+                               MatrixTransposeType trans) {
+  MatrixIndexT A_rows = A.NumRows();
+  if (trans == kNoTrans) {
+    KALDI_ASSERT(num_rows_ == A_rows && num_cols_ == A.NumCols());
+  } else {
+    KALDI_ASSERT(num_rows_ == A.NumCols() && num_cols_ == A_rows);
+  }
+  for (MatrixIndexT r = 0; r < A_rows; r++) {
+    MatrixIndexT num_elements = A.RowNumElements(r);
+    if (num_elements == 0) continue;
+    const MatrixIndexT *indices = A.RowIndices(r);
+    const Real *values = A.RowValues(r);
+    if (trans == kNoTrans) {
+      Real *row_data = data_ + r * stride_;
+      for (MatrixIndexT k = 0; k < num_elements; k++)
+        row_data[indices[k]] += alpha * values[k];
+    } else {
+      Real *col_data = data_ + r;
+      for (MatrixIndexT k = 0; k < num_elements; k++)
+        col_data[indices[k] * stride_] += alpha * values[k];
+    }
+  }
+}
+
+template<typename Real>
+void MatrixBase<Real>::AddSmatMat(Real alpha, const SparseMatrix<Real> &A,
+                                  MatrixTransposeType transA,
+                                  const MatrixBase<Real> &B, Real beta) {
+  MatrixIndexT A_rows = A.NumRows();
+  if (transA == kNoTrans) {
+    KALDI_ASSERT(num_rows_ == A_rows && A.NumCols() == B.num_rows_);
+  } else {
+    KALDI_ASSERT(num_rows_ == A.NumCols() && A_rows == B.num_rows_);
+  }
+  KALDI_ASSERT(num_cols_ == B.num_cols_ && &B != this);
+  if (beta == 0.0) SetZero();
+  else if (beta != 1.0) Scale(beta);
+  for (MatrixIndexT r = 0; r < A_rows; r++) {
+    MatrixIndexT num_elements = A.RowNumElements(r);
+    if (num_elements == 0) continue;
+    const MatrixIndexT *indices = A.RowIndices(r);
+    const Real *values = A.RowValues(r);
+    for (MatrixIndexT k = 0; k < num_elements; k++) {
+      // For A, row r of *this += alpha * A(r, c) * row c of B; for A^T,
+      // row c of *this += alpha * A(r, c) * row r of B.
+      MatrixIndexT c = indices[k];
+      if (transA == kNoTrans)
+        cblas_Xaxpy(num_cols_, alpha * values[k], B.RowData(c), 1,
+                    data_ + r * stride_, 1);
+      else
+        cblas_Xaxpy(num_cols_, alpha * values[k], B.RowData(r), 1,
+                    data_ + c * stride_, 1);
+    }
+  }
+}
+
+template<typename Real>
+void MatrixBase<Real>::AddMatSmat(Real alpha, const MatrixBase<Real> &A,
+                                  const SparseMatrix<Real> &B,
+                                  MatrixTransposeType transB, Real beta) {
+  MatrixIndexT B_rows = B.NumRows();
+  if (transB == kNoTrans) {
+    KALDI_ASSERT(A.num_cols_ == B_rows && num_cols_ == B.NumCols());
+  } else {
+    KALDI_ASSERT(A.num_cols_ == B.NumCols() && num_cols_ == B_rows);
+  }
+  KALDI_ASSERT(num_rows_ == A.num_rows_ && &A != this);
+  if (beta == 0.0) SetZero();
+  else if (beta != 1.0) Scale(beta);
+  for (MatrixIndexT i = 0; i < num_rows_; i++) {
+    const Real *A_row = A.RowData(i);
+    Real *this_row = data_ + i * stride_;
+    for (MatrixIndexT r = 0; r < B_rows; r++) {
+      MatrixIndexT num_elements = B.RowNumElements(r);
+      if (num_elements == 0) continue;
+      const MatrixIndexT *indices = B.RowIndices(r);
+      const Real *values = B.RowValues(r);
+      if (transB == kNoTrans) {
+        // row i of *this += alpha * A(i, r) * row r of B.
+        Real a = alpha * A_row[r];
+        if (a == 0.0) continue;
+        for (MatrixIndexT k = 0; k < num_elements; k++)
+          this_row[indices[k]] += a * values[k];
+      } else {
+        // (*this)(i, r) += alpha * (row i of A) . (row r of B).
+        Real sum = 0.0;
+        for (MatrixIndexT k = 0; k < num_elements; k++)
+          sum += A_row[indices[k]] * values[k];
+        this_row[r] += alpha * sum;
+      }
+    }
+  }
+}
+
 template<typename Real>
 void MatrixBase<Real>::AddSpSp(const Real alpha, const SpMatrix<Real> &A_in,
                                 const SpMatrix<Real> &B_in, const Real beta) {
@@ -583,8 +682,6 @@ inline void Matrix<Real>::Init(const MatrixIndexT rows,
   MatrixIndexT skip;
   MatrixIndexT real_cols;
   size_t size;
-  void *data;  // aligned memory block
-  void *temp;  // memory block to be really freed
 
   // compute the size of skip and real cols
   skip = ((16 / sizeof(Real)) - cols % (16 / sizeof(Real)))
@@ -593,15 +690,12 @@ inline void Matrix<Real>::Init(const MatrixIndexT rows,
   size = static_cast<size_t>(rows) * static_cast<size_t>(real_cols)
       * sizeof(Real);
   
-  // allocate the memory and set the right dimensions and parameters
-  if (NULL != (data = KALDI_MEMALIGN(16, size, &temp))) {
-    MatrixBase<Real>::data_        = static_cast<Real *> (data);
-    MatrixBase<Real>::num_rows_      = rows;
-    MatrixBase<Real>::num_cols_      = cols;
-    MatrixBase<Real>::stride_  = real_cols;
-  } else {
-    throw std::bad_alloc();
-  }
+  // allocate the memory and set the right dimensions and parameters; this
+  // throws std::bad_alloc on failure.
+  MatrixBase<Real>::data_        = static_cast<Real *> (CpuAllocatorMalloc(size));
+  MatrixBase<Real>::num_rows_      = rows;
+  MatrixBase<Real>::num_cols_      = cols;
+  MatrixBase<Real>::stride_  = real_cols;
 }
 
 template<typename Real>
@@ -909,7 +1003,7 @@ template<typename Real>
 void Matrix<Real>::Destroy() {
   // we need to free the data block if it was defined
   if (NULL != MatrixBase<Real>::data_)
-    KALDI_MEMALIGN_FREE( MatrixBase<Real>::data_);
+    CpuAllocatorFree( MatrixBase<Real>::data_);
   MatrixBase<Real>::data_ = NULL;
   MatrixBase<Real>::num_rows_ = MatrixBase<Real>::num_cols_
       = MatrixBase<Real>::stride_ = 0;
@@ -1232,7 +1326,7 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
     ReadBasicType(is, binary, &rows);  // throws on error.
     ReadBasicType(is, binary, &cols);  // throws on error.
     if ((MatrixIndexT)rows != this->num_rows_ || (MatrixIndexT)cols != this->num_cols_) {
-      this->Resize(rows, cols);
+      this->Resize(rows, cols, kUndefined);  // we overwrite all of it.
     }
     if (this->Stride() == this->NumCols() && rows*cols!=0) {
       is.read(reinterpret_cast<char*>(this->Data()),
@@ -2367,13 +2461,8 @@ Real MatrixBase<Real>::LogSumExp(Real prune) const {
 
   double sum_relto_max_elem = 0.0;
 
-  for (MatrixIndexT i = 0; i < num_rows_; i++) {
-    for (MatrixIndexT j = 0; j < num_cols_; j++) {
-      BaseFloat f = (*this)(i, j);
-      if (f >= cutoff)
-        sum_relto_max_elem += Exp(f - max_elem);
-    }
-  }
+  for (MatrixIndexT i = 0; i < num_rows_; i++)
+    sum_relto_max_elem += VecSumExp(RowData(i), num_cols_, max_elem, cutoff);
   return max_elem + Log(sum_relto_max_elem);
 }
 
@@ -2381,9 +2470,14 @@ template<typename Real>
 Real MatrixBase<Real>::ApplySoftMax() {
   Real max = this->Max(), sum = 0.0;
   // the 'max' helps to get in good numeric range.
-  for (MatrixIndexT i = 0; i < num_rows_; i++)
+  for (MatrixIndexT i = 0; i < num_rows_; i++) {
+    Real *row_data = RowData(i);
+    for (MatrixIndexT j = 0; j < num_cols_; j++)
+      row_data[j] -= max;
+    VecExp(row_data, row_data, num_cols_);
     for (MatrixIndexT j = 0; j < num_cols_; j++)
-      sum += ((*this)(i, j) = Exp((*this)(i, j) - max));
+      sum += row_data[j];
+  }
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
@@ -2408,16 +2502,11 @@ template<typename Real>
 void MatrixBase<Real>::SoftHinge(const MatrixBase<Real> &src) {
   KALDI_ASSERT(SameDim(*this, src));
   int32 num_rows = num_rows_, num_cols = num_cols_;
-  for (MatrixIndexT r = 0; r < num_rows; r++) {
-    Real *row_data = this->RowData(r);
-    const Real *src_row_data = src.RowData(r);
-    for (MatrixIndexT c = 0; c < num_cols; c++) {
-      Real x = src_row_data[c], y;
-      if (x > 10.0) y = x; // avoid exponentiating large numbers; function
-      // approaches y=x.
-      else y = Log1p(Exp(x)); // these defined in kaldi-math.h
-      row_data[c] = y;
-    }
+  if (num_cols_ == stride_ && src.num_cols_ == src.stride_) {
+    VecSoftHinge(src.data_, data_, num_rows * num_cols);
+  } else {
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      VecSoftHinge(src.RowData(r), this->RowData(r), num_cols);
   }
 }
 template<typename Real>
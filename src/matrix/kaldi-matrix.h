@@ -519,6 +519,22 @@ class MatrixBase {
                   const MatrixBase<Real>& B, MatrixTransposeType transB,
                   const Real beta);
 
+  /// *this += alpha * A [or A^T], where A is a SparseMatrix.
+  void AddSmat(Real alpha, const SparseMatrix<Real> &A,
+               MatrixTransposeType trans = kNoTrans);
+
+  /// *this = beta * *this + alpha * A [or A^T] * B, where A is a
+  /// SparseMatrix.
+  void AddSmatMat(Real alpha, const SparseMatrix<Real> &A,
+                  MatrixTransposeType transA, const MatrixBase<Real> &B,
+                  Real beta);
+
+  /// *this = beta * *this + alpha * A * B [or B^T], where B is a
+  /// SparseMatrix.
+  void AddMatSmat(Real alpha, const MatrixBase<Real> &A,
+                  const SparseMatrix<Real> &B, MatrixTransposeType transB,
+                  Real beta);
+
   /// this <-- beta*this + alpha*A*B*C.
   void AddMatMatMat(const Real alpha,
                     const MatrixBase<Real>& A, MatrixTransposeType transA,
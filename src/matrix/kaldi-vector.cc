@@ -27,6 +27,8 @@
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
 #include "matrix/sp-matrix.h"
+#include "matrix/simd-functions.h"
+#include "matrix/cpu-allocator.h"
 
 namespace kaldi {
 
@@ -159,18 +161,9 @@ inline void Vector<Real>::Init(const MatrixIndexT dim) {
     this->data_ = NULL;
     return;
   }
-  MatrixIndexT size;
-  void *data;
-  void *free_data;
-
-  size = dim * sizeof(Real);
-
-  if ((data = KALDI_MEMALIGN(16, size, &free_data)) != NULL) {
-    this->data_ = static_cast<Real*> (data);
-    this->dim_ = dim;
-  } else {
-    throw std::bad_alloc();
-  }
+  // CpuAllocatorMalloc throws std::bad_alloc on failure.
+  this->data_ = static_cast<Real*>(CpuAllocatorMalloc(dim * sizeof(Real)));
+  this->dim_ = dim;
 }
 
 
@@ -266,7 +259,7 @@ template<typename Real>
 void Vector<Real>::Destroy() {
   /// we need to free the data block if it was defined
   if (this->data_ != NULL)
-    KALDI_MEMALIGN_FREE(this->data_);
+    CpuAllocatorFree(this->data_);
   this->data_ = NULL;
   this->dim_ = 0;
 }
@@ -691,13 +684,7 @@ Real VectorBase<Real>::LogSumExp(Real prune) const {
   if (prune > 0.0 && max_elem - prune > cutoff) // explicit pruning...
     cutoff = max_elem - prune;
 
-  double sum_relto_max_elem = 0.0;
-
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    BaseFloat f = data_[i];
-    if (f >= cutoff)
-      sum_relto_max_elem += Exp(f - max_elem);
-  }
+  double sum_relto_max_elem = VecSumExp(data_, dim_, max_elem, cutoff);
   return max_elem + Log(sum_relto_max_elem);
 }
 
@@ -710,26 +697,21 @@ void VectorBase<Real>::InvertElements() {
 
 template<typename Real>
 void VectorBase<Real>::ApplyLog() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
+  for (MatrixIndexT i = 0; i < dim_; i++)
     if (data_[i] < 0.0)
       KALDI_ERR << "Trying to take log of a negative number.";
-    data_[i] = Log(data_[i]);
-  }
+  VecLog(data_, data_, dim_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyLogAndCopy(const VectorBase<Real> &v) {
   KALDI_ASSERT(dim_ == v.Dim());
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Log(v(i));
-  }
+  VecLog(v.data_, data_, dim_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyExp() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Exp(data_[i]);
-  }
+  VecExp(data_, data_, dim_);
 }
 
 template<typename Real>
@@ -777,10 +759,12 @@ MatrixIndexT VectorBase<Real>::ApplyFloor(const VectorBase<Real> &floor_vec) {
 
 template<typename Real>
 Real VectorBase<Real>::ApplySoftMax() {
-Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += (data_[i] = Exp(data_[i] - max));
-  }
+  Real max = this->Max(), sum = 0.0;
+  for (MatrixIndexT i = 0; i < dim_; i++)
+    data_[i] -= max;
+  VecExp(data_, data_, dim_);
+  for (MatrixIndexT i = 0; i < dim_; i++)
+    sum += data_[i];
   this->Scale(1.0 / sum);
   return max + Log(sum);
 
@@ -801,17 +785,7 @@ void VectorBase<double>::Tanh(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Tanh(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    if (x > 0.0) {
-      Real inv_expx = Exp(-x);
-      x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
-    } else {
-      Real inv_expx = Exp(x);
-      x = 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
-    }
-    data_[i] = x;
-  }
+  VecTanh(src.data_, data_, dim_);
 }
 #endif
 
@@ -839,17 +813,7 @@ void VectorBase<double>::Sigmoid(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Sigmoid(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    // We aim to avoid floating-point overflow here.
-    if (x > 0.0) {
-      x = 1.0 / (1.0 + Exp(-x));
-    } else {
-      Real ex = Exp(x);
-      x = ex / (ex + 1.0);
-    }
-    data_[i] = x;
-  }
+  VecSigmoid(src.data_, data_, dim_);
 }
 #endif
 
@@ -1044,7 +1008,8 @@ void Vector<Real>::Read(std::istream & is,  bool binary, bool add) {
     }
     int32 size;
     ReadBasicType(is, binary, &size);  // throws on error.
-    if ((MatrixIndexT)size != this->Dim())  this->Resize(size);
+    if ((MatrixIndexT)size != this->Dim())
+      this->Resize(size, kUndefined);  // we overwrite all of it.
     if (size > 0)
       is.read(reinterpret_cast<char*>(this->data_), sizeof(Real)*size);
     if (is.fail()) {
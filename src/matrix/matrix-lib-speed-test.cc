@@ -0,0 +1,70 @@
+// matrix/matrix-lib-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matrix/matrix-lib.h"
+#include "util/timer.h"
+
+namespace kaldi {
+
+// Reports the speed, in elements per second, of the element-wise
+// transcendental functions on a matrix the size of a typical nnet minibatch,
+// with the SIMD functions enabled and disabled.
+template<typename Real> static void UnitTestTranscendentalSpeed() {
+  MatrixIndexT num_rows = 256, num_cols = 1024;
+  Matrix<Real> src(num_rows, num_cols), dest(num_rows, num_cols);
+  src.SetRandn();
+  src.Scale(4.0);
+  Matrix<Real> positive(src);
+  positive.ApplyExp();
+  const char *names[] = { "ApplyExp", "ApplyLog", "Sigmoid", "Tanh",
+                          "SoftHinge", "ApplySoftMax", "LogSumExp" };
+  int32 num_functions = sizeof(names) / sizeof(names[0]);
+  for (int32 enabled = 1; enabled >= (sizeof(Real) == 4 ? 0 : 1); enabled--) {
+    SetSimdFunctionsEnabled(enabled == 1);
+    std::string impl = (sizeof(Real) == 4 ? SimdFunctionsImplementation() :
+                        std::string("scalar"));
+    for (int32 f = 0; f < num_functions; f++) {
+      Timer tim;
+      int32 iter;
+      for (iter = 0; tim.Elapsed() < 0.2; iter++) {
+        switch (f) {
+          case 0: dest.CopyFromMat(src); dest.ApplyExp(); break;
+          case 1: dest.CopyFromMat(positive); dest.ApplyLog(); break;
+          case 2: dest.Sigmoid(src); break;
+          case 3: dest.Tanh(src); break;
+          case 4: dest.SoftHinge(src); break;
+          case 5: dest.CopyFromMat(src); dest.ApplySoftMax(); break;
+          default: src.LogSumExp();
+        }
+      }
+      double elements_per_sec = iter * static_cast<double>(num_rows) *
+          num_cols / tim.Elapsed();
+      KALDI_LOG << "For " << names[f] << " with " << (sizeof(Real) == 4 ?
+                  "float" : "double") << " (" << impl << "), speed was "
+                << elements_per_sec << " elements/sec";
+    }
+  }
+  SetSimdFunctionsEnabled(true);
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestTranscendentalSpeed<float>();
+  kaldi::UnitTestTranscendentalSpeed<double>();
+  std::cout << "Test OK.\n";
+}
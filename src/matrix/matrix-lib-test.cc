@@ -2275,6 +2275,107 @@ template<typename Real> static void  UnitTestSoftHinge() {
 }
 
 
+// Checks the float versions of VecExp etc. against double-precision
+// references, using the error bounds documented in simd-functions.h, and
+// checks that special values give the same results as the scalar path.
+static void UnitTestSimdFunctions() {
+  KALDI_LOG << "Testing SIMD functions, implementation is "
+            << SimdFunctionsImplementation();
+  int32 dim = 100000;
+  Vector<float> x(dim), y(dim);
+  for (int32 i = 0; i < dim; i++)  // covers the valid ranges and beyond.
+    x(i) = -100.0 + 200.0 * i / dim;
+  y.CopyFromVec(x);
+  y.ApplyExp();
+  for (int32 i = 0; i < dim; i++) {
+    double ref = exp(static_cast<double>(x(i)));
+    if (ref > 1.0e-37 && ref < 3.0e+38)
+      KALDI_ASSERT(std::abs(y(i) - ref) <= 2.0e-07 * ref);
+  }
+  VecSigmoid(x.Data(), y.Data(), dim);
+  for (int32 i = 0; i < dim; i++) {
+    double ref = 1.0 / (1.0 + exp(-static_cast<double>(x(i))));
+    KALDI_ASSERT(std::abs(y(i) - ref) <= 2.0e-07);
+    if (ref > 1.0e-37)
+      KALDI_ASSERT(std::abs(y(i) - ref) <= 4.0e-07 * ref);
+  }
+  VecTanh(x.Data(), y.Data(), dim);
+  for (int32 i = 0; i < dim; i++) {
+    double ref = tanh(static_cast<double>(x(i)));
+    KALDI_ASSERT(std::abs(y(i) - ref) <= 2.0e-07);
+    KALDI_ASSERT(std::abs(y(i) - ref) <= 4.0e-07 * std::abs(ref));
+  }
+  VecSoftHinge(x.Data(), y.Data(), dim);
+  for (int32 i = 0; i < dim; i++) {
+    double ref = log1p(exp(static_cast<double>(x(i))));
+    // For x > 10 the result is x, as in the scalar version.
+    KALDI_ASSERT(std::abs(y(i) - ref) <= (x(i) > 10.0 ? 5.0e-05 : 1.0e-06));
+  }
+  for (int32 i = 0; i < dim; i++)  // from 1e-38 to 1e38.
+    x(i) = exp(-87.0 + 174.0 * i / dim);
+  y.CopyFromVec(x);
+  y.ApplyLog();
+  for (int32 i = 0; i < dim; i++) {
+    double ref = log(static_cast<double>(x(i)));
+    if (x(i) >= 0.5 && x(i) <= 2.0) {
+      KALDI_ASSERT(std::abs(y(i) - ref) <= 1.0e-07);
+    } else {
+      KALDI_ASSERT(std::abs(y(i) - ref) <= 2.0e-07 * std::abs(ref));
+    }
+  }
+
+  // Special values go through the scalar path, so they must agree exactly.
+  float inf = std::numeric_limits<float>::infinity(),
+      nan = std::numeric_limits<float>::quiet_NaN();
+  float special[] = { 0.0, -0.0, inf, -inf, nan, 1.0e-40, -1.0e-40, 1.0e-30,
+                      87.5, -87.5, 88.5, -88.5, 100.0, -100.0, 1.0, -1.0,
+                      10.0, 43.5, -43.5, 1.0e+38, 3.0e+38, 0.5, -0.5, 2.0 };
+  int32 num_special = sizeof(special) / sizeof(special[0]);
+  for (int32 f = 0; f < 5; f++) {
+    // Use a length that is not a multiple of the SIMD width.
+    for (int32 len = num_special; len >= num_special - 3; len--) {
+      Vector<float> simd(len), scalar(len);
+      for (int32 enabled = 0; enabled < 2; enabled++) {
+        SetSimdFunctionsEnabled(enabled == 1);
+        float *out = (enabled == 1 ? simd.Data() : scalar.Data());
+        switch (f) {
+          case 0: VecExp(special, out, len); break;
+          case 1: VecLog(special, out, len); break;
+          case 2: VecSigmoid(special, out, len); break;
+          case 3: VecTanh(special, out, len); break;
+          default: VecSoftHinge(special, out, len);
+        }
+      }
+      SetSimdFunctionsEnabled(true);
+      for (int32 i = 0; i < len; i++) {
+        double ax = std::abs(special[i]);
+        bool in_range = (ax < 87.0 && (f != 1 || special[i] > 1.0e-38));
+        if (KALDI_ISNAN(scalar(i))) {
+          KALDI_ASSERT(KALDI_ISNAN(simd(i)));
+        } else if (in_range) {
+          KALDI_ASSERT(std::abs(simd(i) - scalar(i)) <=
+                       1.0e-06 * (1.0 + std::abs(scalar(i))));
+        } else {
+          KALDI_ASSERT(simd(i) == scalar(i));
+        }
+      }
+    }
+  }
+
+  // LogSumExp and ApplySoftMax.
+  for (int32 i = 0; i < 10; i++) {
+    Matrix<float> M(10 + rand() % 10, 10 + rand() % 10);
+    M.SetRandn();
+    M.Scale(10.0);
+    Matrix<double> Md(M);
+    AssertEqual(M.LogSumExp(), static_cast<float>(Md.LogSumExp()));
+    AssertEqual(M.Row(0).LogSumExp(), static_cast<float>(Md.Row(0).LogSumExp()));
+    AssertEqual(M.ApplySoftMax(), static_cast<float>(Md.ApplySoftMax()));
+    Matrix<float> Mf(Md);
+    AssertEqual(M, Mf);
+  }
+}
+
 template<typename Real> static void  UnitTestSimple() {
   for (MatrixIndexT i = 0;i < 5;i++) {
 	MatrixIndexT dimM = 20 + rand()%10, dimN = 20 + rand()%20;
@@ -3995,6 +4096,29 @@ template<typename Real> static void UnitTestCompressedMatrix() {
       Matrix<Real> M4(cmat3.NumRows(), cmat3.NumCols());
       cmat3.CopyToMat(&M4);
       AssertEqual(M2, M4);
+
+      { // check reading again into the same object (which keeps its memory
+        // if the size is the same).
+        {
+          std::ofstream outs("tmpf", std::ios_base::out |std::ios_base::binary);
+          InitKaldiOutputStream(outs, binary);
+          cmat.Write(outs, binary);
+          empty_cmat.Write(outs, binary);
+          cmat.Write(outs, binary);
+        }
+        bool binary_in;
+        std::ifstream ins("tmpf", std::ios_base::in | std::ios_base::binary);
+        InitKaldiInputStream(ins, &binary_in);
+        for (int32 i = 0; i < 3; i++) {
+          cmat3.Read(ins, binary_in);
+          Matrix<Real> M5(cmat3);
+          if (i == 1) {
+            KALDI_ASSERT(cmat3.NumRows() == 0);
+          } else {
+            AssertEqual(M2, M5);
+          }
+        }
+      }
     }
     KALDI_LOG << "M = " << M;
     KALDI_LOG << "M2 = " << M2;
@@ -4239,6 +4363,7 @@ int main() {
   bool full_test = false;
   kaldi::MatrixUnitTest<double>(full_test);
   kaldi::MatrixUnitTest<float>(full_test);
+  kaldi::UnitTestSimdFunctions();
   KALDI_LOG << "Tests succeeded.\n";
 
 }
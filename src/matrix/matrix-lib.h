@@ -32,6 +32,9 @@
 #include "matrix/srfft.h"
 #include "matrix/compressed-matrix.h"
 #include "matrix/optimization.h"
+#include "matrix/simd-functions.h"
+#include "matrix/sparse-matrix.h"
+#include "matrix/cpu-allocator.h"
 
 #endif
 
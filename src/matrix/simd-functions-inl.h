@@ -0,0 +1,240 @@
+// matrix/simd-functions-inl.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// This file has no include guard on purpose: it is only included by
+// simd-functions.cc, once per instruction set, with the following macros
+// defined:
+//   KALDI_SIMD_NAMESPACE  name of the namespace to put the kernels in.
+//   KALDI_SIMD_WIDTH      number of floats per vector (4 or 8).
+//   KALDI_SIMD_TARGET     function attribute selecting the instruction set.
+// The kernels use the GCC vector extensions; the polynomial approximations
+// for exp, log and tanh are those of the Cephes library (single precision).
+// The scalar functions ScalarExp() etc., used for out-of-range elements,
+// must be declared before including this file.
+
+namespace KALDI_SIMD_NAMESPACE {
+
+typedef float VecF __attribute__((vector_size(4 * KALDI_SIMD_WIDTH)));
+typedef int32 VecI __attribute__((vector_size(4 * KALDI_SIMD_WIDTH)));
+
+static const int32 kWidth = KALDI_SIMD_WIDTH;
+
+// 1.5 * 2^23: adding this to a float of magnitude < 2^22 rounds it to an
+// integer, which is then held in the low bits of the mantissa.
+static const float kRoundMagic = 12582912.0f;
+static const int32 kRoundMagicBits = 0x4B400000;
+
+static inline KALDI_SIMD_TARGET VecF Splat(float f) {
+  return VecF() + f;
+}
+
+static inline KALDI_SIMD_TARGET VecF Load(const float *x) {
+  VecF ans;
+  memcpy(&ans, x, sizeof(ans));
+  return ans;
+}
+
+static inline KALDI_SIMD_TARGET void Store(VecF v, float *y) {
+  memcpy(y, &v, sizeof(v));
+}
+
+// Returns a where mask is true (all ones), b elsewhere.
+static inline KALDI_SIMD_TARGET VecF Select(VecI mask, VecF a, VecF b) {
+  return (VecF)((mask & (VecI)a) | (~mask & (VecI)b));
+}
+
+static inline KALDI_SIMD_TARGET VecF Abs(VecF x) {
+  return (VecF)((VecI)x & 0x7FFFFFFF);
+}
+
+static inline KALDI_SIMD_TARGET bool AnyTrue(VecI mask) {
+  int32 m[KALDI_SIMD_WIDTH];
+  memcpy(m, &mask, sizeof(mask));
+  int32 ans = 0;
+  for (int32 i = 0; i < kWidth; i++) ans |= m[i];
+  return ans != 0;
+}
+
+// exp(x), valid for -87 < x < 88 (see InvalidExp()).
+static inline KALDI_SIMD_TARGET VecF Exp(VecF x) {
+  // x = n log(2) + r, with n an integer and |r| <= log(2)/2.
+  VecF t = x * 1.44269504088896341f + kRoundMagic,
+      n = t - kRoundMagic,
+      r = x - n * 0.693359375f;
+  r = r + n * 2.12194440e-4f;
+  VecF r2 = r * r,
+      p = Splat(1.9875691500e-4f);
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r2 + r + 1.0f;
+  // Build 2^n directly from the bits.
+  VecI pow2n = (((VecI)t - kRoundMagicBits) + 127) << 23;
+  return p * (VecF)pow2n;
+}
+
+static inline KALDI_SIMD_TARGET VecI InvalidExp(VecF x) {
+  // Also true for NaN.
+  return ~((x > -87.0f) & (x < 88.0f));
+}
+
+// log(x), valid for normalized positive finite x (see InvalidLog()).
+static inline KALDI_SIMD_TARGET VecF Log(VecF x) {
+  VecI bits = (VecI)x;
+  // x = m * 2^e with m in [0.5, 1).
+  VecI e = (bits >> 23) - 126;
+  VecF m = (VecF)((bits & 0x007FFFFF) | 0x3F000000);
+  // Move m into [sqrt(0.5), sqrt(2)) and subtract 1.
+  VecI small = m < 0.707106781186547524f;
+  e = e + small;  // small is -1 where true.
+  m = m + (VecF)(small & (VecI)m) - 1.0f;
+  VecF ef = (VecF)(e + kRoundMagicBits) - kRoundMagic,
+      z = m * m,
+      p = Splat(7.0376836292e-2f);
+  p = p * m - 1.1514610310e-1f;
+  p = p * m + 1.1676998740e-1f;
+  p = p * m - 1.2420140846e-1f;
+  p = p * m + 1.4249322787e-1f;
+  p = p * m - 1.6668057665e-1f;
+  p = p * m + 2.0000714765e-1f;
+  p = p * m - 2.4999993993e-1f;
+  p = p * m + 3.3333331174e-1f;
+  VecF y = p * m * z;
+  y = y - ef * 2.12194440e-4f;
+  y = y - 0.5f * z;
+  return (m + y) + ef * 0.693359375f;
+}
+
+static inline KALDI_SIMD_TARGET VecI InvalidLog(VecF x) {
+  return ~((x >= 1.17549435e-38f) & (x <= 3.40282347e+38f));
+}
+
+// 1 / (1 + exp(-x)), valid for |x| < 87.
+static inline KALDI_SIMD_TARGET VecF Sigmoid(VecF x) {
+  VecF e = Exp(-Abs(x)),
+      inv = 1.0f / (1.0f + e);
+  return Select(x > 0.0f, inv, e * inv);
+}
+
+static inline KALDI_SIMD_TARGET VecI InvalidSigmoid(VecF x) {
+  return ~(Abs(x) < 87.0f);
+}
+
+// tanh(x), valid for |x| < 43.
+static inline KALDI_SIMD_TARGET VecF Tanh(VecF x) {
+  VecF a = Abs(x);
+  // Polynomial for small |x|, where (1 - e) / (1 + e) loses precision.
+  VecF z = x * x,
+      p = Splat(-5.70498872745e-3f);
+  p = p * z + 2.06390887954e-2f;
+  p = p * z - 5.37397155531e-2f;
+  p = p * z + 1.33314422036e-1f;
+  p = p * z - 3.33332819422e-1f;
+  VecF small_ans = p * z * x + x;
+  VecF e = Exp(-2.0f * a),
+      big_ans = (1.0f - e) / (1.0f + e);
+  // Copy the sign of x.
+  big_ans = (VecF)((VecI)big_ans | ((VecI)x & (int32)0x80000000));
+  return Select(a < 0.625f, small_ans, big_ans);
+}
+
+static inline KALDI_SIMD_TARGET VecI InvalidTanh(VecF x) {
+  return ~(Abs(x) < 43.0f);
+}
+
+// log(1 + exp(x)), valid for x > -87 (and not NaN).
+static inline KALDI_SIMD_TARGET VecF SoftHinge(VecF x) {
+  VecI big = x > 10.0f;
+  VecF e = Exp(Select(big, Splat(0.0f), x)),
+      u = 1.0f + e;
+  // log1p(e) = log(u) - ((u - 1) - e) / u corrects for the rounding of u.
+  VecF ans = Log(u) - ((u - 1.0f) - e) / u;
+  return Select(big, x, ans);
+}
+
+static inline KALDI_SIMD_TARGET VecI InvalidSoftHinge(VecF x) {
+  return ~(x > -87.0f);
+}
+
+// Applies a kernel to n elements; the last partial vector goes through a
+// padded buffer so every element gets the same approximation regardless of
+// its position.  Elements for which the kernel is not valid are recomputed
+// with the scalar function.
+#define KALDI_SIMD_APPLY_FUNCTION(Name)                                       \
+  KALDI_SIMD_TARGET void Vec##Name(const float *x, float *y,                  \
+                                   MatrixIndexT n) {                          \
+    float xbuf[KALDI_SIMD_WIDTH], ybuf[KALDI_SIMD_WIDTH];                     \
+    for (MatrixIndexT i = 0; i < n; i += kWidth) {                            \
+      const float *xp = x + i;                                                \
+      float *yp = y + i;                                                      \
+      MatrixIndexT m = std::min<MatrixIndexT>(kWidth, n - i);                 \
+      if (m < kWidth) {                                                       \
+        for (MatrixIndexT j = 0; j < kWidth; j++)                             \
+          xbuf[j] = (j < m ? xp[j] : 0.0f);                                   \
+        xp = xbuf;                                                            \
+        yp = ybuf;                                                            \
+      }                                                                       \
+      VecF v = Load(xp);                                                      \
+      VecI invalid = Invalid##Name(v);                                        \
+      VecF ans = Name(v);                                                     \
+      if (AnyTrue(invalid)) {                                                 \
+        float a[KALDI_SIMD_WIDTH];                                            \
+        int32 bad[KALDI_SIMD_WIDTH];                                          \
+        Store(ans, a);                                                        \
+        memcpy(bad, &invalid, sizeof(bad));                                   \
+        for (MatrixIndexT j = 0; j < kWidth; j++)                             \
+          if (bad[j]) a[j] = Scalar##Name(xp[j]);                             \
+        ans = Load(a);                                                        \
+      }                                                                       \
+      Store(ans, yp);                                                         \
+      if (m < kWidth)                                                         \
+        for (MatrixIndexT j = 0; j < m; j++) y[i + j] = ybuf[j];              \
+    }                                                                         \
+  }
+
+KALDI_SIMD_APPLY_FUNCTION(Exp)
+KALDI_SIMD_APPLY_FUNCTION(Log)
+KALDI_SIMD_APPLY_FUNCTION(Sigmoid)
+KALDI_SIMD_APPLY_FUNCTION(Tanh)
+KALDI_SIMD_APPLY_FUNCTION(SoftHinge)
+
+#undef KALDI_SIMD_APPLY_FUNCTION
+
+KALDI_SIMD_TARGET double VecSumExp(const float *x, MatrixIndexT n,
+                                   float offset, float cutoff) {
+  double sum = 0.0;
+  float xbuf[KALDI_SIMD_WIDTH], a[KALDI_SIMD_WIDTH];
+  int32 bad[KALDI_SIMD_WIDTH];
+  for (MatrixIndexT i = 0; i < n; i += kWidth) {
+    MatrixIndexT m = std::min<MatrixIndexT>(kWidth, n - i);
+    for (MatrixIndexT j = 0; j < kWidth; j++)
+      xbuf[j] = (j < m ? x[i + j] - offset : 0.0f);
+    VecF v = Load(xbuf);
+    VecI invalid = InvalidExp(v);
+    Store(Exp(v), a);
+    memcpy(bad, &invalid, sizeof(bad));
+    for (MatrixIndexT j = 0; j < m; j++) {
+      if (x[i + j] >= cutoff)
+        sum += (bad[j] ? ScalarExp(xbuf[j]) : a[j]);
+    }
+  }
+  return sum;
+}
+
+}  // namespace KALDI_SIMD_NAMESPACE
@@ -0,0 +1,239 @@
+// matrix/simd-functions.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include "base/kaldi-math.h"
+#include "matrix/simd-functions.h"
+
+// The SIMD kernels need the GCC vector extensions, including comparisons
+// and mixed vector/scalar arithmetic (GCC 4.8 or later, or clang).
+#if defined(__GNUC__) && defined(__SSE2__) && \
+  (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define KALDI_HAVE_SIMD_FUNCTIONS 1
+#if defined(__x86_64__) || defined(__i386__)
+#define KALDI_HAVE_SIMD_FUNCTIONS_AVX2 1
+#endif
+#endif
+
+namespace kaldi {
+
+// The scalar reference versions; these are the formulas VectorBase and
+// MatrixBase used before the SIMD versions were added.
+template<typename Real>
+static inline Real ScalarExp(Real x) { return Exp(x); }
+
+template<typename Real>
+static inline Real ScalarLog(Real x) { return Log(x); }
+
+template<typename Real>
+static inline Real ScalarSigmoid(Real x) {
+  // We aim to avoid floating-point overflow here.
+  if (x > 0.0) {
+    return 1.0 / (1.0 + Exp(-x));
+  } else {
+    Real ex = Exp(x);
+    return ex / (ex + 1.0);
+  }
+}
+
+template<typename Real>
+static inline Real ScalarTanh(Real x) {
+  if (x > 0.0) {
+    Real inv_expx = Exp(-x);
+    return -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+  } else {
+    Real inv_expx = Exp(x);
+    return 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
+  }
+}
+
+template<typename Real>
+static inline Real ScalarSoftHinge(Real x) {
+  // avoid exponentiating large numbers; function approaches y=x.
+  if (x > 10.0) return x;
+  else return Log1p(Exp(x));
+}
+
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS
+
+#define KALDI_SIMD_NAMESPACE simd_sse2
+#define KALDI_SIMD_WIDTH 4
+#define KALDI_SIMD_TARGET
+#include "matrix/simd-functions-inl.h"
+#undef KALDI_SIMD_NAMESPACE
+#undef KALDI_SIMD_WIDTH
+#undef KALDI_SIMD_TARGET
+
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS_AVX2
+#define KALDI_SIMD_NAMESPACE simd_avx2
+#define KALDI_SIMD_WIDTH 8
+#define KALDI_SIMD_TARGET __attribute__((target("avx2,fma")))
+#include "matrix/simd-functions-inl.h"
+#undef KALDI_SIMD_NAMESPACE
+#undef KALDI_SIMD_WIDTH
+#undef KALDI_SIMD_TARGET
+#endif
+
+#endif  // KALDI_HAVE_SIMD_FUNCTIONS
+
+enum SimdFunctionsType {
+  kSimdFunctionsScalar,
+  kSimdFunctionsSse2,
+  kSimdFunctionsAvx2
+};
+
+static bool g_simd_functions_enabled = true;
+
+static SimdFunctionsType DetectSimdFunctionsType() {
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kSimdFunctionsAvx2;
+#endif
+  return kSimdFunctionsSse2;
+#else
+  return kSimdFunctionsScalar;
+#endif
+}
+
+static inline SimdFunctionsType GetSimdFunctionsType() {
+  // The detection is idempotent, so it does not matter if several threads
+  // happen to do it at the same time.
+  static SimdFunctionsType type = DetectSimdFunctionsType();
+  return (g_simd_functions_enabled ? type : kSimdFunctionsScalar);
+}
+
+std::string SimdFunctionsImplementation() {
+  switch (GetSimdFunctionsType()) {
+    case kSimdFunctionsAvx2: return "avx2";
+    case kSimdFunctionsSse2: return "sse2";
+    default: return "scalar";
+  }
+}
+
+void SetSimdFunctionsEnabled(bool enabled) {
+  g_simd_functions_enabled = enabled;
+}
+
+// The generic templates are the scalar reference path; they are only
+// specialized for float.
+#define KALDI_SCALAR_APPLY_FUNCTION(Name)                                     \
+  template<typename Real>                                                     \
+  void Vec##Name(const Real *x, Real *y, MatrixIndexT n) {                    \
+    for (MatrixIndexT i = 0; i < n; i++)                                      \
+      y[i] = Scalar##Name(x[i]);                                              \
+  }
+
+KALDI_SCALAR_APPLY_FUNCTION(Exp)
+KALDI_SCALAR_APPLY_FUNCTION(Log)
+KALDI_SCALAR_APPLY_FUNCTION(Sigmoid)
+KALDI_SCALAR_APPLY_FUNCTION(Tanh)
+KALDI_SCALAR_APPLY_FUNCTION(SoftHinge)
+
+#undef KALDI_SCALAR_APPLY_FUNCTION
+
+template<typename Real>
+double VecSumExp(const Real *x, MatrixIndexT n, Real offset, Real cutoff) {
+  double sum = 0.0;
+  for (MatrixIndexT i = 0; i < n; i++) {
+    BaseFloat f = x[i];
+    if (f >= cutoff)
+      sum += Exp(f - offset);
+  }
+  return sum;
+}
+
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS
+
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS_AVX2
+#define KALDI_SIMD_DISPATCH_AVX2(call)                                        \
+  case kSimdFunctionsAvx2: simd_avx2::call; return;
+#else
+#define KALDI_SIMD_DISPATCH_AVX2(call)
+#endif
+
+#define KALDI_SIMD_DISPATCH_FUNCTION(Name)                                    \
+  template<>                                                                  \
+  void Vec##Name(const float *x, float *y, MatrixIndexT n) {                  \
+    switch (GetSimdFunctionsType()) {                                         \
+      KALDI_SIMD_DISPATCH_AVX2(Vec##Name(x, y, n))                            \
+      case kSimdFunctionsSse2: simd_sse2::Vec##Name(x, y, n); return;         \
+      default:                                                                \
+        for (MatrixIndexT i = 0; i < n; i++)                                  \
+          y[i] = Scalar##Name(x[i]);                                          \
+    }                                                                         \
+  }
+
+KALDI_SIMD_DISPATCH_FUNCTION(Exp)
+KALDI_SIMD_DISPATCH_FUNCTION(Log)
+KALDI_SIMD_DISPATCH_FUNCTION(Sigmoid)
+KALDI_SIMD_DISPATCH_FUNCTION(Tanh)
+KALDI_SIMD_DISPATCH_FUNCTION(SoftHinge)
+
+#undef KALDI_SIMD_DISPATCH_FUNCTION
+#undef KALDI_SIMD_DISPATCH_AVX2
+
+template<>
+double VecSumExp(const float *x, MatrixIndexT n, float offset, float cutoff) {
+  switch (GetSimdFunctionsType()) {
+#ifdef KALDI_HAVE_SIMD_FUNCTIONS_AVX2
+    case kSimdFunctionsAvx2:
+      return simd_avx2::VecSumExp(x, n, offset, cutoff);
+#endif
+    case kSimdFunctionsSse2:
+      return simd_sse2::VecSumExp(x, n, offset, cutoff);
+    default: {
+      double sum = 0.0;
+      for (MatrixIndexT i = 0; i < n; i++)
+        if (x[i] >= cutoff)
+          sum += Exp(x[i] - offset);
+      return sum;
+    }
+  }
+}
+
+#endif  // KALDI_HAVE_SIMD_FUNCTIONS
+
+template
+void VecExp(const float *x, float *y, MatrixIndexT n);
+template
+void VecExp(const double *x, double *y, MatrixIndexT n);
+template
+void VecLog(const float *x, float *y, MatrixIndexT n);
+template
+void VecLog(const double *x, double *y, MatrixIndexT n);
+template
+void VecSigmoid(const float *x, float *y, MatrixIndexT n);
+template
+void VecSigmoid(const double *x, double *y, MatrixIndexT n);
+template
+void VecTanh(const float *x, float *y, MatrixIndexT n);
+template
+void VecTanh(const double *x, double *y, MatrixIndexT n);
+template
+void VecSoftHinge(const float *x, float *y, MatrixIndexT n);
+template
+void VecSoftHinge(const double *x, double *y, MatrixIndexT n);
+template
+double VecSumExp(const float *x, MatrixIndexT n, float offset, float cutoff);
+template
+double VecSumExp(const double *x, MatrixIndexT n, double offset,
+                 double cutoff);
+
+}  // namespace kaldi
@@ -0,0 +1,98 @@
+// matrix/simd-functions.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SIMD_FUNCTIONS_H_
+#define KALDI_MATRIX_SIMD_FUNCTIONS_H_
+
+#include <string>
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/**
+   Element-wise transcendental functions on arrays, as used by VectorBase and
+   MatrixBase (ApplyExp, ApplyLog, Sigmoid, Tanh, SoftHinge, ApplySoftMax and
+   LogSumExp), and hence also by the CPU code paths of CuVectorBase and
+   CuMatrixBase.  The input and output arrays may be identical but must not
+   otherwise overlap.
+
+   For float, when compiled with GCC or clang on x86, these use polynomial
+   approximations evaluated on several elements at once: 8 at a time with
+   AVX2/FMA if the CPU supports it (this is detected at run time), and 4 at a
+   time with SSE2 otherwise.  Elements outside the range where the
+   approximations are valid (NaN, infinities, zero, denormal and negative
+   inputs to log, arguments to exp below -87 or above 88, ...) are passed to
+   the scalar reference path, so those special cases give exactly the same
+   results as before.  For double, and when SIMD is not available or has been
+   disabled with SetSimdFunctionsEnabled(false), the scalar reference path
+   (libm via base/kaldi-math.h) is used for everything.
+
+   Error bounds of the SIMD approximations, as checked in matrix-lib-test
+   (the measured maxima are about half of these):
+    - exp:        relative error < 2e-7.
+    - log:        absolute error < 1e-7 for x in [0.5, 2], relative error
+                  < 2e-7 elsewhere.
+    - sigmoid:    absolute error < 2e-7, relative error < 4e-7.
+    - tanh:       absolute error < 2e-7, relative error < 4e-7.
+    - soft-hinge: absolute error < 1e-6 for x <= 10; for x > 10 it returns
+                  x, like the scalar version (absolute error < 5e-5).
+ */
+
+/// Sets y[i] = exp(x[i]) for 0 <= i < n.
+template<typename Real>
+void VecExp(const Real *x, Real *y, MatrixIndexT n);
+
+/// Sets y[i] = log(x[i]) for 0 <= i < n.  Negative inputs give NaN; the
+/// caller is responsible for checking for them if that is an error.
+template<typename Real>
+void VecLog(const Real *x, Real *y, MatrixIndexT n);
+
+/// Sets y[i] = 1 / (1 + exp(-x[i])) for 0 <= i < n.
+template<typename Real>
+void VecSigmoid(const Real *x, Real *y, MatrixIndexT n);
+
+/// Sets y[i] = tanh(x[i]) for 0 <= i < n.
+template<typename Real>
+void VecTanh(const Real *x, Real *y, MatrixIndexT n);
+
+/// Sets y[i] = log(1 + exp(x[i])) for 0 <= i < n.
+template<typename Real>
+void VecSoftHinge(const Real *x, Real *y, MatrixIndexT n);
+
+/// Returns the sum over i of exp(x[i] - offset), including only the elements
+/// with x[i] >= cutoff.  The sum is accumulated in double precision in the
+/// order i = 0, 1, ..., n-1.
+template<typename Real>
+double VecSumExp(const Real *x, MatrixIndexT n, Real offset, Real cutoff);
+
+/// Returns the name of the implementation the float versions of the functions
+/// above currently use: "avx2", "sse2" or "scalar".
+std::string SimdFunctionsImplementation();
+
+/// If enabled == false, the functions above use the scalar reference path
+/// even when SIMD is available; this is mainly for testing and benchmarking.
+/// It is not thread-safe with respect to concurrent calls of those functions.
+void SetSimdFunctionsEnabled(bool enabled);
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SIMD_FUNCTIONS_H_
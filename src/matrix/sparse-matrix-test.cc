@@ -0,0 +1,221 @@
+// matrix/sparse-matrix-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+// Returns a random sparse matrix, together with its dense version.
+template<typename Real>
+static void RandSparseMatrix(MatrixIndexT num_rows, MatrixIndexT num_cols,
+                             SparseMatrix<Real> *smat, Matrix<Real> *mat) {
+  std::vector<std::vector<std::pair<MatrixIndexT, Real> > > pairs(num_rows);
+  mat->Resize(num_rows, num_cols);
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    int32 n = rand() % 4;
+    for (int32 i = 0; i < n; i++) {
+      // Repeated columns are allowed, and are summed.
+      MatrixIndexT c = rand() % num_cols;
+      Real value = RandGauss();
+      pairs[r].push_back(std::make_pair(c, value));
+      (*mat)(r, c) += value;
+    }
+  }
+  SparseMatrix<Real> tmp(num_cols, pairs);
+  smat->Swap(&tmp);
+}
+
+template<typename Real>
+static void UnitTestSparseVector() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT dim = 1 + rand() % 20;
+    Vector<Real> vec(dim);
+    std::vector<std::pair<MatrixIndexT, Real> > pairs;
+    for (int32 j = 0; j < 5; j++) {
+      MatrixIndexT idx = rand() % dim;
+      Real value = RandGauss();
+      pairs.push_back(std::make_pair(idx, value));
+      vec(idx) += value;
+    }
+    SparseVector<Real> svec(dim, pairs);
+    KALDI_ASSERT(svec.NumElements() <= 5);
+    AssertEqual(svec.Sum(), vec.Sum());
+
+    Vector<Real> vec2(dim);
+    svec.CopyElementsToVec(&vec2);
+    AssertEqual(vec, vec2);
+    svec.AddToVec(2.0, &vec2);
+    vec.Scale(3.0);
+    AssertEqual(vec, vec2);
+
+    Vector<Real> other(dim);
+    other.SetRandn();
+    AssertEqual(VecSvec(other, svec), VecVec(other, vec) / 3.0);
+
+    MatrixIndexT max_index, max_index2;
+    Real max = svec.Max(&max_index);
+    Real max2 = vec.Max(&max_index2);
+    AssertEqual(max, max2 / 3.0);
+    KALDI_ASSERT(max_index == max_index2);
+
+    SparseVector<Real> svec2(vec);
+    svec2.Scale(1.0 / 3.0);
+    Vector<Real> vec3(dim);
+    svec2.CopyElementsToVec(&vec3);
+    vec.Scale(1.0 / 3.0);
+    AssertEqual(vec, vec3);
+  }
+}
+
+template<typename Real>
+static void UnitTestSparseMatrixAdd() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT num_rows = 1 + rand() % 10, num_cols = 1 + rand() % 10;
+    SparseMatrix<Real> smat;
+    Matrix<Real> mat;
+    RandSparseMatrix(num_rows, num_cols, &smat, &mat);
+    KALDI_ASSERT(smat.NumRows() == num_rows && smat.NumCols() == num_cols);
+    AssertEqual(smat.Sum(), mat.Sum());
+    AssertEqual(smat.FrobeniusNorm(), mat.FrobeniusNorm());
+
+    Matrix<Real> mat2(num_rows, num_cols), mat3(num_cols, num_rows);
+    smat.CopyToMat(&mat2);
+    AssertEqual(mat, mat2);
+    smat.CopyToMat(&mat3, kTrans);
+    Matrix<Real> mat_trans(mat, kTrans);
+    AssertEqual(mat_trans, mat3);
+
+    mat2.SetRandn();
+    Matrix<Real> mat2_copy(mat2);
+    mat2.AddSmat(0.5, smat);
+    mat2_copy.AddMat(0.5, mat);
+    AssertEqual(mat2, mat2_copy);
+    mat3.AddSmat(-1.0, smat, kTrans);
+    KALDI_ASSERT(mat3.IsZero());
+
+    SparseMatrix<Real> smat2(mat);
+    Matrix<Real> mat4(num_rows, num_cols);
+    smat2.CopyToMat(&mat4);
+    AssertEqual(mat, mat4);
+    for (MatrixIndexT r = 0; r < num_rows; r++) {
+      Vector<Real> row(num_cols), row2(mat.Row(r));
+      smat.Row(r).CopyElementsToVec(&row);
+      AssertEqual(row, row2);
+    }
+  }
+}
+
+template<typename Real>
+static void UnitTestSparseMatrixMul() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT m = 1 + rand() % 10, n = 1 + rand() % 10,
+        k = 1 + rand() % 10;
+    Real alpha = RandGauss(), beta = (i % 2 == 0 ? 0.0 : RandGauss());
+    SparseMatrix<Real> sA;
+    Matrix<Real> A;
+    Matrix<Real> B(k, n), C(m, n), D(n, k);
+    B.SetRandn();
+    C.SetRandn();
+    D.SetRandn();
+
+    // C = beta C + alpha A B, A is m by k.
+    RandSparseMatrix(m, k, &sA, &A);
+    Matrix<Real> C1(C), C2(C);
+    C1.AddSmatMat(alpha, sA, kNoTrans, B, beta);
+    C2.AddMatMat(alpha, A, kNoTrans, B, kNoTrans, beta);
+    AssertEqual(C1, C2);
+    // C = beta C + alpha A^T B, A is k by m.
+    RandSparseMatrix(k, m, &sA, &A);
+    C1.CopyFromMat(C);
+    C2.CopyFromMat(C);
+    C1.AddSmatMat(alpha, sA, kTrans, B, beta);
+    C2.AddMatMat(alpha, A, kTrans, B, kNoTrans, beta);
+    AssertEqual(C1, C2);
+
+    // E = beta E + alpha D A, D is n by k, A is k by m.
+    Matrix<Real> E(n, m);
+    E.SetRandn();
+    Matrix<Real> E1(E), E2(E);
+    E1.AddMatSmat(alpha, D, sA, kNoTrans, beta);
+    E2.AddMatMat(alpha, D, kNoTrans, A, kNoTrans, beta);
+    AssertEqual(E1, E2);
+    // E = beta E + alpha D A^T, A is m by k.
+    RandSparseMatrix(m, k, &sA, &A);
+    E1.CopyFromMat(E);
+    E2.CopyFromMat(E);
+    E1.AddMatSmat(alpha, D, sA, kTrans, beta);
+    E2.AddMatMat(alpha, D, kNoTrans, A, kTrans, beta);
+    AssertEqual(E1, E2);
+
+    // tr(F A) and tr(G A^T), A is m by k.
+    Matrix<Real> F(k, m), G(m, k);
+    F.SetRandn();
+    G.SetRandn();
+    AssertEqual(TraceMatSmat(F, sA, kNoTrans), TraceMatMat(F, A, kNoTrans));
+    AssertEqual(TraceMatSmat(G, sA, kTrans), TraceMatMat(G, A, kTrans));
+  }
+}
+
+template<typename Real>
+static void UnitTestSparseMatrixIo() {
+  for (int32 i = 0; i < 10; i++) {
+    bool binary = (i % 2 == 0);
+    SparseMatrix<Real> smat;
+    Matrix<Real> mat;
+    RandSparseMatrix(1 + rand() % 10, 1 + rand() % 10, &smat, &mat);
+    SparseVector<Real> svec(smat.Row(0));
+    std::ostringstream os;
+    smat.Write(os, binary);
+    svec.Write(os, binary);
+
+    std::istringstream is(os.str());
+    SparseMatrix<Real> smat2;
+    SparseVector<Real> svec2;
+    smat2.Read(is, binary);
+    svec2.Read(is, binary);
+    KALDI_ASSERT(smat2.NumRows() == smat.NumRows() &&
+                 smat2.NumCols() == smat.NumCols() &&
+                 smat2.NumElements() == smat.NumElements());
+    Matrix<Real> mat2(smat2.NumRows(), smat2.NumCols());
+    smat2.CopyToMat(&mat2);
+    AssertEqual(mat, mat2);
+    KALDI_ASSERT(svec2.Dim() == svec.Dim() &&
+                 svec2.NumElements() == svec.NumElements());
+    Vector<Real> vec(svec.Dim()), vec2(svec.Dim());
+    svec.CopyElementsToVec(&vec);
+    svec2.CopyElementsToVec(&vec2);
+    AssertEqual(vec, vec2);
+  }
+}
+
+template<typename Real>
+static void SparseMatrixUnitTest() {
+  UnitTestSparseVector<Real>();
+  UnitTestSparseMatrixAdd<Real>();
+  UnitTestSparseMatrixMul<Real>();
+  UnitTestSparseMatrixIo<Real>();
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (kaldi::int32 i = 0; i < 5; i++) {
+    kaldi::SparseMatrixUnitTest<float>();
+    kaldi::SparseMatrixUnitTest<double>();
+  }
+  KALDI_LOG << "Tests succeeded.";
+}
@@ -0,0 +1,362 @@
+// matrix/sparse-matrix.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "matrix/sparse-matrix.h"
+
+namespace kaldi {
+
+// Sorts the pairs on index and sums the values of pairs with the same index.
+template<typename Real>
+static void SortAndMergePairs(std::vector<std::pair<MatrixIndexT, Real> > *pairs) {
+  std::sort(pairs->begin(), pairs->end());
+  size_t n = pairs->size(), out = 0;
+  for (size_t in = 0; in < n; in++) {
+    if (out > 0 && (*pairs)[out - 1].first == (*pairs)[in].first)
+      (*pairs)[out - 1].second += (*pairs)[in].second;
+    else
+      (*pairs)[out++] = (*pairs)[in];
+  }
+  pairs->resize(out);
+}
+
+template<typename Real>
+SparseVector<Real>::SparseVector(
+    MatrixIndexT dim, const std::vector<std::pair<MatrixIndexT, Real> > &pairs):
+    dim_(dim), pairs_(pairs) {
+  SortAndMergePairs(&pairs_);
+  if (!pairs_.empty())
+    KALDI_ASSERT(pairs_.front().first >= 0 && pairs_.back().first < dim_);
+}
+
+template<typename Real>
+SparseVector<Real>::SparseVector(const VectorBase<Real> &vec):
+    dim_(vec.Dim()) {
+  const Real *data = vec.Data();
+  for (MatrixIndexT i = 0; i < dim_; i++)
+    if (data[i] != 0.0)
+      pairs_.push_back(std::make_pair(i, data[i]));
+}
+
+template<typename Real>
+Real SparseVector<Real>::Sum() const {
+  Real sum = 0.0;
+  for (size_t i = 0; i < pairs_.size(); i++)
+    sum += pairs_[i].second;
+  return sum;
+}
+
+template<typename Real>
+void SparseVector<Real>::Scale(Real alpha) {
+  for (size_t i = 0; i < pairs_.size(); i++)
+    pairs_[i].second *= alpha;
+}
+
+template<typename Real>
+Real SparseVector<Real>::Max(MatrixIndexT *index) const {
+  KALDI_ASSERT(dim_ > 0);
+  MatrixIndexT num_elements = pairs_.size();
+  Real ans = -std::numeric_limits<Real>::infinity();
+  MatrixIndexT ans_index = 0;
+  for (MatrixIndexT i = 0; i < num_elements; i++) {
+    if (pairs_[i].second > ans) {
+      ans = pairs_[i].second;
+      ans_index = pairs_[i].first;
+    }
+  }
+  if (num_elements < dim_ && ans <= 0.0) {
+    // The maximum is one of the zeros that are not stored; find the first.
+    MatrixIndexT i = 0;
+    while (i < num_elements && pairs_[i].first == i) i++;
+    if (ans < 0.0 || i < ans_index) {
+      ans = 0.0;
+      ans_index = i;
+    }
+  }
+  *index = ans_index;
+  return ans;
+}
+
+template<typename Real>
+void SparseVector<Real>::CopyElementsToVec(VectorBase<Real> *vec) const {
+  KALDI_ASSERT(vec->Dim() == dim_);
+  vec->SetZero();
+  AddToVec(1.0, vec);
+}
+
+template<typename Real>
+void SparseVector<Real>::AddToVec(Real alpha, VectorBase<Real> *vec) const {
+  KALDI_ASSERT(vec->Dim() == dim_);
+  Real *data = vec->Data();
+  for (size_t i = 0; i < pairs_.size(); i++)
+    data[pairs_[i].first] += alpha * pairs_[i].second;
+}
+
+template<typename Real>
+void SparseVector<Real>::Resize(MatrixIndexT dim) {
+  KALDI_ASSERT(dim >= 0);
+  dim_ = dim;
+  pairs_.clear();
+}
+
+template<typename Real>
+void SparseVector<Real>::Swap(SparseVector<Real> *other) {
+  std::swap(dim_, other->dim_);
+  pairs_.swap(other->pairs_);
+}
+
+template<typename Real>
+void SparseVector<Real>::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "SV");
+  WriteBasicType(os, binary, dim_);
+  MatrixIndexT num_elements = pairs_.size();
+  WriteBasicType(os, binary, num_elements);
+  for (MatrixIndexT i = 0; i < num_elements; i++) {
+    WriteBasicType(os, binary, pairs_[i].first);
+    WriteBasicType(os, binary, pairs_[i].second);
+  }
+  if (!binary) os << '\n';
+}
+
+template<typename Real>
+void SparseVector<Real>::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "SV");
+  MatrixIndexT dim, num_elements;
+  ReadBasicType(is, binary, &dim);
+  ReadBasicType(is, binary, &num_elements);
+  if (dim < 0 || num_elements < 0 || num_elements > dim)
+    KALDI_ERR << "Bad sparse vector: dim = " << dim << ", num-elements = "
+              << num_elements;
+  dim_ = dim;
+  pairs_.resize(num_elements);
+  for (MatrixIndexT i = 0; i < num_elements; i++) {
+    ReadBasicType(is, binary, &(pairs_[i].first));
+    ReadBasicType(is, binary, &(pairs_[i].second));
+    if (pairs_[i].first < 0 || pairs_[i].first >= dim ||
+        (i > 0 && pairs_[i].first <= pairs_[i - 1].first))
+      KALDI_ERR << "Bad sparse vector: indexes out of range or not sorted.";
+  }
+}
+
+
+template<typename Real>
+SparseMatrix<Real>::SparseMatrix(
+    MatrixIndexT num_cols,
+    const std::vector<std::vector<std::pair<MatrixIndexT, Real> > > &pairs):
+    num_cols_(num_cols), row_offsets_(1, 0) {
+  KALDI_ASSERT(num_cols >= 0);
+  row_offsets_.reserve(pairs.size() + 1);
+  for (size_t r = 0; r < pairs.size(); r++)
+    AppendRow(SparseVector<Real>(num_cols, pairs[r]));
+}
+
+template<typename Real>
+SparseMatrix<Real>::SparseMatrix(const MatrixBase<Real> &mat):
+    num_cols_(mat.NumCols()), row_offsets_(1, 0) {
+  MatrixIndexT num_rows = mat.NumRows();
+  row_offsets_.reserve(num_rows + 1);
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    const Real *row_data = mat.RowData(r);
+    for (MatrixIndexT c = 0; c < num_cols_; c++) {
+      if (row_data[c] != 0.0) {
+        col_indices_.push_back(c);
+        values_.push_back(row_data[c]);
+      }
+    }
+    row_offsets_.push_back(values_.size());
+  }
+}
+
+template<typename Real>
+SparseVector<Real> SparseMatrix<Real>::Row(MatrixIndexT r) const {
+  KALDI_ASSERT(r >= 0 && r < NumRows());
+  std::vector<std::pair<MatrixIndexT, Real> > pairs;
+  pairs.reserve(RowNumElements(r));
+  for (MatrixIndexT k = row_offsets_[r]; k < row_offsets_[r + 1]; k++)
+    pairs.push_back(std::make_pair(col_indices_[k], values_[k]));
+  return SparseVector<Real>(num_cols_, pairs);
+}
+
+template<typename Real>
+void SparseMatrix<Real>::AppendRow(const SparseVector<Real> &row) {
+  KALDI_ASSERT(row.Dim() == num_cols_);
+  MatrixIndexT num_elements = row.NumElements();
+  for (MatrixIndexT i = 0; i < num_elements; i++) {
+    const std::pair<MatrixIndexT, Real> &p = row.GetElement(i);
+    col_indices_.push_back(p.first);
+    values_.push_back(p.second);
+  }
+  row_offsets_.push_back(values_.size());
+}
+
+template<typename Real>
+void SparseMatrix<Real>::Resize(MatrixIndexT num_rows, MatrixIndexT num_cols) {
+  KALDI_ASSERT(num_rows >= 0 && num_cols >= 0);
+  num_cols_ = num_cols;
+  row_offsets_.assign(num_rows + 1, 0);
+  col_indices_.clear();
+  values_.clear();
+}
+
+template<typename Real>
+Real SparseMatrix<Real>::Sum() const {
+  Real sum = 0.0;
+  for (size_t k = 0; k < values_.size(); k++)
+    sum += values_[k];
+  return sum;
+}
+
+template<typename Real>
+Real SparseMatrix<Real>::FrobeniusNorm() const {
+  Real sum = 0.0;
+  for (size_t k = 0; k < values_.size(); k++)
+    sum += values_[k] * values_[k];
+  return std::sqrt(sum);
+}
+
+template<typename Real>
+void SparseMatrix<Real>::Scale(Real alpha) {
+  for (size_t k = 0; k < values_.size(); k++)
+    values_[k] *= alpha;
+}
+
+template<typename Real>
+void SparseMatrix<Real>::CopyToMat(MatrixBase<Real> *mat,
+                                   MatrixTransposeType trans) const {
+  mat->SetZero();
+  mat->AddSmat(1.0, *this, trans);
+}
+
+template<typename Real>
+void SparseMatrix<Real>::Swap(SparseMatrix<Real> *other) {
+  std::swap(num_cols_, other->num_cols_);
+  row_offsets_.swap(other->row_offsets_);
+  col_indices_.swap(other->col_indices_);
+  values_.swap(other->values_);
+}
+
+template<typename Real>
+void SparseMatrix<Real>::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "SM");
+  MatrixIndexT num_rows = NumRows();
+  WriteBasicType(os, binary, num_rows);
+  WriteBasicType(os, binary, num_cols_);
+  if (!binary) os << '\n';
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    MatrixIndexT num_elements = RowNumElements(r);
+    WriteBasicType(os, binary, num_elements);
+    for (MatrixIndexT k = row_offsets_[r]; k < row_offsets_[r + 1]; k++) {
+      WriteBasicType(os, binary, col_indices_[k]);
+      WriteBasicType(os, binary, values_[k]);
+    }
+    if (!binary) os << '\n';
+  }
+}
+
+template<typename Real>
+void SparseMatrix<Real>::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "SM");
+  MatrixIndexT num_rows, num_cols;
+  ReadBasicType(is, binary, &num_rows);
+  ReadBasicType(is, binary, &num_cols);
+  if (num_rows < 0 || num_cols < 0)
+    KALDI_ERR << "Bad sparse matrix size " << num_rows << " by " << num_cols;
+  Resize(0, num_cols);
+  row_offsets_.reserve(num_rows + 1);
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    MatrixIndexT num_elements;
+    ReadBasicType(is, binary, &num_elements);
+    if (num_elements < 0 || num_elements > num_cols)
+      KALDI_ERR << "Bad sparse matrix: row " << r << " has " << num_elements
+                << " elements.";
+    for (MatrixIndexT i = 0; i < num_elements; i++) {
+      MatrixIndexT c;
+      Real value;
+      ReadBasicType(is, binary, &c);
+      ReadBasicType(is, binary, &value);
+      if (c < 0 || c >= num_cols || (i > 0 && c <= col_indices_.back()))
+        KALDI_ERR << "Bad sparse matrix: indexes out of range or not sorted.";
+      col_indices_.push_back(c);
+      values_.push_back(value);
+    }
+    row_offsets_.push_back(values_.size());
+  }
+}
+
+
+template<typename Real>
+Real VecSvec(const VectorBase<Real> &vec, const SparseVector<Real> &svec) {
+  KALDI_ASSERT(vec.Dim() == svec.Dim());
+  const Real *data = vec.Data();
+  const std::pair<MatrixIndexT, Real> *pairs = svec.Data();
+  MatrixIndexT num_elements = svec.NumElements();
+  Real ans = 0.0;
+  for (MatrixIndexT i = 0; i < num_elements; i++)
+    ans += data[pairs[i].first] * pairs[i].second;
+  return ans;
+}
+
+template<typename Real>
+Real TraceMatSmat(const MatrixBase<Real> &A, const SparseMatrix<Real> &B,
+                  MatrixTransposeType trans) {
+  MatrixIndexT num_rows = B.NumRows();
+  if (trans == kNoTrans) {
+    KALDI_ASSERT(A.NumRows() == B.NumCols() && A.NumCols() == num_rows);
+  } else {
+    KALDI_ASSERT(A.NumRows() == num_rows && A.NumCols() == B.NumCols());
+  }
+  const Real *A_data = A.Data();
+  MatrixIndexT A_stride = A.Stride();
+  Real ans = 0.0;
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    MatrixIndexT num_elements = B.RowNumElements(r);
+    if (num_elements == 0) continue;
+    const MatrixIndexT *indices = B.RowIndices(r);
+    const Real *values = B.RowValues(r);
+    if (trans == kNoTrans) {
+      // tr(A B) = sum_{r,c} A(c, r) B(r, c).
+      for (MatrixIndexT k = 0; k < num_elements; k++)
+        ans += A_data[indices[k] * A_stride + r] * values[k];
+    } else {
+      // tr(A B^T) = sum_{r,c} A(r, c) B(r, c).
+      const Real *A_row = A_data + r * A_stride;
+      for (MatrixIndexT k = 0; k < num_elements; k++)
+        ans += A_row[indices[k]] * values[k];
+    }
+  }
+  return ans;
+}
+
+template class SparseVector<float>;
+template class SparseVector<double>;
+template class SparseMatrix<float>;
+template class SparseMatrix<double>;
+
+template
+float VecSvec(const VectorBase<float> &vec, const SparseVector<float> &svec);
+template
+double VecSvec(const VectorBase<double> &vec, const SparseVector<double> &svec);
+
+template
+float TraceMatSmat(const MatrixBase<float> &A, const SparseMatrix<float> &B,
+                   MatrixTransposeType trans);
+template
+double TraceMatSmat(const MatrixBase<double> &A, const SparseMatrix<double> &B,
+                    MatrixTransposeType trans);
+
+}  // namespace kaldi
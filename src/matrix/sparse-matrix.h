@@ -0,0 +1,193 @@
+// matrix/sparse-matrix.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SPARSE_MATRIX_H_
+#define KALDI_MATRIX_SPARSE_MATRIX_H_ 1
+
+#include <utility>
+#include <vector>
+
+#include "matrix/matrix-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/kaldi-vector.h"
+
+namespace kaldi {
+
+/// \addtogroup matrix_group
+/// @{
+
+/// A sparse vector, stored as (index, value) pairs sorted on index, with no
+/// repeated indexes.  Elements that are not stored are zero.
+template<typename Real>
+class SparseVector {
+ public:
+  SparseVector(): dim_(0) { }
+
+  explicit SparseVector(MatrixIndexT dim): dim_(dim) { KALDI_ASSERT(dim >= 0); }
+
+  /// Initializes from a list of (index, value) pairs in any order; values
+  /// with the same index are summed (so e.g. a Posterior entry for one frame
+  /// can be given directly).
+  SparseVector(MatrixIndexT dim,
+               const std::vector<std::pair<MatrixIndexT, Real> > &pairs);
+
+  /// Initializes from the nonzero elements of a dense vector.
+  explicit SparseVector(const VectorBase<Real> &vec);
+
+  MatrixIndexT Dim() const { return dim_; }
+
+  /// Returns the number of stored elements.
+  MatrixIndexT NumElements() const { return pairs_.size(); }
+
+  /// Returns the i'th stored (index, value) pair, 0 <= i < NumElements().
+  const std::pair<MatrixIndexT, Real> &GetElement(MatrixIndexT i) const {
+    return pairs_[i];
+  }
+
+  /// Returns a pointer to the stored pairs (NULL if there are none).
+  const std::pair<MatrixIndexT, Real> *Data() const {
+    return (pairs_.empty() ? NULL : &(pairs_[0]));
+  }
+
+  Real Sum() const;
+
+  void Scale(Real alpha);
+
+  /// Returns the maximum over all Dim() elements, including those that are
+  /// not stored, and sets *index to its position.  Requires Dim() > 0.
+  Real Max(MatrixIndexT *index) const;
+
+  /// Sets *vec to the dense version of *this; vec->Dim() must equal Dim().
+  void CopyElementsToVec(VectorBase<Real> *vec) const;
+
+  /// Does *vec += alpha * *this; vec->Dim() must equal Dim().
+  void AddToVec(Real alpha, VectorBase<Real> *vec) const;
+
+  /// Sets the dimension and removes all the elements.
+  void Resize(MatrixIndexT dim);
+
+  void Swap(SparseVector<Real> *other);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Read(std::istream &is, bool binary);
+
+ private:
+  MatrixIndexT dim_;
+  std::vector<std::pair<MatrixIndexT, Real> > pairs_;
+};
+
+
+/// A sparse matrix in compressed-sparse-row (CSR) format: the column indexes
+/// and values of all the stored elements are held in two arrays, in row
+/// order and sorted on column within each row.  It is designed to be built
+/// once (e.g. from a Posterior) and then used in the sparse-times-dense
+/// routines MatrixBase::AddSmat(), MatrixBase::AddSmatMat(),
+/// MatrixBase::AddMatSmat() and TraceMatSmat(), or their CuMatrixBase
+/// equivalents.
+template<typename Real>
+class SparseMatrix {
+ public:
+  SparseMatrix(): num_cols_(0), row_offsets_(1, 0) { }
+
+  /// Initializes from one list of (column, value) pairs per row, in the
+  /// format of Posterior; the pairs within a row may be in any order, and
+  /// values with the same column are summed.
+  SparseMatrix(MatrixIndexT num_cols,
+               const std::vector<std::vector<std::pair<MatrixIndexT, Real> > >
+               &pairs);
+
+  /// Initializes from the nonzero elements of a dense matrix.
+  explicit SparseMatrix(const MatrixBase<Real> &mat);
+
+  MatrixIndexT NumRows() const { return row_offsets_.size() - 1; }
+
+  MatrixIndexT NumCols() const { return num_cols_; }
+
+  /// Returns the total number of stored elements.
+  MatrixIndexT NumElements() const { return values_.size(); }
+
+  /// Returns the number of stored elements in row r.
+  MatrixIndexT RowNumElements(MatrixIndexT r) const {
+    KALDI_PARANOID_ASSERT(static_cast<UnsignedMatrixIndexT>(r) <
+                          static_cast<UnsignedMatrixIndexT>(NumRows()));
+    return row_offsets_[r + 1] - row_offsets_[r];
+  }
+
+  /// Returns the column indexes of the stored elements of row r; only valid
+  /// if RowNumElements(r) > 0.
+  const MatrixIndexT *RowIndices(MatrixIndexT r) const {
+    return &(col_indices_[0]) + row_offsets_[r];
+  }
+
+  /// Returns the values of the stored elements of row r; only valid
+  /// if RowNumElements(r) > 0.
+  const Real *RowValues(MatrixIndexT r) const {
+    return &(values_[0]) + row_offsets_[r];
+  }
+
+  /// Returns a copy of row r.
+  SparseVector<Real> Row(MatrixIndexT r) const;
+
+  /// Appends a row; its dimension must equal NumCols().
+  void AppendRow(const SparseVector<Real> &row);
+
+  /// Sets the size to num_rows by num_cols, with no stored elements.
+  void Resize(MatrixIndexT num_rows, MatrixIndexT num_cols);
+
+  Real Sum() const;
+
+  Real FrobeniusNorm() const;
+
+  void Scale(Real alpha);
+
+  /// Sets *mat to the dense version of *this (or its transpose); mat must
+  /// already have the right size.
+  void CopyToMat(MatrixBase<Real> *mat,
+                 MatrixTransposeType trans = kNoTrans) const;
+
+  void Swap(SparseMatrix<Real> *other);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Read(std::istream &is, bool binary);
+
+ private:
+  MatrixIndexT num_cols_;
+  // row_offsets_ has NumRows() + 1 elements; the stored elements of row r are
+  // at positions row_offsets_[r] ... row_offsets_[r+1] - 1 of col_indices_
+  // and values_.
+  std::vector<MatrixIndexT> row_offsets_;
+  std::vector<MatrixIndexT> col_indices_;
+  std::vector<Real> values_;
+};
+
+
+/// Returns the dot product of a dense and a sparse vector.
+template<typename Real>
+Real VecSvec(const VectorBase<Real> &vec, const SparseVector<Real> &svec);
+
+/// Returns tr(A B), or tr(A B^T) if trans == kTrans, where B is sparse.
+template<typename Real>
+Real TraceMatSmat(const MatrixBase<Real> &A, const SparseMatrix<Real> &B,
+                  MatrixTransposeType trans = kNoTrans);
+
+/// @} end of \addtogroup matrix_group
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SPARSE_MATRIX_H_
@@ -47,7 +47,7 @@ void Xent::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &t
   // calculate cross_entropy (in GPU)
   xentropy_aux_ = net_out; // y
   xentropy_aux_.ApplyLog(); // log(y)
-  xentropy_aux_.MulElements(tgt_mat_device_); // t*log(y)
+  xentropy_aux_.MulElements(target); // t*log(y)
   log_post_tgt_.Resize(num_frames);
   log_post_tgt_.AddColSumMat(1.0,xentropy_aux_,0.0); // sum over cols (pdfs)
   log_post_tgt_host_.Resize(num_frames);
@@ -58,7 +58,7 @@ void Xent::Eval(const CuMatrix<BaseFloat> &net_out, const CuMatrix<BaseFloat> &t
   xentropy_aux_ = target; // t
   xentropy_aux_.Add(1e-99); // avoid log(0)
   xentropy_aux_.ApplyLog(); // log(t)
-  xentropy_aux_.MulElements(tgt_mat_device_); // t*log(t)
+  xentropy_aux_.MulElements(target); // t*log(t)
   log_post_tgt_.Resize(num_frames);
   log_post_tgt_.AddColSumMat(1.0,xentropy_aux_,0.0); // sum over cols (pdfs)
   log_post_tgt_host_.Resize(num_frames);
@@ -76,8 +76,7 @@ void Xent::Eval(const CuMatrix<BaseFloat>& net_out, const Posterior& post, CuMat
     num_pdf = net_out.NumCols();
   KALDI_ASSERT(num_frames == post.size());
 
-  // convert posterior to matrix
-  Matrix<BaseFloat> tgt_mat_host(num_frames, num_pdf, kSetZero); // zero-filled
+  // convert posterior to sparse matrix (repeated pdf-ids get summed)
   for (int32 t = 0; t < post.size(); t++) {
     for (int32 i = 0; i < post[t].size(); i++) {
       int32 pdf = post[t][i].first;
@@ -85,40 +84,47 @@ void Xent::Eval(const CuMatrix<BaseFloat>& net_out, const Posterior& post, CuMat
         KALDI_ERR << "Posterior pdf-id out of NN-output dimension, please check number of pdfs by 'hmm-info'."
                   << " nn-outputs : " << num_pdf << ", posterior pdf-id : " << pdf;
       }
-      tgt_mat_host(t, pdf) += post[t][i].second;
     }
   }
-  tgt_mat_device_ = tgt_mat_host; // -> GPU
+  SparseMatrix<BaseFloat> tgt_mat(num_pdf, post);
 
   // compute derivaitve w.r.t. pre-softmax activation (net_out - tgt)
   *diff = net_out;
-  diff->AddMat(-1.0, tgt_mat_device_);
+  diff->AddSmat(-1.0, tgt_mat);
 
   // evaluate the frame-level classification
   int32 correct=0;
   net_out.FindRowMaxId(&max_id_out_); // find max in nn-output
-  tgt_mat_device_.FindRowMaxId(&max_id_tgt_); // find max in targets
   max_id_out_host_.resize(num_frames);
-  max_id_tgt_host_.resize(num_frames);
   max_id_out_.CopyToVec(&max_id_out_host_);
-  max_id_tgt_.CopyToVec(&max_id_tgt_host_);
   // count frames where maxima match
   for(int32 i=0; i<num_frames; i++) {
-    if (max_id_tgt_host_[i] == max_id_out_host_[i]) correct++;
+    MatrixIndexT max_id_tgt;
+    tgt_mat.Row(i).Max(&max_id_tgt); // find max in targets
+    if (max_id_tgt == max_id_out_host_[i]) correct++;
   }
   // TODO calculate phone-level accuracy,
   // need to get shuffled phone-ids externally ...
 
-  // calculate cross_entropy (in GPU)
-  xentropy_aux_ = net_out; // y
-  xentropy_aux_.Add(1e-20); // avoid -inf
-  xentropy_aux_.ApplyLog(); // log(y)
-  xentropy_aux_.MulElements(tgt_mat_device_); // t*log(y)
-  log_post_tgt_.Resize(num_frames);
-  log_post_tgt_.AddColSumMat(1.0,xentropy_aux_,0.0); // sum over cols (pdfs)
-  log_post_tgt_host_.Resize(num_frames);
-  log_post_tgt_.CopyToVec(&log_post_tgt_host_);
-  double cross_entropy = -log_post_tgt_host_.Sum(); // sum over rows (frames)
+  // calculate cross_entropy, looking up only the outputs at the targets
+  std::vector<Int32Pair> tgt_indices;
+  std::vector<BaseFloat> tgt_weights, tgt_out;
+  tgt_indices.reserve(tgt_mat.NumElements());
+  tgt_weights.reserve(tgt_mat.NumElements());
+  for (int32 t = 0; t < num_frames; t++) {
+    MatrixIndexT num_elements = tgt_mat.RowNumElements(t);
+    for (MatrixIndexT i = 0; i < num_elements; i++) {
+      Int32Pair index;
+      index.first = t;
+      index.second = tgt_mat.RowIndices(t)[i];
+      tgt_indices.push_back(index);
+      tgt_weights.push_back(tgt_mat.RowValues(t)[i]);
+    }
+  }
+  net_out.Lookup(tgt_indices, &tgt_out);
+  double cross_entropy = 0.0;
+  for (size_t i = 0; i < tgt_out.size(); i++)
+    cross_entropy -= tgt_weights[i] * log(tgt_out[i] + 1e-20); // avoid -inf
 
   // calculate entropy (from Posterior)
   double entropy = 0.0;
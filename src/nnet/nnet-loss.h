@@ -66,14 +66,11 @@ class Xent {
 
   CuVector<BaseFloat> log_post_tgt_;
   Vector<BaseFloat>   log_post_tgt_host_;
-  CuMatrix<BaseFloat> tgt_mat_device_;
   CuMatrix<BaseFloat> xentropy_aux_;
 
   // frame classification buffers 
   CuArray<int32> max_id_out_;
   std::vector<int32> max_id_out_host_;
-  CuArray<int32> max_id_tgt_;
-  std::vector<int32> max_id_tgt_host_;
 
 };
 
@@ -28,6 +28,7 @@
 #include "decoder/training-graph-compiler.h"
 #include "nnet2/decodable-am-nnet.h"
 #include "lat/kaldi-lattice.h"
+#include "thread/kaldi-task-sequence.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -49,15 +50,14 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     std::string use_gpu = "yes";
-    BaseFloat beam = 200.0;
-    BaseFloat retry_beam = 0.0;
+    AlignConfig align_config;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     BaseFloat acoustic_scale = 1.0;
     BaseFloat transition_scale = 1.0;
     BaseFloat self_loop_scale = 1.0;
 
-    po.Register("beam", &beam, "Decoding beam");
-    po.Register("retry-beam", &retry_beam,
-                "Decoding beam for second try at alignment");
+    align_config.Register(&po);
+    sequencer_config.Register(&po);
     po.Register("transition-scale", &transition_scale,
                 "Transition-probability scale [relative to acoustics]");
     po.Register("acoustic-scale", &acoustic_scale,
@@ -73,12 +73,10 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
-    if (retry_beam != 0 && retry_beam <= beam)
-      KALDI_WARN << "Beams do not make sense: beam " << beam
-                 << ", retry-beam " << retry_beam;
-    
-    FasterDecoderOptions decode_opts;
-    decode_opts.beam = beam;  // Don't set the other options.
+    if (align_config.retry_beam != 0 &&
+        align_config.retry_beam <= align_config.beam)
+      KALDI_WARN << "Beams do not make sense: beam " << align_config.beam
+                 << ", retry-beam " << align_config.retry_beam;
 
 #if HAVE_CUDA==1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
@@ -91,8 +89,8 @@ int main(int argc, char *argv[]) {
         scores_wspecifier = po.GetOptArg(5);
 
 
-    int num_success = 0, num_no_feat = 0, num_other_error = 0;
-    BaseFloat tot_like = 0.0;
+    int num_success = 0, num_no_feat = 0, num_other_error = 0, num_retry = 0;
+    double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
 
     {
@@ -110,26 +108,33 @@ int main(int argc, char *argv[]) {
       Int32VectorWriter alignment_writer(alignment_wspecifier);
       BaseFloatWriter scores_writer(scores_wspecifier);
 
-      for (; !fst_reader.Done(); fst_reader.Next()) {
-        std::string key = fst_reader.Key();
-        if (!feature_reader.HasKey(key)) {
-          num_no_feat++;
-          KALDI_WARN << "No features for utterance " << key;
-        } else {
+      {
+        // The sequencer is only used if --num-threads > 1; it runs the
+        // alignments in parallel, and writes them in the original order.
+        TaskSequencer<AlignUtteranceClass> sequencer(sequencer_config);
+
+        for (; !fst_reader.Done(); fst_reader.Next()) {
+          std::string key = fst_reader.Key();
+          if (!feature_reader.HasKey(key)) {
+            num_no_feat++;
+            KALDI_WARN << "No features for utterance " << key;
+            continue;
+          }
           const CuMatrix<BaseFloat> &features = feature_reader.Value(key);
-          VectorFst<StdArc> decode_fst(fst_reader.Value());
-          fst_reader.FreeCurrent();  // this stops copy-on-write of the fst
-          // by deleting the fst inside the reader, since we're about to mutate
-          // the fst by adding transition probs.
-
           if (features.NumRows() == 0) {
             KALDI_WARN << "Zero-length utterance: " << key;
             num_other_error++;
             continue;
           }
-          if (decode_fst.Start() == fst::kNoStateId) {
+          VectorFst<StdArc> *decode_fst =
+              new VectorFst<StdArc>(fst_reader.Value());
+          fst_reader.FreeCurrent();  // this stops copy-on-write of the fst
+          // by deleting the fst inside the reader, since we're about to mutate
+          // the fst by adding transition probs.
+          if (decode_fst->Start() == fst::kNoStateId) {
             KALDI_WARN << "Empty decoding graph for " << key;
             num_other_error++;
+            delete decode_fst;
             continue;
           }
 
@@ -137,63 +142,40 @@ int main(int argc, char *argv[]) {
             std::vector<int32> disambig_syms;  // empty.
             AddTransitionProbs(trans_model, disambig_syms,
                                transition_scale, self_loop_scale,
-                               &decode_fst);
+                               decode_fst);
           }
 
-          // SimpleDecoder decoder(decode_fst, beam);
-          FasterDecoder decoder(decode_fst, decode_opts);
-          // makes it a bit faster: 37 sec -> 26 sec on 1000 RM utterances @ beam 200.
-
-          CuVector<BaseFloat> empty_spk_info; // TODO: add support for speaker vectors.
           bool pad_input = true;
-          DecodableAmNnet nnet_decodable(trans_model, am_nnet, features, empty_spk_info,
-                                         pad_input, acoustic_scale);
-          decoder.Decode(&nnet_decodable);
-
-          VectorFst<LatticeArc> decoded;  // linear FST.
-          bool ans = decoder.ReachedFinal() // consider only final states.
-              && decoder.GetBestPath(&decoded);  
-          if (!ans && retry_beam != 0.0) {
-            KALDI_WARN << "Retrying utterance " << key << " with beam " << retry_beam;
-            decode_opts.beam = retry_beam;
-            decoder.SetOptions(decode_opts);
-            decoder.Decode(&nnet_decodable);
-            ans = decoder.ReachedFinal() // consider only final states.
-                && decoder.GetBestPath(&decoded);  
-            decode_opts.beam = beam;
-            decoder.SetOptions(decode_opts);
-          }
-          if (ans) {
-            std::vector<int32> alignment;
-            std::vector<int32> words;
-            LatticeWeight weight;
-            frame_count += features.NumRows();
-
-            GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-            BaseFloat like = -(weight.Value1()+weight.Value2()) / acoustic_scale;
-            tot_like += like;
-            if (scores_writer.IsOpen())
-              scores_writer.Write(key, -(weight.Value1()+weight.Value2()));
-            alignment_writer.Write(key, alignment);
-            num_success ++;
-            KALDI_VLOG(2) << "Log-like per frame for utterance " << key 
-                          << " is " << (like / features.NumRows()) << " over "
-                          << features.NumRows() << " frames.";
-            if (num_success % 50  == 0) {
-              KALDI_LOG << "Processed " << num_success << " utterances, "
-                        << "log-like per frame for " << key << " is "
-                        << (like / features.NumRows()) << " over "
-                        << features.NumRows() << " frames.";
-            }
+          if (sequencer_config.num_threads == 1) {
+            CuVector<BaseFloat> empty_spk_info; // TODO: add support for speaker vectors.
+            DecodableAmNnet nnet_decodable(trans_model, am_nnet, features,
+                                           empty_spk_info, pad_input,
+                                           acoustic_scale);
+            AlignUtteranceWrapper(align_config, key, acoustic_scale,
+                                  *decode_fst, &nnet_decodable,
+                                  &alignment_writer, &scores_writer,
+                                  &num_success, &num_other_error, &num_retry,
+                                  &tot_like, &frame_count);
+            delete decode_fst;
           } else {
-            KALDI_WARN << "Did not successfully decode file " << key << ", len = "
-                       << (features.NumRows());
-            num_other_error++;
+            // The nnet computation is done lazily, in the sequencer's thread.
+            DecodableAmNnetParallel *nnet_decodable = new DecodableAmNnetParallel(
+                trans_model, am_nnet,
+                new CuMatrix<BaseFloat>(features),
+                new CuVector<BaseFloat>(),
+                pad_input, acoustic_scale);
+            sequencer.Run(new AlignUtteranceClass(
+                align_config, key, acoustic_scale,
+                decode_fst, nnet_decodable,  // takes ownership of these two.
+                &alignment_writer, &scores_writer, &num_success,
+                &num_other_error, &num_retry, &tot_like, &frame_count));
           }
         }
-      }
+      }  // the sequencer's destructor waits for the remaining alignments.
       KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count)
                 << " over " << frame_count<< " frames.";
+      KALDI_LOG << "Retried " << num_retry << " out of "
+                << (num_success + num_other_error) << " utterances.";
       KALDI_LOG << "Done " << num_success << ", could not find features for "
                 << num_no_feat << ", other errors on " << num_other_error;
     }
@@ -23,6 +23,7 @@
 #include "util/common-utils.h"
 #include "util/timer.h"
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-parallel.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -64,6 +65,9 @@ int main(int argc, char *argv[]) {
 
     std::string use_gpu="yes";
     po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
+
+    int32 cpu_threads = 1;
+    po.Register("cpu-threads", &cpu_threads, "Number of threads for the row-wise matrix operations (softmax, sigmoid, ...) when not using a GPU");
     
     po.Read(argc, argv);
 
@@ -90,6 +94,7 @@ int main(int argc, char *argv[]) {
     CuDevice::Instantiate().SelectGpuId(use_gpu);
     CuDevice::Instantiate().DisableCaching();
 #endif
+    SetCuCpuNumThreads(cpu_threads);
 
     Nnet nnet_transf;
     if(feature_transform != "") {
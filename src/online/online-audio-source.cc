@@ -29,6 +29,32 @@
 
 namespace kaldi {
 
+bool OnlineAudioSourceItf::ReadToBuffer(int32 num_samples,
+                                        RingBuffer<BaseFloat> *buffer) {
+  num_samples = std::min<size_t>(num_samples, buffer->WriteAvailable());
+  if (num_samples <= 0)
+    return true;
+  Vector<BaseFloat> data(num_samples);
+  bool ans = Read(&data);
+  buffer->Write(data.Data(), data.Dim());
+  return ans;
+}
+
+
+// Converts the n samples in the (up to) two regions of a ring buffer,
+// src1 and src2, to BaseFloat, writing them to the regions dest1 and dest2.
+static void ConvertRegions(const int16 *src1, size_t src_size1,
+                           const int16 *src2,
+                           BaseFloat *dest1, size_t dest_size1,
+                           BaseFloat *dest2, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    int16 sample = (i < src_size1 ? src1[i] : src2[i - src_size1]);
+    if (i < dest_size1) dest1[i] = static_cast<BaseFloat>(sample);
+    else dest2[i - dest_size1] = static_cast<BaseFloat>(sample);
+  }
+}
+
+
 // The actual PortAudio callback - delegates to OnlinePaSource->PaCallback()
 int PaCallback(const void *input, void *output,
                long unsigned frame_count,
@@ -85,7 +111,7 @@ OnlinePaSource::~OnlinePaSource() {
 }
 
 
-bool OnlinePaSource::Read(Vector<BaseFloat> *data) {
+OnlinePaSource::rbs_t OnlinePaSource::WaitForSamples(rbs_t nsamples_req) {
   if (!pa_started_) { // start stream the first time Read() is called
     PaError paerr = Pa_StartStream(pa_stream_);
     if (paerr != paNoError)
@@ -100,7 +126,6 @@ bool OnlinePaSource::Read(Vector<BaseFloat> *data) {
                     << "and " << samples_lost_ << " sample(s) were lost";
       samples_lost_ = noverflows_ = 0;
   }
-  uint32 nsamples_req = data->Dim(); // samples to request
   timed_out_ = false;
   while (true) {
     ring_buffer_size_t nsamples = PaUtil_GetRingBufferReadAvailable(&pa_ringbuf_);
@@ -117,16 +142,27 @@ bool OnlinePaSource::Read(Vector<BaseFloat> *data) {
     }
     Pa_Sleep(2);
   }
-  std::vector<int16> buf(nsamples_req);
-  rbs_t nsamples_rcv = PaUtil_ReadRingBuffer(&pa_ringbuf_, buf.data(), nsamples_req);
+  return nsamples_req;
+}
+
+
+bool OnlinePaSource::Read(Vector<BaseFloat> *data) {
+  rbs_t nsamples_req = WaitForSamples(data->Dim());
+  // Convert the samples straight from PortAudio's ring buffer.
+  void *src1, *src2;
+  rbs_t src_size1, src_size2;
+  rbs_t nsamples_rcv = PaUtil_GetRingBufferReadRegions(
+      &pa_ringbuf_, nsamples_req, &src1, &src_size1, &src2, &src_size2);
   if (nsamples_rcv != nsamples_req) {
     KALDI_WARN << "Requested: " << nsamples_req
                << "; Received: " << nsamples_rcv << " samples";
     // This would be a PortAudio error.
   }
-  data->Resize(nsamples_rcv);
-  for (int i = 0; i < nsamples_rcv; ++i)
-    (*data)(i) = static_cast<BaseFloat>(buf[i]);
+  data->Resize(nsamples_rcv, kUndefined);
+  ConvertRegions(static_cast<const int16*>(src1), src_size1,
+                 static_cast<const int16*>(src2),
+                 data->Data(), nsamples_rcv, NULL, nsamples_rcv);
+  PaUtil_AdvanceRingBufferReadIndex(&pa_ringbuf_, nsamples_rcv);
 
   return (nsamples_rcv != 0);
   // NOTE (Dan): I'm pretty sure this return value is not right, it could be
@@ -135,6 +171,27 @@ bool OnlinePaSource::Read(Vector<BaseFloat> *data) {
 }
 
 
+bool OnlinePaSource::ReadToBuffer(int32 num_samples,
+                                  RingBuffer<BaseFloat> *buffer) {
+  rbs_t nsamples_req = WaitForSamples(
+      std::min<size_t>(num_samples, buffer->WriteAvailable()));
+  void *src1, *src2;
+  rbs_t src_size1, src_size2;
+  rbs_t nsamples_rcv = PaUtil_GetRingBufferReadRegions(
+      &pa_ringbuf_, nsamples_req, &src1, &src_size1, &src2, &src_size2);
+  BaseFloat *dest1, *dest2;
+  size_t dest_size1, dest_size2;
+  buffer->GetWriteRegions(nsamples_rcv, &dest1, &dest_size1,
+                          &dest2, &dest_size2);
+  ConvertRegions(static_cast<const int16*>(src1), src_size1,
+                 static_cast<const int16*>(src2),
+                 dest1, dest_size1, dest2, nsamples_rcv);
+  PaUtil_AdvanceRingBufferReadIndex(&pa_ringbuf_, nsamples_rcv);
+  buffer->CommitWrite(nsamples_rcv);
+  return (nsamples_rcv != 0);
+}
+
+
 // Accepts the data and writes it to the ring buffer
 int OnlinePaSource::Callback(const void *input, void *output,
                              ring_buffer_size_t frame_count,
@@ -166,4 +223,15 @@ bool OnlineVectorSource::Read(Vector<BaseFloat> *data) {
   return (pos_ < src_.Dim());
 }
 
+
+bool OnlineVectorSource::ReadToBuffer(int32 num_samples,
+                                      RingBuffer<BaseFloat> *buffer) {
+  size_t n_elem = std::min<size_t>(std::min<size_t>(num_samples,
+                                                    src_.Dim() - pos_),
+                                   buffer->WriteAvailable());
+  buffer->Write(src_.Data() + pos_, n_elem);
+  pos_ += n_elem;
+  return (pos_ < src_.Dim());
+}
+
 } // namespace kaldi
@@ -27,6 +27,7 @@
 #include <pa_ringbuffer.h>
 
 #include "matrix/kaldi-vector.h"
+#include "thread/kaldi-ring-buffer.h"
 
 namespace kaldi {
 
@@ -52,6 +53,14 @@ class OnlineAudioSourceItf {
   //       returning data-- by that time, it will return as much data as it has.
   virtual bool Read(Vector<BaseFloat> *data) = 0;
 
+  // Like Read(), but writes up to "num_samples" samples straight into "buffer"
+  // (as its producer), so the caller does not need a new Vector for each
+  // chunk and can compute features from the buffer directly.  It reads fewer
+  // samples if the buffer does not have room for them.  The default
+  // implementation goes through Read(); the sources in this directory
+  // override it to avoid the intermediate copy.
+  virtual bool ReadToBuffer(int32 num_samples, RingBuffer<BaseFloat> *buffer);
+
   virtual ~OnlineAudioSourceItf() { }
 };
 
@@ -81,6 +90,7 @@ class OnlinePaSource : public OnlineAudioSourceItf {
 
   // Implementation of the OnlineAudioSourceItf
   bool Read(Vector<BaseFloat> *data);
+  bool ReadToBuffer(int32 num_samples, RingBuffer<BaseFloat> *buffer);
 
   // Making friends with the callback so it will be able to access a private
   // member function to delegate the processing
@@ -97,6 +107,10 @@ class OnlinePaSource : public OnlineAudioSourceItf {
   ~OnlinePaSource();
 
  private:
+  // Waits until nsamples_req samples are available in the PortAudio ring
+  // buffer, or the timeout expires; returns the number of samples to read.
+  rbs_t WaitForSamples(rbs_t nsamples_req);
+
   // The real PortAudio callback delegates to this one
   int Callback(const void *input, void *output,
                ring_buffer_size_t frame_count,
@@ -138,6 +152,7 @@ class OnlineVectorSource: public OnlineAudioSourceItf {
 
   // Implementation of the OnlineAudioSourceItf
   bool Read(Vector<BaseFloat> *data);
+  bool ReadToBuffer(int32 num_samples, RingBuffer<BaseFloat> *buffer);
 
  private:
   Vector<BaseFloat> src_;
@@ -471,6 +471,218 @@ bool OnlineDeltaInput::Compute(Matrix<BaseFloat> *output) {
 
 
 
+OnlineFeatureStage::OnlineFeatureStage(int32 dim):
+    cache_(1, dim), num_frames_(0), newest_frame_(0), history_(0),
+    finished_(false) { }
+
+
+bool OnlineFeatureStage::IsValidFrame(int32 frame) {
+  newest_frame_ = std::max(newest_frame_, frame);
+  while (frame >= num_frames_ && !finished_) {
+    int32 num_frames = num_frames_;
+    ComputeMoreFrames();
+    if (num_frames_ == num_frames && !finished_)
+      return false; // No input for now.
+  }
+  return (frame < num_frames_);
+}
+
+
+SubVector<BaseFloat> OnlineFeatureStage::GetFrame(int32 frame) {
+  if (frame >= num_frames_)
+    KALDI_ERR << "Attempt to get frame " << frame << " without checking "
+              << "its validity.";
+  if (frame < num_frames_ - cache_.NumRows())
+    KALDI_ERR << "Attempt to get frame " << frame << ", which has been "
+              << "discarded (use RequireHistory()).";
+  newest_frame_ = std::max(newest_frame_, frame);
+  return cache_.Row(frame % cache_.NumRows());
+}
+
+
+SubMatrix<BaseFloat> OnlineFeatureStage::NewFrames(int32 num_frames) {
+  KALDI_ASSERT(num_frames > 0 && !finished_);
+  int32 capacity = cache_.NumRows(),
+      oldest_needed = std::max(0, std::min(newest_frame_, num_frames_) -
+                                  history_),
+      min_capacity = num_frames_ + num_frames - oldest_needed;
+  if (min_capacity > capacity) {
+    // Grow the ring buffer, keeping the frames it has.  This only happens
+    // in the first few calls.
+    int32 new_capacity = std::max(min_capacity, 2 * capacity);
+    Matrix<BaseFloat> new_cache(new_capacity, cache_.NumCols(), kUndefined);
+    for (int32 t = std::max(0, num_frames_ - capacity); t < num_frames_; t++)
+      new_cache.Row(t % new_capacity).CopyFromVec(cache_.Row(t % capacity));
+    cache_.Swap(&new_cache);
+    capacity = new_capacity;
+  }
+  int32 row = num_frames_ % capacity;
+  num_frames = std::min(num_frames, capacity - row);
+  num_frames_ += num_frames;
+  return cache_.Range(row, num_frames, 0, cache_.NumCols());
+}
+
+
+void OnlineFeatInputStage::ComputeMoreFrames() {
+  batch_.Resize(batch_size_, Dim(), kUndefined);
+  bool more_data = input_->Compute(&batch_);
+  for (int32 i = 0; i < batch_.NumRows(); ) {
+    SubMatrix<BaseFloat> frames(NewFrames(batch_.NumRows() - i));
+    frames.CopyFromMat(batch_.Range(i, frames.NumRows(), 0, Dim()));
+    i += frames.NumRows();
+  }
+  if (!more_data)
+    SetFinished();
+}
+
+
+OnlineCmnStage::OnlineCmnStage(OnlineFeatureStage *input, int32 cmn_window,
+                               int32 min_window):
+    OnlineFeatureStage(input->Dim()), input_(input), cmn_window_(cmn_window),
+    min_window_(min_window), sum_(input->Dim()) {
+  KALDI_ASSERT(cmn_window >= min_window && min_window > 0);
+  // Frame t - cmn_window leaves the sum when we compute frame t.
+  input_->RequireHistory(cmn_window + 1);
+}
+
+
+void OnlineCmnStage::ComputeMoreFrames() {
+  int32 t = NumFramesReady();
+  // The first frames need the first min_window_ frames of input.
+  if (!input_->IsValidFrame(std::max(t, min_window_ - 1)) &&
+      !input_->IsFinished())
+    return; // No input for now.
+  int32 num_input_frames = input_->NumFramesReady();
+  if (t == 0 && num_input_frames > 0) {
+    for (int32 s = 0; s < std::min(min_window_, num_input_frames); s++)
+      sum_.AddVec(1.0, input_->GetFrame(s));
+  }
+  // We compute all the frames the input has ready.
+  while (t < num_input_frames) {
+    SubMatrix<BaseFloat> frames(NewFrames(num_input_frames - t));
+    for (int32 i = 0; i < frames.NumRows(); i++, t++) {
+      SubVector<BaseFloat> input_frame(input_->GetFrame(t)),
+          output_frame(frames, i);
+      // The same as OnlineCmnInput::OutputFrame().
+      int32 num_history_frames;
+      if (t < min_window_)
+        num_history_frames = std::min(min_window_, num_input_frames);
+      else
+        num_history_frames = std::min(t, cmn_window_);
+      output_frame.CopyFromVec(input_frame);
+      output_frame.AddVec(-1.0 / num_history_frames, sum_);
+      if (t >= min_window_)
+        sum_.AddVec(1.0, input_frame);
+      if (t >= cmn_window_)
+        sum_.AddVec(-1.0, input_->GetFrame(t - cmn_window_));
+    }
+  }
+  if (input_->IsFinished())
+    SetFinished();
+}
+
+
+OnlineLdaStage::OnlineLdaStage(OnlineFeatureStage *input,
+                               const Matrix<BaseFloat> &transform,
+                               int32 left_context,
+                               int32 right_context):
+    OnlineFeatureStage(transform.NumRows()), input_(input),
+    left_context_(left_context), right_context_(right_context) {
+  int32 input_dim = input->Dim(),
+      spliced_dim = input_dim * (left_context + 1 + right_context);
+  KALDI_ASSERT(left_context >= 0 && right_context >= 0);
+  if (transform.NumCols() == spliced_dim) {
+    linear_transform_ = transform;
+  } else if (transform.NumCols() == spliced_dim + 1) {
+    linear_transform_ = transform.Range(0, transform.NumRows(),
+                                        0, spliced_dim);
+    offset_.Resize(transform.NumRows());
+    offset_.CopyColFromMat(transform, spliced_dim);
+  } else {
+    KALDI_ERR << "Invalid parameters supplied to OnlineLdaStage";
+  }
+  input_->RequireHistory(left_context + right_context);
+}
+
+
+void OnlineLdaStage::ComputeMoreFrames() {
+  int32 t = NumFramesReady(), input_dim = input_->Dim();
+  if (!input_->IsValidFrame(t + right_context_) && !input_->IsFinished())
+    return; // No input for now.
+  int32 num_input_frames = input_->NumFramesReady(),
+      end = (input_->IsFinished() ? num_input_frames :
+             num_input_frames - right_context_);
+  if (end > t) {
+    // Splice the frames that are ready into consecutive rows; at the edges of
+    // the stream, the first or last frame is repeated.
+    int32 num_frames = end - t;
+    if (spliced_.NumRows() < num_frames)
+      spliced_.Resize(num_frames, linear_transform_.NumCols(), kUndefined);
+    for (int32 i = 0; i < num_frames; i++) {
+      for (int32 j = -left_context_; j <= right_context_; j++) {
+        int32 s = std::min(std::max(t + i + j, 0), num_input_frames - 1);
+        SubVector<BaseFloat> dest(spliced_.Row(i),
+                                  (j + left_context_) * input_dim, input_dim);
+        dest.CopyFromVec(input_->GetFrame(s));
+      }
+    }
+    for (int32 i = 0; i < num_frames; ) {
+      SubMatrix<BaseFloat> frames(NewFrames(num_frames - i));
+      SubMatrix<BaseFloat> spliced(spliced_, i, frames.NumRows(),
+                                   0, spliced_.NumCols());
+      frames.AddMatMat(1.0, spliced, kNoTrans,
+                       linear_transform_, kTrans, 0.0);
+      if (offset_.Dim() != 0)
+        frames.AddVecToRows(1.0, offset_);
+      i += frames.NumRows();
+    }
+  }
+  if (input_->IsFinished())
+    SetFinished();
+}
+
+
+OnlineDeltaStage::OnlineDeltaStage(const DeltaFeaturesOptions &delta_opts,
+                                   OnlineFeatureStage *input):
+    OnlineFeatureStage(input->Dim() * (delta_opts.order + 1)), input_(input),
+    opts_(delta_opts), delta_(delta_opts) {
+  input_->RequireHistory(2 * Context());
+}
+
+
+void OnlineDeltaStage::ComputeMoreFrames() {
+  int32 t = NumFramesReady(), context = Context();
+  if (!input_->IsValidFrame(t + context) && !input_->IsFinished())
+    return; // No input for now.
+  int32 num_input_frames = input_->NumFramesReady(),
+      end = (input_->IsFinished() ? num_input_frames :
+             num_input_frames - context);
+  if (end > t) {
+    // Gather the frames with their context, repeating the first or last frame
+    // at the edges of the stream, as ComputeDeltas() effectively does.
+    int32 num_frames = end - t, num_rows = num_frames + 2 * context;
+    if (context_.NumRows() < num_rows)
+      context_.Resize(num_rows, input_->Dim(), kUndefined);
+    SubMatrix<BaseFloat> input_frames(context_, 0, num_rows,
+                                      0, input_->Dim());
+    for (int32 i = 0; i < num_rows; i++) {
+      int32 s = std::min(std::max(t - context + i, 0), num_input_frames - 1);
+      input_frames.Row(i).CopyFromVec(input_->GetFrame(s));
+    }
+    for (int32 i = 0; i < num_frames; ) {
+      SubMatrix<BaseFloat> frames(NewFrames(num_frames - i));
+      for (int32 j = 0; j < frames.NumRows(); j++) {
+        SubVector<BaseFloat> output_frame(frames, j);
+        delta_.Process(input_frames, context + i + j, &output_frame);
+      }
+      i += frames.NumRows();
+    }
+  }
+  if (input_->IsFinished())
+    SetFinished();
+}
+
+
 void OnlineFeatureMatrix::GetNextFeatures() {
   if (finished_) return; // Nothing to do.
   
@@ -517,6 +729,16 @@ void OnlineFeatureMatrix::GetNextFeatures() {
 
 
 bool OnlineFeatureMatrix::IsValidFrame (int32 frame) {
+  if (stage_ != NULL) {
+    if (finished_) return (frame < stage_->NumFramesReady());
+    for (int32 iter = 0; iter < opts_.num_tries; iter++) {
+      if (stage_->IsValidFrame(frame)) return true;
+      if (stage_->IsFinished()) return false;
+    }
+    KALDI_WARN << "After " << opts_.num_tries << ", got no features, giving up.";
+    finished_ = true;
+    return false;
+  }
    KALDI_ASSERT(frame >= feat_offset_ &&
                "You are attempting to get expired frames.");
   if (frame < feat_offset_ + feat_matrix_.NumRows())
@@ -537,6 +759,8 @@ bool OnlineFeatureMatrix::IsValidFrame (int32 frame) {
 }
 
 SubVector<BaseFloat> OnlineFeatureMatrix::GetFrame(int32 frame) {
+  if (stage_ != NULL)
+    return stage_->GetFrame(frame);
   if (frame < feat_offset_)
     KALDI_ERR << "Attempting to get a discarded frame.";
   if (frame >= feat_offset_ + feat_matrix_.NumRows())
@@ -286,9 +286,10 @@ class OnlineFeInput : public OnlineFeatInputItf {
   E *extractor_; // the actual feature extractor used
   const int32 frame_size_;
   const int32 frame_shift_;
-  Vector<BaseFloat> wave_; // the samples to be passed for extraction
-  Vector<BaseFloat> wave_remainder_; // the samples remained from the previous
-                                     // feature batch
+  RingBuffer<BaseFloat> buffer_; // the samples not yet consumed: the remainder
+                                 // from the previous batch, and the new ones
+  Vector<BaseFloat> wave_; // used to make the samples contiguous, if they
+                           // wrap around the end of buffer_
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineFeInput);
 };
@@ -307,25 +308,39 @@ OnlineFeInput<E>::Compute(Matrix<BaseFloat> *output) {
     return true;
   }
 
-  // Prepare the input audio samples
+  // Read the audio samples into the buffer, after the remainder from the
+  // previous batch.
   int32 samples_req = frame_size_ + (nvec - 1) * frame_shift_;
-  Vector<BaseFloat> read_samples(samples_req);
+  buffer_.Reserve(samples_req);
+  int32 num_samples = buffer_.ReadAvailable();
+  bool ans = true;
+  if (num_samples < samples_req) {
+    ans = source_->ReadToBuffer(samples_req - num_samples, &buffer_);
+    num_samples = buffer_.ReadAvailable();
+  }
+  if (num_samples < frame_size_) {
+    output->Resize(0, 0);
+    return ans;
+  }
 
-  bool ans = source_->Read(&read_samples);
-  
-  Vector<BaseFloat> all_samples(wave_remainder_.Dim() + read_samples.Dim());
-  all_samples.Range(0, wave_remainder_.Dim()).CopyFromVec(wave_remainder_);
-  all_samples.Range(wave_remainder_.Dim(), read_samples.Dim()).
-      CopyFromVec(read_samples);
-  
-  // Extract the features
-  if (all_samples.Dim() >= frame_size_) {
-    extractor_->Compute(all_samples, 1.0, output, &wave_remainder_);
+  // Extract the features, straight from the buffer unless the samples wrap
+  // around its end.
+  const BaseFloat *data1, *data2;
+  size_t size1, size2;
+  buffer_.GetReadRegions(0, num_samples, &data1, &size1, &data2, &size2);
+  if (size2 == 0) {
+    SubVector<BaseFloat> wave(const_cast<BaseFloat*>(data1), num_samples);
+    extractor_->Compute(wave, 1.0, output);
   } else {
-    output->Resize(0, 0);
-    wave_remainder_ = all_samples;
+    if (wave_.Dim() < num_samples)
+      wave_.Resize(buffer_.Capacity(), kUndefined);
+    SubVector<BaseFloat> wave(wave_, 0, num_samples);
+    buffer_.Peek(0, num_samples, wave.Data());
+    extractor_->Compute(wave, 1.0, output);
   }
-  
+  // The remainder starts at the first frame that was not extracted.
+  buffer_.Consume(std::min(num_samples, output->NumRows() * frame_shift_));
+
   return ans;
 }
 
@@ -344,15 +359,176 @@ struct OnlineFeatureMatrixOptions {
   }
 };
 
+// The classes below form a pull-based alternative to the chain of
+// OnlineFeatInputItf objects above.  Instead of passing matrices of new frames
+// down the chain, each stage keeps the frames it has computed in a ring
+// buffer, and a frame is computed (from the frames of the previous stage) only
+// when someone asks for it or for a later frame.  Any recent frame can then
+// be looked at again without recomputing it, which is what a decoder needs.
+// A typical chain is
+//   OnlineFeatInputStage -> OnlineCmnStage -> OnlineLdaStage
+// (or OnlineDeltaStage), wrapped in an OnlineFeatureMatrix for the decodable.
+class OnlineFeatureStage {
+ public:
+  int32 Dim() const { return cache_.NumCols(); }
+
+  // Returns true if the frame exists, computing it (and the frames before it)
+  // if that has not been done yet.  Returns false if the stream ended before
+  // this frame, or if the input has no more data for now (e.g. the audio
+  // source timed out); IsFinished() tells which.
+  bool IsValidFrame(int32 frame);
+
+  // Returns a frame for which IsValidFrame() returned true.  The reference is
+  // only good until more frames are computed.  The frames kept are at least
+  // those within RequireHistory() frames of the newest frame asked for.
+  SubVector<BaseFloat> GetFrame(int32 frame);
+
+  // The number of frames computed so far.
+  int32 NumFramesReady() const { return num_frames_; }
+
+  // True if NumFramesReady() is the number of frames in the stream.
+  bool IsFinished() const { return finished_; }
+
+  // Makes the stage keep at least "num_frames" frames before the newest frame
+  // asked for; this is for the next stage, if it needs left context.
+  void RequireHistory(int32 num_frames) {
+    history_ = std::max(history_, num_frames);
+  }
+
+  virtual ~OnlineFeatureStage() { }
+
+ protected:
+  explicit OnlineFeatureStage(int32 dim);
+
+  // Called when a frame after the ones computed is asked for.  Computes one or
+  // more frames, writing them to the rows returned by NewFrames(), and calls
+  // SetFinished() when there will be no more.  If it does neither, there is no
+  // input for now.
+  virtual void ComputeMoreFrames() = 0;
+
+  // Returns the rows for the next "num_frames" frames, or for fewer of them
+  // if the ring buffer wraps around (then call it again for the rest).  The
+  // frames count as ready from here on.
+  SubMatrix<BaseFloat> NewFrames(int32 num_frames);
+
+  void SetFinished() { finished_ = true; }
+
+ private:
+  Matrix<BaseFloat> cache_; // Ring buffer: frame t is in row t % NumRows().
+  int32 num_frames_;
+  int32 newest_frame_; // The newest frame asked for.
+  int32 history_;
+  bool finished_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineFeatureStage);
+};
+
+
+// Makes an OnlineFeatInputItf (e.g. OnlineFeInput) the first stage of a chain.
+// It asks the input for opts.batch_size frames at a time; each call that
+// times out counts as "no input for now".
+class OnlineFeatInputStage: public OnlineFeatureStage {
+ public:
+  OnlineFeatInputStage(const OnlineFeatureMatrixOptions &opts,
+                       OnlineFeatInputItf *input):
+      OnlineFeatureStage(input->Dim()), batch_size_(opts.batch_size),
+      input_(input) { }
+
+ protected:
+  virtual void ComputeMoreFrames();
+
+ private:
+  int32 batch_size_;
+  OnlineFeatInputItf *input_;
+  Matrix<BaseFloat> batch_;
+};
+
+
+// Cepstral mean normalization, the same as OnlineCmnInput: frame t has the
+// mean of the cmn_window frames before it subtracted, or at the start of the
+// stream, the mean of the first min_window frames.
+class OnlineCmnStage: public OnlineFeatureStage {
+ public:
+  OnlineCmnStage(OnlineFeatureStage *input, int32 cmn_window,
+                 int32 min_window);
+
+ protected:
+  virtual void ComputeMoreFrames();
+
+ private:
+  OnlineFeatureStage *input_;
+  const int32 cmn_window_;
+  const int32 min_window_;
+  Vector<double> sum_; // Sum of the input frames the mean of the next frame
+                       // is taken over.
+};
+
+
+// Splices left_context + 1 + right_context frames of the input, and multiplies
+// them by "transform" (which may have an extra column for an offset, as for
+// OnlineLdaInput).  The frames that are ready are computed together: they are
+// spliced into consecutive rows of one matrix, which is multiplied by the
+// transform with a single matrix product, straight into the ring buffer.
+class OnlineLdaStage: public OnlineFeatureStage {
+ public:
+  OnlineLdaStage(OnlineFeatureStage *input,
+                 const Matrix<BaseFloat> &transform,
+                 int32 left_context,
+                 int32 right_context);
+
+ protected:
+  virtual void ComputeMoreFrames();
+
+ private:
+  OnlineFeatureStage *input_;
+  const int32 left_context_;
+  const int32 right_context_;
+  Matrix<BaseFloat> linear_transform_;
+  Vector<BaseFloat> offset_; // Empty if there is no offset.
+  Matrix<BaseFloat> spliced_; // Spliced input frames, reused between calls.
+};
+
+
+// Delta features, the same as OnlineDeltaInput.
+class OnlineDeltaStage: public OnlineFeatureStage {
+ public:
+  OnlineDeltaStage(const DeltaFeaturesOptions &delta_opts,
+                   OnlineFeatureStage *input);
+
+ protected:
+  virtual void ComputeMoreFrames();
+
+ private:
+  int32 Context() const { return opts_.order * opts_.window; }
+
+  OnlineFeatureStage *input_;
+  DeltaFeaturesOptions opts_;
+  DeltaFeatures delta_;
+  Matrix<BaseFloat> context_; // Input frames with context, reused.
+};
+
+
 // The class OnlineFeatureMatrix wraps something of type
-// OnlineFeatInputItf in a manner that is convenient for
-// a Decodable type to consume.
+// OnlineFeatInputItf, or the last stage of a chain of OnlineFeatureStage
+// objects, in a manner that is convenient for a Decodable type to consume.
 class OnlineFeatureMatrix {
  public:
   OnlineFeatureMatrix(const OnlineFeatureMatrixOptions &opts,
                       OnlineFeatInputItf *input):
-      opts_(opts), input_(input), feat_dim_(input->Dim()),
+      opts_(opts), input_(input), stage_(NULL), feat_dim_(input->Dim()),
       feat_offset_(0), finished_(false) { }
+
+  // With a stage, the frames come straight from its cache, so any frame the
+  // stage still keeps can be asked for; opts.batch_size is not used, and a
+  // timeout is retried opts.num_tries times, as with an OnlineFeatInputItf.
+  OnlineFeatureMatrix(const OnlineFeatureMatrixOptions &opts,
+                      OnlineFeatureStage *stage):
+      opts_(opts), input_(NULL), stage_(stage), feat_dim_(stage->Dim()),
+      feat_offset_(0), finished_(false) {
+    // Like GetNextFeatures(), keep the frame before the newest one, which
+    // may still be needed after IsLastFrame() looked at the next one.
+    stage_->RequireHistory(1);
+  }
   
   bool IsValidFrame (int32 frame); 
 
@@ -370,6 +546,7 @@ class OnlineFeatureMatrix {
   
   const OnlineFeatureMatrixOptions opts_;
   OnlineFeatInputItf *input_;
+  OnlineFeatureStage *stage_; // If not NULL, used instead of input_.
   int32 feat_dim_;
   Matrix<BaseFloat> feat_matrix_;
   int32 feat_offset_; // the offset of the first frame in the current batch
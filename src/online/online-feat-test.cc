@@ -243,6 +243,88 @@ void TestOnlineCmnInput() { // We're also testing OnlineCacheInput here.
 }
 
 
+// Reads all the frames of "stage", through an OnlineFeatureMatrix, checking
+// that the frames before the newest one stay available.
+void GetStageOutput(OnlineFeatureStage *stage, Matrix<BaseFloat> *output) {
+  OnlineFeatureMatrixOptions opts;
+  opts.num_tries = 100; // makes it very unlikely we'll get that many timeouts.
+  OnlineFeatureMatrix feature_matrix(opts, stage);
+  std::vector<Vector<BaseFloat> > frames;
+  while (feature_matrix.IsValidFrame(frames.size())) {
+    int32 t = frames.size();
+    frames.push_back(Vector<BaseFloat>(feature_matrix.GetFrame(t)));
+    if (t > 0)
+      KALDI_ASSERT(feature_matrix.GetFrame(t - 1).ApproxEqual(frames[t - 1]));
+  }
+  KALDI_ASSERT(stage->IsFinished());
+  output->Resize(frames.size(), stage->Dim());
+  for (size_t t = 0; t < frames.size(); t++)
+    output->Row(t).CopyFromVec(frames[t]);
+}
+
+// Checks that the OnlineFeatureStage chains give the same output as the
+// corresponding OnlineFeatInputItf chains.
+void TestOnlineFeatureStages() {
+  int32 dim = 2 + rand() % 5; // dimension of features.
+  int32 num_frames = 1 + rand() % 100;
+
+  Matrix<BaseFloat> input_feats(num_frames, dim);
+  input_feats.SetRandn();
+  OnlineFeatureMatrixOptions opts;
+  opts.batch_size = 1 + rand() % 30;
+  int32 cmn_window = 10 + rand() % 20;
+  int32 min_window = 1 + rand() % (cmn_window - 1);
+
+  {
+    OnlineMatrixInput matrix_input1(input_feats), matrix_input2(input_feats);
+    OnlineCmnInput cmn_input(&matrix_input1, cmn_window, min_window);
+    OnlineFeatInputStage input_stage(opts, &matrix_input2);
+    OnlineCmnStage cmn_stage(&input_stage, cmn_window, min_window);
+    Matrix<BaseFloat> output_feats1, output_feats2;
+    GetOutput(&cmn_input, &output_feats1);
+    GetStageOutput(&cmn_stage, &output_feats2);
+    AssertEqual(output_feats1, output_feats2);
+  }
+  {
+    int32 left_context = rand() % 5, right_context = rand() % 5;
+    bool have_offset = (rand() % 2 == 0);
+    Matrix<BaseFloat> transform(1 + rand() % 5,
+                                dim * (left_context + 1 + right_context) +
+                                (have_offset ? 1 : 0));
+    transform.SetRandn();
+    OnlineMatrixInput matrix_input1(input_feats), matrix_input2(input_feats);
+    OnlineLdaInput lda_input(&matrix_input1, transform,
+                             left_context, right_context);
+    OnlineFeatInputStage input_stage(opts, &matrix_input2);
+    OnlineLdaStage lda_stage(&input_stage, transform,
+                             left_context, right_context);
+    Matrix<BaseFloat> output_feats1, output_feats2;
+    GetOutput(&lda_input, &output_feats1);
+    GetStageOutput(&lda_stage, &output_feats2);
+    AssertEqual(output_feats1, output_feats2);
+  }
+  {
+    DeltaFeaturesOptions delta_opts;
+    delta_opts.order = rand() % 3;
+    delta_opts.window = 1 + rand() % 3;
+    OnlineMatrixInput matrix_input(input_feats);
+    OnlineFeatInputStage input_stage(opts, &matrix_input);
+    OnlineCmnStage cmn_stage(&input_stage, cmn_window, min_window);
+    OnlineDeltaStage delta_stage(delta_opts, &cmn_stage);
+    Matrix<BaseFloat> cmn_feats, output_feats1(num_frames,
+                                               dim * (delta_opts.order + 1)),
+        output_feats2;
+    {
+      OnlineMatrixInput matrix_input2(input_feats);
+      OnlineCmnInput cmn_input(&matrix_input2, cmn_window, min_window);
+      GetOutput(&cmn_input, &cmn_feats);
+    }
+    ComputeDeltas(delta_opts, cmn_feats, &output_feats1);
+    GetStageOutput(&delta_stage, &output_feats2);
+    AssertEqual(output_feats1, output_feats2);
+  }
+}
+
 
 }  // end namespace kaldi
 
@@ -254,6 +336,7 @@ int main() {
     TestOnlineLdaInput();
     TestOnlineDeltaInput();
     TestOnlineCmnInput(); // also tests cache input.
+    TestOnlineFeatureStages();
     // I have not tested the delta input yet.
   }
   std::cout << "Test OK.\n";
@@ -0,0 +1,119 @@
+// online/online-lattice-faster-decoder.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online/online-lattice-faster-decoder.h"
+#include "fstext/fstext-utils.h"
+#include "hmm/hmm-utils.h"
+
+namespace kaldi {
+
+// Presents the frames of a stream from "offset" on as frames 0, 1, ... of
+// an utterance, which is how LatticeFasterDecoder numbers them.
+class OffsetDecodable: public DecodableInterface {
+ public:
+  OffsetDecodable(DecodableInterface *decodable, int32 offset):
+      decodable_(decodable), offset_(offset) { }
+  virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+    return decodable_->LogLikelihood(frame + offset_, index);
+  }
+  virtual bool IsLastFrame(int32 frame) {
+    return decodable_->IsLastFrame(frame + offset_);
+  }
+  virtual int32 NumIndices() { return decodable_->NumIndices(); }
+ private:
+  DecodableInterface *decodable_;
+  int32 offset_;
+};
+
+
+OnlineLatticeFasterDecoder::OnlineLatticeFasterDecoder(
+    const fst::Fst<fst::StdArc> &fst,
+    const OnlineLatticeFasterDecoderOpts &opts,
+    const std::vector<int32> &sil_phones,
+    const TransitionModel &trans_model):
+    LatticeFasterDecoder(fst, opts), opts_(opts), silence_set_(sil_phones),
+    trans_model_(trans_model), state_(kEndFeats), frame_(0) {
+  InitDecoding();
+}
+
+
+OnlineLatticeFasterDecoder::DecodeState
+OnlineLatticeFasterDecoder::Decode(DecodableInterface *decodable) {
+  if (state_ == kEndFeats || state_ == kEndUtt) { // new utterance
+    if (state_ == kEndFeats)
+      frame_ = 0;
+    InitDecoding();
+  }
+  OffsetDecodable utt_decodable(decodable, utt_start_frame());
+  int32 num_frames = AdvanceDecoding(&utt_decodable, opts_.batch_size);
+  frame_ += num_frames;
+  if (num_frames == opts_.batch_size && !decodable->IsLastFrame(frame_ - 1)) {
+    if (EndOfUtterance())
+      state_ = kEndUtt;
+    else
+      state_ = kEndBatch;
+  } else {
+    state_ = kEndFeats;
+  }
+  if (state_ != kEndBatch)
+    FinalizeDecoding();
+  return state_;
+}
+
+
+bool OnlineLatticeFasterDecoder::GetCompactLattice(CompactLattice *clat) const {
+  clat->DeleteStates();
+  if (NumFramesDecoded() == 0)
+    return false;
+  if (opts_.determinize_period > 0) // most of it is determinized already.
+    return GetLattice(clat);
+  Lattice lat;
+  if (!GetRawLattice(&lat))
+    return false;
+  fst::Connect(&lat);
+  if (lat.Start() == fst::kNoStateId)
+    return false;
+  if (!DeterminizeLatticePhonePrunedWrapper(trans_model_, &lat,
+                                            opts_.lattice_beam, clat,
+                                            opts_.det_opts))
+    KALDI_WARN << "Determinization finished earlier than the beam";
+  return true;
+}
+
+
+bool OnlineLatticeFasterDecoder::EndOfUtterance() const {
+  fst::VectorFst<LatticeArc> trace;
+  int32 utt_frames = NumFramesDecoded();
+  int32 sil_frm = opts_.inter_utt_sil / (1 + utt_frames / opts_.max_utt_len_);
+  if (!GetBestPathTraceback(&trace, false, sil_frm))
+    return false;
+  std::vector<int32> isymbols;
+  fst::GetLinearSymbolSequence(trace, &isymbols,
+                               static_cast<std::vector<int32>* >(0),
+                               static_cast<LatticeArc::Weight*>(0));
+  std::vector<std::vector<int32> > split;
+  SplitToPhones(trans_model_, isymbols, &split);
+  for (size_t i = 0; i < split.size(); i++) {
+    int32 tid = split[i][0];
+    int32 phone = trans_model_.TransitionIdToPhone(tid);
+    if (silence_set_.count(phone) == 0)
+      return false;
+  }
+  return true;
+}
+
+} // namespace kaldi
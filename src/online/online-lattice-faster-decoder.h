@@ -0,0 +1,110 @@
+// online/online-lattice-faster-decoder.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_ONLINE_ONLINE_LATTICE_FASTER_DECODER_H_
+#define KALDI_ONLINE_ONLINE_LATTICE_FASTER_DECODER_H_
+
+#include <vector>
+#include "decoder/lattice-faster-decoder.h"
+#include "hmm/transition-model.h"
+#include "util/const-integer-set.h"
+
+namespace kaldi {
+
+// Extends LatticeFasterDecoder's options with those of the online decoding
+// and the silence-based utterance segmentation (these have the same meaning
+// as in OnlineFasterDecoderOpts).
+struct OnlineLatticeFasterDecoderOpts : public LatticeFasterDecoderConfig {
+  int32 batch_size; // number of features decoded in one go
+  int32 inter_utt_sil; // minimum silence (#frames) to trigger end of utterance
+  int32 max_utt_len_; // if utt. is longer, we accept shorter silence as utt. separators
+
+  OnlineLatticeFasterDecoderOpts():
+    batch_size(27), inter_utt_sil(50), max_utt_len_(1500) {}
+
+  void Register(OptionsItf *po) {
+    LatticeFasterDecoderConfig::Register(po);
+    po->Register("batch-size", &batch_size,
+                 "Number of frames decoded in each call to Decode()");
+    po->Register("inter-utt-sil", &inter_utt_sil,
+                 "Maximum # of silence frames to trigger new utterance");
+    po->Register("max-utt-length", &max_utt_len_,
+                 "If the utterance becomes longer than this number of frames, "
+                 "shorter silence is acceptable as an utterance separator");
+  }
+};
+
+/**
+   An online decoder that produces lattices.  Like OnlineFasterDecoder, it
+   decodes a stream of frames in batches, and splits it into utterances where
+   the best path ends in enough silence; but it keeps the whole lattice of the
+   current utterance (pruned every prune_interval frames, as in the offline
+   decoder), so that at the end of each utterance you can get its lattice,
+   e.g. for confidences or N-best lists, without decoding it again.  Between
+   batches, GetBestPathTraceback() gives the best path so far cheaply.
+ */
+class OnlineLatticeFasterDecoder : public LatticeFasterDecoder {
+ public:
+  // Codes returned by Decode() to show the current state of the decoder
+  enum DecodeState {
+    kEndFeats = 1, // No more scores are available from the Decodable
+    kEndUtt = 2, // End of utterance, caused by e.g. a sufficiently long silence
+    kEndBatch = 4 // End of batch - end of utterance not reached yet
+  };
+
+  // "sil_phones" - the IDs of all silence phones
+  OnlineLatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
+                             const OnlineLatticeFasterDecoderOpts &opts,
+                             const std::vector<int32> &sil_phones,
+                             const TransitionModel &trans_model);
+
+  /// Decodes up to opts.batch_size frames of "decodable", whose frames are
+  /// numbered from the start of the stream.  When it returns kEndUtt or
+  /// kEndFeats the utterance is finished (and FinalizeDecoding() has been
+  /// called), so you can get its lattice; the next call starts a new
+  /// utterance (and, after kEndFeats, a new stream).
+  DecodeState Decode(DecodableInterface *decodable);
+
+  /// Gets the lattice of the current utterance, determinized as in
+  /// DecodeUtteranceLatticeFaster() using the options in opts.det_opts (or,
+  /// if opts.determinize_period > 0, by GetLattice(), as most of it has been
+  /// determinized while decoding).  It is normally called after Decode()
+  /// returns kEndUtt or kEndFeats, but it can also be called between batches.
+  /// Returns false if there is no lattice.
+  bool GetCompactLattice(CompactLattice *clat) const;
+
+  /// Returns "true" if the best current hypothesis ends with long enough
+  /// silence.
+  bool EndOfUtterance() const;
+
+  /// The next frame of the stream to be decoded.
+  int32 frame() const { return frame_; }
+
+  /// The frame of the stream at which the current utterance started.
+  int32 utt_start_frame() const { return frame_ - NumFramesDecoded(); }
+
+ private:
+  const OnlineLatticeFasterDecoderOpts opts_;
+  const ConstIntegerSet<int32> silence_set_; // silence phones IDs
+  const TransitionModel &trans_model_; // needed for trans-id -> phone conversion
+  DecodeState state_; // the current state of the decoder
+  int32 frame_; // the next frame to be processed
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineLatticeFasterDecoder);
+};
+
+} // namespace kaldi
+#endif // KALDI_ONLINE_ONLINE_LATTICE_FASTER_DECODER_H_
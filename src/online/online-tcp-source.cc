@@ -21,6 +21,7 @@
 
 #include "online-tcp-source.h"
 #include <unistd.h>
+#include <algorithm>
 
 namespace kaldi {
 
@@ -122,6 +123,14 @@ int OnlineTcpVectorSource::FillFrame(int32 get_size) {
   return frame_offset;
 }
 
+void OnlineTcpVectorSource::ReserveFrame(int32 size) {
+  if (frame_size < size) {
+    frame_size = size;
+    delete[] frame;
+    frame = new char[frame_size];
+  }
+}
+
 bool OnlineTcpVectorSource::Read(Vector<BaseFloat> *data) {
   if (!connected)
     return false;
@@ -130,11 +139,7 @@ bool OnlineTcpVectorSource::Read(Vector<BaseFloat> *data) {
 
   int32 n_bytes = n_elem * 2;
 
-  if (frame_size < n_bytes) {
-    frame_size = n_bytes;
-    delete[] frame;
-    frame = new char[frame_size];
-  }
+  ReserveFrame(n_bytes);
 
   int32 b_read = FillFrame(n_bytes);
   int32 n_read = b_read / 2;
@@ -148,6 +153,33 @@ bool OnlineTcpVectorSource::Read(Vector<BaseFloat> *data) {
   return (n_read == n_elem);
 }
 
+bool OnlineTcpVectorSource::ReadToBuffer(int32 num_samples,
+                                         RingBuffer<BaseFloat> *buffer) {
+  if (!connected)
+    return false;
+
+  int32 n_elem = std::min<size_t>(num_samples, buffer->WriteAvailable());
+  int32 n_bytes = n_elem * 2;
+  ReserveFrame(n_bytes);
+
+  int32 n_read = FillFrame(n_bytes) / 2;
+
+  // convert the samples straight into the buffer's memory
+  BaseFloat *data1, *data2;
+  size_t size1, size2;
+  buffer->GetWriteRegions(n_read, &data1, &size1, &data2, &size2);
+  short* s_frame = (short*) frame;
+  for (size_t i = 0; i < size1; i++)
+    data1[i] = s_frame[i];
+  for (size_t i = 0; i < size2; i++)
+    data2[i] = s_frame[size1 + i];
+  buffer->CommitWrite(n_read);
+
+  samples_processed += n_read;
+
+  return (n_read == n_elem);
+}
+
 bool OnlineTcpVectorSource::IsConnected() {
   return connected;
 }
@@ -38,6 +38,7 @@ class OnlineTcpVectorSource : public OnlineAudioSourceItf {
 
   // Implementation of the OnlineAudioSourceItf
   bool Read(Vector<BaseFloat> *data);
+  bool ReadToBuffer(int32 num_samples, RingBuffer<BaseFloat> *buffer);
 
   //returns if the socket is still connected
   bool IsConnected();
@@ -65,6 +66,8 @@ class OnlineTcpVectorSource : public OnlineAudioSourceItf {
   int32 GetNextPack();
   //runs "getNextPack" enough times to fill the frame with "size" bytes
   int32 FillFrame(int32 size);
+  //makes sure "frame" can hold "size" bytes
+  void ReserveFrame(int32 size);
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineTcpVectorSource);
 };
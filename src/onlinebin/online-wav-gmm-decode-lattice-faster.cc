@@ -0,0 +1,245 @@
+// onlinebin/online-wav-gmm-decode-lattice-faster.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/feature-mfcc.h"
+#include "feat/wave-reader.h"
+#include "online/online-audio-source.h"
+#include "online/online-feat-input.h"
+#include "online/online-decodable.h"
+#include "online/online-lattice-faster-decoder.h"
+#include "online/onlinebin-util.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+
+    typedef kaldi::int32 int32;
+    typedef OnlineFeInput<Mfcc> FeInput;
+
+    // up to delta-delta derivative features are calculated (unless LDA is used)
+    const int32 kDeltaOrder = 2;
+
+    const char *usage =
+        "Reads in wav file(s) and simulates online decoding, producing a\n"
+        "lattice for each utterance (as well as the best path), so that no\n"
+        "second, offline pass is needed for confidences or N-best lists.\n"
+        "Utterance segmentation is done on-the-fly, as in\n"
+        "online-wav-gmm-decode-faster; the utterance keys are\n"
+        "<wav-key>_<start-frame>-<end-frame>.\n"
+        "Feature splicing/LDA transform is used, if the optional(last) argument "
+        "is given.\n"
+        "Otherwise delta/delta-delta(i.e. 2-nd order) features are produced.\n\n"
+        "Usage: online-wav-gmm-decode-lattice-faster [options] wav-rspecifier "
+        "model-in fst-in word-symbol-table silence-phones lattice-wspecifier "
+        "transcript-wspecifier alignments-wspecifier [lda-matrix-in]\n\n"
+        "Example: ./online-wav-gmm-decode-lattice-faster --max-active=4000 "
+        "--beam=12.0 --lattice-beam=6.0 --acoustic-scale=0.0769 "
+        "scp:wav.scp model HCLG.fst words.txt '1:2:3:4:5' ark:lat.ark "
+        "ark,t:trans.txt ark,t:ali.txt";
+    ParseOptions po(usage);
+    BaseFloat acoustic_scale = 0.1;
+    int32 cmn_window = 600,
+      min_cmn_window = 100; // adds 1 second latency, only at utterance start.
+    int32 channel = -1;
+    int32 right_context = 4, left_context = 4;
+
+    OnlineLatticeFasterDecoderOpts decoder_opts;
+    decoder_opts.Register(&po);
+    OnlineFeatureMatrixOptions feature_reading_opts;
+    feature_reading_opts.Register(&po);
+
+    po.Register("left-context", &left_context, "Number of frames of left context");
+    po.Register("right-context", &right_context, "Number of frames of right context");
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("cmn-window", &cmn_window,
+        "Number of feat. vectors used in the running average CMN calculation");
+    po.Register("min-cmn-window", &min_cmn_window,
+                "Minumum CMN window used at start of decoding (adds "
+                "latency only at start)");
+    po.Register("channel", &channel,
+        "Channel to extract (-1 -> expect mono, 0 -> left, 1 -> right)");
+    po.Read(argc, argv);
+    if (po.NumArgs() != 8 && po.NumArgs() != 9) {
+      po.PrintUsage();
+      return 1;
+    }
+
+    std::string wav_rspecifier = po.GetArg(1),
+        model_rspecifier = po.GetArg(2),
+        fst_rspecifier = po.GetArg(3),
+        word_syms_filename = po.GetArg(4),
+        silence_phones_str = po.GetArg(5),
+        lattice_wspecifier = po.GetArg(6),
+        words_wspecifier = po.GetArg(7),
+        alignment_wspecifier = po.GetArg(8),
+        lda_mat_rspecifier = po.GetOptArg(9);
+
+    std::vector<int32> silence_phones;
+    if (!SplitStringToIntegers(silence_phones_str, ":", false, &silence_phones))
+        KALDI_ERR << "Invalid silence-phones string " << silence_phones_str;
+    if (silence_phones.empty())
+        KALDI_ERR << "No silence phones given!";
+
+    CompactLatticeWriter lattice_writer(lattice_wspecifier);
+    Int32VectorWriter words_writer(words_wspecifier);
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    Matrix<BaseFloat> lda_transform;
+    if (lda_mat_rspecifier != "") {
+      bool binary_in;
+      Input ki(lda_mat_rspecifier, &binary_in);
+      lda_transform.Read(ki.Stream(), binary_in);
+    }
+
+    TransitionModel trans_model;
+    AmDiagGmm am_gmm;
+    {
+        bool binary;
+        Input ki(model_rspecifier, &binary);
+        trans_model.Read(ki.Stream(), binary);
+        am_gmm.Read(ki.Stream(), binary);
+    }
+
+    fst::SymbolTable *word_syms = NULL;
+    if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                    << word_syms_filename;
+
+    fst::Fst<fst::StdArc> *decode_fst = ReadDecodeGraph(fst_rspecifier);
+
+    // As in online-wav-gmm-decode-faster, the MFCC and frame extraction
+    // options are hardwired.
+    MfccOptions mfcc_opts;
+    mfcc_opts.use_energy = false;
+    int32 frame_length = mfcc_opts.frame_opts.frame_length_ms = 25;
+    int32 frame_shift = mfcc_opts.frame_opts.frame_shift_ms = 10;
+
+    int32 window_size = right_context + left_context + 1;
+    decoder_opts.batch_size = std::max(decoder_opts.batch_size, window_size);
+
+    OnlineLatticeFasterDecoder decoder(*decode_fst, decoder_opts,
+                                       silence_phones, trans_model);
+    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    VectorFst<LatticeArc> out_fst;
+    int32 num_utts = 0, num_lattices = 0;
+    for (; !reader.Done(); reader.Next()) {
+      std::string wav_key = reader.Key();
+      std::cerr << "File: " << wav_key << std::endl;
+      const WaveData &wav_data = reader.Value();
+      if(wav_data.SampFreq() != 16000)
+        KALDI_ERR << "Sampling rates other than 16kHz are not supported!";
+      int32 num_chan = wav_data.Data().NumRows(), this_chan = channel;
+      {  // This block works out the channel (0=left, 1=right...)
+        KALDI_ASSERT(num_chan > 0);  // should have been caught in
+        // reading code if no channels.
+        if (channel == -1) {
+          this_chan = 0;
+          if (num_chan != 1)
+            KALDI_WARN << "Channel not specified but you have data with "
+                       << num_chan  << " channels; defaulting to zero";
+        } else {
+          if (this_chan >= num_chan) {
+            KALDI_WARN << "File with id " << wav_key << " has "
+                       << num_chan << " channels but you specified channel "
+                       << channel << ", producing no output.";
+            continue;
+          }
+        }
+      }
+      OnlineVectorSource au_src(wav_data.Data().Row(this_chan));
+      Mfcc mfcc(mfcc_opts);
+      FeInput fe_input(&au_src, &mfcc,
+                       frame_length*(wav_data.SampFreq()/1000),
+                       frame_shift*(wav_data.SampFreq()/1000));
+      // The feature stages compute each frame once, when the decoder first
+      // asks for it, and keep the recent frames.
+      OnlineFeatInputStage fe_stage(feature_reading_opts, &fe_input);
+      OnlineCmnStage cmn_stage(&fe_stage, cmn_window, min_cmn_window);
+      OnlineFeatureStage *feat_transform = 0;
+      if (lda_mat_rspecifier != "") {
+        feat_transform = new OnlineLdaStage(
+            &cmn_stage, lda_transform,
+            left_context, right_context);
+      } else {
+        DeltaFeaturesOptions opts;
+        opts.order = kDeltaOrder;
+        feat_transform = new OnlineDeltaStage(opts, &cmn_stage);
+      }
+
+      // feature_reading_opts contains number of retries, batch size.
+      OnlineFeatureMatrix feature_matrix(feature_reading_opts,
+                                         feat_transform);
+
+      OnlineDecodableDiagGmmScaled decodable(am_gmm, trans_model, acoustic_scale,
+                                             &feature_matrix);
+      while (1) {
+        OnlineLatticeFasterDecoder::DecodeState dstate =
+            decoder.Decode(&decodable);
+        if (dstate & (decoder.kEndFeats | decoder.kEndUtt)) {
+          std::stringstream res_key;
+          res_key << wav_key << '_' << decoder.utt_start_frame() << '-'
+                  << decoder.frame();
+          std::vector<int32> tids, word_ids;
+          if (decoder.NumFramesDecoded() > 0 &&
+              decoder.GetBestPathTraceback(&out_fst)) {
+            fst::GetLinearSymbolSequence(out_fst, &tids, &word_ids,
+                                         static_cast<LatticeArc::Weight*>(0));
+            PrintPartialResult(word_ids, word_syms, true);
+            if (!word_ids.empty())
+              words_writer.Write(res_key.str(), word_ids);
+            alignment_writer.Write(res_key.str(), tids);
+            num_utts++;
+          }
+          CompactLattice clat;
+          if (decoder.GetCompactLattice(&clat)) {
+            // We'll write the lattice without acoustic scaling.
+            if (acoustic_scale != 0.0)
+              fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
+                                &clat);
+            lattice_writer.Write(res_key.str(), clat);
+            num_lattices++;
+          }
+          if (dstate == decoder.kEndFeats)
+            break;
+        } else if (GetVerboseLevel() >= 2 &&
+                   decoder.GetBestPathTraceback(&out_fst)) {
+          std::vector<int32> word_ids;
+          fst::GetLinearSymbolSequence(out_fst,
+                                       static_cast<vector<int32> *>(0),
+                                       &word_ids,
+                                       static_cast<LatticeArc::Weight*>(0));
+          std::ostringstream partial;
+          for (size_t i = 0; i < word_ids.size(); i++)
+            partial << word_syms->Find(word_ids[i]) << ' ';
+          KALDI_VLOG(2) << "Partial result at frame " << decoder.frame()
+                        << ": " << partial.str();
+        }
+      }
+      if (feat_transform) delete feat_transform;
+    }
+    KALDI_LOG << "Decoded " << num_utts << " utterances, wrote "
+              << num_lattices << " lattices.";
+    if (word_syms) delete word_syms;
+    if (decode_fst) delete decode_fst;
+    return 0;
+  } catch(const std::exception& e) {
+    std::cerr << e.what();
+    return -1;
+  }
+} // main()
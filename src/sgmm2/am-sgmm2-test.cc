@@ -256,6 +256,53 @@ void TestSgmm2PreXform(const AmSgmm2 &sgmm) {
   KALDI_ASSERT(res_vec.IsZero(1.0e-6));
 }
 
+// Checks that ComputeSubstateLikesBatch() gives the same likelihoods as
+// LogLikelihood() on its own.
+void TestSgmm2Batch(const AmSgmm2 &sgmm) {
+  using namespace kaldi;
+  std::vector<int32> pdf2group;  // Three pdfs in two groups.
+  pdf2group.push_back(0);
+  pdf2group.push_back(0);
+  pdf2group.push_back(1);
+  AmSgmm2 sgmm1;
+  sgmm1.InitializeFromFullGmm(sgmm.full_ubm(), pdf2group, sgmm.PhoneSpaceDim(),
+                              0, true, 0.9);
+  sgmm1.ComputeNormalizers();
+  int32 dim = sgmm1.FeatureDim(), num_frames = 1 + kaldi::RandInt(0, 4);
+  kaldi::Sgmm2GselectConfig config;
+  config.full_gmm_nbest = std::min(config.full_gmm_nbest, sgmm1.NumGauss());
+  Sgmm2PerSpkDerivedVars empty;
+
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame(num_frames);
+  std::vector<const Sgmm2PerFrameDerivedVars*> per_frame_ptrs(num_frames);
+  std::vector<Sgmm2LikelihoodCache> caches(
+      num_frames, Sgmm2LikelihoodCache(sgmm1.NumGroups(), sgmm1.NumPdfs()));
+  std::vector<Sgmm2LikelihoodCache*> cache_ptrs(num_frames);
+  for (int32 f = 0; f < num_frames; f++) {
+    kaldi::Vector<BaseFloat> feat(dim);
+    feat.SetRandn();
+    std::vector<int32> gselect;
+    sgmm1.GaussianSelection(config, feat, &gselect);
+    sgmm1.ComputePerFrameVars(feat, gselect, empty, &(per_frame[f]));
+    per_frame_ptrs[f] = &(per_frame[f]);
+    cache_ptrs[f] = &(caches[f]);
+  }
+  Matrix<BaseFloat> v_stacked;
+  sgmm1.GetStackedSubstateVectors(&v_stacked);
+  sgmm1.ComputeSubstateLikesBatch(per_frame_ptrs, v_stacked, &empty,
+                                  cache_ptrs);
+  Sgmm2LikelihoodCache cache(sgmm1.NumGroups(), sgmm1.NumPdfs());
+  for (int32 f = 0; f < num_frames; f++) {
+    cache.NextFrame();
+    for (int32 j2 = 0; j2 < sgmm1.NumPdfs(); j2++) {
+      BaseFloat loglike = sgmm1.LogLikelihood(per_frame[f], j2, &cache, &empty),
+          loglike_batch = sgmm1.LogLikelihood(per_frame[f], j2, &(caches[f]),
+                                              &empty);
+      kaldi::AssertEqual(loglike, loglike_batch, 1e-4);
+    }
+  }
+}
+
 void UnitTestSgmm2() {
   size_t dim = 1 + kaldi::RandInt(0, 9);  // random dimension of the gmm
   size_t num_comp = 1 + kaldi::RandInt(0, 9);  // random number of mixtures
@@ -273,6 +320,7 @@ void UnitTestSgmm2() {
   TestSgmm2Substates(sgmm);
   TestSgmm2IncreaseDim(sgmm);
   TestSgmm2PreXform(sgmm);
+  TestSgmm2Batch(sgmm);
 }
 
 int main() {
@@ -477,32 +477,117 @@ void AmSgmm2::ComponentLogLikes(const Sgmm2PerFrameDerivedVars &per_frame_vars,
   // Although the extra memory allocation of storing this as a
   // matrix might seem unnecessary, we save time in the LogSumExp()
   // via more effective pruning.
-  loglikes->Resize(num_gselect, num_substates);
-  bool speaker_dep_weights =
-      (spk_vars->v_s.Dim() != 0 && HasSpeakerDependentWeights());
-  if (speaker_dep_weights) {
-    KALDI_ASSERT(static_cast<int32>(spk_vars->log_d_jms.size()) == NumGroups());
-    KALDI_ASSERT(static_cast<int32>(w_jmi_.size()) == NumGroups() ||
-                 "You need to call ComputeWeights().");
-  }
+  loglikes->Resize(num_gselect, num_substates, kUndefined);
+  // for all substates and selected Gaussians, compute z_{i}^T v_{jm}, as one
+  // matrix multiplication.
+  loglikes->AddMatMat(1.0, per_frame_vars.zti, kNoTrans, v_[j1], kTrans, 0.0);
   for (int32 ki = 0;  ki < num_gselect; ki++) {
     SubVector<BaseFloat> logp_xi(*loglikes, ki);
     int32 i = gselect[ki];
-    // for all substates, compute z_{i}^T v_{jm}
-    logp_xi.AddMatVec(1.0, v_[j1], kNoTrans, per_frame_vars.zti.Row(ki), 0.0);
     logp_xi.AddVec(1.0, n_[j1].Row(i));  // for all substates, add n_{jim}
     logp_xi.Add(per_frame_vars.nti(ki));  // for all substates, add n_{i}(t)
   }    
-  if (speaker_dep_weights) { // [SSGMM]
-    Vector<BaseFloat> &log_d = spk_vars->log_d_jms[j1];
-    if (log_d.Dim() == 0) { // have not yet cached this quantity.
-      log_d.Resize(num_substates); 
-      log_d.AddMatVec(1.0, w_jmi_[j1], kNoTrans, spk_vars->b_is, 0.0);
-      log_d.ApplyLog();
+  AddSpeakerWeightTerm(j1, spk_vars, loglikes);
+}
+
+void AmSgmm2::AddSpeakerWeightTerm(int32 j1,
+                                   Sgmm2PerSpkDerivedVars *spk_vars,
+                                   MatrixBase<BaseFloat> *loglikes) const {
+  bool speaker_dep_weights =
+      (spk_vars->v_s.Dim() != 0 && HasSpeakerDependentWeights());
+  if (!speaker_dep_weights) return;
+  KALDI_ASSERT(static_cast<int32>(spk_vars->log_d_jms.size()) == NumGroups());
+  KALDI_ASSERT(static_cast<int32>(w_jmi_.size()) == NumGroups() ||
+               "You need to call ComputeWeights().");
+  // [SSGMM]
+  Vector<BaseFloat> &log_d = spk_vars->log_d_jms[j1];
+  if (log_d.Dim() == 0) { // have not yet cached this quantity.
+    log_d.Resize(NumSubstatesForGroup(j1));
+    log_d.AddMatVec(1.0, w_jmi_[j1], kNoTrans, spk_vars->b_is, 0.0);
+    log_d.ApplyLog();
+  }
+  loglikes->AddVecToRows(-1.0, log_d); // [SSGMM] this is the term
+  // - log d_{jm}^{(s)} in the likelihood function [eq. 25 in
+  // the techreport]
+}
+
+// Sets up a sub-state cache element from the log-likelihoods indexed
+// [gselect-index][substate-index], which it destroys.
+static void SetSubstateCacheElement(
+    MatrixBase<BaseFloat> *loglikes,
+    Sgmm2LikelihoodCache::SubstateCacheElement *substate_cache) {
+  BaseFloat max = loglikes->Max(); // use this to keep things in good numerical range.
+  loglikes->Add(-max);
+  loglikes->ApplyExp();
+  substate_cache->remaining_log_like = max;
+  int32 num_substates = loglikes->NumCols();
+  substate_cache->likes.Resize(num_substates); // zeroes it.
+  substate_cache->likes.AddRowSumMat(1.0, *loglikes); // add likelihoods [not in log!] for
+  // each column [i.e. summing over the rows], so we get the sum for
+  // each substate index.  You have to multiply by exp(remaining_log_like)
+  // to get a real likelihood.
+}
+
+void AmSgmm2::GetStackedSubstateVectors(Matrix<BaseFloat> *v_stacked) const {
+  int32 num_substates = 0;
+  for (int32 j1 = 0; j1 < NumGroups(); j1++)
+    num_substates += v_[j1].NumRows();
+  v_stacked->Resize(num_substates, PhoneSpaceDim(), kUndefined);
+  int32 offset = 0;
+  for (int32 j1 = 0; j1 < NumGroups(); j1++) {
+    v_stacked->Range(offset, v_[j1].NumRows(), 0,
+                     PhoneSpaceDim()).CopyFromMat(v_[j1]);
+    offset += v_[j1].NumRows();
+  }
+}
+
+void AmSgmm2::ComputeSubstateLikesBatch(
+    const std::vector<const Sgmm2PerFrameDerivedVars*> &per_frame_vars,
+    const MatrixBase<BaseFloat> &v_stacked,
+    Sgmm2PerSpkDerivedVars *spk_vars,
+    const std::vector<Sgmm2LikelihoodCache*> &caches) const {
+  KALDI_ASSERT(per_frame_vars.size() == caches.size());
+  KALDI_ASSERT(v_stacked.NumCols() == PhoneSpaceDim());
+  int32 num_frames = per_frame_vars.size(), tot_gselect = 0;
+  for (int32 f = 0; f < num_frames; f++)
+    tot_gselect += per_frame_vars[f]->gselect.size();
+  if (tot_gselect == 0) return;
+
+  // Stack the z_{i}(t) of all the frames; then one matrix multiplication
+  // gives z_{i}^T v_{jm} for all frames, selected Gaussians and substates.
+  Matrix<BaseFloat> zti(tot_gselect, PhoneSpaceDim(), kUndefined);
+  for (int32 f = 0, offset = 0; f < num_frames; f++) {
+    int32 num_gselect = per_frame_vars[f]->gselect.size();
+    if (num_gselect == 0) continue;
+    zti.RowRange(offset, num_gselect).CopyFromMat(per_frame_vars[f]->zti);
+    offset += num_gselect;
+  }
+  Matrix<BaseFloat> loglikes(tot_gselect, v_stacked.NumRows(), kUndefined);
+  loglikes.AddMatMat(1.0, zti, kNoTrans, v_stacked, kTrans, 0.0);
+
+  for (int32 f = 0, row_offset = 0; f < num_frames; f++) {
+    const std::vector<int32> &gselect = per_frame_vars[f]->gselect;
+    int32 num_gselect = gselect.size();
+    Sgmm2LikelihoodCache *cache = caches[f];
+    cache->NextFrame();
+    if (num_gselect == 0) continue;
+    for (int32 ki = 0; ki < num_gselect; ki++)  // add n_{i}(t)
+      loglikes.Row(row_offset + ki).Add(per_frame_vars[f]->nti(ki));
+    for (int32 j1 = 0, col_offset = 0; j1 < NumGroups(); j1++) {
+      int32 num_substates = v_[j1].NumRows();
+      KALDI_ASSERT(col_offset + num_substates <= v_stacked.NumRows());
+      SubMatrix<BaseFloat> group_loglikes(loglikes, row_offset, num_gselect,
+                                          col_offset, num_substates);
+      for (int32 ki = 0; ki < num_gselect; ki++)  // add n_{jim}
+        group_loglikes.Row(ki).AddVec(1.0, n_[j1].Row(gselect[ki]));
+      AddSpeakerWeightTerm(j1, spk_vars, &group_loglikes);
+      Sgmm2LikelihoodCache::SubstateCacheElement &substate_cache =
+          cache->substate_cache[j1];
+      SetSubstateCacheElement(&group_loglikes, &substate_cache);
+      substate_cache.t = cache->t;
+      col_offset += num_substates;
     }
-    loglikes->AddVecToRows(-1.0, log_d); // [SSGMM] this is the term
-    // - log d_{jm}^{(s)} in the likelihood function [eq. 25 in
-    // the techreport]
+    row_offset += num_gselect;
   }
 }
 
@@ -539,16 +624,7 @@ BaseFloat AmSgmm2::LogLikelihood(const Sgmm2PerFrameDerivedVars &per_frame_vars,
     substate_cache.t = t;
     Matrix<BaseFloat> loglikes; // indexed [gselect-index][substate-index]
     ComponentLogLikes(per_frame_vars, j1, spk_vars, &loglikes);
-    BaseFloat max = loglikes.Max(); // use this to keep things in good numerical range.
-    loglikes.Add(-max);
-    loglikes.ApplyExp();
-    substate_cache.remaining_log_like = max;
-    int32 num_substates = loglikes.NumCols();
-    substate_cache.likes.Resize(num_substates); // zeroes it.
-    substate_cache.likes.AddRowSumMat(1.0, loglikes); // add likelihoods [not in log!] for
-    // each column [i.e. summing over the rows], so we get the sum for
-    // each substate index.  You have to multiply by exp(remaining_log_like)
-    // to get a real likelihood.
+    SetSubstateCacheElement(&loglikes, &substate_cache);
   }
   
   BaseFloat log_like = substate_cache.remaining_log_like
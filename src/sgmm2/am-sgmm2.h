@@ -307,6 +307,27 @@ class AmSgmm2 {
                                 Sgmm2PerSpkDerivedVars *spk_vars,
                                 Matrix<BaseFloat> *post) const;
 
+  /// Stacks the sub-state vectors v_{jm} of all the groups into the rows of
+  /// *v_stacked, in order of j1 and then m, for use in
+  /// ComputeSubstateLikesBatch().  It has to be redone if the model changes.
+  void GetStackedSubstateVectors(Matrix<BaseFloat> *v_stacked) const;
+
+  /// Batched version of the sub-state level of LogLikelihood().  For each
+  /// frame f, it calls caches[f]->NextFrame() and then computes the sub-state
+  /// likelihoods of all the groups for that frame into caches[f], so that
+  /// LogLikelihood() with caches[f] only has to do a dot product per pdf.  The
+  /// terms z_{i}(t)^T v_{jm} for all the frames, selected Gaussians and
+  /// sub-states are computed with one matrix multiplication, using the
+  /// output of GetStackedSubstateVectors(); this is a lot faster than doing
+  /// the groups one by one if most groups are needed, as in decoding with a
+  /// typical beam, but it is wasteful if only a few are, as in alignment with
+  /// a narrow beam.
+  void ComputeSubstateLikesBatch(
+      const std::vector<const Sgmm2PerFrameDerivedVars*> &per_frame_vars,
+      const MatrixBase<BaseFloat> &v_stacked,
+      Sgmm2PerSpkDerivedVars *spk_vars,
+      const std::vector<Sgmm2LikelihoodCache*> &caches) const;
+
   /// Increases the total number of substates based on the state occupancies.
   void SplitSubstates(const Vector<BaseFloat> &state_occupancies, // [indexed by pdf-id j2]
                       const Sgmm2SplitSubstatesConfig &config);
@@ -475,6 +496,12 @@ class AmSgmm2 {
                                 Sgmm2PerSpkDerivedVars *spk_vars,
                                 Matrix<BaseFloat> *loglikes) const;
 
+  /// [SSGMM] Adds the term -log d_{jm}^{(s)} to each row of loglikes (which
+  /// is indexed [gselect-index][substate-index] for group j1), if we have
+  /// speaker-dependent weights; otherwise does nothing.
+  void AddSpeakerWeightTerm(int32 j1, Sgmm2PerSpkDerivedVars *spk_vars,
+                            MatrixBase<BaseFloat> *loglikes) const;
+
   
   /// Initializes the matrices M_ and w_.
   void InitializeMw(int32 phn_subspace_dim,
@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include <vector>
+#include <algorithm>
 using std::vector;
 
 #include "sgmm2/decodable-am-sgmm2.h"
@@ -34,7 +35,56 @@ DecodableAmSgmm2::~DecodableAmSgmm2() {
   }
 }
 
+void DecodableAmSgmm2::SetBatchFrames(int32 batch_frames,
+                                      const Matrix<BaseFloat> *v_stacked) {
+  KALDI_ASSERT(batch_frames >= 0);
+  batch_frames_ = batch_frames;
+  block_start_ = -1;
+  my_v_stacked_.Resize(0, 0);
+  v_stacked_ = NULL;
+  if (batch_frames > 0) {
+    if (v_stacked == NULL) {
+      sgmm_.GetStackedSubstateVectors(&my_v_stacked_);
+      v_stacked_ = &my_v_stacked_;
+    } else {
+      v_stacked_ = v_stacked;
+    }
+    block_vars_.resize(batch_frames);
+    block_caches_.resize(batch_frames,
+                         Sgmm2LikelihoodCache(sgmm_.NumGroups(),
+                                              sgmm_.NumPdfs()));
+  } else {
+    block_vars_.clear();
+    block_caches_.clear();
+  }
+}
+
+void DecodableAmSgmm2::ComputeBlock(int32 block_start) {
+  int32 num_frames = std::min(batch_frames_, NumFrames() - block_start);
+  KALDI_ASSERT(num_frames > 0);
+  std::vector<const Sgmm2PerFrameDerivedVars*> per_frame_vars(num_frames);
+  std::vector<Sgmm2LikelihoodCache*> caches(num_frames);
+  for (int32 f = 0; f < num_frames; f++) {
+    int32 frame = block_start + f;
+    SubVector<BaseFloat> data(*feature_matrix_, frame);
+    sgmm_.ComputePerFrameVars(data, (*gselect_)[frame], *spk_,
+                              &(block_vars_[f]));
+    per_frame_vars[f] = &(block_vars_[f]);
+    caches[f] = &(block_caches_[f]);
+  }
+  sgmm_.ComputeSubstateLikesBatch(per_frame_vars, *v_stacked_, spk_, caches);
+  block_start_ = block_start;
+}
+
 BaseFloat DecodableAmSgmm2::LogLikelihoodForPdf(int32 frame, int32 pdf_id) {
+  if (batch_frames_ > 0) {
+    if (block_start_ < 0 || frame < block_start_ ||
+        frame >= block_start_ + batch_frames_)
+      ComputeBlock(frame);
+    int32 f = frame - block_start_;
+    return sgmm_.LogLikelihood(block_vars_[f], pdf_id, &(block_caches_[f]),
+                               spk_, log_prune_);
+  }
   if (frame != cur_frame_) {
     cur_frame_ = frame;
     sgmm_cache_.NextFrame(); // it has a frame-index internally but it doesn't
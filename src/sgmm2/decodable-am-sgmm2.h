@@ -41,7 +41,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(&feats),
       gselect_(&gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(false) {
+      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(false),
+      batch_frames_(0), block_start_(-1), v_stacked_(NULL) {
     KALDI_ASSERT(gselect.size() == static_cast<size_t>(feats.NumRows()));
   }
 
@@ -56,7 +57,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(feats),
       gselect_(gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(true) {
+      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(true),
+      batch_frames_(0), block_start_(-1), v_stacked_(NULL) {
     KALDI_ASSERT(gselect->size() == static_cast<size_t>(feats->NumRows()));
   }
   
@@ -73,10 +75,26 @@ class DecodableAmSgmm2 : public DecodableInterface {
     return (frame == NumFrames() - 1);
   }
 
+  /// If batch_frames > 0, the sub-state likelihoods are computed for blocks
+  /// of batch_frames frames at a time, for all the groups, with one matrix
+  /// multiplication per block (see AmSgmm2::ComputeSubstateLikesBatch()).
+  /// This is faster when most of the groups are active on each frame, as in
+  /// decoding with a wide beam; with a narrow beam it may be slower.  The
+  /// default (0) computes them frame by frame, only for the groups needed.
+  /// If v_stacked is non-NULL it must be the output of
+  /// sgmm.GetStackedSubstateVectors(), and must outlive this object; this
+  /// saves recomputing it for each utterance.
+  void SetBatchFrames(int32 batch_frames,
+                      const Matrix<BaseFloat> *v_stacked = NULL);
+
   virtual ~DecodableAmSgmm2();
  protected:
   virtual BaseFloat LogLikelihoodForPdf(int32 frame, int32 pdf_id);
 
+  /// Computes the per-frame quantities and sub-state likelihoods for the block
+  /// of frames starting at "block_start", in batch mode.
+  void ComputeBlock(int32 block_start);
+
   const AmSgmm2 &sgmm_;
   Sgmm2PerSpkDerivedVars *spk_;
   const TransitionModel &trans_model_;  ///< for tid to pdf mapping
@@ -91,6 +109,17 @@ class DecodableAmSgmm2 : public DecodableInterface {
 
   bool delete_vars_; // If true, we will delete feature_matrix_, gselect_, and
   // spk_ in the destructor.
+
+  // The following are used only in batch mode (batch_frames_ > 0).
+  int32 batch_frames_;
+  int32 block_start_;  // First frame of the block in block_caches_, or -1.
+  const Matrix<BaseFloat> *v_stacked_;  // from AmSgmm2::GetStackedSubstateVectors();
+                                        // either the user's or &my_v_stacked_.
+  Matrix<BaseFloat> my_v_stacked_;
+  std::vector<Sgmm2PerFrameDerivedVars> block_vars_;  // indexed by frame
+                                                       // - block_start_.
+  std::vector<Sgmm2LikelihoodCache> block_caches_;  // indexed by frame
+                                                     // - block_start_.
   
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmSgmm2);
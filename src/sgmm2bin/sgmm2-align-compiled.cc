@@ -28,6 +28,7 @@
 #include "decoder/training-graph-compiler.h"
 #include "sgmm2/decodable-am-sgmm2.h"
 #include "lat/kaldi-lattice.h" // for {Compact}LatticeArc
+#include "thread/kaldi-task-sequence.h"
 
 
 int main(int argc, char *argv[]) {
@@ -46,20 +47,24 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     bool binary = true;
-    BaseFloat beam = 200.0;
-    BaseFloat retry_beam = 0.0;
+    AlignConfig align_config;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     BaseFloat acoustic_scale = 1.0;
     BaseFloat transition_scale = 1.0;
     BaseFloat self_loop_scale = 1.0;
     BaseFloat log_prune = 5.0;
+    int32 batch_frames = 0;
     std::string gselect_rspecifier, spkvecs_rspecifier, utt2spk_rspecifier;
     
     po.Register("binary", &binary, "Write output in binary mode");
-    po.Register("beam", &beam, "Decoding beam");
-    po.Register("retry-beam", &retry_beam, "Decoding beam for second try "
-                "at alignment");
+    align_config.Register(&po);
+    sequencer_config.Register(&po);
     po.Register("log-prune", &log_prune, "Pruning beam used to reduce number "
                 "of exp() evaluations.");
+    po.Register("batch-frames", &batch_frames, "If >0, compute the sub-state "
+                "likelihoods for all states in blocks of this many frames, "
+                "with one matrix multiply per block (only worthwhile with "
+                "wide beams)");
     po.Register("spk-vecs", &spkvecs_rspecifier, "Speaker vectors (rspecifier)");
     po.Register("utt2spk", &utt2spk_rspecifier,
                 "rspecifier for utterance to speaker map");
@@ -83,12 +88,10 @@ int main(int argc, char *argv[]) {
     if (gselect_rspecifier == "")
       KALDI_ERR << "--gselect option is mandatory.";
     
-    if (retry_beam != 0 && retry_beam <= beam)
-      KALDI_WARN << "Beams do not make sense: beam " << beam
-                 << ", retry-beam " << retry_beam;
-
-    FasterDecoderOptions decode_opts;
-    decode_opts.beam = beam;  // Don't set the other options.
+    if (align_config.retry_beam != 0 &&
+        align_config.retry_beam <= align_config.beam)
+      KALDI_WARN << "Beams do not make sense: beam " << align_config.beam
+                 << ", retry-beam " << align_config.retry_beam;
 
     std::string model_in_filename = po.GetArg(1);
     std::string fst_rspecifier = po.GetArg(2);
@@ -103,6 +106,9 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_sgmm.Read(ki.Stream(), binary);
     }
+    Matrix<BaseFloat> v_stacked;  // Only used if batch_frames > 0.
+    if (batch_frames > 0)
+      am_sgmm.GetStackedSubstateVectors(&v_stacked);
 
     SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_rspecifier);
     RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -113,19 +119,21 @@ int main(int argc, char *argv[]) {
 
     Int32VectorWriter alignment_writer(alignment_wspecifier);
 
-    int num_done = 0, num_err = 0;
-    BaseFloat tot_like = 0.0;
+    int num_done = 0, num_err = 0, num_retry = 0;
+    double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
 
-    for (; !fst_reader.Done(); fst_reader.Next()) {
-      std::string utt = fst_reader.Key();
-      if (!feature_reader.HasKey(utt)) num_err++;
-      else {
-        VectorFst<StdArc> decode_fst(fst_reader.Value());
-        // stops copy-on-write of the fst by deleting the fst inside the reader,
-        // since we're about to mutate the fst by adding transition probs.
-        fst_reader.FreeCurrent();
+    {
+      // The sequencer is only used if --num-threads > 1; it runs the
+      // alignments in parallel, and writes them in the original order.
+      TaskSequencer<AlignUtteranceClass> sequencer(sequencer_config);
 
+      for (; !fst_reader.Done(); fst_reader.Next()) {
+        std::string utt = fst_reader.Key();
+        if (!feature_reader.HasKey(utt)) {
+          num_err++;
+          continue;
+        }
         const Matrix<BaseFloat> &features = feature_reader.Value(utt);
         if (features.NumRows() == 0) {
           KALDI_WARN << "Zero-length utterance: " << utt;
@@ -133,14 +141,15 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        Sgmm2PerSpkDerivedVars spk_vars;
+        Sgmm2PerSpkDerivedVars *spk_vars = new Sgmm2PerSpkDerivedVars;
         if (spkvecs_reader.IsOpen()) {
           if (spkvecs_reader.HasKey(utt)) {
-            spk_vars.SetSpeakerVector(spkvecs_reader.Value(utt));
-            am_sgmm.ComputePerSpkDerivedVars(&spk_vars);
+            spk_vars->SetSpeakerVector(spkvecs_reader.Value(utt));
+            am_sgmm.ComputePerSpkDerivedVars(spk_vars);
           } else {
             KALDI_WARN << "Cannot find speaker vector for " << utt;
             num_err++;
+            delete spk_vars;
             continue;
           }
         }  // else spk_vars is "empty"
@@ -154,66 +163,57 @@ int main(int argc, char *argv[]) {
         const std::vector<std::vector<int32> > &gselect =
             gselect_reader.Value(utt);
 
-        if (decode_fst.Start() == fst::kNoStateId) {
+        VectorFst<StdArc> *decode_fst = new VectorFst<StdArc>(fst_reader.Value());
+        // stops copy-on-write of the fst by deleting the fst inside the reader,
+        // since we're about to mutate the fst by adding transition probs.
+        fst_reader.FreeCurrent();
+        if (decode_fst->Start() == fst::kNoStateId) {
           KALDI_WARN << "Empty decoding graph for " << utt;
           num_err++;
+          delete decode_fst;
+          delete spk_vars;
           continue;
         }
-        
+
         {  // Add transition-probs to the FST.
           std::vector<int32> disambig_syms;  // empty.
           AddTransitionProbs(trans_model, disambig_syms,
                              transition_scale, self_loop_scale,
-                             &decode_fst);
+                             decode_fst);
         }
 
-        FasterDecoder decoder(decode_fst, decode_opts);
-        
-        DecodableAmSgmm2Scaled sgmm_decodable(am_sgmm, trans_model, features, gselect,
-                                              log_prune, acoustic_scale, &spk_vars);
-
-        decoder.Decode(&sgmm_decodable);
-        
-        VectorFst<LatticeArc> decoded;  // linear FST.
-        bool ans = decoder.ReachedFinal() // consider only final states.
-            && decoder.GetBestPath(&decoded);  
-        if (!ans && retry_beam != 0.0) {
-          KALDI_WARN << "Retrying utterance " << utt << " with beam "
-                     << retry_beam;
-          decode_opts.beam = retry_beam;
-          decoder.SetOptions(decode_opts);
-          decoder.Decode(&sgmm_decodable);
-          ans = decoder.ReachedFinal() // consider only final states.
-              && decoder.GetBestPath(&decoded);
-          decode_opts.beam = beam;
-          decoder.SetOptions(decode_opts);
-        }
-        if (ans) {
-          std::vector<int32> alignment;
-          std::vector<int32> words;
-          LatticeWeight weight;
-          frame_count += features.NumRows();
-
-          GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-          BaseFloat like = (-weight.Value1() -weight.Value2()) / acoustic_scale;
-          tot_like += like;
-          alignment_writer.Write(utt, alignment);
-          num_done ++;
-          if (num_done % 50  == 0) {
-            KALDI_LOG << "Processed " << num_done << " utterances, "
-                      << "log-like per frame for " << utt << " is "
-                      << (like / features.NumRows()) << " over "
-                      << features.NumRows() << " frames.";
-          }
+        if (sequencer_config.num_threads == 1) {
+          DecodableAmSgmm2Scaled sgmm_decodable(am_sgmm, trans_model, features,
+                                                gselect, log_prune,
+                                                acoustic_scale, spk_vars);
+          if (batch_frames > 0)
+            sgmm_decodable.SetBatchFrames(batch_frames, &v_stacked);
+          AlignUtteranceWrapper(align_config, utt, acoustic_scale, *decode_fst,
+                                &sgmm_decodable, &alignment_writer, NULL,
+                                &num_done, &num_err, &num_retry, &tot_like,
+                                &frame_count);
+          delete decode_fst;
+          delete spk_vars;
         } else {
-          KALDI_WARN << "Did not successfully decode file " << utt << ", len = "
-                     << (features.NumRows());
-          num_err++;
+          // This version of the constructor takes ownership of the copies of
+          // the features and Gaussian selection, and of spk_vars.
+          DecodableAmSgmm2Scaled *sgmm_decodable = new DecodableAmSgmm2Scaled(
+              am_sgmm, trans_model, new Matrix<BaseFloat>(features),
+              new std::vector<std::vector<int32> >(gselect), spk_vars,
+              log_prune, acoustic_scale);
+          if (batch_frames > 0)
+            sgmm_decodable->SetBatchFrames(batch_frames, &v_stacked);
+          sequencer.Run(new AlignUtteranceClass(
+              align_config, utt, acoustic_scale,
+              decode_fst, sgmm_decodable,  // takes ownership of these two.
+              &alignment_writer, NULL, &num_done, &num_err, &num_retry,
+              &tot_like, &frame_count));
         }
       }
-    }
+    }  // the sequencer's destructor waits for the remaining alignments.
 
-    KALDI_LOG << "Done " << num_done << ", errors on " << num_err;
+    KALDI_LOG << "Done " << num_done << ", errors on " << num_err
+              << ", retried " << num_retry;
     KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count)
               << " over " << frame_count << " frames.";
     return (num_done != 0 ? 0 : 1);
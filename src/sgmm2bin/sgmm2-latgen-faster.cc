@@ -40,6 +40,8 @@ bool ProcessUtterance(LatticeFasterDecoder &decoder,
                       const TransitionModel &trans_model,
                       double log_prune,
                       double acoustic_scale,
+                      int32 batch_frames,
+                      const Matrix<BaseFloat> &v_stacked,
                       const Matrix<BaseFloat> &features,
                       RandomAccessInt32VectorVectorReader &gselect_reader,
                       RandomAccessBaseFloatVectorReaderMapped &spkvecs_reader,
@@ -76,6 +78,8 @@ bool ProcessUtterance(LatticeFasterDecoder &decoder,
   
   DecodableAmSgmm2Scaled sgmm_decodable(am_sgmm, trans_model, features, gselect,
                                         log_prune, acoustic_scale, &spk_vars);
+  if (batch_frames > 0)
+    sgmm_decodable.SetBatchFrames(batch_frames, &v_stacked);
 
   return DecodeUtteranceLatticeFaster(
       decoder, sgmm_decodable, trans_model, word_syms, utt, acoustic_scale,
@@ -101,6 +105,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 0.1;
     bool allow_partial = false;
     BaseFloat log_prune = 5.0;
+    int32 batch_frames = 0;
     string word_syms_filename, gselect_rspecifier, spkvecs_rspecifier,
         utt2spk_rspecifier;
 
@@ -111,6 +116,9 @@ int main(int argc, char *argv[]) {
         "Scaling factor for acoustic likelihoods");
     po.Register("log-prune", &log_prune,
                 "Pruning beam used to reduce number of exp() evaluations.");
+    po.Register("batch-frames", &batch_frames, "If >0, compute the sub-state "
+                "likelihoods for all states in blocks of this many frames, "
+                "with one matrix multiply per block (faster with wide beams)");
     po.Register("word-symbol-table", &word_syms_filename,
         "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
@@ -146,6 +154,9 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_sgmm.Read(ki.Stream(), binary);
     }
+    Matrix<BaseFloat> v_stacked;  // Only used if batch_frames > 0.
+    if (batch_frames > 0)
+      am_sgmm.GetStackedSubstateVectors(&v_stacked);
 
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
@@ -200,6 +211,7 @@ int main(int argc, char *argv[]) {
           }
           double like;
           if (ProcessUtterance(decoder, am_sgmm, trans_model, log_prune, acoustic_scale,
+                               batch_frames, v_stacked,
                                features, gselect_reader, spkvecs_reader, word_syms,
                                utt, determinize, allow_partial,
                                &alignment_writer, &words_writer, &compact_lattice_writer,
@@ -235,6 +247,7 @@ int main(int argc, char *argv[]) {
         double like;
 
         if (ProcessUtterance(decoder, am_sgmm, trans_model, log_prune, acoustic_scale,
+                             batch_frames, v_stacked,
                              features, gselect_reader, spkvecs_reader, word_syms,
                              utt, determinize, allow_partial,
                              &alignment_writer, &words_writer, &compact_lattice_writer,
@@ -0,0 +1,125 @@
+// thread/kaldi-ring-buffer-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <sched.h>
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-ring-buffer.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+// Checks the buffer against a simple queue, with random reads and writes that
+// wrap around the end of the buffer.
+void TestRingBuffer() {
+  for (int32 iter = 0; iter < 10; iter++) {
+    RingBuffer<int16> buffer(1 + rand() % 100);
+    KALDI_ASSERT((buffer.Capacity() & (buffer.Capacity() - 1)) == 0);
+    std::vector<int16> reference;  // what should be in the buffer.
+    int16 next_value = 0;
+    for (int32 i = 0; i < 1000; i++) {
+      if (rand() % 2 == 0) {
+        size_t n = rand() % 50, room = buffer.WriteAvailable();
+        std::vector<int16> data(n + 1);
+        for (size_t j = 0; j < n; j++) data[j] = next_value + j;
+        size_t written;
+        if (rand() % 2 == 0) {
+          written = buffer.Write(&(data[0]), n);
+        } else {
+          int16 *data1, *data2;
+          size_t size1, size2;
+          written = buffer.GetWriteRegions(n, &data1, &size1, &data2, &size2);
+          KALDI_ASSERT(size1 + size2 == written);
+          for (size_t j = 0; j < size1; j++) data1[j] = data[j];
+          for (size_t j = 0; j < size2; j++) data2[j] = data[size1 + j];
+          buffer.CommitWrite(written);
+        }
+        KALDI_ASSERT(written == std::min(n, room));
+        reference.insert(reference.end(), data.begin(),
+                         data.begin() + written);
+        next_value += written;
+      } else {
+        size_t n = rand() % 50, offset = rand() % 5;
+        std::vector<int16> data(n + 1);
+        size_t num_peeked = buffer.Peek(offset, n, &(data[0]));
+        KALDI_ASSERT(num_peeked == (offset >= reference.size() ? 0 :
+                                    std::min(n, reference.size() - offset)));
+        for (size_t j = 0; j < num_peeked; j++)
+          KALDI_ASSERT(data[j] == reference[offset + j]);
+        size_t num_read = buffer.Read(&(data[0]), n);
+        KALDI_ASSERT(num_read == std::min(n, reference.size()));
+        for (size_t j = 0; j < num_read; j++)
+          KALDI_ASSERT(data[j] == reference[j]);
+        reference.erase(reference.begin(), reference.begin() + num_read);
+      }
+      KALDI_ASSERT(buffer.ReadAvailable() == reference.size());
+      if (rand() % 100 == 0) {
+        buffer.Reserve(buffer.Capacity() + 1);
+        KALDI_ASSERT(buffer.ReadAvailable() == reference.size());
+      }
+    }
+  }
+}
+
+// Thread 0 writes a sequence of numbers to a small buffer and thread 1 reads
+// them, checking that they arrive in order.
+class RingBufferThreadTestClass: public MultiThreadable {
+ public:
+  RingBufferThreadTestClass(RingBuffer<int32> *buffer, int32 count):
+      buffer_(buffer), count_(count) { }
+  void operator() () {
+    if (thread_id_ == 0) {
+      for (int32 i = 0; i < count_; ) {
+        int32 data[7];
+        int32 n = std::min(count_ - i, 1 + rand() % 7);
+        for (int32 j = 0; j < n; j++) data[j] = i + j;
+        int32 written = buffer_->Write(data, n);
+        if (written == 0) sched_yield();  // buffer full.
+        i += written;
+      }
+    } else if (thread_id_ == 1) {
+      for (int32 i = 0; i < count_; ) {
+        int32 data[5];
+        int32 n = buffer_->Read(data, 5);
+        if (n == 0) sched_yield();  // buffer empty.
+        for (int32 j = 0; j < n; j++)
+          KALDI_ASSERT(data[j] == i + j);
+        i += n;
+      }
+    }
+  }
+ private:
+  RingBuffer<int32> *buffer_;
+  int32 count_;
+};
+
+void TestRingBufferThreads() {
+  RingBuffer<int32> buffer(16);
+  RingBufferThreadTestClass c(&buffer, 20000);
+  RunMultiThreadedPersistent(c, 2);
+  KALDI_ASSERT(buffer.ReadAvailable() == 0);
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  TestRingBuffer();
+  TestRingBufferThreads();
+  KALDI_LOG << "Test OK.";
+}
@@ -0,0 +1,189 @@
+// thread/kaldi-ring-buffer.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_THREAD_KALDI_RING_BUFFER_H_
+#define KALDI_THREAD_KALDI_RING_BUFFER_H_ 1
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#endif
+
+namespace kaldi {
+
+/**
+   A fixed-size ring buffer of samples (or any other plain-old-data type), for
+   passing data from one producer thread to one consumer thread without locks,
+   e.g. from an audio callback to the feature extraction.  This works in the
+   same way as the PortAudio ring buffer: the producer only ever changes the
+   write index and the consumer only the read index, and memory barriers make
+   sure that the data is in place before the index that makes it visible.
+
+   Both sides can work on the buffer's memory directly: the producer asks for
+   the regions it may write to with GetWriteRegions() and calls CommitWrite()
+   when they are filled, and the consumer asks for the regions it may read
+   with GetReadRegions() (so it can e.g. compute a window of samples straight
+   from the buffer, without copying it out) and calls Consume() once it no
+   longer needs them.  There are two regions because the data may wrap around
+   the end of the buffer; the second one is empty if it does not.
+ */
+template<class T>
+class RingBuffer {
+ public:
+  /// The capacity is min_capacity rounded up to a power of two.
+  explicit RingBuffer(size_t min_capacity = 0): mask_(0), read_index_(0),
+                                                write_index_(0) {
+    Reserve(min_capacity);
+  }
+
+  size_t Capacity() const { return data_.size(); }
+
+  /// Number of elements that can be read.  Call from the consumer thread
+  /// (from the producer it's a lower bound).
+  size_t ReadAvailable() const {
+    size_t ans = write_index_ - read_index_;
+    Barrier();  // don't read the data before the index.
+    return ans;
+  }
+
+  /// Number of elements that can be written.  Call from the producer thread
+  /// (from the consumer it's a lower bound).
+  size_t WriteAvailable() const {
+    size_t ans = data_.size() - (write_index_ - read_index_);
+    Barrier();  // don't overwrite data before the consumer is done.
+    return ans;
+  }
+
+  /// Producer: gets the regions into which up to n elements can be written;
+  /// returns the total size of the regions (<= n).
+  size_t GetWriteRegions(size_t n, T **data1, size_t *size1,
+                         T **data2, size_t *size2) {
+    n = std::min(n, WriteAvailable());
+    size_t index = write_index_ & mask_;
+    *data1 = (data_.empty() ? NULL : &(data_[index]));
+    *size1 = std::min(n, data_.size() - index);
+    *data2 = (data_.empty() ? NULL : &(data_[0]));
+    *size2 = n - *size1;
+    return n;
+  }
+
+  /// Producer: makes the next n elements (which must have been written to
+  /// the regions from GetWriteRegions()) visible to the consumer.
+  void CommitWrite(size_t n) {
+    KALDI_ASSERT(n <= data_.size() - (write_index_ - read_index_));
+    Barrier();  // the data must be in place before the index moves.
+    write_index_ += n;
+  }
+
+  /// Producer: copies up to n elements into the buffer; returns how many
+  /// there was room for.
+  size_t Write(const T *data, size_t n) {
+    T *data1, *data2;
+    size_t size1, size2;
+    n = GetWriteRegions(n, &data1, &size1, &data2, &size2);
+    if (size1 > 0) std::memcpy(data1, data, size1 * sizeof(T));
+    if (size2 > 0) std::memcpy(data2, data + size1, size2 * sizeof(T));
+    CommitWrite(n);
+    return n;
+  }
+
+  /// Consumer: gets the regions holding the n elements starting at "offset"
+  /// elements from the read position (fewer if not so many are available);
+  /// returns the total size of the regions.
+  size_t GetReadRegions(size_t offset, size_t n,
+                        const T **data1, size_t *size1,
+                        const T **data2, size_t *size2) const {
+    size_t available = ReadAvailable();
+    n = (offset >= available ? 0 : std::min(n, available - offset));
+    size_t index = (read_index_ + offset) & mask_;
+    *data1 = (data_.empty() ? NULL : &(data_[index]));
+    *size1 = std::min(n, data_.size() - index);
+    *data2 = (data_.empty() ? NULL : &(data_[0]));
+    *size2 = n - *size1;
+    return n;
+  }
+
+  /// Consumer: copies the n elements starting at "offset" elements from the
+  /// read position (fewer if not so many are available) to "data", without
+  /// consuming them; returns how many were copied.
+  size_t Peek(size_t offset, size_t n, T *data) const {
+    const T *data1, *data2;
+    size_t size1, size2;
+    n = GetReadRegions(offset, n, &data1, &size1, &data2, &size2);
+    if (size1 > 0) std::memcpy(data, data1, size1 * sizeof(T));
+    if (size2 > 0) std::memcpy(data + size1, data2, size2 * sizeof(T));
+    return n;
+  }
+
+  /// Consumer: frees the first n elements for the producer.
+  void Consume(size_t n) {
+    KALDI_ASSERT(n <= write_index_ - read_index_);
+    Barrier();  // we must be done with the data before the index moves.
+    read_index_ += n;
+  }
+
+  /// Consumer: copies up to n elements to "data" and consumes them; returns
+  /// how many there were.
+  size_t Read(T *data, size_t n) {
+    n = Peek(0, n, data);
+    Consume(n);
+    return n;
+  }
+
+  /// Grows the buffer so it can hold at least min_capacity elements, keeping
+  /// its contents.  Unlike the other functions, this must not be called
+  /// while another thread is using the buffer.
+  void Reserve(size_t min_capacity) {
+    if (min_capacity <= data_.size()) return;
+    size_t capacity = 1;
+    while (capacity < min_capacity) capacity *= 2;
+    size_t n = write_index_ - read_index_;
+    std::vector<T> new_data(capacity);
+    if (n > 0) Peek(0, n, &(new_data[0]));
+    data_.swap(new_data);
+    mask_ = capacity - 1;
+    read_index_ = 0;
+    write_index_ = n;
+  }
+
+ private:
+  static inline void Barrier() {
+#if defined(_MSC_VER)
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  std::vector<T> data_;
+  size_t mask_;  // data_.size() - 1.
+  // These count the elements read and written so far; the position in data_
+  // is the index & mask_, and they are allowed to wrap around.
+  volatile size_t read_index_;
+  volatile size_t write_index_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_RING_BUFFER_H_
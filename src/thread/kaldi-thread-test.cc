@@ -81,10 +81,109 @@ void TestThreads() {
 }
 
 
+// Like MyThreadClass, but for use with RunMultiThreadedPersistent.
+class MyThreadableClass: public MultiThreadable {
+ public:
+  MyThreadableClass(int32 max_to_count, int32 *i): max_to_count_(max_to_count),
+                                                   iptr_(i),
+                                                   private_counter_(0) { }
+  void operator() () {
+    int32 block_size = (max_to_count_+ (num_threads_-1) ) / num_threads_;
+    int32 start = block_size * thread_id_,
+        end = std::min(max_to_count_, start + block_size);
+    for (int32 j = start; j < end; j++)
+      private_counter_ += j;
+  }
+  ~MyThreadableClass() {
+    *iptr_ += private_counter_;
+  }
+ private:
+  int32 max_to_count_;
+  int32 *iptr_;
+  int32 private_counter_;
+};
+
+// Calls RunMultiThreadedPersistent from inside a job, which should then run
+// in the calling thread.
+class MyNestedClass: public MultiThreadable {
+ public:
+  explicit MyNestedClass(int32 *i): iptr_(i), private_counter_(0) { }
+  void operator() () {
+    MyThreadableClass c(100, &private_counter_);
+    RunMultiThreadedPersistent(c, 4);
+  }
+  ~MyNestedClass() {
+    *iptr_ += private_counter_;
+  }
+ private:
+  int32 *iptr_;
+  int32 private_counter_;
+};
+
+// Throws an exception in the job with thread_id_ == fail_id_.
+class MyFailingClass: public MultiThreadable {
+ public:
+  MyFailingClass(int32 fail_id, int32 *num_done): fail_id_(fail_id),
+                                                  num_done_(num_done),
+                                                  done_(false) { }
+  void operator() () {
+    if (thread_id_ == fail_id_)
+      KALDI_ERR << "Failing in job " << thread_id_ << " (this is expected)";
+    done_ = true;
+  }
+  ~MyFailingClass() {
+    if (done_) (*num_done_)++;
+  }
+ private:
+  int32 fail_id_;
+  int32 *num_done_;
+  bool done_;
+};
+
+void TestThreadsPersistentException() {
+  int32 num_threads = 4;
+  for (int32 fail_id = 0; fail_id < num_threads; fail_id++) {
+    int32 num_done = 0;
+    bool caught = false;
+    try {
+      MyFailingClass c(fail_id, &num_done);
+      RunMultiThreadedPersistent(c, num_threads);
+    } catch (const std::exception &) {
+      caught = true;
+    }
+    // All the other jobs must have finished before the exception got here.
+    KALDI_ASSERT(caught && num_done == num_threads - 1);
+  }
+  // The pool must still be usable.
+  int32 tot = 0;
+  MyThreadableClass c(10000, &tot);
+  RunMultiThreadedPersistent(c, num_threads);
+  KALDI_ASSERT(tot == (10000*(10000-1))/2);
+}
+
+void TestThreadsPersistent() {
+  for (int32 num_threads = 1; num_threads <= 8; num_threads++) {
+    // Run it many times, to check that the workers are reused correctly.
+    for (int32 i = 0; i < 1000; i++) {
+      int32 max_to_count = 10000, tot = 0;
+      MyThreadableClass c(max_to_count, &tot);
+      RunMultiThreadedPersistent(c, num_threads);
+      KALDI_ASSERT(tot == (10000*(10000-1))/2);
+    }
+  }
+  int32 tot = 0;
+  MyNestedClass c(&tot);
+  RunMultiThreadedPersistent(c, 3);
+  KALDI_ASSERT(tot == 3 * (100*(100-1))/2);
+}
+
+
 }  // end namespace kaldi.
 
 int main() {
   using namespace kaldi;
   TestThreads();
+  TestThreadsPersistent();
+  TestThreadsPersistentException();
 }
 
@@ -28,6 +28,127 @@ MultiThreadable::~MultiThreadable() {
   // default implementation does nothing
 }
 
+MultiThreadPool *MultiThreadPool::instance_ = NULL;
+pthread_once_t MultiThreadPool::instance_once_ = PTHREAD_ONCE_INIT;
+
+MultiThreadPool &MultiThreadPool::Instantiate() {
+  pthread_once(&instance_once_, CreateInstance);
+  return *instance_;
+}
+
+void MultiThreadPool::CreateInstance() {
+  // This is never deleted; the workers live until the program exits.
+  instance_ = new MultiThreadPool();
+}
+
+MultiThreadPool::MultiThreadPool(): generation_(0), num_pending_(0) {
+  pthread_mutex_init(&run_mutex_, NULL);
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&work_cond_, NULL);
+  pthread_cond_init(&done_cond_, NULL);
+}
+
+// The argument of WorkerLoop().
+struct MultiThreadPoolWorkerInfo {
+  MultiThreadPool *pool;
+  int32 worker;  // This is worker number "worker", so it runs jobs_[worker + 1].
+  int64 generation;  // The generation_ when it was created.
+};
+
+void MultiThreadPool::EnsureNumWorkers(int32 num_workers) {
+  while (static_cast<int32>(workers_.size()) < num_workers) {
+    MultiThreadPoolWorkerInfo *info = new MultiThreadPoolWorkerInfo;
+    info->pool = this;
+    info->worker = workers_.size();
+    pthread_mutex_lock(&mutex_);
+    info->generation = generation_;
+    pthread_mutex_unlock(&mutex_);
+    pthread_t thread;
+    int32 ret;
+    if ((ret = pthread_create(&thread, NULL, WorkerLoop, info))) {
+      const char *c = strerror(ret);
+      if (c == NULL) { c = "[NULL]"; }
+      KALDI_ERR << "Error creating thread, errno was: " << c;
+    }
+    pthread_detach(thread);
+    workers_.push_back(thread);
+  }
+}
+
+void *MultiThreadPool::WorkerLoop(void *arg) {
+  MultiThreadPoolWorkerInfo *info = static_cast<MultiThreadPoolWorkerInfo*>(arg);
+  MultiThreadPool *pool = info->pool;
+  size_t job_index = info->worker + 1;
+  int64 generation = info->generation;
+  delete info;
+  pthread_mutex_lock(&pool->mutex_);
+  while (true) {
+    while (pool->generation_ == generation)
+      pthread_cond_wait(&pool->work_cond_, &pool->mutex_);
+    generation = pool->generation_;
+    if (job_index < pool->jobs_.size()) {
+      MultiThreadable *job = pool->jobs_[job_index];
+      pthread_mutex_unlock(&pool->mutex_);
+      // An exception can't cross threads; we pass on its message, and Run()
+      // throws an exception with it once all the jobs have finished.
+      std::string error;
+      try {
+        (*job)();
+      } catch (const std::exception &e) {
+        error = e.what();
+        if (error.empty()) error = "[empty message]";
+      } catch (...) {
+        error = "[unknown exception]";
+      }
+      pthread_mutex_lock(&pool->mutex_);
+      if (!error.empty() && pool->worker_error_.empty())
+        pool->worker_error_ = error;
+      if (--pool->num_pending_ == 0)
+        pthread_cond_signal(&pool->done_cond_);
+    }
+  }
+  return NULL;
+}
+
+void MultiThreadPool::Run(const std::vector<MultiThreadable*> &jobs) {
+  if (jobs.size() <= 1 || pthread_mutex_trylock(&run_mutex_) != 0) {
+    for (size_t i = 0; i < jobs.size(); i++)
+      (*jobs[i])();
+    return;
+  }
+  EnsureNumWorkers(jobs.size() - 1);
+  pthread_mutex_lock(&mutex_);
+  jobs_ = jobs;
+  num_pending_ = jobs.size() - 1;
+  generation_++;
+  pthread_cond_broadcast(&work_cond_);
+  pthread_mutex_unlock(&mutex_);
+
+  try {
+    (*jobs[0])();
+  } catch (...) {
+    // The other jobs may still be using the caller's objects, so wait for
+    // them before passing the exception on.
+    WaitForWorkers();
+    throw;
+  }
+  std::string worker_error = WaitForWorkers();
+  if (!worker_error.empty())
+    KALDI_ERR << "Exception in worker thread: " << worker_error;
+}
+
+std::string MultiThreadPool::WaitForWorkers() {
+  pthread_mutex_lock(&mutex_);
+  while (num_pending_ > 0)
+    pthread_cond_wait(&done_cond_, &mutex_);
+  jobs_.clear();
+  std::string ans;
+  ans.swap(worker_error_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_mutex_unlock(&run_mutex_);
+  return ans;
+}
+
 
 
 }  // end namespace kaldi
@@ -28,6 +28,7 @@
 #endif
 
 #include <pthread.h>
+#include <string>
 #include "thread/kaldi-barrier.h"
 // This header provides a convenient mechanism for parallelization.  The idea is
 // that you have some range of integers, e.g. A ... B-1 (with B > A), and some
@@ -44,18 +45,22 @@
 // Description of MultiThreadPool and its usage:
 //
 // Usage of the RunMultiThreadedPersistent is the same as the usage of
-// RunMultiThreaded, except that the object provided ust inherit MultiThreadable
-// and it's run method isn't called, but operator() is called directly instead.
-// Member variables num_threads_ and thread_id_ must NOT be redefined in the
-// classes used, as they are called when using MultiThreadable*
+// RunMultiThreaded, except that the object provided must inherit
+// MultiThreadable and its run method isn't called, but operator() is called
+// directly instead.  Member variables num_threads_ and thread_id_ must NOT be
+// redefined in the classes used, as they are called when using
+// MultiThreadable*.
 //
-// MultiThreadPool is a singleton class, it's instance is obtained using
-// MultiThreadPool::Instantiate(). First instantiation initializes the thread
-// pool using g_num_threads threads, each of those threads runs infinite loop in
-// ThreadWorker::run(). When RunMultiThreadedPersistent(c) is called, each
-// ThreadWorker is given a pointer to a copy of c and calls c() in it's thread.
-// After doing this, it Waits on barrier to sync with all the threads and the
-// main one, then Waits again until it receives another job.
+// MultiThreadPool is a singleton class, its instance is obtained using
+// MultiThreadPool::Instantiate().  Its worker threads are created the first
+// time they are needed and then persist until the program exits, each of them
+// waiting for jobs in MultiThreadPool::WorkerLoop().  When
+// RunMultiThreadedPersistent(c) is called, the copy of c with thread_id_ == 0
+// is run in the calling thread and the others are handed to the workers; it
+// returns when they have all finished.  This avoids the cost of creating and
+// joining threads, so it is suitable for parallelizing operations that take
+// well under a millisecond, such as the CPU versions of the CuMatrix
+// operations.
 
 namespace kaldi {
 
@@ -164,6 +169,68 @@ class MultiThreader {
   std::vector<C> cvec_;
 };
 
+/// See the description of MultiThreadPool at the top of this file.
+class MultiThreadPool {
+ public:
+  static MultiThreadPool &Instantiate();
+
+  /// Calls (*jobs[i])() for each i, jobs[0] in the calling thread and the
+  /// others in worker threads, and returns when they have all finished.  If
+  /// the pool is already in use (because Run() was called from two threads at
+  /// once, or from inside one of the jobs), the jobs are all run in the
+  /// calling thread, one after another.  If a job throws, Run() waits for the
+  /// others to finish and then throws: the original exception if it came from
+  /// jobs[0], and otherwise a KaldiErrorException with its message.
+  void Run(const std::vector<MultiThreadable*> &jobs);
+
+ private:
+  MultiThreadPool();
+  MultiThreadPool(const MultiThreadPool &);  // Disallow.
+  MultiThreadPool &operator = (const MultiThreadPool &);  // Disallow.
+
+  static void CreateInstance();
+
+  // Creates worker threads until there are at least num_workers of them; must
+  // be called with run_mutex_ held.
+  void EnsureNumWorkers(int32 num_workers);
+
+  static void *WorkerLoop(void *arg);
+
+  // Waits for the workers to finish the current jobs, releases run_mutex_ and
+  // returns the message of the first exception a worker caught, if any.
+  std::string WaitForWorkers();
+
+  static MultiThreadPool *instance_;
+  static pthread_once_t instance_once_;
+
+  pthread_mutex_t run_mutex_;  // Held while Run() is using the workers.
+  pthread_mutex_t mutex_;  // Protects the members below.
+  pthread_cond_t work_cond_;  // Signaled when there are new jobs.
+  pthread_cond_t done_cond_;  // Signaled when num_pending_ reaches zero.
+  std::vector<pthread_t> workers_;
+  std::vector<MultiThreadable*> jobs_;  // jobs_[i + 1] is for worker i.
+  int64 generation_;  // Incremented each time new jobs are set.
+  int32 num_pending_;  // Number of jobs the workers have not finished.
+  std::string worker_error_;  // Message of the first exception in a worker.
+};
+
+/// Here, class C should inherit from MultiThreadable.  Like RunMultiThreaded(),
+/// but uses the threads of MultiThreadPool instead of creating new ones; see
+/// the description at the top of this file.
+template<class C> void RunMultiThreadedPersistent(const C &c_in,
+                                                  int32 num_threads =
+                                                  g_num_threads) {
+  num_threads = std::max<int32>(1, num_threads);
+  std::vector<C> cvec(num_threads, c_in);
+  std::vector<MultiThreadable*> jobs(num_threads);
+  for (int32 thread = 0; thread < num_threads; thread++) {
+    cvec[thread].thread_id_ = thread;
+    cvec[thread].num_threads_ = num_threads;
+    jobs[thread] = &(cvec[thread]);
+  }
+  MultiThreadPool::Instantiate().Run(jobs);
+}
+
 /// Here, class C should inherit from MultiThreadable.  Note: if you want to
 /// control the number of threads yourself, or need to do something in the main
 /// thread of the program while the objects exist, just initialize the
@@ -61,16 +61,11 @@ void AccCmvnStats(const MatrixBase<BaseFloat> &feats,
   }
 }
 
-void ApplyCmvn(const MatrixBase<double> &stats,
-               bool var_norm,
-               MatrixBase<BaseFloat> *feats) {
-  KALDI_ASSERT(feats != NULL);
+// Gets the normalization x(d) <-- x(d)*norm(1, d) + norm(0, d).
+static void GetCmvnNorm(const MatrixBase<double> &stats,
+                        bool var_norm,
+                        Matrix<BaseFloat> *norm_out) {
   int32 dim = stats.NumCols() - 1;
-  if (stats.NumRows() > 2 || stats.NumRows() < 1 || feats->NumCols() != dim) {
-    KALDI_ERR << "Dim mismatch in ApplyCmvn: cmvn "
-              << stats.NumRows() << 'x' << stats.NumCols()
-              << ", feats " << feats->NumRows() << 'x' << feats->NumCols();
-  }
   if (stats.NumRows() == 1 && var_norm)
     KALDI_ERR << "You requested variance normalization but no variance stats "
               << "are supplied.";
@@ -82,7 +77,8 @@ void ApplyCmvn(const MatrixBase<double> &stats,
     KALDI_ERR << "Insufficient stats for cepstral mean and variance normalization: "
               << "count = " << count;
   
-  Matrix<BaseFloat> norm(2, dim);  // norm(0, d) = mean offset
+  Matrix<BaseFloat> &norm = *norm_out;
+  norm.Resize(2, dim);  // norm(0, d) = mean offset
   // norm(1, d) = scale, e.g. x(d) <-- x(d)*norm(1, d) + norm(0, d).
   for (int32 d = 0; d < dim; d++) {
     double mean, offset, scale;
@@ -106,6 +102,20 @@ void ApplyCmvn(const MatrixBase<double> &stats,
     norm(0, d) = offset;
     norm(1, d) = scale;
   }
+}
+
+void ApplyCmvn(const MatrixBase<double> &stats,
+               bool var_norm,
+               MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(feats != NULL);
+  int32 dim = stats.NumCols() - 1;
+  if (stats.NumRows() > 2 || stats.NumRows() < 1 || feats->NumCols() != dim) {
+    KALDI_ERR << "Dim mismatch in ApplyCmvn: cmvn "
+              << stats.NumRows() << 'x' << stats.NumCols()
+              << ", feats " << feats->NumRows() << 'x' << feats->NumCols();
+  }
+  Matrix<BaseFloat> norm;
+  GetCmvnNorm(stats, var_norm, &norm);
   int32 num_frames = feats->NumRows();
 
   // Apply the normalization.
@@ -117,5 +127,21 @@ void ApplyCmvn(const MatrixBase<double> &stats,
   }
 }
 
+void GetCmvnTransform(const MatrixBase<double> &stats,
+                      bool var_norm,
+                      Matrix<BaseFloat> *transform) {
+  int32 dim = stats.NumCols() - 1;
+  if (stats.NumRows() > 2 || stats.NumRows() < 1 || dim < 0)
+    KALDI_ERR << "Bad cmvn stats dimension " << stats.NumRows() << 'x'
+              << stats.NumCols();
+  Matrix<BaseFloat> norm;
+  GetCmvnNorm(stats, var_norm, &norm);
+  transform->Resize(dim, dim + 1);
+  for (int32 d = 0; d < dim; d++) {
+    (*transform)(d, d) = norm(1, d);
+    (*transform)(d, dim) = norm(0, d);
+  }
+}
+
 
 }  // namespace kaldi
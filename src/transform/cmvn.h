@@ -52,6 +52,13 @@ void ApplyCmvn(const MatrixBase<double> &stats,
                bool norm_vars,
                MatrixBase<BaseFloat> *feats);
 
+/// Gets the normalization that ApplyCmvn() applies, as a dim by (dim+1) affine
+/// transform (a diagonal matrix, and the offsets in the last column), so it
+/// can be composed with other transforms.
+void GetCmvnTransform(const MatrixBase<double> &stats,
+                      bool norm_vars,
+                      Matrix<BaseFloat> *transform);
+
 }  // namespace kaldi
 
 #endif  // KALDI_TRANSFORM_CMVN_H_
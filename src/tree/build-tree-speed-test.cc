@@ -0,0 +1,119 @@
+// tree/build-tree-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "util/parse-options.h"
+#include "util/stl-utils.h"
+#include "util/timer.h"
+#include "tree/build-tree.h"
+
+namespace kaldi {
+
+// Builds a triphone tree from synthetic GaussClusterable stats, once serially
+// and once with several threads, and checks that the trees are identical.
+// The sizes are kept small so the test runs quickly; the timings it prints
+// are only a rough guide.
+void TestBuildTreeSpeed(int32 num_phones, int32 num_stats, int32 num_quest,
+                        int32 max_leaves, int32 num_threads) {
+  int32 dim = 39, N = 3, P = 1;
+  std::vector<int32> phone_ids(num_phones);
+  for (int32 i = 0; i < num_phones; i++)
+    phone_ids[i] = i + 1;
+  std::vector<int32> hmm_lengths(num_phones + 1, 3);
+  std::vector<bool> is_ctx_dep(num_phones + 1, true);
+  hmm_lengths[0] = 0;
+
+  BuildTreeStatsType stats;
+  GenRandStats(dim, num_stats, N, P, phone_ids, hmm_lengths, is_ctx_dep,
+               true, &stats);
+
+  Questions qopts;
+  qopts.InitRand(stats, num_quest, 0, kAllKeysUnion);
+
+  std::vector<std::vector<int32> > phone_sets(num_phones);
+  for (int32 i = 0; i < num_phones; i++)
+    phone_sets[i].push_back(phone_ids[i]);
+  std::vector<bool> share_roots(num_phones, true),
+      do_split(num_phones, true);
+  BaseFloat thresh = 0.0;
+
+  std::string tree_text[2];
+  double elapsed[2];
+  for (int32 i = 0; i < 2; i++) {
+    int32 this_num_threads = (i == 0 ? 1 : num_threads);
+    Timer tim;
+    EventMap *tree = BuildTree(qopts, phone_sets, hmm_lengths, share_roots,
+                               do_split, stats, thresh, max_leaves, 0.0, P,
+                               this_num_threads);
+    elapsed[i] = tim.Elapsed();
+    std::ostringstream os;
+    tree->Write(os, false);
+    tree_text[i] = os.str();
+    delete tree;
+  }
+  KALDI_ASSERT(tree_text[0] == tree_text[1]);
+  KALDI_LOG << "For BuildTree with " << num_phones << " phones, "
+            << stats.size() << " stats, " << num_quest << " questions and "
+            << max_leaves << " leaves, time was " << elapsed[0]
+            << " seconds with 1 thread and " << elapsed[1] << " seconds with "
+            << num_threads << " threads.";
+
+  // BuildTreeTwoLevel should not depend on the number of threads either.
+  std::vector<int32> leaf_map[2];
+  for (int32 i = 0; i < 2; i++) {
+    int32 this_num_threads = (i == 0 ? 1 : num_threads);
+    EventMap *tree = BuildTreeTwoLevel(qopts, phone_sets, hmm_lengths,
+                                       share_roots, do_split, stats,
+                                       max_leaves / 4, max_leaves, true, P,
+                                       &(leaf_map[i]), this_num_threads);
+    std::ostringstream os;
+    tree->Write(os, false);
+    tree_text[i] = os.str();
+    delete tree;
+  }
+  KALDI_ASSERT(tree_text[0] == tree_text[1] && leaf_map[0] == leaf_map[1]);
+  DeleteBuildTreeStats(&stats);
+}
+
+}  // end namespace kaldi
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  const char *usage =
+      "Times BuildTree() with one thread and several threads.  By default the\n"
+      "trees are small enough for a unit test; use --full for a tree of the\n"
+      "size built for a typical large-vocabulary system.\n"
+      "Usage: build-tree-speed-test [options]\n";
+  ParseOptions po(usage);
+  bool full = false;
+  int32 num_threads = 4;
+  po.Register("full", &full, "If true, also build a production-scale tree "
+              "(40 phones, 100k stats, 200 questions, 4000 leaves).");
+  po.Register("num-threads", &num_threads, "Number of threads to compare "
+              "with one thread in the largest configuration.");
+  po.Read(argc, argv);
+  if (po.NumArgs() != 0) {
+    po.PrintUsage();
+    exit(1);
+  }
+  TestBuildTreeSpeed(10, 2000, 20, 200, 2);
+  TestBuildTreeSpeed(15, 3000, 20, 300, num_threads);
+  if (full)
+    TestBuildTreeSpeed(40, 100000, 200, 4000, num_threads);
+  std::cout << "Test OK.\n";
+}
@@ -21,6 +21,8 @@
 #include <queue>
 #include "util/stl-utils.h"
 #include "tree/build-tree-utils.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-mutex.h"
 
 
 
@@ -343,30 +345,21 @@ BaseFloat ComputeInitialSplit(const std::vector<Clusterable*> &summed_stats,
 }
 
 
-// returns best delta-objf.
-// If key does not exist, returns 0 and sets yes_set_out to empty.
-BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
-                              const Questions &q_opts,
-                              EventKeyType key,
-                              std::vector<EventValueType> *yes_set_out) {
-  if (stats.size()<=1) return 0.0;  // cannot split if only zero or one instance of stats.
-  if (!PossibleValues(key, stats, NULL)) {
-    yes_set_out->clear();
-    return 0.0;  // Can't split as key not always defined.
-  }
-  std::vector<Clusterable*> summed_stats;  // indexed by value corresponding to key. owned here.
-  {  // compute summed_stats
-    std::vector<BuildTreeStatsType> split_stats;
-    SplitStatsByKey(stats, key, &split_stats);
-    SumStatsVec(split_stats, &summed_stats);
-  }
-
+// This is the part of FindBestSplitForKey that comes after we have summed the
+// stats for each value of the key.  "summed_stats_in" is indexed by value and
+// may contain NULL pointers; it is not modified, and its pointers are not
+// owned here.  Returns best delta-objf.
+static BaseFloat FindBestSplitForKeyGivenSummedStats(
+    const std::vector<Clusterable*> &summed_stats_in,
+    const Questions &q_opts,
+    EventKeyType key,
+    std::vector<EventValueType> *yes_set_out) {
   std::vector<EventValueType> yes_set;
-  BaseFloat improvement = ComputeInitialSplit(summed_stats,
+  BaseFloat improvement = ComputeInitialSplit(summed_stats_in,
                                                q_opts, key, &yes_set);
   // find best basic question.
 
-  std::vector<int32> assignments(summed_stats.size(), 0);  // assigns to "no" (0) by default.
+  std::vector<int32> assignments(summed_stats_in.size(), 0);  // assigns to "no" (0) by default.
   for (std::vector<EventValueType>::const_iterator iter = yes_set.begin(); iter != yes_set.end(); iter++) {
     KALDI_ASSERT(*iter>=0);
     if (*iter < (EventValueType)assignments.size()) {
@@ -376,8 +369,15 @@ BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
     }
   }
   std::vector<Clusterable*> clusters(2, (Clusterable*)NULL);  // no, yes.
-  kaldi::AddToClusters(summed_stats, assignments, &clusters);
-
+  kaldi::AddToClusters(summed_stats_in, assignments, &clusters);
+
+  // We need non-NULL stats for RefineClusters; summed_stats is a copy of
+  // summed_stats_in with the NULL pointers replaced by empty stats, which
+  // are owned here (see "was_null").
+  std::vector<Clusterable*> summed_stats(summed_stats_in);
+  std::vector<bool> was_null(summed_stats.size());
+  for (size_t i = 0; i < summed_stats.size(); i++)
+    was_null[i] = (summed_stats[i] == NULL);
   EnsureClusterableVectorNotNull(&summed_stats);
   EnsureClusterableVectorNotNull(&clusters);
 
@@ -416,16 +416,58 @@ BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
     DeletePointers(&clusters);
   }
 #endif
-  DeletePointers(&summed_stats);
+  for (size_t i = 0; i < summed_stats.size(); i++)
+    if (was_null[i]) delete summed_stats[i];
   return improvement; // objective-function improvement.
 }
 
+// returns best delta-objf.
+// If key does not exist, returns 0 and sets yes_set_out to empty.
+BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
+                              const Questions &q_opts,
+                              EventKeyType key,
+                              std::vector<EventValueType> *yes_set_out) {
+  if (stats.size()<=1) return 0.0;  // cannot split if only zero or one instance of stats.
+  if (!PossibleValues(key, stats, NULL)) {
+    yes_set_out->clear();
+    return 0.0;  // Can't split as key not always defined.
+  }
+  std::vector<Clusterable*> summed_stats;  // indexed by value corresponding to key. owned here.
+  {  // compute summed_stats
+    std::vector<BuildTreeStatsType> split_stats;
+    SplitStatsByKey(stats, key, &split_stats);
+    SumStatsVec(split_stats, &summed_stats);
+  }
+  BaseFloat improvement = FindBestSplitForKeyGivenSummedStats(
+      summed_stats, q_opts, key, yes_set_out);
+  DeletePointers(&summed_stats);
+  return improvement;
+}
+
 
 
 /*
-  DecisionTreeBuilder is a class used in SplitDecisionTree
+  DecisionTreeSplitter is a class used in SplitDecisionTree.
+
+  Finding the best split of a leaf involves, for each key that has questions,
+  summing the stats for each value of the key and evaluating the questions.
+  The (leaf, key) pairs are independent so we evaluate them in parallel (see
+  DecisionTreeSplitterEvaluator); the choice of the best key is done
+  afterwards, in the same order as the serial algorithm, so the resulting tree
+  does not depend on the number of threads.  A leaf keeps the summed stats
+  for the key it would be split on; when it is split, the children take the
+  relevant subsets of those and don't need to re-sum the stats for that key.
 */
 
+class DecisionTreeSplitter;
+
+// A (splitter, key-index) pair: a unit of work for
+// DecisionTreeSplitterEvaluator.
+typedef std::pair<DecisionTreeSplitter*, size_t> DecisionTreeSplitJob;
+
+static void EvaluateSplitJobs(const std::vector<DecisionTreeSplitJob> &jobs,
+                              int32 num_threads);
+
 class DecisionTreeSplitter {
  public:
   EventMap *GetMap() {
@@ -444,15 +486,98 @@ class DecisionTreeSplitter {
       best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());  // may have changed.
     }
   }
+  // The constructor does not work out the best split; you have to call
+  // GetSplitJobs(), evaluate the jobs with EvaluateKey() and then call
+  // FinishSplit() (see EvaluateSplitJobs()).  "key_stats", if non-NULL, are
+  // summed stats for each value of key "key" (as from SplitStatsByKey and
+  // SumStatsVec), which we take ownership of; this saves re-summing them.
   DecisionTreeSplitter(EventAnswerType leaf, const BuildTreeStatsType &stats,
-                      const Questions &q_opts): q_opts_(q_opts), yes_(NULL), no_(NULL), leaf_(leaf), stats_(stats) {
-    // not, this must work when stats is empty too. [just gives zero improvement, non-splittable].
-    FindBestSplit();
+                       const Questions &q_opts, int32 num_threads,
+                       EventKeyType key = 0,
+                       std::vector<Clusterable*> *key_stats = NULL):
+      q_opts_(q_opts), num_threads_(num_threads), best_split_impr_(0.0),
+      yes_(NULL), no_(NULL), leaf_(leaf), stats_(stats) {
+    // note, this must work when stats is empty too. [just gives zero improvement, non-splittable].
+    q_opts_.GetKeysWithQuestions(&all_keys_);
+    if (all_keys_.size() == 0) {
+      KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
+    }
+    key_imprs_.resize(all_keys_.size(), 0.0);
+    key_yes_sets_.resize(all_keys_.size());
+    key_stats_.resize(all_keys_.size());
+    key_stats_computed_.resize(all_keys_.size(), false);
+    if (key_stats != NULL) {
+      for (size_t i = 0; i < all_keys_.size(); i++) {
+        if (all_keys_[i] == key) {
+          key_stats_[i].swap(*key_stats);
+          key_stats_computed_[i] = true;
+        }
+      }
+      DeletePointers(key_stats); // in case it was not one of our keys.
+    }
   }
   ~DecisionTreeSplitter() {
     if (yes_) delete yes_;
     if (no_) delete no_;
+    for (size_t i = 0; i < key_stats_.size(); i++)
+      DeletePointers(&(key_stats_[i]));
+  }
+
+  // Outputs the list of jobs needed to find the best split of this leaf.
+  void GetSplitJobs(std::vector<DecisionTreeSplitJob> *jobs) {
+    for (size_t i = 0; i < all_keys_.size(); i++)
+      if (q_opts_.HasQuestionsForKey(all_keys_[i]))
+        jobs->push_back(std::make_pair(this, i));
+  }
+
+  // Works out the best split for the i'th key; may be called in parallel
+  // for different keys.
+  void EvaluateKey(size_t i) {
+    EventKeyType key = all_keys_[i];
+    std::vector<EventValueType> &yes_set = key_yes_sets_[i];
+    yes_set.clear();
+    key_imprs_[i] = 0.0;
+    // The next two checks are as in FindBestSplitForKey().
+    if (stats_.size() <= 1) return;  // cannot split if only zero or one
+                                     // instance of stats.
+    if (!key_stats_computed_[i]) {
+      if (!PossibleValues(key, stats_, NULL))
+        return;  // Can't split as key not always defined.
+      std::vector<BuildTreeStatsType> split_stats;
+      SplitStatsByKey(stats_, key, &split_stats);
+      SumStatsVec(split_stats, &(key_stats_[i]));
+      key_stats_computed_[i] = true;
+    }
+    key_imprs_[i] = FindBestSplitForKeyGivenSummedStats(key_stats_[i], q_opts_,
+                                                        key, &yes_set);
   }
+
+  // This sets best_split_impr_, key_ and yes_set_, from the results of
+  // EvaluateKey().  It frees the summed stats for the keys we won't split on.
+  void FinishSplit() {
+    best_split_impr_ = 0;
+    int32 best_i = -1;
+    for (size_t i = 0; i < all_keys_.size(); i++) {
+      if (q_opts_.HasQuestionsForKey(all_keys_[i])) {
+        BaseFloat split_improvement = key_imprs_[i];
+        if (split_improvement > best_split_impr_) {
+          best_split_impr_ = split_improvement;
+          yes_set_ = key_yes_sets_[i];
+          key_ = all_keys_[i];
+          best_i = i;
+        }
+      }
+    }
+    for (size_t i = 0; i < all_keys_.size(); i++) {
+      std::vector<EventValueType>().swap(key_yes_sets_[i]);  // free memory.
+      if (static_cast<int32>(i) != best_i) {
+        DeletePointers(&(key_stats_[i]));
+        std::vector<Clusterable*>().swap(key_stats_[i]);
+        key_stats_computed_[i] = false;
+      }
+    }
+  }
+
  private:
   void DoSplitInternal(int32 *next_leaf) {
     // Does the split; applicable only to leaf nodes.
@@ -463,12 +588,18 @@ class DecisionTreeSplitter {
     // Now split the stats.
     BuildTreeStatsType yes_stats, no_stats;
     yes_stats.reserve(stats_.size()); no_stats.reserve(stats_.size());  //  probably better than multiple resizings.
+    EventValueType yes_max_val = -1, no_max_val = -1;
     for (BuildTreeStatsType::const_iterator iter = stats_.begin(); iter != stats_.end(); ++iter) {
       const EventType &vec = iter->first;
       EventValueType val;
       if (!EventMap::Lookup(vec, key_, &val)) KALDI_ERR << "DoSplitInternal: key has no value.";
-      if (std::binary_search(yes_set_.begin(), yes_set_.end(), val)) yes_stats.push_back(*iter);
-      else no_stats.push_back(*iter);
+      if (std::binary_search(yes_set_.begin(), yes_set_.end(), val)) {
+        yes_stats.push_back(*iter);
+        yes_max_val = std::max(yes_max_val, val);
+      } else {
+        no_stats.push_back(*iter);
+        no_max_val = std::max(no_max_val, val);
+      }
     }
 #ifdef KALDI_PARANOID
     {  // Check objf improvement.
@@ -481,38 +612,47 @@ class DecisionTreeSplitter {
       delete yes_clust; delete no_clust;
     }
 #endif
-    yes_ = new DecisionTreeSplitter(yes_leaf, yes_stats, q_opts_);
-    no_ = new DecisionTreeSplitter(no_leaf, no_stats, q_opts_);
-    best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());
-    stats_.clear();  // note: pointers in stats_ were not owned here.
-  }
-  void FindBestSplit() {
-    // This sets best_split_impr_, key_ and yes_set_.
-    // May just pick best question, or may iterate a bit (depends on
-    // q_opts; see FindBestSplitForKey for details)
-    std::vector<EventKeyType> all_keys;
-    q_opts_.GetKeysWithQuestions(&all_keys);
-    if (all_keys.size() == 0) {
-      KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
-    }
-    best_split_impr_ = 0;
-    for (size_t i = 0; i < all_keys.size(); i++) {
-      if (q_opts_.HasQuestionsForKey(all_keys[i])) {
-        std::vector<EventValueType> temp_yes_set;
-        BaseFloat split_improvement = FindBestSplitForKey(stats_, q_opts_, all_keys[i], &temp_yes_set);
-        if (split_improvement > best_split_impr_) {
-          best_split_impr_ = split_improvement;
-          yes_set_ = temp_yes_set;
-          key_ = all_keys[i];
+    // Give each child the summed stats for the values of key_ that it
+    // has; these are the same as it would have computed itself, since the
+    // order of the stats is unchanged.  The sizes are as SplitStatsByKey
+    // would give (one more than the largest value seen).
+    std::vector<Clusterable*> yes_key_stats(yes_max_val + 1, NULL),
+        no_key_stats(no_max_val + 1, NULL);
+    for (size_t i = 0; i < all_keys_.size(); i++) {
+      if (all_keys_[i] == key_ && key_stats_computed_[i]) {
+        std::vector<Clusterable*> &key_stats = key_stats_[i];
+        for (size_t v = 0; v < key_stats.size(); v++) {
+          if (key_stats[v] == NULL) continue;
+          EventValueType val = static_cast<EventValueType>(v);
+          if (std::binary_search(yes_set_.begin(), yes_set_.end(), val)) {
+            KALDI_ASSERT(val <= yes_max_val);
+            yes_key_stats[v] = key_stats[v];
+          } else {
+            KALDI_ASSERT(val <= no_max_val);
+            no_key_stats[v] = key_stats[v];
+          }
+          key_stats[v] = NULL;  // ownership transferred to the children.
         }
+        key_stats_computed_[i] = false;
       }
     }
+    yes_ = new DecisionTreeSplitter(yes_leaf, yes_stats, q_opts_, num_threads_,
+                                    key_, &yes_key_stats);
+    no_ = new DecisionTreeSplitter(no_leaf, no_stats, q_opts_, num_threads_,
+                                   key_, &no_key_stats);
+    std::vector<DecisionTreeSplitJob> jobs;
+    yes_->GetSplitJobs(&jobs);
+    no_->GetSplitJobs(&jobs);
+    EvaluateSplitJobs(jobs, num_threads_);
+    yes_->FinishSplit();
+    no_->FinishSplit();
+    best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());
+    stats_.clear();  // note: pointers in stats_ were not owned here.
   }
 
-
-
   // Data members... Always used:
   const Questions &q_opts_;
+  int32 num_threads_;
   BaseFloat best_split_impr_;
 
   // If already split:
@@ -527,8 +667,54 @@ class DecisionTreeSplitter {
   EventKeyType key_;
   std::vector<EventValueType> yes_set_;
 
+  // Per-key quantities, indexed as all_keys_.  Apart from key_stats_ and
+  // key_stats_computed_ (for the best key), these are only used between
+  // GetSplitJobs() and FinishSplit().
+  std::vector<EventKeyType> all_keys_;
+  std::vector<BaseFloat> key_imprs_;
+  std::vector<std::vector<EventValueType> > key_yes_sets_;
+  std::vector<std::vector<Clusterable*> > key_stats_;  // summed stats for each
+                                                       // value of the key; owned here.
+  std::vector<bool> key_stats_computed_;
 };
 
+// This class is used to evaluate DecisionTreeSplitJobs in parallel.  The
+// threads take jobs from a shared list, since they differ a lot in size.
+class DecisionTreeSplitterEvaluator: public MultiThreadable {
+ public:
+  DecisionTreeSplitterEvaluator(const std::vector<DecisionTreeSplitJob> &jobs,
+                                size_t *next_job, Mutex *mutex):
+      jobs_(jobs), next_job_(next_job), mutex_(mutex) { }
+  void operator () () {
+    while (true) {
+      mutex_->Lock();
+      size_t j = (*next_job_)++;
+      mutex_->Unlock();
+      if (j >= jobs_.size()) return;
+      jobs_[j].first->EvaluateKey(jobs_[j].second);
+    }
+  }
+ private:
+  const std::vector<DecisionTreeSplitJob> &jobs_;
+  size_t *next_job_;
+  Mutex *mutex_;
+};
+
+static void EvaluateSplitJobs(const std::vector<DecisionTreeSplitJob> &jobs,
+                              int32 num_threads) {
+  if (num_threads <= 1 || jobs.size() <= 1) {
+    for (size_t j = 0; j < jobs.size(); j++)
+      jobs[j].first->EvaluateKey(jobs[j].second);
+  } else {
+    size_t next_job = 0;
+    Mutex mutex;
+    DecisionTreeSplitterEvaluator c(jobs, &next_job, &mutex);
+    // The destructor of MultiThreader waits for the threads to finish.
+    MultiThreader<DecisionTreeSplitterEvaluator> m(
+        std::min<int32>(num_threads, jobs.size()), c);
+  }
+}
+
 EventMap *SplitDecisionTree(const EventMap &input_map,
                             const BuildTreeStatsType &stats,
                             Questions &q_opts,
@@ -536,7 +722,8 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
                             int32 max_leaves,  // max_leaves<=0 -> no maximum.
                             int32 *num_leaves,
                             BaseFloat *obj_impr_out,
-                            BaseFloat *smallest_split_change_out) {
+                            BaseFloat *smallest_split_change_out,
+                            int32 num_threads) {
   KALDI_ASSERT(num_leaves != NULL && *num_leaves > 0);  // can't be 0 or input_map would be empty.
   int32 num_empty_leaves = 0;
   BaseFloat like_impr = 0.0;
@@ -551,8 +738,17 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
     for (size_t i = 0;i < split_stats.size();i++) {
       EventAnswerType leaf = static_cast<EventAnswerType>(i);
       if (split_stats[i].size() == 0) num_empty_leaves++;
-      builders[i] = new DecisionTreeSplitter(leaf, split_stats[i], q_opts);
+      builders[i] = new DecisionTreeSplitter(leaf, split_stats[i], q_opts,
+                                             num_threads);
     }
+    // Find the best split of each of the initial leaves; this is where most
+    // of the parallelism is, since there are many leaves.
+    std::vector<DecisionTreeSplitJob> jobs;
+    for (size_t i = 0; i < builders.size(); i++)
+      builders[i]->GetSplitJobs(&jobs);
+    EvaluateSplitJobs(jobs, num_threads);
+    for (size_t i = 0; i < builders.size(); i++)
+      builders[i]->FinishSplit();
   }
 
   {  // Do the splitting.
@@ -596,7 +792,8 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
 }
 
 
-int ClusterEventMapGetMapping(const EventMap &e_in, const BuildTreeStatsType &stats, BaseFloat thresh, std::vector<EventMap*> *mapping) {
+int ClusterEventMapGetMapping(const EventMap &e_in, const BuildTreeStatsType &stats, BaseFloat thresh, std::vector<EventMap*> *mapping,
+                              int32 num_threads) {
   // First map stats
   KALDI_ASSERT(stats.size() != 0);
   std::vector<BuildTreeStatsType> split_stats;
@@ -626,7 +823,8 @@ int ClusterEventMapGetMapping(const EventMap &e_in, const BuildTreeStatsType &st
                            thresh,
                            0,  // no min-clust: use threshold for now.
                            NULL,  // don't need clusters out.
-                           &assignments);  // this algorithm is quadratic, so might be quite slow.
+                           &assignments,  // this algorithm is quadratic, so might be quite slow.
+                           num_threads);
 
 
   KALDI_ASSERT(assignments.size() == summed_stats_contiguous.size() && !assignments.empty());
@@ -688,9 +886,11 @@ EventMap *MapEventMapLeaves(const EventMap &e_in,
 }
 
 EventMap *ClusterEventMap(const EventMap &e_in, const BuildTreeStatsType &stats,
-                          BaseFloat thresh, int32 *num_removed_ptr) {
+                          BaseFloat thresh, int32 *num_removed_ptr,
+                          int32 num_threads) {
   std::vector<EventMap*> mapping;
-  int32 num_removed = ClusterEventMapGetMapping(e_in, stats, thresh, &mapping);
+  int32 num_removed = ClusterEventMapGetMapping(e_in, stats, thresh, &mapping,
+                                                num_threads);
   EventMap *ans = e_in.Copy(mapping);
   DeletePointers(&mapping);
   if (num_removed_ptr != NULL) *num_removed_ptr = num_removed;
@@ -797,9 +997,11 @@ static int32 ClusterEventMapRestrictedHelper(const EventMap &e_in,
                                              const BuildTreeStatsType &stats,
                                              BaseFloat thresh,
                                              std::vector<EventKeyType> keys,
-                                             std::vector<EventMap*> *leaf_mapping) {
+                                             std::vector<EventMap*> *leaf_mapping,
+                                             int32 num_threads) {
   if (keys.size() == 0) {
-    return ClusterEventMapGetMapping(e_in, stats, thresh, leaf_mapping);
+    return ClusterEventMapGetMapping(e_in, stats, thresh, leaf_mapping,
+                                     num_threads);
   } else {  // split on the key.
     int32 ans = 0;
     std::vector<BuildTreeStatsType> split_stats;
@@ -807,7 +1009,8 @@ static int32 ClusterEventMapRestrictedHelper(const EventMap &e_in,
     keys.pop_back();
     for (size_t i = 0; i< split_stats.size(); i++)
       if (split_stats[i].size() != 0)
-        ans += ClusterEventMapRestrictedHelper(e_in, split_stats[i], thresh, keys, leaf_mapping);
+        ans += ClusterEventMapRestrictedHelper(e_in, split_stats[i], thresh, keys, leaf_mapping,
+                                               num_threads);
     return ans;
   }
 }
@@ -816,10 +1019,12 @@ EventMap *ClusterEventMapRestrictedByKeys(const EventMap &e_in,
                                           const BuildTreeStatsType &stats,
                                           BaseFloat thresh,
                                           const std::vector<EventKeyType> &keys,
-                                          int32 *num_removed) {
+                                          int32 *num_removed,
+                                          int32 num_threads) {
   std::vector<EventMap*> leaf_mapping;  // For output of ClusterEventMapGetMapping.
 
-  int32 nr = ClusterEventMapRestrictedHelper(e_in, stats, thresh, keys, &leaf_mapping);
+  int32 nr = ClusterEventMapRestrictedHelper(e_in, stats, thresh, keys, &leaf_mapping,
+                                             num_threads);
   if (num_removed != NULL) *num_removed = nr;
 
   EventMap *ans = e_in.Copy(leaf_mapping);
@@ -832,7 +1037,8 @@ EventMap *ClusterEventMapRestrictedByMap(const EventMap &e_in,
                                          const BuildTreeStatsType &stats,
                                          BaseFloat thresh,
                                          const EventMap &e_restrict,
-                                         int32 *num_removed_ptr) {
+                                         int32 *num_removed_ptr,
+                                         int32 num_threads) {
   std::vector<EventMap*> leaf_mapping;
 
   std::vector<BuildTreeStatsType> split_stats;
@@ -841,7 +1047,7 @@ EventMap *ClusterEventMapRestrictedByMap(const EventMap &e_in,
   for (size_t i = 0; i < split_stats.size(); i++) {
     if (!split_stats[i].empty())
       num_removed += ClusterEventMapGetMapping(e_in, split_stats[i], thresh,
-                                               &leaf_mapping);
+                                               &leaf_mapping, num_threads);
   }
 
   if (num_removed_ptr != NULL) *num_removed_ptr = num_removed;
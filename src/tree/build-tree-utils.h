@@ -191,16 +191,19 @@ EventMap *DoTableSplitMultiple(const EventMap &orig,
 // *If you only want to cluster a subset of the leaves (e.g. just non-silence, or just
 // a particular phone, do this by providing a set of "stats" that correspond to just
 // this subset of leaves*.  Leaves with no stats will not be clustered.
-// See build-tree.cc for an example of usage.
+// See build-tree.cc for an example of usage.  "num_threads" is passed to
+// ClusterBottomUp().
 int ClusterEventMapGetMapping(const EventMap &e_in, const BuildTreeStatsType &stats,
-                              BaseFloat thresh, std::vector<EventMap*> *mapping);
+                              BaseFloat thresh, std::vector<EventMap*> *mapping,
+                              int32 num_threads = 1);
 
 /// This is as ClusterEventMapGetMapping but a more convenient interface
 /// that exposes less of the internals.  It uses a bottom-up clustering to
 /// combine the leaves, until the log-likelihood decrease from combinging two
 /// leaves exceeds the threshold.
 EventMap *ClusterEventMap(const EventMap &e_in, const BuildTreeStatsType &stats,
-                          BaseFloat thresh, int32 *num_removed);
+                          BaseFloat thresh, int32 *num_removed,
+                          int32 num_threads = 1);
 
 /// This is as ClusterEventMap, but first splits the stats on the keys specified
 /// in "keys" (e.g. typically keys = [ -1, P ]), and only clusters within the
@@ -210,7 +213,8 @@ EventMap *ClusterEventMapRestrictedByKeys(const EventMap &e_in,
                                           const BuildTreeStatsType &stats,
                                           BaseFloat thresh,
                                           const std::vector<EventKeyType> &keys,
-                                          int32 *num_removed);
+                                          int32 *num_removed,
+                                          int32 num_threads = 1);
 
 
 /// This version of ClusterEventMapRestricted restricts the clustering to only
@@ -220,7 +224,8 @@ EventMap *ClusterEventMapRestrictedByMap(const EventMap &e_in,
                                          const BuildTreeStatsType &stats,
                                          BaseFloat thresh,
                                          const EventMap &e_restrict,
-                                         int32 *num_removed);
+                                         int32 *num_removed,
+                                         int32 num_threads = 1);
 
 
 /// RenumberEventMap [intended to be used after calling ClusterEventMap] renumbers
@@ -269,6 +274,9 @@ EventMap *ShareEventMapLeaves(const EventMap &e_in, EventKeyType key,
 /// @param smallest_split_change_out If non-NULL, will be set to the smallest objective-function
 ///         improvement that we got from splitting any leaf; useful to provide a threshold
 ///         for ClusterEventMap.
+/// @param num_threads [in] Number of threads to use when evaluating the
+///         candidate splits of different leaves and keys; the resulting tree
+///         does not depend on this.
 /// @return The EventMap after splitting is returned; pointer is owned by caller.
 EventMap *SplitDecisionTree(const EventMap &orig,
                             const BuildTreeStatsType &stats,
@@ -277,7 +285,8 @@ EventMap *SplitDecisionTree(const EventMap &orig,
                             int32 max_leaves,  // max_leaves<=0 -> no maximum.
                             int32 *num_leaves,
                             BaseFloat *objf_impr_out,
-                            BaseFloat *smallest_split_change_out);
+                            BaseFloat *smallest_split_change_out,
+                            int32 num_threads = 1);
 
 /// CreateRandomQuestions will initialize a Questions randomly, in a reasonable
 /// way [for testing purposes, or when hand-designed questions are not available].
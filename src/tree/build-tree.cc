@@ -141,7 +141,8 @@ EventMap *BuildTree(Questions &qopts,
                     BaseFloat thresh,
                     int32 max_leaves,
                     BaseFloat cluster_thresh,  // typically == thresh.  If negative, use smallest split.
-                    int32 P) {
+                    int32 P,
+                    int32 num_threads) {
   KALDI_ASSERT(thresh > 0 || max_leaves > 0);
   KALDI_ASSERT(stats.size() != 0);
   KALDI_ASSERT(!phone_sets.empty()
@@ -179,7 +180,8 @@ EventMap *BuildTree(Questions &qopts,
   EventMap *tree_split = SplitDecisionTree(*tree_stub,
                                            filtered_stats,
                                            qopts, thresh, max_leaves,
-                                           &num_leaves, &impr, &smallest_split);
+                                           &num_leaves, &impr, &smallest_split,
+                                           num_threads);
   
   if (cluster_thresh < 0.0) {
     KALDI_LOG <<  "Setting clustering threshold to smallest split " << smallest_split;
@@ -209,7 +211,8 @@ EventMap *BuildTree(Questions &qopts,
                                                               stats,
                                                               cluster_thresh,
                                                               *tree_stub,
-                                                              &num_removed);
+                                                              &num_removed,
+                                                              num_threads);
     KALDI_LOG <<  "BuildTree: removed "<< num_removed << " leaves.";
 
     int32 num_leaves = 0;
@@ -320,13 +323,15 @@ EventMap *BuildTreeTwoLevel(Questions &qopts,
                             int32 max_leaves_second,
                             bool cluster_leaves,
                             int32 P,
-                            std::vector<int32> *leaf_map) {
+                            std::vector<int32> *leaf_map,
+                            int32 num_threads) {
 
   KALDI_LOG << "****BuildTreeTwoLevel: building first level tree";
   EventMap *first_level_tree = BuildTree(qopts, phone_sets,
                                          phone2num_pdf_classes,
                                          share_roots, do_split, stats, 0.0,
-                                         max_leaves_first, 0.0, P);
+                                         max_leaves_first, 0.0, P,
+                                         num_threads);
   KALDI_ASSERT(first_level_tree != NULL);
   KALDI_LOG << "****BuildTreeTwoLevel: done building first level tree";
 
@@ -352,7 +357,8 @@ EventMap *BuildTreeTwoLevel(Questions &qopts,
   EventMap *tree = SplitDecisionTree(*first_level_tree,
                                      filtered_stats,
                                      qopts, 0.0, max_leaves_second,
-                                     &num_leaves, &impr, &smallest_split);
+                                     &num_leaves, &impr, &smallest_split,
+                                     num_threads);
   
   KALDI_LOG << "Building second-level tree: increased #leaves from "
             << old_num_leaves << " to " << num_leaves << ", smallest split was "
@@ -375,7 +381,8 @@ EventMap *BuildTreeTwoLevel(Questions &qopts,
                                                               stats,
                                                               smallest_split,
                                                               *first_level_tree,
-                                                              &num_removed);
+                                                              &num_removed,
+                                                              num_threads);
     KALDI_LOG <<  "BuildTreeTwoLevel: removed " << num_removed << " leaves.";
     
     int32 num_leaves = 0;
@@ -75,6 +75,9 @@ namespace kaldi {
  
  * @param P [in] The central position of the phone context window, e.g. 1 for a
  *                triphone system.
+ * @param num_threads [in] Number of threads used in decision-tree splitting
+ *                and in clustering the leaves (see SplitDecisionTree and
+ *                ClusterBottomUp); does not affect the result.
  * @return  Returns a pointer to an EventMap object that is the tree.
 
 */
@@ -88,7 +91,8 @@ EventMap *BuildTree(Questions &qopts,
                     BaseFloat thresh,
                     int32 max_leaves,
                     BaseFloat cluster_thresh,  // typically == thresh.  If negative, use smallest split.
-                    int32 P);
+                    int32 P,
+                    int32 num_threads = 1);
 
 
 /**
@@ -138,6 +142,8 @@ EventMap *BuildTree(Questions &qopts,
  * @param leaf_map [out]  Will be set to be a mapping from the leaves of the
  *                 "big" tree to the leaves of the "little" tree, which you can
  *                 view as cluster centers.
+ * @param num_threads [in] Number of threads, as for BuildTree; does not affect
+ *                 the result.
  * @return  Returns a pointer to an EventMap object that is the (big) tree.
 
 */
@@ -152,7 +158,8 @@ EventMap *BuildTreeTwoLevel(Questions &qopts,
                             int32 max_leaves_second,
                             bool cluster_leaves,
                             int32 P,
-                            std::vector<int32> *leaf_map);
+                            std::vector<int32> *leaf_map,
+                            int32 num_threads = 1);
 
 
 /// GenRandStats generates random statistics of the form used by BuildTree.
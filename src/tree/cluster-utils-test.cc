@@ -244,6 +244,108 @@ static void TestClusterBottomUp() {
 }
 
 
+// Checks that GaussClusterableCache gives exactly the same objective
+// functions and distances as GaussClusterable, before and after merges.
+static void TestGaussClusterableCache() {
+  for (int32 iter = 0; iter < 10; iter++) {
+    int32 dim = 1 + rand() % 5, num_points = 2 + rand() % 10;
+    BaseFloat var_floor = 0.01 * (1 + rand() % 10);
+    std::vector<Clusterable*> points(num_points);
+    for (int32 i = 0; i < num_points; i++) {
+      GaussClusterable *gc = new GaussClusterable(dim, var_floor);
+      int32 n = 1 + rand() % 10;
+      for (int32 k = 0; k < n; k++) {
+        Vector<BaseFloat> vec(dim);
+        vec.SetRandn();
+        // the weights are not exactly representable, so the counts, which
+        // GaussClusterable sums in double, are not either.
+        gc->AddStats(vec, 0.1 + 0.3 * RandUniform());
+      }
+      points[i] = gc;
+    }
+    GaussClusterableCache cache;
+    KALDI_ASSERT(cache.Init(points));
+    // Merge random pairs, checking everything as we go.
+    for (int32 m = 0; m + 1 < num_points; m++) {
+      for (int32 i = m; i < num_points; i++) {
+        KALDI_ASSERT(cache.Objf(i) == points[i]->Objf());
+        for (int32 j = m; j < num_points; j++)
+          if (j != i)
+            KALDI_ASSERT(cache.Distance(i, j) ==
+                         points[i]->Distance(*(points[j])));
+      }
+      // merge point m into a later one.
+      int32 i = m + 1 + rand() % (num_points - m - 1);
+      points[i]->Add(*(points[m]));
+      cache.Merge(i, m);
+    }
+    DeletePointers(&points);
+  }
+  // A different variance floor means the cache can't be used.
+  std::vector<Clusterable*> points;
+  points.push_back(new GaussClusterable(2, 0.1));
+  points.push_back(new GaussClusterable(2, 0.2));
+  GaussClusterableCache cache;
+  KALDI_ASSERT(!cache.Init(points));
+  DeletePointers(&points);
+}
+
+static void TestClusterGaussMultiThreaded() {
+  // Checks that GaussClusterable's own ObjfPlus, ObjfMinus and Distance agree
+  // with the generic versions, and that the clustering routines give the same
+  // answers with several threads as with one.
+  int32 dim = 1 + rand() % 10, num_points = 200 + rand() % 1000;
+  BaseFloat var_floor = 0.01;
+  std::vector<Clusterable*> points;
+  for (int32 i = 0; i < num_points; i++) {
+    GaussClusterable *gc = new GaussClusterable(dim, var_floor);
+    Vector<BaseFloat> center(dim);
+    center.SetRandn();
+    int32 n = 1 + rand() % 5;
+    for (int32 j = 0; j < n; j++) {
+      Vector<BaseFloat> vec(dim);
+      vec.SetRandn();
+      vec.AddVec(2.0, center);
+      gc->AddStats(vec, 0.5 + RandUniform());
+    }
+    points.push_back(gc);
+  }
+  for (int32 n = 0; n < 20; n++) {
+    Clusterable *a = points[rand() % num_points],
+        *b = points[rand() % num_points];
+    KALDI_ASSERT(a->ObjfPlus(*b) == a->Clusterable::ObjfPlus(*b));
+    KALDI_ASSERT(a->ObjfMinus(*b) == a->Clusterable::ObjfMinus(*b));
+    KALDI_ASSERT(a->Distance(*b) == a->Clusterable::Distance(*b));
+  }
+
+  int32 min_clust = 1 + rand() % 20, num_threads = 2 + rand() % 3;
+  std::vector<int32> assignments1, assignments2;
+  BaseFloat ans1 = ClusterBottomUp(points, 1.0e+10, min_clust, NULL,
+                                   &assignments1, 1),
+      ans2 = ClusterBottomUp(points, 1.0e+10, min_clust, NULL,
+                             &assignments2, num_threads);
+  KALDI_ASSERT(ans1 == ans2 && assignments1 == assignments2);
+
+  ClusterKMeansOptions cfg;
+  cfg.verbose = false;
+  int32 num_clust = 1 + rand() % 20, seed = rand();
+  std::vector<Clusterable*> clusters1, clusters2;
+  srand(seed);
+  ans1 = ClusterKMeans(points, num_clust, &clusters1, &assignments1, cfg);
+  cfg.num_threads = num_threads;
+  srand(seed);
+  ans2 = ClusterKMeans(points, num_clust, &clusters2, &assignments2, cfg);
+  KALDI_ASSERT(ans1 == ans2 && assignments1 == assignments2);
+  std::cout << "Bottom-up and k-means clustering of " << num_points
+            << " Gaussians gave the same results with " << num_threads
+            << " threads.\n";
+
+  DeletePointers(&clusters1);
+  DeletePointers(&clusters2);
+  DeletePointers(&points);
+}
+
+
 static void TestRefineClusters() {
   for (size_t n = 0;n < 4;n++) {
     // Test it by creating a random clustering and verifying that it does not make it worse, and
@@ -455,6 +557,8 @@ int main() {
   TestTreeCluster();
   TestClusterKMeans();
   TestClusterBottomUp();
+  TestGaussClusterableCache();
+  TestClusterGaussMultiThreaded();
   TestRefineClusters();
 
   for (size_t i = 0;i < 2;i++)
@@ -25,7 +25,9 @@ using std::vector;
 
 #include "base/kaldi-math.h"
 #include "util/stl-utils.h"
+#include "thread/kaldi-thread.h"
 #include "tree/cluster-utils.h"
+#include "tree/clusterable-classes.h"
 
 namespace kaldi {
 
@@ -190,25 +192,85 @@ void AddToClustersOptimized(const std::vector<Clusterable*> &stats,
 // Bottom-up clustering routines
 // ============================================================================
 
+bool GaussClusterableCache::Init(const std::vector<Clusterable*> &points) {
+  if (points.empty() || points[0]->Type() != "gauss") return false;
+  const GaussClusterable *first =
+      static_cast<const GaussClusterable*>(points[0]);
+  int32 num_points = points.size(), dim = first->x_stats().Dim();
+  double var_floor = first->var_floor();
+  for (int32 i = 1; i < num_points; i++) {
+    if (points[i]->Type() != "gauss") return false;
+    const GaussClusterable *gc =
+        static_cast<const GaussClusterable*>(points[i]);
+    if (gc->x_stats().Dim() != dim || gc->var_floor() != var_floor)
+      return false;
+  }
+  dim_ = dim;
+  var_floor_ = var_floor;
+  stats_.Resize(num_points, 2 * dim);
+  counts_.Resize(num_points);
+  objf_.resize(num_points);
+  for (int32 i = 0; i < num_points; i++) {
+    const GaussClusterable *gc =
+        static_cast<const GaussClusterable*>(points[i]);
+    stats_.Row(i).Range(0, dim).CopyFromVec(gc->x_stats());
+    stats_.Row(i).Range(dim, dim).CopyFromVec(gc->x2_stats());
+    counts_(i) = gc->count();
+    objf_[i] = gc->Objf();
+  }
+  return true;
+}
+
+BaseFloat GaussClusterableCache::Distance(int32 i, int32 j) const {
+  const double *stats_i = stats_.RowData(i), *stats_j = stats_.RowData(j);
+  BaseFloat objf_plus = GaussClusterable::ObjfFromStats(
+      counts_(i) + counts_(j), stats_i, stats_i + dim_, stats_j,
+      stats_j + dim_, 1.0, dim_, var_floor_),
+      ans = objf_[i] + objf_[j] - objf_plus;
+  if (ans < 0) {
+    if (std::fabs(ans) > 0.01 * (1.0 + std::fabs(objf_plus))) {
+      KALDI_WARN << "Negative number returned (badly defined Clusterable "
+                 << "class?): ans= " << ans;
+    }
+    ans = 0;
+  }
+  return ans;
+}
+
+void GaussClusterableCache::Merge(int32 i, int32 j) {
+  stats_.Row(i).AddVec(1.0, stats_.Row(j));
+  counts_(i) += counts_(j);
+  const double *stats_i = stats_.RowData(i);
+  objf_[i] = GaussClusterable::ObjfFromStats(counts_(i), stats_i,
+                                             stats_i + dim_, NULL, NULL,
+                                             0.0, dim_, var_floor_);
+}
+
+
 class BottomUpClusterer {
  public:
   BottomUpClusterer(const std::vector<Clusterable*> &points,
                     BaseFloat max_merge_thresh,
                     int32 min_clust,
                     std::vector<Clusterable*> *clusters_out,
-                    std::vector<int32> *assignments_out)
+                    std::vector<int32> *assignments_out,
+                    int32 num_threads)
       : ans_(0.0), points_(points), max_merge_thresh_(max_merge_thresh),
         min_clust_(min_clust), clusters_(clusters_out != NULL? clusters_out
             : &tmp_clusters_), assignments_(assignments_out != NULL ?
-                assignments_out : &tmp_assignments_) {
+                assignments_out : &tmp_assignments_),
+        num_threads_(num_threads) {
     nclusters_ = npoints_ = points.size();
     dist_vec_.resize((npoints_ * (npoints_ - 1)) / 2);
+    use_gauss_cache_ = gauss_cache_.Init(points);
   }
 
   BaseFloat Cluster();
   ~BottomUpClusterer() { DeletePointers(&tmp_clusters_); }
 
  private:
+  friend class BottomUpDistanceTask;
+
   void Renumber();
   void InitializeAssignments();
   void SetInitialDistances();  ///< Sets up distances and queue.
@@ -220,7 +282,20 @@ class BottomUpClusterer {
   /// Reconstructs the priority queue from the distances.
   void ReconstructQueue();
 
-  void SetDistance(int32 i, int32 j);
+  /// Returns the distance between clusters i and j (requires j < i).
+  BaseFloat ComputeDistance(int32 i, int32 j) const {
+    if (use_gauss_cache_) return gauss_cache_.Distance(i, j);
+    else return (*clusters_)[i]->Distance(*((*clusters_)[j]));
+  }
+  /// Computes the part of the distances handled by one thread: if row == -1,
+  /// all of dist_vec_; otherwise the distances between cluster "row" and all
+  /// other clusters, which are put in new_dist_.
+  void ComputeDistances(int32 row, int32 thread_id, int32 num_threads);
+  /// Computes the distances described for ComputeDistances(), using
+  /// num_threads_ threads if the amount of work justifies it.
+  void ComputeDistancesMultiThreaded(int32 row);
+
+  void SetDistance(int32 i, int32 j, BaseFloat dist);
   BaseFloat& Distance(int32 i, int32 j) {
     KALDI_ASSERT(i < npoints_ && j < i);
     return dist_vec_[(i * (i - 1)) / 2 + j];
@@ -237,8 +312,12 @@ class BottomUpClusterer {
   std::vector<int32> tmp_assignments_;
 
   std::vector<BaseFloat> dist_vec_;
+  std::vector<BaseFloat> new_dist_;  // distances to a newly merged cluster.
   int32 nclusters_;
   int32 npoints_;
+  int32 num_threads_;
+  bool use_gauss_cache_;
+  GaussClusterableCache gauss_cache_;
   typedef std::pair<BaseFloat, std::pair<uint_smaller, uint_smaller> > QueueElement;
   // Priority queue using greater (lowest distances are highest priority).
   typedef std::priority_queue<QueueElement, std::vector<QueueElement>,
@@ -246,6 +325,19 @@ class BottomUpClusterer {
   QueueType queue_;
 };
 
+/// Runs BottomUpClusterer::ComputeDistances() in several threads.
+class BottomUpDistanceTask: public MultiThreadable {
+ public:
+  BottomUpDistanceTask(BottomUpClusterer *clusterer, int32 row)
+      : clusterer_(clusterer), row_(row) { }
+  void operator() () {
+    clusterer_->ComputeDistances(row_, thread_id_, num_threads_);
+  }
+ private:
+  BottomUpClusterer *clusterer_;
+  int32 row_;
+};
+
 BaseFloat BottomUpClusterer::Cluster() {
   KALDI_VLOG(2) << "Initializing cluster assignments.";
   InitializeAssignments();
@@ -322,11 +414,41 @@ void BottomUpClusterer::InitializeAssignments() {
   }
 }
 
+void BottomUpClusterer::ComputeDistances(int32 row, int32 thread_id,
+                                         int32 num_threads) {
+  if (row == -1) {
+    // Rows are interleaved between threads, which balances the work of the
+    // triangular matrix well enough.
+    for (int32 i = thread_id; i < npoints_; i += num_threads)
+      for (int32 j = 0; j < i; j++)
+        dist_vec_[(i * (i - 1)) / 2 + j] = ComputeDistance(i, j);
+  } else {
+    for (int32 k = thread_id; k < npoints_; k += num_threads) {
+      if (k != row && (*clusters_)[k] != NULL)
+        new_dist_[k] = (k < row ? ComputeDistance(row, k) :
+                        ComputeDistance(k, row));
+    }
+  }
+}
+
+void BottomUpClusterer::ComputeDistancesMultiThreaded(int32 row) {
+  // Below this many distances it is not worth starting threads.
+  const int32 kMinDistancesForThreads = 1000;
+  int32 num_distances = (row == -1 ? static_cast<int32>(dist_vec_.size())
+                         : nclusters_);
+  if (num_threads_ <= 1 || num_distances < kMinDistancesForThreads) {
+    ComputeDistances(row, 0, 1);
+  } else {
+    BottomUpDistanceTask task(this, row);
+    MultiThreader<BottomUpDistanceTask> m(num_threads_, task);
+  }
+}
+
 void BottomUpClusterer::SetInitialDistances() {
+  ComputeDistancesMultiThreaded(-1);
   for (int32 i = 0; i < npoints_; i++) {
     for (int32 j = 0; j < i; j++) {
-      BaseFloat dist = (*clusters_)[i]->Distance(*((*clusters_)[j]));
-      dist_vec_[(i * (i - 1)) / 2 + j] = dist;
+      BaseFloat dist = dist_vec_[(i * (i - 1)) / 2 + j];
       if (dist <= max_merge_thresh_)
         queue_.push(std::make_pair(dist, std::make_pair(static_cast<uint_smaller>(i),
             static_cast<uint_smaller>(j))));
@@ -345,6 +467,7 @@ bool BottomUpClusterer::CanMerge(int32 i, int32 j, BaseFloat dist) {
 void BottomUpClusterer::MergeClusters(int32 i, int32 j) {
   KALDI_ASSERT(i != j && i < npoints_ && j < npoints_);
   (*clusters_)[i]->Add(*((*clusters_)[j]));
+  if (use_gauss_cache_) gauss_cache_.Merge(i, j);
   delete (*clusters_)[j];
   (*clusters_)[j] = NULL;
   // note that we may have to follow the chain within "assignment_" to get
@@ -355,12 +478,14 @@ void BottomUpClusterer::MergeClusters(int32 i, int32 j) {
   ans_ -= dist_vec_[(i * (i - 1)) / 2 + j];
   nclusters_--;
   // Now update "distances".
+  new_dist_.resize(npoints_);
+  ComputeDistancesMultiThreaded(i);
   for (int32 k = 0; k < npoints_; k++) {
     if (k != i && (*clusters_)[k] != NULL) {
       if (k < i)
-        SetDistance(i, k);  // SetDistance requires k < i.
+        SetDistance(i, k, new_dist_[k]);  // SetDistance requires k < i.
       else
-        SetDistance(k, i);
+        SetDistance(k, i, new_dist_[k]);
     }
   }
 }
@@ -386,10 +511,9 @@ void BottomUpClusterer::ReconstructQueue() {
   }
 }
 
-void BottomUpClusterer::SetDistance(int32 i, int32 j) {
+void BottomUpClusterer::SetDistance(int32 i, int32 j, BaseFloat dist) {
   KALDI_ASSERT(i < npoints_ && j < i && (*clusters_)[i] != NULL
          && (*clusters_)[j] != NULL);
-  BaseFloat dist = (*clusters_)[i]->Distance(*((*clusters_)[j]));
   dist_vec_[(i * (i - 1)) / 2 + j] = dist;  // set the distance in the array.
   if (dist < max_merge_thresh_) {
     queue_.push(std::make_pair(dist, std::make_pair(static_cast<uint_smaller>(i),
@@ -408,7 +532,8 @@ BaseFloat ClusterBottomUp(const std::vector<Clusterable*> &points,
                           BaseFloat max_merge_thresh,
                           int32 min_clust,
                           std::vector<Clusterable*> *clusters_out,
-                          std::vector<int32> *assignments_out) {
+                          std::vector<int32> *assignments_out,
+                          int32 num_threads) {
   KALDI_ASSERT(max_merge_thresh >= 0.0 && min_clust >= 0);
   KALDI_ASSERT(!ContainsNullPointers(points));
   int32 npoints = points.size();
@@ -417,7 +542,8 @@ BaseFloat ClusterBottomUp(const std::vector<Clusterable*> &points,
                npoints < static_cast<int32>(static_cast<uint_smaller>(-1)));
 
   KALDI_VLOG(2) << "Initializing clustering object.";
-  BottomUpClusterer bc(points, max_merge_thresh, min_clust, clusters_out, assignments_out);
+  BottomUpClusterer bc(points, max_merge_thresh, min_clust, clusters_out,
+                       assignments_out, num_threads);
   BaseFloat ans = bc.Cluster();
   if (clusters_out) KALDI_ASSERT(!ContainsNullPointers(*clusters_out));
   return ans;
@@ -694,9 +820,10 @@ class RefineClusterer {
   RefineClusterer(const std::vector<Clusterable*> &points,
                   std::vector<Clusterable*> *clusters,
                   std::vector<int32> *assignments,
-                  RefineClustersOptions cfg)
+                  RefineClustersOptions cfg,
+                  int32 num_threads)
       : points_(points), clusters_(clusters), assignments_(assignments),
-        cfg_(cfg) {
+        cfg_(cfg), num_threads_(num_threads) {
     KALDI_ASSERT(cfg_.top_n >= 2);
     num_points_ = points_.size();
     num_clust_ = static_cast<int32> (clusters->size());
@@ -724,6 +851,8 @@ class RefineClusterer {
   }
   // at some point check cfg_.top_n > 1 after maxing to num_clust_.
  private:
+  friend class RefineClustererInitTask;
+
   void InitPoint(int32 point) {
     // Find closest clusters to this point.
     // distances are really negated objf changes, ignoring terms that don't vary with the "other" cluster.
@@ -735,14 +864,11 @@ class RefineClusterer {
 
     for (int32 clust = 0;clust < num_clust_;clust++) {
       if (clust != my_clust) {
-        Clusterable *tmp = (*clusters_)[clust]->Copy();
-        tmp->Add(*point_cl);
         BaseFloat other_clust_objf = clust_objf_[clust];
-        BaseFloat other_clust_plus_me_objf = (*clusters_)[clust]->ObjfPlus(* (points_[point]));
+        BaseFloat other_clust_plus_me_objf = (*clusters_)[clust]->ObjfPlus(*point_cl);
 
         BaseFloat distance = other_clust_objf-other_clust_plus_me_objf;  // negated delta-objf, with only "varying" terms.
         distances.push_back(std::make_pair(distance, (LocalInt)clust));
-        delete tmp;
       }
     }
     if ((cfg_.top_n-1-1) >= 0) {
@@ -768,11 +894,7 @@ class RefineClusterer {
     info.objf = (*clusters_)[my_clust]->ObjfMinus(*(points_[point]));
     my_clust_index_[point] = cfg_.top_n-1;
   }
-  void InitPoints() {
-    // finds, for each point, the closest cfg_.top_n clusters (including its own cluster).
-    // this may be the most time-consuming step of the algorithm.
-    for (int32 p = 0;p < num_points_;p++) InitPoint(p);
-  }
+  void InitPoints();
   void Iterate() {
     int32 iter, num_iters = cfg_.num_iters;
     for (iter = 0;iter < num_iters;iter++) {
@@ -847,15 +969,13 @@ class RefineClusterer {
   void UpdateInfo(int32 point, int32 idx) {
     point_info &pinfo = GetInfo(point, idx);
     if (pinfo.time < clust_time_[pinfo.clust]) {  // it's not up-to-date...
-      Clusterable *tmp_cl = (*clusters_)[pinfo.clust]->Copy();
+      const Clusterable *clust_cl = (*clusters_)[pinfo.clust];
       if (idx == my_clust_index_[point]) {
-        tmp_cl->Sub( *(points_[point]) );
+        pinfo.objf = clust_cl->ObjfMinus( *(points_[point]) );
       } else{
-        tmp_cl->Add( *(points_[point]) );
+        pinfo.objf = clust_cl->ObjfPlus( *(points_[point]) );
       }
       pinfo.time = t_;
-      pinfo.objf = tmp_cl->Objf();
-      delete tmp_cl;
     }
   }
 
@@ -889,19 +1009,47 @@ class RefineClusterer {
   int32 num_points_;
   int32 t_;
   RefineClustersOptions cfg_;  // note, we change top_n in config; don't make this member a reference member.
+  int32 num_threads_;
 };
 
+/// Runs RefineClusterer::InitPoint() for a subset of the points; used to
+/// initialize the points in several threads.
+class RefineClustererInitTask: public MultiThreadable {
+ public:
+  explicit RefineClustererInitTask(RefineClusterer *clusterer)
+      : clusterer_(clusterer) { }
+  void operator() () {
+    for (int32 p = thread_id_; p < clusterer_->num_points_; p += num_threads_)
+      clusterer_->InitPoint(p);
+  }
+ private:
+  RefineClusterer *clusterer_;
+};
+
+void RefineClusterer::InitPoints() {
+  // finds, for each point, the closest cfg_.top_n clusters (including its own cluster).
+  // this may be the most time-consuming step of the algorithm, and the points
+  // are independent of each other so we can do it in parallel.
+  if (num_threads_ <= 1) {
+    for (int32 p = 0;p < num_points_;p++) InitPoint(p);
+  } else {
+    RefineClustererInitTask task(this);
+    MultiThreader<RefineClustererInitTask> m(num_threads_, task);
+  }
+}
+
 
 BaseFloat RefineClusters(const std::vector<Clusterable*> &points,
                          std::vector<Clusterable*> *clusters,
                          std::vector<int32> *assignments,
-                         RefineClustersOptions cfg) {
+                         RefineClustersOptions cfg,
+                         int32 num_threads) {
 #ifndef KALDI_PARANOID // don't do this check in "paranoid" mode as we want to expose bugs.
   if (cfg.num_iters <= 0) { return 0.0; } // nothing to do.
 #endif
   KALDI_ASSERT(clusters != NULL && assignments != NULL);
   KALDI_ASSERT(!ContainsNullPointers(points) && !ContainsNullPointers(*clusters));
-  RefineClusterer rc(points, clusters, assignments, cfg);
+  RefineClusterer rc(points, clusters, assignments, cfg, num_threads);
   BaseFloat ans = rc.Refine();
   KALDI_ASSERT(!ContainsNullPointers(*clusters));
   return ans;
@@ -972,7 +1120,8 @@ BaseFloat ClusterKMeansOnce(const std::vector<Clusterable*> &points,
     // Keep refining clusters by reassigning points.
     BaseFloat objf_before;
     if (cfg.verbose) objf_before =SumClusterableObjf(*clusters_out);
-    BaseFloat impr = RefineClusters(points, clusters_out, assignments_out, cfg.refine_cfg);
+    BaseFloat impr = RefineClusters(points, clusters_out, assignments_out,
+                                    cfg.refine_cfg, cfg.num_threads);
     BaseFloat objf_after;
     if (cfg.verbose) objf_after = SumClusterableObjf(*clusters_out);
     ans += impr;
@@ -103,6 +103,10 @@ void AddToClustersOptimized(const std::vector<Clusterable*> &stats,
  *  @param assignments_out [out] If non-NULL, will be resized to the number of
  *                 points, and each element is the index of the cluster that point
  *                 was assigned to.
+ *  @param num_threads [in] Number of threads used to compute the merge costs;
+ *                 the result does not depend on it.  If all the points are
+ *                 GaussClusterable objects, their stats are kept in a single
+ *                 matrix and the merge costs computed directly from that.
  *  @return Returns the total objf change relative to all clusters being separate, which is
  *    a negative.  Note that this is not the same as what the other clustering algorithms return.
  */
@@ -110,7 +114,41 @@ BaseFloat ClusterBottomUp(const std::vector<Clusterable*> &points,
                           BaseFloat thresh,
                           int32 min_clust,
                           std::vector<Clusterable*> *clusters_out,
-                          std::vector<int32> *assignments_out);
+                          std::vector<int32> *assignments_out,
+                          int32 num_threads = 1);
+
+/// GaussClusterableCache keeps the stats of a set of GaussClusterable objects
+/// in one matrix (a row per object: the x stats followed by the x2 stats),
+/// together with their counts and objective functions.  ClusterBottomUp() uses
+/// it to compute merge costs with no virtual calls or temporary objects, and
+/// without recomputing the objective functions of the clusters being merged.
+/// The results are exactly those GaussClusterable computes.
+class GaussClusterableCache {
+ public:
+  GaussClusterableCache(): dim_(0), var_floor_(0.0) { }
+
+  /// Copies the stats of "points"; returns false, leaving the object empty, if
+  /// they are not all GaussClusterable objects of the same dimension and
+  /// variance floor.
+  bool Init(const std::vector<Clusterable*> &points);
+
+  /// Returns the same as points[i]->Objf(), where "points" reflects any
+  /// merges done by Merge().
+  BaseFloat Objf(int32 i) const { return objf_[i]; }
+
+  /// Returns the same as points[i]->Distance(*(points[j])).
+  BaseFloat Distance(int32 i, int32 j) const;
+
+  /// Adds the stats of j to those of i.
+  void Merge(int32 i, int32 j);
+
+ private:
+  int32 dim_;
+  double var_floor_;
+  Matrix<double> stats_;
+  Vector<double> counts_;
+  std::vector<BaseFloat> objf_;
+};
 
 /** This is a bottom-up clustering where the points are pre-clustered in a set
  *  of compartments, such that only points in the same compartment are clustered
@@ -152,19 +190,25 @@ struct RefineClustersOptions {
  *  and from that point only consider move to those "top_n" clusters. Since
  *  RefineClusters is called multiple times from ClusterKMeans (for instance),
  *  this is not really a limitation.
+ *
+ *  "num_threads" is the number of threads used to find the "top_n" closest
+ *  clusters of each point; the result does not depend on it.
  */
 BaseFloat RefineClusters(const std::vector<Clusterable*> &points,
                          std::vector<Clusterable*> *clusters /*non-NULL*/,
                          std::vector<int32> *assignments /*non-NULL*/,
-                         RefineClustersOptions cfg = RefineClustersOptions());
+                         RefineClustersOptions cfg = RefineClustersOptions(),
+                         int32 num_threads = 1);
 
 struct ClusterKMeansOptions {
   RefineClustersOptions refine_cfg;
   int32 num_iters;
   int32 num_tries;  // if >1, try whole procedure >once and pick best.
   bool verbose;
+  int32 num_threads;  // passed to RefineClusters().
   ClusterKMeansOptions()
-      : refine_cfg(), num_iters(20), num_tries(2), verbose(true)  {}
+      : refine_cfg(), num_iters(20), num_tries(2), verbose(true),
+        num_threads(1) {}
 };
 
 /** ClusterKMeans is a K-means-like clustering algorithm. It starts with
@@ -190,31 +190,84 @@ void GaussClusterable::Read(std::istream &is, bool binary) {
   stats_.Read(is, binary);
 }
 
-BaseFloat GaussClusterable::Objf() const {
-  if (count_ <= 0.0) {
-    if (count_ < -0.1) {
-      KALDI_WARN << "GaussClusterable::Objf(), count is negative " << count_;
+BaseFloat GaussClusterable::ObjfFromStats(double count,
+                                          const double *x_stats,
+                                          const double *x2_stats,
+                                          const double *other_x_stats,
+                                          const double *other_x2_stats,
+                                          double f, int32 dim,
+                                          double var_floor) {
+  if (count <= 0.0) {
+    if (count < -0.1) {
+      KALDI_WARN << "GaussClusterable::Objf(), count is negative " << count;
     }
     return 0.0;
   } else {
-    size_t dim = stats_.NumCols();
-    Vector<double> vars(dim);
-    double objf_per_frame = 0.0;
-    for (size_t d = 0; d < dim; d++) {
-      double mean(stats_(0, d) / count_), var = stats_(1, d) / count_ - mean
-          * mean, floored_var = std::max(var, var_floor_);
-      vars(d) = floored_var;
+    // The sum of log-variances is accumulated the same way as
+    // VectorBase::SumLog(), i.e. as products with occasional logs.
+    double objf_per_frame = 0.0, sum_log = 0.0, prod = 1.0;
+    for (int32 d = 0; d < dim; d++) {
+      double x = x_stats[d], x2 = x2_stats[d];
+      if (other_x_stats != NULL) {
+        x += f * other_x_stats[d];
+        x2 += f * other_x2_stats[d];
+      }
+      double mean(x / count), var = x2 / count - mean * mean,
+          floored_var = std::max(var, var_floor);
       objf_per_frame += -0.5 * var / floored_var;
+      prod *= floored_var;
+      if (prod < 1.0e-10 || prod > 1.0e+10) {
+        sum_log += Log(prod);
+        prod = 1.0;
+      }
     }
-    objf_per_frame += -0.5 * (vars.SumLog() + M_LOG_2PI * dim);
+    if (prod != 1.0) sum_log += Log(prod);
+    objf_per_frame += -0.5 * (sum_log + M_LOG_2PI * dim);
     if (KALDI_ISNAN(objf_per_frame)) {
       KALDI_WARN << "GaussClusterable::Objf(), objf is NaN\n";
       return 0.0;
     }
-    // KALDI_VLOG(2) << "count = " << count_ << ", objf_per_frame = "<< objf_per_frame
-    //   << ", returning " << (objf_per_frame*count_) << ", floor = " << var_floor_;
-    return objf_per_frame * count_;
+    return objf_per_frame * count;
+  }
+}
+
+BaseFloat GaussClusterable::Objf() const {
+  return ObjfFromStats(count_, stats_.RowData(0), stats_.RowData(1), NULL,
+                       NULL, 0.0, stats_.NumCols(), var_floor_);
+}
+
+BaseFloat GaussClusterable::ObjfPlus(const Clusterable &other_in) const {
+  KALDI_ASSERT(other_in.Type() == "gauss");
+  const GaussClusterable *other =
+      static_cast<const GaussClusterable*>(&other_in);
+  return ObjfFromStats(count_ + other->count_, stats_.RowData(0),
+                       stats_.RowData(1), other->stats_.RowData(0),
+                       other->stats_.RowData(1), 1.0, stats_.NumCols(),
+                       var_floor_);
+}
+
+BaseFloat GaussClusterable::ObjfMinus(const Clusterable &other_in) const {
+  KALDI_ASSERT(other_in.Type() == "gauss");
+  const GaussClusterable *other =
+      static_cast<const GaussClusterable*>(&other_in);
+  return ObjfFromStats(count_ - other->count_, stats_.RowData(0),
+                       stats_.RowData(1), other->stats_.RowData(0),
+                       other->stats_.RowData(1), -1.0, stats_.NumCols(),
+                       var_floor_);
+}
+
+BaseFloat GaussClusterable::Distance(const Clusterable &other_in) const {
+  BaseFloat objf_plus = this->ObjfPlus(other_in),
+      ans = this->Objf() + other_in.Objf() - objf_plus;
+  if (ans < 0) {
+    // This should not happen. Check if it is more than just rounding error.
+    if (std::fabs(ans) > 0.01 * (1.0 + std::fabs(objf_plus))) {
+      KALDI_WARN << "Negative number returned (badly defined Clusterable "
+                 << "class?): ans= " << ans;
+    }
+    ans = 0;
   }
+  return ans;
 }
 
 
@@ -81,6 +81,11 @@ class GaussClusterable: public Clusterable {
   virtual void SetZero();
   virtual void Add(const Clusterable &other_in);
   virtual void Sub(const Clusterable &other_in);
+  // The next three override the generic versions, which create a temporary
+  // copy of the stats; they give the same answers.
+  virtual BaseFloat ObjfPlus(const Clusterable &other_in) const;
+  virtual BaseFloat ObjfMinus(const Clusterable &other_in) const;
+  virtual BaseFloat Distance(const Clusterable &other_in) const;
   virtual BaseFloat Normalizer() const { return count_; }
   virtual Clusterable *Copy() const;
   virtual void Scale(BaseFloat f);
@@ -88,10 +93,24 @@ class GaussClusterable: public Clusterable {
   virtual Clusterable *ReadNew(std::istream &is, bool binary) const;
   virtual ~GaussClusterable() {}
 
-  BaseFloat count() const { return count_; }
+  double count() const { return count_; }
+  double var_floor() const { return var_floor_; }
   // The next two functions are not const-correct, because of SubVector.
   SubVector<double> x_stats() const { return stats_.Row(0); }
   SubVector<double> x2_stats() const { return stats_.Row(1); }
+
+  /// Returns the objective function of the Gaussian stats with count "count",
+  /// sum "x_stats + f * other_x_stats" and sum-squared "x2_stats + f *
+  /// other_x2_stats", all of dimension "dim"; "other_x_stats" and
+  /// "other_x2_stats" may be NULL, meaning zero.  This is the computation
+  /// behind Objf(), ObjfPlus() and ObjfMinus(); it is exposed so that
+  /// clustering code that keeps stats in contiguous arrays gets exactly the
+  /// same answers.
+  static BaseFloat ObjfFromStats(double count, const double *x_stats,
+                                 const double *x2_stats,
+                                 const double *other_x_stats,
+                                 const double *other_x2_stats, double f,
+                                 int32 dim, double var_floor);
  private:
   double count_;
   Matrix<double> stats_; // two rows: sum, then sum-squared.
@@ -104,6 +104,28 @@ void TestGenRandContextDependency() {
         for (size_t k = 0; k < phones.size(); k++) KALDI_ASSERT(all_phones[phones[k]]);
     }
 
+    {  // Check that Compute() (which uses the compiled form of the tree)
+       // agrees with the EventMap.
+      int32 N = dep->ContextWidth();
+      for (int32 i = 0; i < 20; i++) {
+        std::vector<int32> phoneseq(N);
+        EventType event;
+        int32 pdf_class = rand() % 3;
+        event.push_back(std::make_pair(kPdfClass, pdf_class));
+        for (int32 n = 0; n < N; n++) {
+          phoneseq[n] = (rand() % 5 == 0 ? 0 : phones[rand() % phones.size()]);
+          event.push_back(std::make_pair(n, phoneseq[n]));
+        }
+        int32 pdf_id, pdf_id2;
+        bool ans = dep->Compute(phoneseq, pdf_class, &pdf_id),
+            ans2 = dep->ToPdfMap().Map(event, &pdf_id2);
+        KALDI_ASSERT(ans == ans2);
+        if (ans) {
+          KALDI_ASSERT(pdf_id == pdf_id2);
+        }
+      }
+    }
+
     dep->Write(outfile, binary);
     ko.Close();
   }
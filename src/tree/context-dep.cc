@@ -27,6 +27,18 @@ bool ContextDependency::Compute(const std::vector<int32> &phoneseq,
                                  int32 pdf_class,
                                  int32 *pdf_id) const {
   KALDI_ASSERT(static_cast<int32>(phoneseq.size()) == N_);
+  if (!compiled_to_pdf_.Empty()) {
+    // values[0] is the pdf-class (key kPdfClass == -1), values[i+1] the phone
+    // at position i.
+    EventValueType values[kMaxCompiledContextWidth + 1];
+    values[0] = pdf_class;
+    for (int32 i = 0; i < N_; i++) {
+      values[i + 1] = phoneseq[i];
+      KALDI_ASSERT(static_cast<EventAnswerType>(phoneseq[i]) != -1);  // >=0 ?
+    }
+    KALDI_ASSERT(pdf_id != NULL);
+    return compiled_to_pdf_.Map(values, pdf_id);
+  }
   EventType  event_vec;
   event_vec.reserve(N_+1);
   event_vec.push_back(std::make_pair
@@ -42,6 +54,15 @@ bool ContextDependency::Compute(const std::vector<int32> &phoneseq,
   return to_pdf_->Map(event_vec, pdf_id);
 }
 
+void ContextDependency::CompileToPdf() {
+  compiled_to_pdf_ = CompiledEventMap();
+  if (to_pdf_ != NULL && N_ <= kMaxCompiledContextWidth) {
+    KALDI_COMPILE_TIME_ASSERT(kPdfClass == -1);
+    if (!compiled_to_pdf_.Init(*to_pdf_, kPdfClass, N_ + 1))
+      KALDI_VLOG(2) << "Could not compile the decision tree; using it as is.";
+  }
+}
+
 ContextDependency *GenRandContextDependency(const std::vector<int32> &phone_ids,
                                             bool ensure_all_covered,
                                             std::vector<int32> *hmm_lengths) {
@@ -172,6 +193,7 @@ void ContextDependency::Read (std::istream &is, bool binary) {
   }
   ExpectToken(is, binary, "EndContextDependency");
   to_pdf_ = to_pdf;
+  CompileToPdf();
 }
 
 void ContextDependency::GetPdfInfo(const std::vector<int32> &phones,
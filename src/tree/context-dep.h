@@ -87,7 +87,7 @@ class ContextDependency: public ContextDependencyInterface {
   // Constructor takes ownership of pointers.
   ContextDependency(int32 N, int32 P,
                     EventMap *to_pdf):
-      N_(N), P_(P), to_pdf_(to_pdf) { }
+      N_(N), P_(P), to_pdf_(to_pdf) { CompileToPdf(); }
   void Write (std::ostream &os, bool binary) const;
 
   ~ContextDependency() { if (to_pdf_ != NULL) delete to_pdf_; }
@@ -108,6 +108,12 @@ class ContextDependency: public ContextDependencyInterface {
   int32 P_;
   EventMap *to_pdf_;  // owned here.
 
+  // A flattened copy of to_pdf_ that is faster to look up in; it is used in
+  // Compute() unless it is empty (e.g. if N_ is too large).
+  CompiledEventMap compiled_to_pdf_;
+  static const int32 kMaxCompiledContextWidth = 15;
+  void CompileToPdf();
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(ContextDependency);
 };
 
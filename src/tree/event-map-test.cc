@@ -205,6 +205,52 @@ void TestEventMapIo(bool binary) {
   }
 }
 
+void TestCompiledEventMap(bool binary) {
+  std::vector<EventKeyType> keys;
+  for (EventKeyType key = -1; key <= 2; key++)
+    keys.push_back(key);
+  EventMap *em = RandomEventMap(keys);
+  EventKeyType min_key = -2;  // key -2 is never asked about.
+  int32 num_keys = 5;
+  CompiledEventMap compiled;
+  KALDI_ASSERT(compiled.Init(*em, min_key, num_keys) && !compiled.Empty());
+
+  // Check that the I/O works.
+  std::ostringstream os;
+  compiled.Write(os, binary);
+  std::istringstream is(os.str());
+  CompiledEventMap compiled2;
+  compiled2.Read(is, binary);
+  KALDI_ASSERT(compiled2.MinKey() == min_key &&
+               compiled2.NumKeys() == num_keys);
+
+  for (int32 i = 0; i < 100; i++) {
+    EventType event;
+    std::vector<EventValueType> values(num_keys);
+    for (int32 k = 0; k < num_keys; k++) {
+      // values may be negative, or too large for any table.
+      values[k] = (rand() % (kMaxVal + 2)) - 1;
+      event.push_back(std::make_pair(min_key + k, values[k]));
+    }
+    EventAnswerType ans, ans2 = -5, ans3 = -5;
+    bool ret = em->Map(event, &ans),
+        ret2 = compiled.Map(&(values[0]), &ans2),
+        ret3 = compiled2.Map(&(values[0]), &ans3);
+    KALDI_ASSERT(ret == ret2 && ret == ret3);
+    if (ret) {
+      KALDI_ASSERT(ans == ans2 && ans == ans3);
+    }
+  }
+
+  delete em;
+
+  // A map that asks about a key outside the range cannot be compiled.
+  std::vector<EventValueType> yes_set(1, 1);
+  SplitEventMap split(num_keys + min_key, yes_set, new ConstantEventMap(1),
+                      new ConstantEventMap(2));
+  KALDI_ASSERT(!compiled.Init(split, min_key, num_keys) && compiled.Empty());
+}
+
 void TestEventMapPrune() {
   const EventAnswerType no_ans = -10;
   std::vector<EventKeyType> keys;
@@ -323,5 +369,6 @@ int main() {
     TestEventMap();
     TestEventMapPrune();
     TestEventMapMapValues();
+    TestCompiledEventMap(i % 2 == 0);
   }
 }
@@ -487,6 +487,86 @@ bool GetTreeStructure(const EventMap &map,
   return true;
 }
 
+bool CompiledEventMap::Init(const EventMap &emap, EventKeyType min_key,
+                            int32 num_keys) {
+  KALDI_ASSERT(num_keys > 0);
+  min_key_ = min_key;
+  num_keys_ = num_keys;
+  nodes_.clear();
+  if (!CompileNode(emap)) {
+    nodes_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool CompiledEventMap::CompileNode(const EventMap &emap) {
+  if (const ConstantEventMap *c =
+      dynamic_cast<const ConstantEventMap*>(&emap)) {
+    nodes_.push_back(kConstantNode);
+    nodes_.push_back(c->answer_);
+    return true;
+  }
+  if (const TableEventMap *t = dynamic_cast<const TableEventMap*>(&emap)) {
+    if (t->key_ < min_key_ || t->key_ >= min_key_ + num_keys_) return false;
+    size_t start = nodes_.size(), size = t->table_.size();
+    nodes_.push_back(kTableNode);
+    nodes_.push_back(t->key_ - min_key_);
+    nodes_.push_back(static_cast<int32>(size));
+    nodes_.resize(nodes_.size() + size, -1);
+    for (size_t i = 0; i < size; i++) {
+      if (t->table_[i] != NULL) {
+        nodes_[start + 3 + i] = nodes_.size();
+        if (!CompileNode(*(t->table_[i]))) return false;
+      }
+    }
+    return true;
+  }
+  if (const SplitEventMap *sp = dynamic_cast<const SplitEventMap*>(&emap)) {
+    if (sp->key_ < min_key_ || sp->key_ >= min_key_ + num_keys_) return false;
+    const ConstIntegerSet<EventValueType> &yes_set = sp->yes_set_;
+    EventValueType lo = 0, hi = -1;  // An empty range for an empty set.
+    if (yes_set.size() != 0) {
+      lo = *(yes_set.begin());
+      hi = *(yes_set.end() - 1);
+    }
+    size_t start = nodes_.size(), num_words = (hi - lo + 32) / 32;
+    nodes_.push_back(kSplitNode);
+    nodes_.push_back(sp->key_ - min_key_);
+    nodes_.push_back(-1);  // offset of the "no" child; set below.
+    nodes_.push_back(lo);
+    nodes_.push_back(hi);
+    nodes_.resize(nodes_.size() + num_words, 0);
+    for (ConstIntegerSet<EventValueType>::iterator iter = yes_set.begin();
+         iter != yes_set.end(); ++iter) {
+      uint32 offset = *iter - lo;
+      uint32 word = static_cast<uint32>(nodes_[start + 5 + offset / 32]);
+      word |= static_cast<uint32>(1) << (offset % 32);
+      nodes_[start + 5 + offset / 32] = static_cast<int32>(word);
+    }
+    if (!CompileNode(*(sp->yes_))) return false;
+    nodes_[start + 2] = nodes_.size();
+    return CompileNode(*(sp->no_));
+  }
+  return false;  // Some other type of EventMap.
+}
+
+void CompiledEventMap::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<CompiledEventMap>");
+  WriteBasicType(os, binary, min_key_);
+  WriteBasicType(os, binary, num_keys_);
+  WriteIntegerVector(os, binary, nodes_);
+  WriteToken(os, binary, "</CompiledEventMap>");
+}
 
+void CompiledEventMap::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<CompiledEventMap>");
+  ReadBasicType(is, binary, &min_key_);
+  ReadBasicType(is, binary, &num_keys_);
+  ReadIntegerVector(is, binary, &nodes_);
+  ExpectToken(is, binary, "</CompiledEventMap>");
+  if (num_keys_ <= 0 || nodes_.empty())
+    KALDI_ERR << "Reading CompiledEventMap: invalid data.";
+}
 
 } // end namespace kaldi
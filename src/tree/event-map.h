@@ -200,6 +200,7 @@ class ConstantEventMap: public EventMap {
   static ConstantEventMap *Read(std::istream &is, bool binary);
  private:
   EventAnswerType answer_;
+  friend class CompiledEventMap;
   KALDI_DISALLOW_COPY_AND_ASSIGN(ConstantEventMap);
 };
 
@@ -260,6 +261,7 @@ class TableEventMap: public EventMap {
  private:
   EventKeyType key_;
   std::vector<EventMap*> table_;
+  friend class CompiledEventMap;
   KALDI_DISALLOW_COPY_AND_ASSIGN(TableEventMap);
 };
 
@@ -338,6 +340,7 @@ class SplitEventMap: public EventMap {  // A decision tree [non-leaf] node.
   EventMap *yes_;  // owned here.
   EventMap *no_;  // owned here.
   SplitEventMap &operator = (const SplitEventMap &other);  // Disallow.
+  friend class CompiledEventMap;
 };
 
 /**
@@ -358,6 +361,90 @@ bool GetTreeStructure(const EventMap &map,
                       std::vector<int32> *parents);
 
 
+/**
+   CompiledEventMap is a read-only, flattened copy of an EventMap made of
+   ConstantEventMap, TableEventMap and SplitEventMap nodes, for fast lookup.
+   The nodes are stored in depth-first order in a single array of integers
+   rather than as separate objects reached through virtual functions, and the
+   "yes" sets of the SplitEventMap nodes become bitmaps.  Instead of an
+   EventType it is given an array of values indexed by key - min_key, so all
+   the keys the map asks about must be in a known, small range; this is the
+   case for the EventMap of a ContextDependency object, whose keys are
+   kPdfClass = -1 and the phone positions 0 ... N-1.
+*/
+class CompiledEventMap {
+ public:
+  CompiledEventMap(): min_key_(0), num_keys_(0) { }
+
+  /// Compiles "emap".  Returns false (and leaves this object empty) if emap
+  /// asks about a key outside the range min_key ... min_key + num_keys - 1,
+  /// or contains a type of node that we cannot compile.
+  bool Init(const EventMap &emap, EventKeyType min_key, int32 num_keys);
+
+  /// Returns true if Init() has not been called or failed.
+  bool Empty() const { return nodes_.empty(); }
+
+  EventKeyType MinKey() const { return min_key_; }
+  int32 NumKeys() const { return num_keys_; }
+
+  /// "values" is indexed by key - MinKey(), and must have NumKeys() elements
+  /// (all the keys are treated as present).  Returns the same as
+  /// EventMap::Map() would for the corresponding EventType.
+  inline bool Map(const EventValueType *values, EventAnswerType *ans) const;
+
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  // Appends the node "emap" and its children to nodes_; returns false if it
+  // cannot be compiled.
+  bool CompileNode(const EventMap &emap);
+
+  // Node types; each node starts with its type, and is followed by:
+  //  kConstantNode: the answer.
+  //  kTableNode: the key index (key - min_key_), the table size S, then S
+  //     offsets of the children in nodes_ (-1 for NULL).
+  //  kSplitNode: the key index, the offset of the "no" child, the lowest and
+  //     highest values of the yes-set and a bitmap of the values in between,
+  //     packed 32 to a word; the "yes" child follows the bitmap.
+  enum { kConstantNode = 0, kTableNode = 1, kSplitNode = 2 };
+
+  EventKeyType min_key_;
+  int32 num_keys_;
+  std::vector<int32> nodes_;
+};
+
+inline bool CompiledEventMap::Map(const EventValueType *values,
+                                  EventAnswerType *ans) const {
+  const int32 *nodes = &(nodes_[0]);
+  int32 pos = 0;
+  while (true) {
+    const int32 *node = nodes + pos;
+    if (node[0] == kConstantNode) {
+      *ans = node[1];
+      return true;
+    } else if (node[0] == kTableNode) {
+      EventValueType value = values[node[1]];
+      if (value < 0 || value >= node[2] || node[3 + value] < 0) {
+        *ans = -1;
+        return false;
+      }
+      pos = node[3 + value];
+    } else {  // kSplitNode.
+      EventValueType value = values[node[1]];
+      bool yes = false;
+      if (value >= node[3] && value <= node[4]) {
+        uint32 offset = value - node[3];
+        yes = ((static_cast<uint32>(node[5 + offset / 32]) >>
+                (offset % 32)) & 1) != 0;
+      }
+      if (yes) pos += 5 + (node[4] - node[3] + 32) / 32;
+      else pos = node[2];
+    }
+  }
+}
+
+
 /// @} end "addtogroup event_map_group"
 
 }
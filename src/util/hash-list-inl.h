@@ -60,6 +60,11 @@ typename HashList<I, T>::Elem* HashList<I, T>::GetList() {
   return list_head_;
 }
 
+template<class I, class T>
+const typename HashList<I, T>::Elem* HashList<I, T>::GetList() const {
+  return list_head_;
+}
+
 template<class I, class T>
 inline void HashList<I, T>::Delete(Elem *e) {
   e->tail = freed_head_;
@@ -67,6 +67,9 @@ template<class I, class T> class HashList {
   /// class.
   Elem *GetList();
 
+  /// Const version of GetList().
+  const Elem *GetList() const;
+
   /// Think of this like delete().  It is to be called for each Elem in turn
   /// after you "obtained ownership" by doing Clear().  This is not the opposite of
   /// Insert, it is the opposite of New.  It's really a memory operation.
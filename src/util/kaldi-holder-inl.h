@@ -22,6 +22,7 @@
 #define KALDI_UTIL_KALDI_HOLDER_INL_H_
 
 #include <algorithm>
+#include <cstring>
 #include "util/kaldi-io.h"
 #include "util/text-utils.h"
 #include "matrix/kaldi-matrix.h"
@@ -262,10 +263,32 @@ template<class BasicType> class BasicVectorHolder {
         int32 size;
         ReadBasicType(is, true, &size);
         t_.resize(size);
-        for (typename std::vector<BasicType>::iterator iter = t_.begin();
-            iter != t_.end();
-            ++iter) {
-          ReadBasicType(is, true, &(*iter));
+        if (std::numeric_limits<BasicType>::is_integer &&
+            sizeof(BasicType) > 1 && size > 0) {
+          // Fast path for integers: read all the elements (each one is a
+          // size byte followed by the value) with one read, and check them
+          // here, rather than calling ReadBasicType() for each.
+          const size_t elem_size = 1 + sizeof(BasicType);
+          const char size_byte = (std::numeric_limits<BasicType>::is_signed ?
+                                  1 : -1) * static_cast<char>(sizeof(BasicType));
+          buffer_.resize(size * elem_size);
+          is.read(&(buffer_[0]), buffer_.size());
+          if (is.fail())
+            KALDI_ERR << "BasicVectorHolder::Read, read failure";
+          for (int32 i = 0; i < size; i++) {
+            const char *elem = &(buffer_[i * elem_size]);
+            if (elem[0] != size_byte)
+              KALDI_ERR << "BasicVectorHolder::Read, did not get expected "
+                        << "integer type, " << static_cast<int>(elem[0])
+                        << " vs. " << static_cast<int>(size_byte);
+            memcpy(&(t_[i]), elem + 1, sizeof(BasicType));
+          }
+        } else {
+          for (typename std::vector<BasicType>::iterator iter = t_.begin();
+               iter != t_.end();
+               ++iter) {
+            ReadBasicType(is, true, &(*iter));
+          }
         }
         return true;
       } catch (...) {
@@ -285,6 +308,7 @@ template<class BasicType> class BasicVectorHolder {
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(BasicVectorHolder);
   T t_;
+  std::vector<char> buffer_;  // Used in binary reading.
 };
 
 
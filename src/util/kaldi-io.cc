@@ -317,8 +317,18 @@ class InputImplBase {
   virtual ~InputImplBase() { }
 };
 
+// Size of the read buffer for file and pipe input.  The default buffer is a
+// few kilobytes, so reading an archive of many small objects would take a
+// system call every few objects.
+static const size_t kInputBufferSize = 65536;
+
 class FileInputImpl: public InputImplBase {
  public:
+  FileInputImpl(): buffer_(kInputBufferSize) {
+    // This must be done before the file is opened.
+    is_.rdbuf()->pubsetbuf(&(buffer_[0]), buffer_.size());
+  }
+
   virtual bool Open(const std::string &filename, bool binary) {
     if (is_.is_open()) KALDI_ERR << "FileInputImpl::Open(), "
                                 << "open called on already open file.";
@@ -347,6 +357,8 @@ class FileInputImpl: public InputImplBase {
     // whether it fails.
   }
  private:
+  std::vector<char> buffer_;  // Declared before is_ so that it outlives the
+                              // stream.
   std::ifstream is_;
 };
 
@@ -409,7 +421,7 @@ class PipeInputImpl: public InputImplBase {
       fb_ = new PipebufType(f_,  // Using this constructor won't lead the
                                  // destructor to close the stream.
                                  (binary ? std::ios_base::in|std::ios_base::binary
-                                  :std::ios_base::in));
+                                  :std::ios_base::in), kInputBufferSize);
       KALDI_ASSERT(fb_ != NULL);  // or would be alloc error.
       is_ = new std::istream(fb_);
 #else
@@ -486,6 +498,11 @@ class OffsetFileInputImpl: public InputImplBase {
   // This class is a bit more complicated than the
 
  public:
+  OffsetFileInputImpl(): buffer_(kInputBufferSize) {
+    // This must be done before the file is first opened.
+    is_.rdbuf()->pubsetbuf(&(buffer_[0]), buffer_.size());
+  }
+
   // splits a filename like /my/file:123 into /my/file and the
   // number 123.  Crashes if not this format.
   static void SplitFilename(const std::string &rxfilename,
@@ -580,6 +597,8 @@ class OffsetFileInputImpl: public InputImplBase {
  private:
   std::string filename_;  // the actual filename
   bool binary_;  // true if was opened in binary mode.
+  std::vector<char> buffer_;  // Declared before is_ so that it outlives the
+                              // stream.
   std::ifstream is_;
 };
 
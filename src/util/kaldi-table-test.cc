@@ -714,6 +714,44 @@ void UnitTestTableSequentialBaseFloatVectorBoth(bool binary, bool read_scp) {
   }
 }
 
+void UnitTestTableSequentialBaseFloatSparseMatrixBoth(bool binary,
+                                                      bool read_scp) {
+  int32 sz = rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > m;
+
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back(CharToString('a' + static_cast<char>(i)));
+    m.push_back(Matrix<BaseFloat>(1 + rand() % 4, 1 + rand() % 4));
+    for (int32 j = 0; j < 3; j++)
+      m.back()(rand() % m.back().NumRows(), rand() % m.back().NumCols()) =
+          RandGauss();
+  }
+
+  bool ans;
+  BaseFloatSparseMatrixWriter bw(binary ? "b,ark,scp:tmpf,tmpf.scp" :
+                                 "t,ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], SparseMatrix<BaseFloat>(m[i]));
+  ans = bw.Close();
+  KALDI_ASSERT(ans);
+
+  SequentialBaseFloatSparseMatrixReader sbr(read_scp ? "scp:tmpf.scp" :
+                                            "ark:tmpf");
+  std::vector<std::string> k2;
+  std::vector<Matrix<BaseFloat> > m2;
+  for (; !sbr.Done(); sbr.Next()) {
+    k2.push_back(sbr.Key());
+    const SparseMatrix<BaseFloat> &smat = sbr.Value();
+    m2.push_back(Matrix<BaseFloat>(smat.NumRows(), smat.NumCols()));
+    smat.CopyToMat(&(m2.back()));
+  }
+  KALDI_ASSERT(sbr.Close());
+  KALDI_ASSERT(k2 == k && m2.size() == m.size());
+  for (size_t i = 0; i < m2.size(); i++)
+    KALDI_ASSERT(m2[i].ApproxEqual(m[i], binary ? 1.0e-10 : 0.01));
+}
+
 template<class T> void RandomizeVector(std::vector<T> *v) {
   if (v->size() > 1) {
     for (size_t i = 0; i < 10; i++) {
@@ -892,6 +930,7 @@ int main() {
       UnitTestTableSequentialInt32PairVectorBoth(b, c);
       UnitTestTableSequentialInt32VectorVectorBoth(b, c);
       UnitTestTableSequentialBaseFloatVectorBoth(b, c);
+      UnitTestTableSequentialBaseFloatSparseMatrixBoth(b, c);
       for (int k = 0; k < 2; k++) {
         bool d = (k == 0);
         for (int l = 0; l < 2; l++) {
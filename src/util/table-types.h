@@ -54,6 +54,14 @@ typedef TableWriter<KaldiObjectHolder<Vector<double> > >  DoubleVectorWriter;
 typedef SequentialTableReader<KaldiObjectHolder<Vector<double> > >  SequentialDoubleVectorReader;
 typedef RandomAccessTableReader<KaldiObjectHolder<Vector<double> > >  RandomAccessDoubleVectorReader;
 
+typedef TableWriter<KaldiObjectHolder<SparseMatrix<BaseFloat> > >  BaseFloatSparseMatrixWriter;
+typedef SequentialTableReader<KaldiObjectHolder<SparseMatrix<BaseFloat> > >  SequentialBaseFloatSparseMatrixReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<SparseMatrix<BaseFloat> > >  RandomAccessBaseFloatSparseMatrixReader;
+
+typedef TableWriter<KaldiObjectHolder<SparseVector<BaseFloat> > >  BaseFloatSparseVectorWriter;
+typedef SequentialTableReader<KaldiObjectHolder<SparseVector<BaseFloat> > >  SequentialBaseFloatSparseVectorReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<SparseVector<BaseFloat> > >  RandomAccessBaseFloatSparseVectorReader;
+
 typedef TableWriter<KaldiObjectHolder<CuMatrix<BaseFloat> > >  BaseFloatCuMatrixWriter;
 typedef SequentialTableReader<KaldiObjectHolder<CuMatrix<BaseFloat> > >  SequentialBaseFloatCuMatrixReader;
 typedef RandomAccessTableReader<KaldiObjectHolder<CuMatrix<BaseFloat> > >  RandomAccessBaseFloatCuMatrixReader;
@@ -92,7 +92,16 @@ BaseFloat VtsAccumAmDiagGmm::AccumulateForGmm(const AmDiagGmm &model_clean,
                              BaseFloat weight) {
   KALDI_ASSERT(gmm_index >= 0 && static_cast<size_t>(gmm_index) < gmm_accumulators_.size() )
 
-    int32 offset = GetGaussianOffset(model_clean, gmm_index);
+  if (gauss_offsets_.size() != static_cast<size_t>(model_clean.NumPdfs())) {
+    // Index of the first Gaussian of each pdf in Jx, cached because this is
+    // called for every frame.
+    gauss_offsets_.resize(model_clean.NumPdfs());
+    for (int32 i = 0, offset = 0; i < model_clean.NumPdfs(); ++i) {
+      gauss_offsets_[i] = offset;
+      offset += model_clean.NumGaussInPdf(i);
+    }
+  }
+  int32 offset = gauss_offsets_[gmm_index];
   BaseFloat log_like = gmm_accumulators_[gmm_index]->AccumulateFromDiag(model_clean.GetPdf(gmm_index),
                                                    model_noisy.GetPdf(gmm_index),
                                                    Jx, offset, data, weight);
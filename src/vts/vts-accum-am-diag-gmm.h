@@ -74,6 +74,9 @@ class VtsAccumAmDiagGmm {
   /// accumulators and update methods for the GMMs
   std::vector<VtsAccumDiagGmm*> gmm_accumulators_;
 
+  /// Index of the first Gaussian of each pdf, set in AccumulateForGmm()
+  std::vector<int32> gauss_offsets_;
+
   /// Totoal counts & likelihood (for diagnostics)
   double total_frames_, total_log_like_;
 
@@ -291,7 +291,7 @@ BaseFloat VtsAccumDiagGmm::AccumulateFromDiag(
       Vector<double> inv_var(ngmm_noisy.vars_.Row(g));
       inv_var.InvertElements();
 
-      Matrix<double> Jx_sm(Jx[offset + g]);
+      const Matrix<double> &Jx_sm = Jx[offset + g];
 
       Vector<double> y_mu(data);
       y_mu.AddVec(-1.0, ngmm_noisy.means_.Row(g));  // y - mu
@@ -0,0 +1,148 @@
+// vts/vts-first-order-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/diag-gmm-normal.h"
+#include "thread/kaldi-thread.h"
+#include "vts/vts-first-order.h"
+
+namespace kaldi {
+
+// A random GMM over static, delta and acceleration cepstra.
+static void InitRandomGmm(int32 dim, DiagGmm *gmm) {
+  int32 num_gauss = 1 + rand() % 8;
+  gmm->Resize(num_gauss, dim);
+  Matrix<BaseFloat> inv_vars(num_gauss, dim), means(num_gauss, dim);
+  Vector<BaseFloat> weights(num_gauss);
+  for (int32 i = 0; i < num_gauss; i++) {
+    for (int32 j = 0; j < dim; j++) {
+      inv_vars(i, j) = exp(0.5 * RandGauss());
+      means(i, j) = RandGauss();
+    }
+    weights(i) = 1.0 / num_gauss;
+  }
+  gmm->SetWeights(weights);
+  gmm->SetInvVarsAndMeans(inv_vars, means);
+  gmm->ComputeGconsts();
+}
+
+// Compensates "gmm" one Gaussian at a time with CompensateDiagGaussian(),
+// which is the reference for the other functions; appends the Jacobians to Jx
+// and Jz.
+static void CompensateGmmSimple(const Vector<double> &mu_h,
+                                const Vector<double> &mu_z,
+                                const Vector<double> &var_z,
+                                int32 num_cepstral, int32 num_fbank,
+                                const Matrix<double> &dct_mat,
+                                const Matrix<double> &inv_dct_mat,
+                                DiagGmm *gmm,
+                                std::vector<Matrix<double> > *Jx,
+                                std::vector<Matrix<double> > *Jz) {
+  DiagGmmNormal ngmm(*gmm);
+  for (int32 g = 0; g < gmm->NumGauss(); g++) {
+    Vector<double> mean(ngmm.means_.Row(g)), cov(ngmm.vars_.Row(g));
+    Matrix<double> jx, jz;
+    CompensateDiagGaussian(mu_h, mu_z, var_z, num_cepstral, num_fbank,
+                           dct_mat, inv_dct_mat, mean, cov, jx, jz);
+    ngmm.means_.Row(g).CopyFromVec(mean);
+    ngmm.vars_.Row(g).CopyFromVec(cov);
+    Jx->push_back(jx);
+    Jz->push_back(jz);
+  }
+  ngmm.CopyToDiagGmm(gmm);
+  gmm->ComputeGconsts();
+}
+
+static void AssertGmmEqual(const DiagGmm &gmm1, const DiagGmm &gmm2) {
+  DiagGmmNormal ngmm1(gmm1), ngmm2(gmm2);
+  KALDI_ASSERT(ngmm1.means_.ApproxEqual(ngmm2.means_, 1.0e-04));
+  KALDI_ASSERT(ngmm1.vars_.ApproxEqual(ngmm2.vars_, 1.0e-04));
+}
+
+// Checks CompensateDiagGmm() and CompensateModel(), which compensate all the
+// Gaussians of a GMM at once, against CompensateDiagGaussian().
+void UnitTestCompensateDiagGmm() {
+  int32 num_cepstral = 13, num_fbank = 23, dim = 3 * num_cepstral;
+  Matrix<double> dct_mat, inv_dct_mat;
+  GenerateDCTmatrix(num_cepstral, num_fbank, 22.0, &dct_mat, &inv_dct_mat);
+  for (int32 iter = 0; iter < 5; iter++) {
+    Vector<double> mu_h(dim), mu_z(dim), var_z(dim);
+    mu_h.SetRandn();
+    mu_h.Scale(0.1);
+    mu_z.SetRandn();
+    var_z.SetRandn();
+    var_z.ApplyExp();
+
+    // CompensateDiagGmm, with and without the Jacobians.
+    DiagGmm gmm;
+    InitRandomGmm(dim, &gmm);
+    DiagGmm ref_gmm(gmm);
+    std::vector<Matrix<double> > ref_Jx, ref_Jz;
+    CompensateGmmSimple(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                        inv_dct_mat, &ref_gmm, &ref_Jx, &ref_Jz);
+    for (int32 keep = 0; keep < 2; keep++) {
+      DiagGmm this_gmm(gmm);
+      int32 num_gauss = (keep ? gmm.NumGauss() : 0);
+      std::vector<Matrix<double> > Jx(num_gauss), Jz(num_gauss);
+      CompensateDiagGmm(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                        inv_dct_mat, this_gmm, Jx, Jz);
+      AssertGmmEqual(ref_gmm, this_gmm);
+      for (int32 g = 0; g < num_gauss; g++) {
+        KALDI_ASSERT(Jx[g].ApproxEqual(ref_Jx[g], 1.0e-06));
+        KALDI_ASSERT(Jz[g].ApproxEqual(ref_Jz[g], 1.0e-06));
+      }
+    }
+
+    // CompensateModel, which splits the pdfs between threads and needs the
+    // Jacobians at the right offsets.
+    int32 num_pdfs = 1 + rand() % 5;
+    AmDiagGmm am_gmm, ref_am_gmm;
+    ref_Jx.clear();
+    ref_Jz.clear();
+    for (int32 pdf = 0; pdf < num_pdfs; pdf++) {
+      DiagGmm pdf_gmm;
+      InitRandomGmm(dim, &pdf_gmm);
+      am_gmm.AddPdf(pdf_gmm);
+      CompensateGmmSimple(mu_h, mu_z, var_z, num_cepstral, num_fbank,
+                          dct_mat, inv_dct_mat, &pdf_gmm, &ref_Jx, &ref_Jz);
+      ref_am_gmm.AddPdf(pdf_gmm);
+    }
+    for (int32 keep = 0; keep < 2; keep++) {
+      AmDiagGmm this_am_gmm;
+      this_am_gmm.CopyFromAmDiagGmm(am_gmm);
+      int32 num_gauss = (keep ? am_gmm.NumGauss() : 0);
+      std::vector<Matrix<double> > Jx(num_gauss), Jz(num_gauss);
+      g_num_threads = 1 + rand() % 3;
+      CompensateModel(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                      inv_dct_mat, this_am_gmm, Jx, Jz);
+      for (int32 pdf = 0; pdf < num_pdfs; pdf++)
+        AssertGmmEqual(ref_am_gmm.GetPdf(pdf), this_am_gmm.GetPdf(pdf));
+      for (int32 g = 0; g < num_gauss; g++) {
+        KALDI_ASSERT(Jx[g].ApproxEqual(ref_Jx[g], 1.0e-06));
+        KALDI_ASSERT(Jz[g].ApproxEqual(ref_Jz[g], 1.0e-06));
+      }
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestCompensateDiagGmm();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -8,6 +8,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/timer.h"
+#include "thread/kaldi-thread.h"
 #include "gmm/am-diag-gmm.h"
 #include "gmm/diag-gmm-normal.h"
 #include "gmm/decodable-am-diag-gmm.h"
@@ -324,6 +325,104 @@ void CompensateDiagGaussian(const Vector<double> &mu_h,
   }
 }
 
+/*
+ * Row k of the returned matrix holds the num_cepstral x num_cepstral matrix
+ * dct_mat(:, k) * inv_dct_mat(k, :), row by row.  Since the Jacobian of the
+ * mismatch function is Jx = C * diag(w) * C_inv, with
+ * w = 1 / ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) ), the Jacobians of a
+ * set of Gaussians are the rows of W * basis, W having the w's as rows.
+ */
+static void ComputeJacobianBasis(const Matrix<double> &dct_mat,
+                                 const Matrix<double> &inv_dct_mat,
+                                 Matrix<double> *basis) {
+  int32 num_cepstral = dct_mat.NumRows(), num_fbank = dct_mat.NumCols();
+  basis->Resize(num_fbank, num_cepstral * num_cepstral, kUndefined);
+  for (int32 k = 0; k < num_fbank; ++k)
+    for (int32 ii = 0; ii < num_cepstral; ++ii)
+      for (int32 jj = 0; jj < num_cepstral; ++jj)
+        (*basis)(k, ii * num_cepstral + jj) = dct_mat(ii, k) * inv_dct_mat(k, jj);
+}
+
+/*
+ * Compensates all the Gaussians of a GMM at once; this gives the same result
+ * as CompensateDiagGaussian() on each of them.  The nonlinearity is computed
+ * on the matrix of means, and the Jacobians as one matrix product with the
+ * basis from ComputeJacobianBasis().  The Jacobians are stored in Jx[g] and
+ * Jz[g] if Jx and Jz are not NULL.
+ */
+static void CompensateDiagGmmBatch(const Vector<double> &mu_h,
+                                   const Vector<double> &mu_z,
+                                   const Vector<double> &var_z,
+                                   int32 num_cepstral,
+                                   int32 num_fbank,
+                                   const Matrix<double> &dct_mat,
+                                   const Matrix<double> &inv_dct_mat,
+                                   const Matrix<double> &jacobian_basis,
+                                   DiagGmm *gmm,
+                                   Matrix<double> *Jx,
+                                   Matrix<double> *Jz) {
+  DiagGmmNormal ngmm(*gmm);
+  int32 num_gauss = gmm->NumGauss(), n = num_cepstral;
+  KALDI_ASSERT(ngmm.means_.NumCols() >= 3 * n && var_z.Dim() >= 3 * n);
+
+  SubMatrix<double> mu_s(ngmm.means_, 0, num_gauss, 0, n);
+  // log ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) ), and the inverses of
+  // 1 + exp( C_inv * (mu_n - mu_x - mu_h) ), one row per Gaussian.
+  Matrix<double> mu_y_s(mu_s), log_fbank(num_gauss, num_fbank),
+      inv_fbank(num_gauss, num_fbank);
+  mu_y_s.Scale(-1.0);
+  mu_y_s.AddVecToRows(1.0, SubVector<double>(mu_z, 0, n));
+  mu_y_s.AddVecToRows(-1.0, SubVector<double>(mu_h, 0, n));  // mu_n - mu_x - mu_h
+  log_fbank.AddMatMat(1.0, mu_y_s, kNoTrans, inv_dct_mat, kTrans, 0.0);
+  log_fbank.ApplyExp();
+  log_fbank.Add(1.0);
+  inv_fbank.CopyFromMat(log_fbank);
+  log_fbank.ApplyLog();
+  inv_fbank.InvertElements();
+
+  // The Jacobians, one per row.
+  Matrix<double> jx(num_gauss, n * n);
+  jx.AddMatMat(1.0, inv_fbank, kNoTrans, jacobian_basis, kNoTrans, 0.0);
+
+  // new static means: mu_x + mu_h + C * log ( 1 + exp( C_inv * (mu_n - mu_x - mu_h) ) )
+  mu_s.AddVecToRows(1.0, SubVector<double>(mu_h, 0, n));
+  mu_s.AddMatMat(1.0, log_fbank, kNoTrans, dct_mat, kTrans, 1.0);
+
+  Vector<double> tmp_mu(n);
+  Matrix<double> jx2(n, n), jz2(n, n);
+  for (int32 g = 0; g < num_gauss; ++g) {
+    SubMatrix<double> this_jx(jx.RowData(g), n, n, n);
+    // The dynamic means are multiplied by Jx.
+    for (int32 b = 1; b < 3; ++b) {
+      SubVector<double> mu_dyn(ngmm.means_.Row(g), b * n, n);
+      tmp_mu.CopyFromVec(mu_dyn);
+      mu_dyn.AddMatVec(1.0, this_jx, kNoTrans, tmp_mu, 0.0);
+    }
+    // diag( Jx * diag(var_x) * Jx^T + Jz * diag(var_z) * Jz^T ) is
+    // (Jx .* Jx) * var_x + (Jz .* Jz) * var_z.
+    jx2.CopyFromMat(this_jx);
+    jz2.CopyFromMat(this_jx);
+    for (int32 ii = 0; ii < n; ++ii)
+      jz2(ii, ii) = 1.0 - jz2(ii, ii);
+    if (Jx != NULL) {
+      Jx[g] = jx2;
+      Jz[g] = jz2;
+    }
+    jx2.ApplyPow(2.0);
+    jz2.ApplyPow(2.0);
+    for (int32 b = 0; b < 3; ++b) {
+      SubVector<double> x_var(ngmm.vars_.Row(g), b * n, n);
+      SubVector<double> n_var(var_z, b * n, n);
+      tmp_mu.CopyFromVec(x_var);
+      x_var.AddMatVec(1.0, jx2, kNoTrans, tmp_mu, 0.0);
+      x_var.AddMatVec(1.0, jz2, kNoTrans, n_var, 1.0);
+    }
+  }
+
+  ngmm.CopyToDiagGmm(gmm);
+  gmm->ComputeGconsts();
+}
+
 /*
  * Do the compensation using the current noise model parameters for a diagonal GMM.
  * Also keep the statistics of the Jx, and Jz for next iteration of noise estimation.
@@ -341,31 +440,61 @@ void CompensateDiagGmm(const Vector<double> &mu_h,
                        DiagGmm &noise_gmm,
                        std::vector<Matrix<double> > &Jx,
                        std::vector<Matrix<double> > &Jz) {
+  Matrix<double> jacobian_basis;
+  ComputeJacobianBasis(dct_mat, inv_dct_mat, &jacobian_basis);
+  bool keep_jacobians = !Jx.empty();
+  KALDI_ASSERT(!keep_jacobians || (Jx.size() >= noise_gmm.NumGauss() &&
+                                   Jz.size() >= noise_gmm.NumGauss()));
+  CompensateDiagGmmBatch(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                         inv_dct_mat, jacobian_basis, &noise_gmm,
+                         keep_jacobians ? &(Jx[0]) : NULL,
+                         keep_jacobians ? &(Jz[0]) : NULL);
+}
 
-//KALDI_LOG << "Beginning compensate model ...";
-
-// iterate all the Gaussians
-  DiagGmmNormal ngmm(noise_gmm);
-
-  int32 num_gauss = noise_gmm.NumGauss();
-  for (int32 g = 0; g < num_gauss; ++g) {
-
-    //KALDI_LOG << "pdf_id: " << pdf << ", gauss_id: " << g;
-
-    Vector<double> cur_mean(ngmm.means_.Row(g));
-    Vector<double> cur_var(ngmm.vars_.Row(g));
-    CompensateDiagGaussian(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
-                           inv_dct_mat,
-                           cur_mean, cur_var, Jx[g], Jz[g]);
-    ngmm.means_.CopyRowFromVec(cur_mean, g);
-    ngmm.vars_.CopyRowFromVec(cur_var, g);
+// Compensates the pdfs of an AmDiagGmm, split between the threads.
+class CompensateModelClass: public MultiThreadable {
+ public:
+  CompensateModelClass(const Vector<double> &mu_h,
+                       const Vector<double> &mu_z,
+                       const Vector<double> &var_z,
+                       int32 num_cepstral,
+                       int32 num_fbank,
+                       const Matrix<double> &dct_mat,
+                       const Matrix<double> &inv_dct_mat,
+                       const Matrix<double> &jacobian_basis,
+                       AmDiagGmm *am_gmm,
+                       std::vector<Matrix<double> > *Jx,
+                       std::vector<Matrix<double> > *Jz):
+      mu_h_(mu_h), mu_z_(mu_z), var_z_(var_z), num_cepstral_(num_cepstral),
+      num_fbank_(num_fbank), dct_mat_(dct_mat), inv_dct_mat_(inv_dct_mat),
+      jacobian_basis_(jacobian_basis), am_gmm_(am_gmm), Jx_(Jx), Jz_(Jz),
+      gauss_offsets_(am_gmm->NumPdfs(), 0) {
+    for (int32 pdf = 1; pdf < am_gmm->NumPdfs(); ++pdf)
+      gauss_offsets_[pdf] = gauss_offsets_[pdf - 1] +
+          am_gmm->NumGaussInPdf(pdf - 1);
   }
 
-  ngmm.CopyToDiagGmm(&noise_gmm);
-  noise_gmm.ComputeGconsts();
+  void operator() () {
+    bool keep_jacobians = !Jx_->empty();
+    for (int32 pdf = thread_id_; pdf < am_gmm_->NumPdfs();
+         pdf += num_threads_) {
+      int32 offset = gauss_offsets_[pdf];
+      CompensateDiagGmmBatch(mu_h_, mu_z_, var_z_, num_cepstral_, num_fbank_,
+                             dct_mat_, inv_dct_mat_, jacobian_basis_,
+                             &(am_gmm_->GetPdf(pdf)),
+                             keep_jacobians ? &((*Jx_)[offset]) : NULL,
+                             keep_jacobians ? &((*Jz_)[offset]) : NULL);
+    }
+  }
 
-//KALDI_LOG << "Model compensation done!";
-}
+ private:
+  const Vector<double> &mu_h_, &mu_z_, &var_z_;
+  int32 num_cepstral_, num_fbank_;
+  const Matrix<double> &dct_mat_, &inv_dct_mat_, &jacobian_basis_;
+  AmDiagGmm *am_gmm_;
+  std::vector<Matrix<double> > *Jx_, *Jz_;
+  std::vector<int32> gauss_offsets_;  // index of the first Gaussian of each pdf.
+};
 
 /*
  * Do the compensation using the current noise model parameters.
@@ -384,36 +513,13 @@ void CompensateModel(const Vector<double> &mu_h,
                      AmDiagGmm &noise_am_gmm,
                      std::vector<Matrix<double> > &Jx,
                      std::vector<Matrix<double> > &Jz) {
-
-  //KALDI_LOG << "Beginning compensate model ...";
-
-  // iterate all the GMMs
-  int32 num_pdf = noise_am_gmm.NumPdfs();
-  for (int32 pdf = 0, tot_gauss_id = 0; pdf < num_pdf; ++pdf) {
-    // iterate all the Gaussians
-    DiagGmm *gmm = &(noise_am_gmm.GetPdf(pdf));
-    DiagGmmNormal ngmm(*gmm);
-
-    int32 num_gauss = gmm->NumGauss();
-    for (int32 g = 0; g < num_gauss; ++g, ++tot_gauss_id) {
-
-      //KALDI_LOG << "pdf_id: " << pdf << ", gauss_id: " << g;
-
-      Vector<double> cur_mean(ngmm.means_.Row(g));
-      Vector<double> cur_var(ngmm.vars_.Row(g));
-      CompensateDiagGaussian(mu_h, mu_z, var_z, num_cepstral, num_fbank,
-                             dct_mat, inv_dct_mat, cur_mean, cur_var,
-                             Jx[tot_gauss_id],
-                             Jz[tot_gauss_id]);
-      ngmm.means_.CopyRowFromVec(cur_mean, g);
-      ngmm.vars_.CopyRowFromVec(cur_var, g);
-    }
-
-    ngmm.CopyToDiagGmm(gmm);
-    gmm->ComputeGconsts();
-  }
-
-  //KALDI_LOG << "Model compensation done!";
+  KALDI_ASSERT(Jx.empty() || (Jx.size() == noise_am_gmm.NumGauss() &&
+                              Jz.size() == noise_am_gmm.NumGauss()));
+  Matrix<double> jacobian_basis;
+  ComputeJacobianBasis(dct_mat, inv_dct_mat, &jacobian_basis);
+  CompensateModelClass c(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
+                         inv_dct_mat, jacobian_basis, &noise_am_gmm, &Jx, &Jz);
+  RunMultiThreaded(c);
 }
 
 /*
@@ -100,7 +100,10 @@ void CompensateDiagGaussian(const Vector<double> &mu_h,
 /*
  * Compensate a Diagonal Gaussian Mixture model.
  *
- * noise_gmm is inputed as clean GMM and compensated by this function
+ * noise_gmm is inputed as clean GMM and compensated by this function.
+ * All the Gaussians are compensated at once, with matrix operations; the result
+ * is the same as CompensateDiagGaussian() on each of them.
+ * If Jx and Jz are empty, the Jacobians are not kept.
  *
  */
 void CompensateDiagGmm(const Vector<double> &mu_h, const Vector<double> &mu_z,
@@ -124,7 +127,9 @@ void CompensateDiagGmm(const Vector<double> &mu_h, const Vector<double> &mu_z,
  *      i.e. the clean speech mean;
  * Jz: the per-Gaussian component Jacobian of the mismatch function with respect to z,
  *      i.e. the additive noise mean;
+ * If Jx and Jz are empty, the Jacobians are not kept (e.g. for decoding).
  *
+ * The pdfs are compensated in parallel, using g_num_threads threads.
  *
  */
 void CompensateModel(const Vector<double> &mu_h, const Vector<double> &mu_z,
@@ -19,6 +19,7 @@
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
 #include "gmm/diag-gmm-normal.h"
 #include "vts/vts-first-order.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -87,6 +88,8 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "Produce output even when final state was not reached");
+    po.Register("num-threads", &g_num_threads,
+                "Number of threads used for the model compensation");
     po.Read(argc, argv);
 
     if (po.NumArgs() < 5 || po.NumArgs() > 7) {
@@ -194,7 +197,7 @@ int main(int argc, char *argv[]) {
       // Initialize with the clean speech model
       noise_am_gmm.CopyFromAmDiagGmm(am_gmm);
 
-      std::vector<Matrix<double> > Jx(am_gmm.NumGauss()), Jz(am_gmm.NumGauss());  // not necessary for compensation only
+      std::vector<Matrix<double> > Jx, Jz;  // empty: not needed for decoding
       CompensateModel(mu_h, mu_z, var_z, num_cepstral, num_fbank, dct_mat,
                       inv_dct_mat, noise_am_gmm, Jx, Jz);
 